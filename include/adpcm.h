@@ -0,0 +1,22 @@
+#pragma once
+#include <Arduino.h>
+
+// ADPCM block decoders for WAV (IMA/DVI 0x11 and Microsoft 0x02).
+// Each call decodes one self-contained block into interleaved 16-bit PCM;
+// a short final block is decoded as far as its bytes go.
+
+static const uint16_t WAV_FORMAT_MS_ADPCM  = 0x0002;
+static const uint16_t WAV_FORMAT_IMA_ADPCM = 0x0011;
+
+// Coefficient pairs held for MS-ADPCM (the 7 standard ones plus custom).
+static const int ADPCM_MS_MAX_COEFS = 16;
+
+// Frames per block implied by blockAlign when the fmt chunk omits it.
+uint32_t adpcmImaFramesPerBlock(uint32_t blockAlign, uint16_t channels);
+uint32_t adpcmMsFramesPerBlock(uint32_t blockAlign, uint16_t channels);
+
+// Decode one block. Returns frames written (at most maxFrames).
+size_t adpcmImaDecodeBlock(const uint8_t* block, size_t bytes, uint16_t channels, int16_t* out,
+                           size_t maxFrames);
+size_t adpcmMsDecodeBlock(const uint8_t* block, size_t bytes, uint16_t channels,
+                          const int16_t (*coefs)[2], int numCoefs, int16_t* out, size_t maxFrames);
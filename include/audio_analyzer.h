@@ -0,0 +1,33 @@
+#pragma once
+#include <Arduino.h>
+
+// Audio analyzer module.
+// The audio task copies each output block into a lock-free tap; a task on
+// core 0 computes peak/RMS meters and a log-binned FFT spectrum from it and
+// packs the result into a compact binary frame for the web panel.
+
+// Number of log-spaced spectrum bins in a frame.
+static const int ANALYZER_BINS = 32;
+
+// Binary frame layout (little-endian), served by /spectrum:
+//   u8  version (1)      u8  binCount
+//   u16 sequence         u16 sampleRate / 10
+//   i16 peakL, peakR, rmsL, rmsR   (dBFS * 100)
+//   u16 analysisUs       u8  updateHz    u8 fftLog2
+//   u8  bins[binCount]   (0 = -90 dBFS .. 255 = 0 dBFS)
+static const size_t ANALYZER_FRAME_HEADER = 20;
+static const size_t ANALYZER_FRAME_SIZE   = ANALYZER_FRAME_HEADER + ANALYZER_BINS;
+
+// Start the analysis task on core 0. fftSize must be 256 or 512.
+void analyzerBegin(int fftSize);
+
+// Called by the audio task with the final interleaved stereo output.
+// Only copies into the tap ring; never blocks.
+void analyzerTap(const int16_t* stereo, size_t frames, uint32_t sampleRate);
+
+// Copy the latest frame into out (ANALYZER_FRAME_SIZE bytes).
+// Returns false if no frame has been produced yet.
+bool analyzerGetFrame(uint8_t* out);
+
+// Get analysis cost stats as JSON.
+String analyzerGetStatsJson();
@@ -0,0 +1,92 @@
+#pragma once
+#include <Arduino.h>
+
+// Audio decoder interface and registry.
+// Every codec implements IAudioDecoder; the playback engine only talks to
+// this interface, so new formats plug in through the registry without
+// touching the engine. Formats are detected from magic bytes, not from the
+// file extension.
+
+// Stream parameters reported by a decoder after open().
+struct AudioStreamInfo {
+  uint32_t sampleRate    = 0;
+  uint16_t channels      = 0; // Channels in the decoded PCM.
+  uint16_t bitsPerSample = 0; // Source resolution (decoded PCM is always 16-bit).
+  uint32_t channelMask   = 0; // Speaker mask for downmix (0 = default layout).
+  uint64_t totalBytes    = 0; // Encoded payload size, for progress.
+  uint32_t totalMs       = 0; // Duration (0 = unknown).
+  uint32_t loopStartMs   = 0; // Sample loop the decoder repeats (end 0 = none).
+  uint32_t loopEndMs     = 0;
+};
+
+static const int AUDIO_MARKER_LABEL_LEN = 24;
+
+// Named position in a stream (WAV cue points), for navigation.
+struct AudioMarker {
+  uint32_t id;
+  uint32_t ms;
+  char     label[AUDIO_MARKER_LABEL_LEN];
+};
+
+class IAudioDecoder
+{
+public:
+  virtual ~IAudioDecoder() {}
+
+  // Short codec name for logs ("WAV", "MP3", ...).
+  virtual const char* name() const = 0;
+
+  // Open and parse the stream. Returns false on unsupported/invalid input.
+  virtual bool open(const String& path) = 0;
+
+  // Stream parameters, valid after a successful open().
+  virtual const AudioStreamInfo& info() const = 0;
+
+  // Decode up to maxFrames interleaved 16-bit frames (info().channels wide).
+  // Returns the number of frames produced; 0 means end of stream or error.
+  virtual size_t decode(int16_t* out, size_t maxFrames) = 0;
+
+  // Seek to a position in milliseconds. Returns false if not supported.
+  virtual bool seek(uint32_t ms) = 0;
+
+  // Encoded bytes consumed and playback position, for progress.
+  virtual uint64_t positionBytes() const = 0;
+  virtual uint32_t positionMs() const    = 0;
+
+  // Markers sorted by position; returns the count and sets *out (0 if none).
+  virtual size_t markers(const AudioMarker** out) const
+  {
+    *out = nullptr;
+    return 0;
+  }
+
+  // Release the file and all buffers.
+  virtual void close() = 0;
+};
+
+// Registry entry for one codec.
+struct AudioDecoderEntry {
+  const char* name;
+  const char* extensions; // Space-separated, lower case, with dot (".wav .wave").
+  bool (*probe)(const uint8_t* head, size_t len);
+  IAudioDecoder* (*create)();
+  bool decodeAhead; // Costly to decode: run on core 0 through a PCM ring.
+};
+
+// Number of header bytes passed to probe().
+static const size_t DECODER_PROBE_BYTES = 16;
+
+// Register a codec. Built-in codecs are registered on first use.
+bool decoderRegister(const AudioDecoderEntry& entry);
+
+// Sniff the file header and return the matching codec, or nullptr.
+const AudioDecoderEntry* decoderProbeFile(const String& path);
+
+// Create and open a decoder for the file. Returns nullptr on failure.
+// Codecs flagged decodeAhead are wrapped with a ring of decodeAheadMs
+// (0 disables). The caller owns the decoder and must close() and delete it.
+IAudioDecoder* decoderOpen(const String& path, uint32_t decodeAheadMs);
+
+// Check the extension against all registered codecs (for listings, where
+// opening every file would be too slow).
+bool decoderKnowsExtension(const String& path);
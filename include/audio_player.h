@@ -4,7 +4,7 @@
 // Start playback with current file from settings.
 void audioStart();
 
-// Start playback of specific file (WAV or MP3).
+// Start playback of specific file (any format in the decoder registry).
 // Also saves the file as default in settings.json.
 void audioStartFile(const String& path);
 
@@ -14,8 +14,12 @@ void audioStop();
 // Restart playback (stop + start).
 void audioRestart();
 
+// Request a seek to ms in the current track (applied by the audio task).
+// Returns false if nothing is playing.
+bool audioSeekMs(uint32_t ms);
+
 // Check if audio is currently playing.
 bool audioIsRunning();
 
-// Check if file format is supported (WAV or MP3).
+// Check if file format is supported (sniffs the file header).
 bool audioIsSupportedFormat(const String& path);
@@ -1,12 +1,17 @@
 #pragma once
+#include "audio_decoder.h"
+
 #include <Arduino.h>
 
 // Audio Progress module.
 // Tracks playback position and provides progress info for UI.
 
+// Markers kept for the current track.
+static const int PROGRESS_MAX_MARKERS = 32;
+
 struct AudioProgressInfo {
-  uint32_t totalBytes;    // Total data size in bytes.
-  uint32_t playedBytes;   // Bytes played so far.
+  uint64_t totalBytes;    // Total data size in bytes.
+  uint64_t playedBytes;   // Bytes played so far.
   uint32_t totalMs;       // Total duration in milliseconds.
   uint32_t playedMs;      // Played duration in milliseconds.
   uint8_t  percent;       // Progress 0-100%.
@@ -15,6 +20,11 @@ struct AudioProgressInfo {
   uint32_t sampleRate;    // Sample rate of current file.
   uint16_t channels;      // Number of channels.
   uint16_t bitsPerSample; // Bits per sample.
+  uint32_t loopStartMs;   // Active sample loop (loopEndMs 0 = none).
+  uint32_t loopEndMs;
+  uint8_t  markerCount;   // Cue markers of the current track.
+
+  AudioMarker markers[PROGRESS_MAX_MARKERS];
 };
 
 // Global progress info (updated by audio_player).
@@ -24,11 +34,22 @@ extern AudioProgressInfo g_audioProgress;
 void progressInit();
 
 // Reset progress (call when starting new file).
-void progressReset(const String& fileName, uint32_t totalBytes, uint32_t sampleRate,
+void progressReset(const String& fileName, uint64_t totalBytes, uint32_t sampleRate,
                    uint16_t channels, uint16_t bitsPerSample);
 
 // Update progress (call during playback).
-void progressUpdate(uint32_t playedBytes);
+void progressUpdate(uint64_t playedBytes);
+
+// Update progress from a decoder that knows its own time position
+// (compressed formats, where bytes do not map linearly to time).
+void progressUpdatePosition(uint64_t playedBytes, uint32_t playedMs);
+
+// Attach the decoder's loop region and cue markers (after progressReset).
+void progressSetStreamMarks(uint32_t loopStartMs, uint32_t loopEndMs, const AudioMarker* markers,
+                            size_t count);
+
+// Find a marker of the current track by id. Returns false if unknown.
+bool progressFindMarker(uint32_t id, uint32_t& ms);
 
 // Mark playback as stopped.
 void progressStop();
@@ -37,5 +58,5 @@ void progressStop();
 String progressGetJson();
 
 // Calculate duration from bytes.
-uint32_t progressBytesToMs(uint32_t bytes, uint32_t sampleRate, uint16_t channels,
+uint32_t progressBytesToMs(uint64_t bytes, uint32_t sampleRate, uint16_t channels,
                            uint16_t bitsPerSample);
@@ -0,0 +1,10 @@
+#pragma once
+#include <Arduino.h>
+
+// CRC-32 (IEEE 802.3, reflected 0xEDB88320), the zlib/PNG/gzip checksum.
+// Slice-by-8: eight bytes per step through eight 256-entry tables (8 KB,
+// built on first use).
+
+// Continue a running CRC over len bytes. Start with crc = 0; the result
+// matches zlib's crc32(crc, data, len).
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len);
@@ -0,0 +1,29 @@
+#pragma once
+#include "audio_decoder.h"
+
+// Decode-ahead module.
+// Wraps a decoder so it runs on core 0 and writes PCM into a lock-free
+// single-producer/single-consumer ring; the audio task on core 1 only
+// drains the ring. Used for compressed codecs whose decode cost would
+// otherwise stall I2S output.
+
+struct DecodeAheadStats {
+  bool     active;        // A wrapped decoder is running.
+  uint32_t sampleRate;    // Rate of the wrapped stream.
+  uint32_t ringFrames;    // Ring capacity in frames.
+  uint32_t fillFrames;    // Frames currently buffered.
+  uint32_t minFillFrames; // Lowest fill seen since the track started.
+  uint32_t underruns;     // Times the audio task found the ring empty.
+  uint32_t decodeCalls;   // Inner decode calls.
+  uint32_t decodeUs;      // Total time spent in the inner decoder.
+  uint32_t decodedFrames; // Total frames produced by the inner decoder.
+};
+
+extern DecodeAheadStats g_decodeAheadStats;
+
+// Wrap inner with a ring holding ringMs of audio. Takes ownership of inner.
+// Returns inner unchanged if the ring or task cannot be created.
+IAudioDecoder* decodeAheadWrap(IAudioDecoder* inner, uint32_t ringMs);
+
+// Get stats as JSON.
+String decodeAheadGetStatsJson();
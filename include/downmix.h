@@ -0,0 +1,43 @@
+#pragma once
+#include <Arduino.h>
+
+// Multichannel downmix module.
+// Reduces up to 8 interleaved input channels to stereo with a 2 x N matrix.
+// Defaults follow ITU-R BS.775 (centre and surrounds at -3 dB, LFE dropped).
+
+static const int DOWNMIX_MAX_CHANNELS = 8;
+
+// WAVE channel mask speaker bits (dwChannelMask order).
+static const uint32_t SPEAKER_FRONT_LEFT            = 0x1;
+static const uint32_t SPEAKER_FRONT_RIGHT           = 0x2;
+static const uint32_t SPEAKER_FRONT_CENTER          = 0x4;
+static const uint32_t SPEAKER_LOW_FREQUENCY         = 0x8;
+static const uint32_t SPEAKER_BACK_LEFT             = 0x10;
+static const uint32_t SPEAKER_BACK_RIGHT            = 0x20;
+static const uint32_t SPEAKER_FRONT_LEFT_OF_CENTER  = 0x40;
+static const uint32_t SPEAKER_FRONT_RIGHT_OF_CENTER = 0x80;
+static const uint32_t SPEAKER_BACK_CENTER           = 0x100;
+static const uint32_t SPEAKER_SIDE_LEFT             = 0x200;
+static const uint32_t SPEAKER_SIDE_RIGHT            = 0x400;
+
+// Downmix matrix: coeffs[out][in], out 0 = L, out 1 = R.
+struct DownmixMatrix {
+  bool  valid; // Set for custom matrices loaded from settings.json.
+  float coeffs[2][DOWNMIX_MAX_CHANNELS];
+};
+
+// Default speaker mask for a channel count (WAVE_FORMAT_PCM ordering).
+uint32_t downmixDefaultMask(uint16_t channels);
+
+// Fill an ITU default matrix for the given layout, normalized so no output
+// can exceed full scale. channelMask = 0 uses downmixDefaultMask().
+void downmixSetDefaults(DownmixMatrix& m, uint16_t channels, uint32_t channelMask);
+
+// Prepare the mixer for a track (custom matrix from settings if present).
+// Returns false for unsupported channel counts (2..8 are supported).
+bool downmixInit(uint16_t channels, uint32_t channelMask);
+
+// Mix interleaved frames to stereo. Works in place (dst may equal src):
+// each output frame is written behind the input frame it is read from.
+// Returns number of stereo frames written.
+size_t downmixProcess(const int16_t* src, size_t frames, int16_t* dst);
@@ -0,0 +1,57 @@
+#pragma once
+#include <Arduino.h>
+
+// DSP chain planner.
+// Picks the cheapest valid stage order for the current track (downmix early,
+// EQ at the lower of source/output rate, volume folded into EQ) and runs it.
+
+// Chain stages.
+enum DspStage : uint8_t {
+  DSP_STAGE_DOWNMIX,  // Stereo -> mono (in place).
+  DSP_STAGE_GAIN,     // Volume.
+  DSP_STAGE_EQ,       // Equalizer (optionally with volume folded into stage 0).
+  DSP_STAGE_RESAMPLE, // Sample rate conversion into the resample buffer.
+  DSP_STAGE_EXPAND,   // Mono -> interleaved stereo for I2S (in place).
+};
+
+static const int DSP_MAX_STAGES = 6;
+
+// What the planner needs to know about the track and the enabled stages.
+struct DspPlanInput {
+  uint32_t srcRate;      // Source sample rate.
+  uint16_t srcChannels;  // 1 or 2.
+  uint32_t outRate;      // I2S rate (== srcRate when not resampling).
+  bool     resample;     // Resampler active.
+  bool     resampleHold; // Resampler uses the cheap zero-order hold tier.
+  int      eqBands;      // Active EQ bands (0 = EQ off or flat).
+  bool     forceMono;    // Run DSP on a mono downmix (adaptive quality).
+  bool     dualCore;     // Core-0 worker may take one channel of heavy stages.
+};
+
+struct DspPlan {
+  DspStage stages[DSP_MAX_STAGES];
+  uint8_t  stageCount;
+  uint8_t  dspChannels;     // Channels the chain runs on (1 or 2).
+  bool     gainFolded;      // Volume is applied through EQ stage-0 coefficients.
+  bool     splitEq;         // EQ channels are split across both cores.
+  uint32_t eqRate;          // Rate the EQ runs at (coefficients are computed for it).
+  uint32_t estCyclesPerSec; // Estimated CPU cycles per second of audio.
+  DspPlanInput input;       // Input the plan was built from.
+};
+
+// Build the cheapest valid plan for the given input.
+DspPlan dspPlanBuild(const DspPlanInput& in);
+
+// True if the plan was built from an equal input (no rebuild needed).
+bool dspPlanMatches(const DspPlan& plan, const DspPlanInput& in);
+
+// Log the plan and its estimated cost.
+void dspPlanLog(const DspPlan& plan);
+
+// Run the plan on one chunk.
+// buf: source frames in source layout, capacity >= 2 * frames samples.
+// resampleBuf: stereo buffer with resampleMaxFrames frames (used if resampling).
+// out: receives the buffer holding the final interleaved stereo frames.
+// Returns: number of stereo frames in *out.
+size_t dspPlanRun(const DspPlan& plan, int16_t* buf, size_t frames, float volume,
+                  int16_t* resampleBuf, size_t resampleMaxFrames, int16_t** out);
@@ -0,0 +1,28 @@
+#pragma once
+#include <Arduino.h>
+
+// Dual-core DSP worker.
+// A task pinned to core 0 takes one channel of heavy stages while the audio
+// task on core 1 processes the other. Hand-off uses a task notification to the
+// worker and a binary semaphore back; no mutex is taken on the sample path.
+
+struct DspWorkerStats {
+  uint32_t jobs;     // Split jobs completed.
+  uint32_t workerUs; // Total time the worker spent processing.
+  uint32_t waitUs;   // Total time the audio task waited for the worker.
+};
+
+extern DspWorkerStats g_dspWorkerStats;
+
+// Start the worker task on core 0 (call once in setup).
+void dspWorkerBegin();
+
+// True if the worker task is running.
+bool dspWorkerReady();
+
+// Run EQ on an interleaved stereo buffer: L on the calling core, R on the
+// worker. Falls back to single-core processing if the worker is not running.
+void dspWorkerEqStereo(int16_t* buffer, size_t frames, uint32_t sampleRate);
+
+// Get stats as JSON.
+String dspWorkerGetStatsJson();
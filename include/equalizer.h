@@ -30,9 +30,36 @@ void eqProcessSample(int16_t& L, int16_t& R, uint32_t sampleRate);
 // Apply EQ to a buffer of stereo samples.
 void eqProcessBuffer(int16_t* buffer, size_t frames, uint32_t sampleRate);
 
-// Recalculate filter coefficients (call after changing settings).
+// Apply EQ to a buffer of mono samples (uses the left channel filter state).
+void eqProcessMono(int16_t* buffer, size_t frames, uint32_t sampleRate);
+
+// Apply pending setting changes and recalculate coefficients if the sample rate
+// changed. Must be called before eqProcessChannel() and never concurrently with it.
+void eqPrepare(uint32_t sampleRate);
+
+// Apply EQ to one channel of an interleaved buffer (stride = samples per frame).
+// Different channels may be processed concurrently from different cores.
+void eqProcessChannel(int16_t* buffer, size_t frames, int stride, int ch);
+
+// Clear filter history (delay lines) of all bands.
+void eqResetState();
+
+// Recalculate filter coefficients (call after changing settings). Safe from any
+// task: the new coefficients are built by the audio task at its next eqPrepare().
 void eqUpdateCoefficients(uint32_t sampleRate);
 
+// Limit processing to the N strongest bands (1-5). Flat bands are always skipped.
+// Like eqUpdateCoefficients(), applied at the next eqPrepare().
+void eqSetMaxBands(int count);
+
+// Number of bands processed per sample, including changes not yet applied by
+// eqPrepare(). Safe from any task.
+int eqGetActiveBandCount();
+
+// Linear gain folded into the first processed band (1.0 = none).
+// Lets the volume stage be skipped when EQ runs anyway.
+void eqSetInputGain(float gain);
+
 // Get/set individual band (index 0-4).
 float eqGetBand(int index);
 void  eqSetBand(int index, float gainDb);
@@ -0,0 +1,8 @@
+#pragma once
+#include "audio_decoder.h"
+
+// FLAC decoder: streaming frame decoder (fixed and LPC subframes, Rice
+// residuals, stereo decorrelation) for 8..24-bit streams, with
+// SEEKTABLE-based seek. Memory is allocated once at open and bounded by
+// channels x max block size.
+const AudioDecoderEntry& flacDecoderEntry();
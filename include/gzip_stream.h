@@ -0,0 +1,48 @@
+#pragma once
+#include <Arduino.h>
+
+// Streaming gzip decoder.
+// Fed compressed data in chunks of any size as it arrives, it hands out
+// the inflated bytes through a callback. Inflation uses the tinfl decoder
+// in the ESP32 ROM with a fixed 32 KB circular window, so memory stays at
+// about 43 KB however large the file. The trailer's CRC-32 and length are
+// checked.
+
+// Receives the next piece of output; return false to stop.
+typedef bool (*GzipSinkFn)(const uint8_t* data, size_t len, void* ctx);
+
+struct GzipInflate;
+
+struct GzipStream {
+  GzipInflate* inflate; // Decoder state and window (heap).
+  GzipSinkFn   sink;
+  void*        ctx;
+  int          state;
+  uint8_t      flags;   // Header FLG byte.
+  uint8_t      buf[10]; // Header or trailer bytes collected.
+  size_t       fill;
+  size_t       skip;    // Bytes of the extra field left.
+  uint32_t     crc;     // CRC-32 of the output so far.
+  uint64_t     inBytes;
+  uint64_t     outBytes;
+  const char*  error;
+};
+
+// Start decoding a new stream. False if the decoder cannot be allocated.
+bool gzipBegin(GzipStream* gz, GzipSinkFn sink, void* ctx);
+
+// Feed the next chunk. Returns false once the data is not valid gzip or
+// the sink stopped (see gzipError). Data after the trailer is ignored.
+bool gzipFeed(GzipStream* gz, const uint8_t* data, size_t len);
+
+// The trailer has been read and matches.
+bool gzipDone(const GzipStream* gz);
+
+// Why decoding stopped, or nullptr.
+const char* gzipError(const GzipStream* gz);
+
+// Release the decoder.
+void gzipEnd(GzipStream* gz);
+
+// True if data starts with the gzip magic bytes.
+bool gzipSniff(const uint8_t* data, size_t len);
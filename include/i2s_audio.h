@@ -2,4 +2,10 @@
 #include <Arduino.h>
 
 void i2sDeinit();
+
+// Install the driver from settings. If it is already installed with the same
+// DMA layout, only the sample rate is updated (no reinstall between tracks).
 void i2sInitFromSettings();
+
+// Change the output rate of the installed driver. Returns false on failure.
+bool i2sSetSampleRate(uint32_t sampleRate);
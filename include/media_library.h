@@ -0,0 +1,105 @@
+#pragma once
+#include <Arduino.h>
+
+// Media library index.
+// A binary index of the card under /.library/: a table of fixed-size
+// records grouped by directory (records.bin) and a string pool with paths
+// and tags (strings.bin). Listings and lookups read it instead of opening
+// every file. Uploads, deletes and renames go to a short in-memory change
+// list that a core 0 task merges into the table. At boot a per-directory
+// signature walk catches edits made elsewhere and rebuilds in the
+// background; codec details and tags are filled in while playback is idle.
+
+struct LibraryEntry {
+  String   name;
+  String   path;
+  uint32_t size  = 0;
+  uint32_t mtime = 0;
+  bool     isDir = false;
+
+  // Valid when probed is set (audio files only).
+  bool     probed        = false;
+  char     codec[5]      = {0}; // Registry name ("WAV", "MP3", "FLAC"), empty if unreadable.
+  uint32_t sampleRate    = 0;
+  uint8_t  channels      = 0;
+  uint8_t  bitsPerSample = 0;
+  uint32_t durationMs    = 0;
+  String   title;
+  String   artist;
+};
+
+// Called for each entry; return false to stop. Runs with the index locked,
+// so it must not call back into the library.
+typedef bool (*LibraryVisitFn)(const LibraryEntry& entry, void* ctx);
+typedef bool (*LibraryIndexVisitFn)(const LibraryEntry& entry, uint32_t index, void* ctx);
+
+// Load the index and start the maintenance task (after SD init).
+void libraryBegin();
+
+// Visit the entries of a directory. Returns false when the index cannot
+// answer (not built yet, or directory unknown); scan the card instead.
+bool libraryForEachInDir(const String& dir, LibraryVisitFn fn, void* ctx);
+
+// Look up one file or directory.
+bool libraryLookup(const String& path, LibraryEntry& entry);
+
+// First audio file in the root directory.
+bool libraryFirstAudio(String& path);
+
+// Record changes made through the web panel.
+void libraryNoteChanged(const String& path);
+void libraryNoteRemoved(const String& path);
+void libraryNoteRenamed(const String& oldPath, const String& newPath);
+
+// A directory and everything below it changed (an unpacked archive). One
+// change entry however many files it holds; the merge rescans the tree.
+// The root means the whole card: a rebuild.
+void libraryNoteTreeChanged(const String& path);
+
+// Throw the index away and rebuild it from the card in the background.
+void libraryRebuild();
+
+// Record table identity (0 while no table is served). Changes whenever
+// records are renumbered by a rebuild or merge; record indices are only
+// meaningful together with the table id they came from.
+uint32_t libraryTableId();
+
+// Bumped whenever the table content changes, including probed tags.
+uint32_t libraryContentVersion();
+
+// Records in the table, not counting pending changes.
+uint32_t libraryRecordCount();
+
+// Records below this index keep their content until the table changes.
+// Tag probing works upwards from here and only ever fills in later ones.
+uint32_t libraryStableRecords();
+
+// Visit table records [first, first + count) of table tableId. Records
+// shadowed by a pending change are skipped. False if the table changed.
+bool libraryVisitRecords(uint32_t tableId, uint32_t first, uint32_t count, LibraryIndexVisitFn fn,
+                         void* ctx);
+
+// Visit the given records (ascending indices read fastest), skipping
+// shadowed ones. False if the table changed.
+bool libraryGetRecords(uint32_t tableId, const uint32_t* indices, size_t count,
+                       LibraryIndexVisitFn fn, void* ctx);
+
+// Visit files added or changed since the last merge.
+void libraryForEachPending(LibraryVisitFn fn, void* ctx);
+
+// Listing generation of a directory: changes whenever one of its entries
+// may have (including probed details). Directories share hashed counters,
+// so an unrelated change can also move it; it never stays put on a change.
+uint32_t libraryDirGeneration(const String& dir);
+
+// True when dir is in the index, so libraryDirGeneration() tracks it. Hidden
+// directories, ones past the directory limit and ones not merged yet are not.
+bool libraryCoversDir(const String& dir);
+
+// True if any component of path is hidden or a system entry (starts with "."
+// or "_", or is empty); the scanner skips those. Uploads use it to keep out
+// of /.library, /.cache and /.upload.
+bool libraryIsHiddenPath(const String& path);
+
+// Get stats as JSON.
+String libraryGetStatsJson();
@@ -0,0 +1,37 @@
+#pragma once
+#include <Arduino.h>
+
+#include "media_library.h"
+
+// Media search index.
+// Word-prefix and substring search over file names, titles and artists.
+// Every lower-cased word of a library entry is stored together with its
+// suffixes in one sorted table on the card (/.library/search.tok, first
+// 12 bytes of each string) with posting lists of library record indices
+// (search.pst). Any query is then a prefix range scan over that table,
+// located through a small in-RAM fence array: a few SD reads regardless of
+// library size. A core 0 task rebuilds the index with an external merge
+// sort once the library has been quiet for a while; files changed since
+// the last library merge, and tags probed since the build, are matched
+// directly.
+
+enum SearchMode {
+  SEARCH_SUBSTRING, // Terms match anywhere inside a word.
+  SEARCH_PREFIX,    // Terms match at the start of a word.
+};
+
+// Called per result once the query is done and no lock is held; return
+// false to stop.
+typedef bool (*SearchResultFn)(const LibraryEntry& entry, void* ctx);
+
+// Load the index and start the rebuild task (after libraryBegin).
+void searchBegin();
+
+// Run a query. All space-separated terms must match. Results whose match
+// starts a word come first. Skips `offset` results, delivers up to `limit`
+// and sets *more when further results exist. Returns the number delivered.
+size_t searchRun(const String& query, SearchMode mode, uint32_t offset, uint32_t limit,
+                 SearchResultFn fn, void* ctx, bool* more);
+
+// Get stats as JSON.
+String searchGetStatsJson();
@@ -0,0 +1,13 @@
+#pragma once
+#include <Arduino.h>
+
+// Media tag reader.
+// Title and artist from ID3v2 (MP3), RIFF LIST/INFO (WAV, RF64) and
+// Vorbis comments (FLAC), converted to UTF-8. Only the tag area at the
+// start of the file is read; audio payload is skipped with seeks.
+
+// Longest tag value kept, in bytes.
+static const size_t TAGS_MAX_LEN = 64;
+
+// Read title and artist. Returns true if either was found.
+bool tagsRead(const String& path, String& title, String& artist);
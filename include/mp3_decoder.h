@@ -0,0 +1,6 @@
+#pragma once
+#include "audio_decoder.h"
+
+// MP3 decoder: ESP8266Audio's AudioGeneratorMP3 feeding a PCM sink, so
+// decoded frames go through the shared DSP and I2S chain like any codec.
+const AudioDecoderEntry& mp3DecoderEntry();
@@ -0,0 +1,59 @@
+#pragma once
+#include <Arduino.h>
+
+// MP3 frame index module.
+// Stream parameters and a seek table (byte offset at fixed time steps).
+// Opening a file only reads its first frame: the table comes from the
+// Xing/Info or VBRI header, or from the first frame's bitrate. Those
+// offsets are byte estimates (a Xing TOC holds percentages of the file),
+// so a seek to one must resync to the next frame. The exact table, from
+// walking every frame header once, is built on request by a core 0 task
+// and cached next to the file as "/dir/.name.mp3.idx" (revalidated by
+// source size and mtime).
+
+// Seek table entries kept in memory; longer files use a coarser step.
+static const uint16_t MP3_INDEX_MAX_ENTRIES = 4096;
+
+struct Mp3Index {
+  bool      valid           = false;
+  uint32_t  sampleRate      = 0;
+  uint8_t   channels        = 0;
+  uint16_t  samplesPerFrame = 0;
+  uint32_t  frameCount      = 0;
+  uint32_t  durationMs      = 0;
+  uint32_t  dataStart       = 0; // First audio frame.
+  uint32_t  dataEnd         = 0; // End of audio (before ID3v1).
+  uint32_t  intervalMs      = 0; // Time step between seek entries.
+  uint16_t  entryCount      = 0;
+  uint32_t* offsets         = nullptr; // Absolute offset per step.
+  bool      exact           = false;   // Offsets are frame starts from a full walk.
+};
+
+// Load the cached index, or build the estimated one from the first frame.
+// Returns idx.valid.
+bool mp3IndexLoad(const String& path, Mp3Index& idx);
+
+// Queue a background frame walk that caches the exact table. The newest
+// request replaces one that has not started yet.
+void mp3IndexRequestWalk(const String& path);
+
+// Number of walks finished so far. A change means a table requested
+// earlier may now be cached.
+uint32_t mp3IndexWalkCount();
+
+// Swap in the cached exact table once the walk has written it. True if
+// idx is exact afterwards.
+bool mp3IndexUpgrade(const String& path, Mp3Index& idx);
+
+// First confirmed frame at or after an estimated offset (a few KB are
+// searched); offset itself for exact tables or when none is found.
+uint32_t mp3IndexResync(const String& path, const Mp3Index& idx, uint32_t offset);
+
+// Release the seek table.
+void mp3IndexFree(Mp3Index& idx);
+
+// Byte offset of the frame at or before ms; entryMs receives its exact time.
+uint32_t mp3IndexSeekOffset(const Mp3Index& idx, uint32_t ms, uint32_t* entryMs);
+
+// Sidecar cache path for an MP3 file.
+String mp3IndexPath(const String& path);
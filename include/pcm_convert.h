@@ -0,0 +1,13 @@
+#pragma once
+#include <Arduino.h>
+
+// Sample format converters to 16-bit PCM for the WAV path.
+// All take a packed little-endian source and a sample (not frame) count;
+// source and destination must not overlap.
+
+void pcmConvertU8(const uint8_t* src, int16_t* dst, size_t samples);
+void pcmConvertS24(const uint8_t* src, int16_t* dst, size_t samples);
+void pcmConvertS32(const uint8_t* src, int16_t* dst, size_t samples);
+void pcmConvertF32(const uint8_t* src, int16_t* dst, size_t samples);
+void pcmConvertALaw(const uint8_t* src, int16_t* dst, size_t samples);
+void pcmConvertMuLaw(const uint8_t* src, int16_t* dst, size_t samples);
@@ -0,0 +1,50 @@
+#pragma once
+#include <Arduino.h>
+
+// Adaptive quality governor.
+// Measures processing headroom on the audio core and steps DSP quality down
+// when it stays low, then back up (with hysteresis) once it recovers.
+
+// Quality levels, each one includes the savings of the previous.
+enum QualityLevel : uint8_t {
+  QUALITY_FULL          = 0, // Linear resampler, all EQ bands, stereo DSP.
+  QUALITY_FAST_RESAMPLE = 1, // Zero-order hold resampler.
+  QUALITY_REDUCED_EQ    = 2, // Only the strongest EQ bands.
+  QUALITY_MONO          = 3, // DSP runs on a mono downmix.
+  QUALITY_LEVEL_COUNT
+};
+
+struct QualityStats {
+  uint8_t  level;       // Current QualityLevel.
+  int16_t  headroomPct; // Headroom over the last window (100 = idle, <0 = late).
+  uint32_t stepDowns;   // Number of downgrades since boot.
+  uint32_t stepUps;     // Number of upgrades since boot.
+  bool     enabled;     // Adaptive quality on/off.
+};
+
+// Global governor stats.
+extern QualityStats g_qualityStats;
+
+// Initialize governor.
+void qualityInit();
+
+// Enable/disable automatic level changes (headroom is measured either way).
+// Disabling returns to QUALITY_FULL at the next reported chunk.
+void qualitySetEnabled(bool enabled);
+
+// Return to full quality and clear the measurement window (call at track start).
+void qualityReset();
+
+// Report one processed chunk.
+// busyUs: time spent reading and processing the chunk.
+// audioUs: playback duration of the audio it produced.
+void qualityReportChunk(uint32_t busyUs, uint32_t audioUs);
+
+// Current level (read by the audio task for each chunk).
+QualityLevel qualityGetLevel();
+
+// Human-readable level name.
+const char* qualityGetLevelName(uint8_t level);
+
+// Get stats as JSON.
+String qualityGetStatsJson();
@@ -0,0 +1,30 @@
+#pragma once
+#include <Arduino.h>
+
+// Pre-render cache.
+// While playback is idle, a core 0 task renders files that need decoding,
+// downmix or resampling into 16-bit stereo WAV at the output rate under
+// /.cache/. Playback then opens the rendered copy, which needs no codec,
+// downmix or resampler work. Entries are keyed by source path, size, mtime
+// and pipeline parameters, and evicted least recently used first once the
+// size budget (settings cacheMaxMB) is reached.
+
+// Load the cache index and start the render task (after settings load).
+void renderCacheBegin();
+
+// Queue a file for rendering when the player is idle.
+void renderCacheRequest(const String& path);
+
+// Rendered copy of path for the current pipeline. Marks it as used.
+bool renderCacheLookup(const String& path, String& cachedPath);
+
+// Abort any render in progress, wait until it has stopped and hold off new
+// ones (call before playback starts; the renderer shares the downmix and
+// resampler with the player).
+void renderCacheYield();
+
+// Delete all rendered files.
+void renderCacheClear();
+
+// Get stats as JSON.
+String renderCacheGetStatsJson();
@@ -5,15 +5,22 @@
 // Converts between different sample rates using linear interpolation.
 // For better quality, use simple integer ratios (e.g., 48000->24000).
 
+// Resampler quality tiers (higher value = cheaper, lower quality).
+enum ResamplerTier : uint8_t {
+  RESAMPLER_TIER_LINEAR = 0, // Linear interpolation between neighbour frames.
+  RESAMPLER_TIER_HOLD   = 1, // Zero-order hold (nearest previous frame).
+};
+
 // Resampler state (keeps track of fractional position).
 struct ResamplerState {
-  float    position; // Fractional sample position.
-  int16_t  lastL;    // Last sample (L channel).
-  int16_t  lastR;    // Last sample (R channel).
-  uint32_t srcRate;  // Source sample rate.
-  uint32_t dstRate;  // Destination sample rate.
-  float    ratio;    // srcRate / dstRate.
-  bool     active;   // Resampling needed.
+  float         position; // Fractional sample position.
+  int16_t       lastL;    // Last sample (L channel).
+  int16_t       lastR;    // Last sample (R channel).
+  uint32_t      srcRate;  // Source sample rate.
+  uint32_t      dstRate;  // Destination sample rate.
+  float         ratio;    // srcRate / dstRate.
+  bool          active;   // Resampling needed.
+  ResamplerTier tier;     // Interpolation quality.
 };
 
 // Global resampler state.
@@ -28,6 +35,10 @@ void resamplerReset();
 // Check if resampling is active.
 bool resamplerIsActive();
 
+// Select interpolation tier (can be changed between buffers).
+void          resamplerSetTier(ResamplerTier tier);
+ResamplerTier resamplerGetTier();
+
 // Resample a buffer of stereo samples.
 // Input: srcBuf with srcFrames stereo frames.
 // Output: dstBuf with up to dstMaxFrames stereo frames.
@@ -35,6 +46,10 @@ bool resamplerIsActive();
 size_t resamplerProcess(const int16_t* srcBuf, size_t srcFrames, int16_t* dstBuf,
                         size_t dstMaxFrames);
 
+// Same as resamplerProcess() for a mono buffer (one sample per frame).
+size_t resamplerProcessMono(const int16_t* srcBuf, size_t srcFrames, int16_t* dstBuf,
+                            size_t dstMaxFrames);
+
 // Calculate required output buffer size for given input.
 size_t resamplerCalcOutputFrames(size_t srcFrames);
 
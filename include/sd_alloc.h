@@ -0,0 +1,39 @@
+#pragma once
+#include <Arduino.h>
+
+// SD file allocation.
+// Reserves clusters for a file before it is written, so large uploads land
+// in one contiguous run instead of being chained cluster by cluster as they
+// grow, and reports how fragmented an existing file is. Works on the card
+// through FatFs directly; the Arduino File API has no allocation control.
+
+enum SdPrealloc {
+  SD_PREALLOC_NONE,       // Nothing reserved; write the file as usual.
+  SD_PREALLOC_EXTENDED,   // Reserved, but no free run was large enough.
+  SD_PREALLOC_CONTIGUOUS, // Reserved in one contiguous run.
+};
+
+struct SdFragInfo {
+  uint64_t size;
+  uint32_t clusterBytes;
+  uint32_t clusters;
+  uint32_t fragments; // Runs of consecutive clusters; 1 is contiguous.
+  uint32_t firstCluster;
+};
+
+// Create (or replace) the file at path with size bytes allocated. The
+// reserved file must be opened "r+" so writing does not release the
+// clusters, and cut to its real length with sdTruncate() afterwards.
+SdPrealloc sdPreallocate(const String& path, uint64_t size);
+
+// Cut the file to size bytes, releasing clusters past it.
+bool sdTruncate(const String& path, uint64_t size);
+
+// Walk the cluster chain of a file.
+bool sdFileFragments(const String& path, SdFragInfo* info);
+
+// Fragmentation of a file as JSON (error field if it cannot be read).
+String sdFileFragmentsJson(const String& path);
+
+// Get stats as JSON.
+String sdAllocGetStatsJson();
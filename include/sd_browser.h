@@ -1,6 +1,8 @@
 #pragma once
 #include <Arduino.h>
 
+#include "media_library.h"
+
 // SD File Browser module.
 // Provides directory listing, file selection, delete and rename operations.
 
@@ -10,9 +12,24 @@ struct FileInfo {
   bool     isDir;
 };
 
-// Get list of files in directory (max 50 entries).
-// Returns JSON array string: [{"name":"file.wav","size":12345,"isDir":false}, ...]
-String sdListDir(const String& path);
+enum SdSortKey {
+  SD_SORT_NAME,
+  SD_SORT_SIZE,
+  SD_SORT_MTIME,
+};
+
+// Visit one page of a directory (limit at most 200), directories first,
+// then ascending by the sort key. Hidden entries are left out. Served from
+// the media library index when it covers the directory. Memory use is
+// bounded by the page size: deep offsets take one directory pass per 200
+// skipped entries. *total gets the number of entries. Returns false if the
+// directory cannot be read.
+bool sdListDirPage(const String& path, SdSortKey sort, uint32_t offset, uint32_t limit,
+                   LibraryVisitFn fn, void* ctx, uint32_t* total);
+
+// One library entry as a JSON object: name, size, isDir, mtime and the
+// probed codec fields and tags, plus its full path when withPath is set.
+String sdEntryToJson(const LibraryEntry& e, bool withPath);
 
 // Delete file or empty directory.
 bool sdDeleteFile(const String& path);
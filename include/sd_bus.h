@@ -0,0 +1,73 @@
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+
+// SD bus arbiter.
+// Every card transfer runs inside a slice of the bus owned by one I/O
+// class. Audio read-ahead has strict priority: it waits at most for the
+// slice in progress, and while its buffered audio (the read deadline
+// reported by the player) is short, other classes hold off before starting
+// a new slice. Uploads, listings and background work share what is left in
+// slices sized from measured throughput so a slice ends well before the
+// audio deadline. Busy time, bytes and waits are counted per class.
+
+enum SdIoClass {
+  SD_IO_AUDIO,      // Playback reads.
+  SD_IO_UPLOAD,     // Upload writes.
+  SD_IO_BROWSE,     // Listings, index lookups, delete and rename.
+  SD_IO_BACKGROUND, // Library scans, pre-render and search builds.
+  SD_IO_CLASSES
+};
+
+// No playback running: no deadline.
+static const uint32_t SD_BUS_NO_DEADLINE = 0xFFFFFFFF;
+
+// Create the bus lock (before any task touches the card).
+void sdBusBegin();
+
+// Take and give back the bus. Slices nest within one task.
+void sdBusAcquire(SdIoClass cls);
+void sdBusRelease(SdIoClass cls, size_t bytes);
+
+// Audio buffered ahead of the output in ms, or SD_BUS_NO_DEADLINE. Called
+// by the player after each block.
+void sdBusReportAudioSlack(uint32_t ms);
+
+// Largest transfer one slice of this class should carry right now
+// (a power of two from 4 to 32 KB).
+size_t sdBusSliceBytes(SdIoClass cls);
+
+// FatFs drive number of the card ("0:" is 0), or -1 if not mounted.
+int sdBusFatDrive();
+
+// FAT cluster size of the card in bytes (queried once, 32 KB if unknown).
+uint32_t sdBusClusterBytes();
+
+// Read inside one slice of the class.
+size_t sdBusRead(SdIoClass cls, File& f, uint8_t* buf, size_t len);
+
+// Write in slices of sdBusSliceBytes(cls). Returns the bytes written.
+size_t sdBusWrite(SdIoClass cls, File& f, const uint8_t* buf, size_t len);
+
+// Get stats as JSON.
+String sdBusGetStatsJson();
+
+// Scoped slice: acquired on construction, released with the bytes
+// reported through done().
+class SdBusSlice
+{
+public:
+  explicit SdBusSlice(SdIoClass cls) : m_cls(cls) { sdBusAcquire(cls); }
+  ~SdBusSlice() { sdBusRelease(m_cls, m_bytes); }
+
+  // Record transferred bytes; returns n for use inline.
+  size_t done(size_t n)
+  {
+    m_bytes += n;
+    return n;
+  }
+
+private:
+  SdIoClass m_cls;
+  size_t    m_bytes = 0;
+};
@@ -3,10 +3,19 @@
 #include <WebServer.h>
 
 // SD Upload module.
-// Handles file uploads via HTTP multipart/form-data.
+// Handles file uploads via HTTP multipart/form-data (POST /upload) and raw
+// request bodies (PUT /fs/<path>, e.g. curl -T file http://host/fs/music/).
+// Large files can go through a resumable session (/upload-session): chunks
+// carry Content-Range offsets, a running CRC-32 is kept, and the file is
+// renamed into place only when complete and verified. POST /upload-tar?dest=
+// unpacks a tar archive member by member as it streams in. PUT and tar
+// bodies may be gzip-compressed and are inflated on the fly.
 
 // Initialize upload handlers on the web server.
 void sdUploadBegin(WebServer& server);
 
 // Get upload status message.
 String sdUploadGetStatus();
+
+// True while an upload is writing to the SD card.
+bool sdUploadIsActive();
@@ -1,4 +1,6 @@
 #pragma once
+#include "downmix.h"
+
 #include <Arduino.h>
 
 // EQ settings (5 bands).
@@ -21,8 +23,17 @@ struct AudioSettings {
   EqBands eq;                // EQ band gains.
   bool    autoTuneEnabled;   // Auto-tuner on/off.
   bool    resamplingEnabled; // Resampling on/off.
+  bool    adaptiveQuality;   // Step DSP quality down when headroom is low.
+  bool    dualCoreDsp;       // Split heavy DSP stages across both cores.
+  int     spectrumFftSize;   // Analyzer FFT points (256 or 512).
+  int     decodeAheadMs;     // Decode-ahead ring depth for MP3 (0 = inline).
+  bool    wavLoops;          // Repeat smpl loops found in WAV files (off by default).
+  int     cacheMaxMB;        // Pre-render cache budget on SD (0 = off).
   String  timezone;          // Timezone (e.g., "Europe/Moscow").
   int     timezoneOffset;    // UTC offset in seconds (e.g., 10800 for MSK).
+
+  // Custom downmix matrices indexed by input channel count (3..8 used).
+  DownmixMatrix downmix[DOWNMIX_MAX_CHANNELS + 1];
 };
 
 extern AudioSettings g_settings;
@@ -0,0 +1,60 @@
+#pragma once
+#include <Arduino.h>
+
+// Incremental tar reader.
+// Fed the archive in chunks of any size as it arrives, it reports
+// directories and regular files with their data and never holds more than
+// one 512-byte header. Understands ustar prefixes, GNU long names ('L') and
+// pax path records ('x'); links and other entry types are skipped.
+
+static const size_t TAR_BLOCK    = 512;
+static const size_t TAR_MAX_META = 1024; // Longest long-name or pax header kept.
+
+enum TarEvent {
+  TAR_DIR,        // name: directory.
+  TAR_FILE_BEGIN, // name, len: file size.
+  TAR_FILE_DATA,  // data, len: next piece of the file.
+  TAR_FILE_END,   // name: all data delivered.
+};
+
+// Return false to stop reading (the reader then reports an error).
+typedef bool (*TarEventFn)(TarEvent event, const char* name, const uint8_t* data, size_t len,
+                           void* ctx);
+
+enum TarState {
+  TAR_STATE_HEADER,
+  TAR_STATE_DATA,
+  TAR_STATE_META,
+  TAR_STATE_SKIP,
+  TAR_STATE_END,
+  TAR_STATE_ERROR
+};
+
+struct TarReader {
+  TarEventFn  fn;
+  void*       ctx;
+  TarState    state;
+  uint8_t     header[TAR_BLOCK];
+  size_t      fill;      // Header or meta bytes collected.
+  uint64_t    remaining; // Data bytes left in the entry.
+  uint32_t    pad;       // Padding after the data, up to the next block.
+  char        metaType;  // 'L' or 'x' while collecting meta.
+  String      name;      // Entry being read.
+  String      longName;  // From a preceding 'L' or 'x' entry.
+  String      meta;
+  int         zeroBlocks;
+  const char* error;
+};
+
+// Start reading a new archive.
+void tarBegin(TarReader* tar, TarEventFn fn, void* ctx);
+
+// Feed the next chunk. Returns false once the archive is malformed or a
+// callback stopped it (see tarError); data after the end is ignored.
+bool tarFeed(TarReader* tar, const uint8_t* data, size_t len);
+
+// The end-of-archive blocks have been read.
+bool tarDone(const TarReader* tar);
+
+// Why reading stopped, or nullptr.
+const char* tarError(const TarReader* tar);
@@ -0,0 +1,6 @@
+#pragma once
+#include "audio_decoder.h"
+
+// WAV (RIFF/WAVE) decoder, 1..8 channels: 8/16/24/32-bit PCM, 32-bit float,
+// A-law/mu-law, IMA/MS ADPCM, and WAVE_FORMAT_EXTENSIBLE with channel mask.
+const AudioDecoderEntry& wavDecoderEntry();
@@ -2,14 +2,64 @@
 #include <Arduino.h>
 #include <SD.h>
 
+#include "adpcm.h"
+
+// Cue points kept per file, and label bytes kept per cue.
+static const int WAV_MAX_CUES      = 32;
+static const int WAV_CUE_LABEL_LEN = 24;
+
+static const uint16_t WAV_FORMAT_PCM        = 0x0001;
+static const uint16_t WAV_FORMAT_IEEE_FLOAT = 0x0003;
+static const uint16_t WAV_FORMAT_ALAW       = 0x0006;
+static const uint16_t WAV_FORMAT_MULAW      = 0x0007;
+static const uint16_t WAV_FORMAT_EXTENSIBLE = 0xFFFE;
+
+// Cue point from the cue chunk, labelled from LIST/adtl when present.
+struct WavCue {
+  uint32_t id;
+  uint32_t frame; // Offset into the data chunk, in frames.
+  char     label[WAV_CUE_LABEL_LEN];
+};
+
 struct WavInfo {
   bool     ok            = false;
   uint16_t audioFormat   = 0;
   uint16_t numChannels   = 0;
   uint32_t sampleRate    = 0;
   uint16_t bitsPerSample = 0;
+  uint16_t blockAlign    = 0;
+  uint16_t validBits     = 0; // WAVE_FORMAT_EXTENSIBLE only.
+  uint32_t channelMask   = 0; // WAVE_FORMAT_EXTENSIBLE only.
+  bool     extensible    = false;
+  bool     rf64          = false; // RF64/BW64 container with a ds64 chunk.
   uint32_t dataOffset    = 0;
-  uint32_t dataSize      = 0;
+  uint64_t dataSize      = 0;
+
+  // Compressed formats: frames per block (ADPCM) and the fact chunk's
+  // total frame count (0 when absent).
+  uint16_t samplesPerBlock = 0;
+  uint64_t factFrames      = 0;
+
+  // MS-ADPCM predictor coefficient pairs.
+  uint8_t msNumCoefs                     = 0;
+  int16_t msCoefs[ADPCM_MS_MAX_COEFS][2] = {};
+
+  // First smpl loop, in frames; loopEnd is inclusive.
+  bool     hasLoop   = false;
+  uint32_t loopStart = 0;
+  uint32_t loopEnd   = 0;
+  uint32_t loopCount = 0; // Total plays of the loop (0 = forever).
+
+  uint8_t cueCount = 0;
+  WavCue  cues[WAV_MAX_CUES];
 };
 
+// Parse RIFF/WAVE (or RF64/BW64) chunks up to data. For
+// WAVE_FORMAT_EXTENSIBLE the subformat GUID is resolved, so audioFormat
+// holds the effective tag. An unknown data size (0xFFFFFFFF from streaming
+// writers) or one past the end of the file is taken from the file length.
+// Chunks after data (smpl, cue, LIST/adtl) are read in the same pass; the
+// file position afterwards is unspecified. File offsets are 32-bit (the FAT32
+// limit), so for RF64 the data size is capped to what the file holds and
+// chunks starting beyond 4 GiB are skipped.
 WavInfo parseWavHeader(File& f);
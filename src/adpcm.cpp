@@ -0,0 +1,194 @@
+#include "adpcm.h"
+
+static const int16_t IMA_STEP_TABLE[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,
+    25,    28,    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,
+    88,    97,    107,   118,   130,   143,   157,   173,   190,   209,   230,   253,   279,
+    307,   337,   371,   408,   449,   494,   544,   598,   658,   724,   796,   876,   963,
+    1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,  2272,  2499,  2749,  3024,  3327,
+    3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t IMA_INDEX_TABLE[16] = {-1, -1, -1, -1, 2, 4, 6, 8,
+                                           -1, -1, -1, -1, 2, 4, 6, 8};
+
+static const int16_t MS_ADAPTATION_TABLE[16] = {230, 230, 230, 230, 307, 409, 512, 614,
+                                                768, 614, 512, 409, 307, 230, 230, 230};
+
+static inline int16_t clamp16(int32_t v)
+{
+  if (v > 32767)
+    return 32767;
+  if (v < -32768)
+    return -32768;
+  return (int16_t)v;
+}
+
+static inline int16_t readS16(const uint8_t* p)
+{
+  return (int16_t)((uint16_t)p[0] | ((uint16_t)p[1] << 8));
+}
+
+uint32_t adpcmImaFramesPerBlock(uint32_t blockAlign, uint16_t channels)
+{
+  if (channels == 0 || blockAlign <= 4u * channels)
+    return 0;
+  return (blockAlign - 4u * channels) * 2 / channels + 1;
+}
+
+uint32_t adpcmMsFramesPerBlock(uint32_t blockAlign, uint16_t channels)
+{
+  if (channels == 0 || blockAlign < 7u * channels)
+    return 0;
+  return (blockAlign - 7u * channels) * 2 / channels + 2;
+}
+
+// ----------------------------------------------------------------------------
+// IMA ADPCM
+// ----------------------------------------------------------------------------
+
+struct ImaState {
+  int32_t predictor;
+  int     index;
+};
+
+static inline int16_t imaStep(ImaState& s, uint8_t nibble)
+{
+  int32_t step = IMA_STEP_TABLE[s.index];
+  int32_t diff = step >> 3;
+  if (nibble & 4)
+    diff += step;
+  if (nibble & 2)
+    diff += step >> 1;
+  if (nibble & 1)
+    diff += step >> 2;
+
+  s.predictor = clamp16((nibble & 8) ? s.predictor - diff : s.predictor + diff);
+
+  s.index += IMA_INDEX_TABLE[nibble];
+  if (s.index < 0)
+    s.index = 0;
+  else if (s.index > 88)
+    s.index = 88;
+
+  return (int16_t)s.predictor;
+}
+
+size_t adpcmImaDecodeBlock(const uint8_t* block, size_t bytes, uint16_t channels, int16_t* out,
+                           size_t maxFrames)
+{
+  if (channels == 0 || channels > 8 || bytes < 4u * channels || maxFrames == 0)
+    return 0;
+
+  // Header: per channel int16 predictor, uint8 step index, reserved byte.
+  // The predictor is the first output sample.
+  ImaState state[8];
+  for (uint16_t ch = 0; ch < channels; ch++) {
+    const uint8_t* h   = block + 4 * ch;
+    state[ch].predictor = readS16(h);
+    state[ch].index     = h[2] > 88 ? 88 : h[2];
+    out[ch]             = (int16_t)state[ch].predictor;
+  }
+
+  // Body: groups of 4 bytes (8 samples, low nibble first) per channel.
+  const uint8_t* p      = block + 4 * channels;
+  size_t         groups = (bytes - 4u * channels) / (4u * channels);
+  size_t         frames = 1 + groups * 8;
+  if (frames > maxFrames)
+    frames = maxFrames;
+
+  for (size_t g = 0; g < groups; g++) {
+    size_t base = 1 + g * 8;
+    if (base >= frames)
+      break;
+    size_t count = frames - base < 8 ? frames - base : 8;
+
+    for (uint16_t ch = 0; ch < channels; ch++) {
+      const uint8_t* src = p + (g * channels + ch) * 4;
+      int16_t*       dst = out + base * channels + ch;
+      for (size_t i = 0; i < count; i++) {
+        uint8_t b      = src[i >> 1];
+        uint8_t nibble = (i & 1) ? (b >> 4) : (b & 0x0F);
+        dst[i * channels] = imaStep(state[ch], nibble);
+      }
+    }
+  }
+
+  return frames;
+}
+
+// ----------------------------------------------------------------------------
+// Microsoft ADPCM
+// ----------------------------------------------------------------------------
+
+struct MsState {
+  int32_t c1, c2;
+  int32_t delta;
+  int32_t s1, s2;
+};
+
+static inline int16_t msStep(MsState& s, uint8_t nibble)
+{
+  int32_t signedNibble = (nibble & 8) ? (int32_t)nibble - 16 : (int32_t)nibble;
+  int32_t predicted    = (s.s1 * s.c1 + s.s2 * s.c2) >> 8;
+  int16_t sample       = clamp16(predicted + signedNibble * s.delta);
+
+  s.s2    = s.s1;
+  s.s1    = sample;
+  s.delta = (MS_ADAPTATION_TABLE[nibble] * s.delta) >> 8;
+  if (s.delta < 16)
+    s.delta = 16;
+
+  return sample;
+}
+
+size_t adpcmMsDecodeBlock(const uint8_t* block, size_t bytes, uint16_t channels,
+                          const int16_t (*coefs)[2], int numCoefs, int16_t* out, size_t maxFrames)
+{
+  if (channels == 0 || channels > 8 || bytes < 7u * channels || maxFrames < 2)
+    return 0;
+
+  // Header is stored field by field across channels: predictor indices,
+  // deltas, then sample1 and sample2. sample2 is played first.
+  MsState        state[8];
+  const uint8_t* p = block;
+  for (uint16_t ch = 0; ch < channels; ch++) {
+    int idx = p[ch] < numCoefs ? p[ch] : 0;
+    state[ch].c1 = coefs[idx][0];
+    state[ch].c2 = coefs[idx][1];
+  }
+  p += channels;
+  for (uint16_t ch = 0; ch < channels; ch++) {
+    state[ch].delta = readS16(p + 2 * ch);
+  }
+  p += 2 * channels;
+  for (uint16_t ch = 0; ch < channels; ch++) {
+    state[ch].s1 = readS16(p + 2 * ch);
+  }
+  p += 2 * channels;
+  for (uint16_t ch = 0; ch < channels; ch++) {
+    state[ch].s2 = readS16(p + 2 * ch);
+  }
+  p += 2 * channels;
+
+  for (uint16_t ch = 0; ch < channels; ch++) {
+    out[ch]            = (int16_t)state[ch].s2;
+    out[channels + ch] = (int16_t)state[ch].s1;
+  }
+
+  // Body: nibbles high first, interleaved across channels sample by sample.
+  size_t nibbles = (bytes - 7u * channels) * 2;
+  size_t frames  = 2 + nibbles / channels;
+  if (frames > maxFrames)
+    frames = maxFrames;
+
+  size_t   total = (frames - 2) * channels;
+  int16_t* dst   = out + 2 * channels;
+  for (size_t n = 0; n < total; n++) {
+    uint8_t b      = p[n >> 1];
+    uint8_t nibble = (n & 1) ? (b & 0x0F) : (b >> 4);
+    dst[n]         = msStep(state[n % channels], nibble);
+  }
+
+  return frames;
+}
@@ -0,0 +1,378 @@
+#include "audio_analyzer.h"
+
+#include "web_log.h"
+
+#include <atomic>
+#include <math.h>
+
+// Tap ring: the most recent stereo output frames (power of two).
+static const uint32_t TAP_FRAMES = 2048;
+static const uint32_t TAP_MASK   = TAP_FRAMES - 1;
+static const int      TAP_TRIES  = 3; // Snapshot attempts racing the writer.
+
+// Output is decimated by this factor before the FFT.
+static const int DECIMATION = 2;
+
+// Target update rate and the CPU budget analysis may use on core 0.
+static const uint32_t   BASE_PERIOD_MS    = 66; // ~15 Hz.
+static const uint32_t   MAX_PERIOD_MS     = 250;
+static const uint32_t   BUDGET_US_PER_SEC = 30000; // 3% of one core.
+static const float      SPECTRUM_MIN_HZ   = 40.0f;
+static const float      SPECTRUM_FLOOR_DB = -90.0f;
+static const uint8_t    FRAME_VERSION     = 1;
+static const uint32_t   ANALYZER_STACK    = 4096;
+static const BaseType_t ANALYZER_CORE     = 0;
+
+static int16_t               g_tap[TAP_FRAMES * 2];
+static std::atomic<uint32_t> g_tapWritten(0); // Total frames written (wraps).
+static std::atomic<uint32_t> g_tapSeq(0);     // Odd while the writer is copying.
+static std::atomic<uint32_t> g_tapRate(0);
+
+// Analysis state (owned by the analyzer task).
+static int      g_fftSize  = 512;
+static int      g_fftLog2  = 9;
+static int16_t* g_snapshot = nullptr; // fftSize * DECIMATION stereo frames.
+static float*   g_re       = nullptr;
+static float*   g_im       = nullptr;
+static float*   g_window   = nullptr;
+static float*   g_cos      = nullptr;
+static float*   g_sin      = nullptr;
+static uint16_t g_binLo[ANALYZER_BINS];
+static uint16_t g_binHi[ANALYZER_BINS];
+static uint32_t g_binRate = 0;
+
+// Published frame (double-buffered, index flipped after a full write).
+static uint8_t          g_frames[2][ANALYZER_FRAME_SIZE];
+static std::atomic<int> g_frameReady(-1);
+static uint16_t         g_sequence   = 0;
+static uint32_t         g_analysisUs = 0;
+static uint32_t         g_periodMs   = BASE_PERIOD_MS;
+static TaskHandle_t     g_task       = nullptr;
+
+void analyzerTap(const int16_t* stereo, size_t frames, uint32_t sampleRate)
+{
+  if (!g_task || frames == 0)
+    return;
+
+  // Only the newest TAP_FRAMES frames matter.
+  if (frames > TAP_FRAMES) {
+    stereo += (frames - TAP_FRAMES) * 2;
+    frames = TAP_FRAMES;
+  }
+
+  // Seqlock: odd while the ring is being written (single writer).
+  uint32_t seq = g_tapSeq.load(std::memory_order_relaxed);
+  g_tapSeq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  uint32_t pos   = g_tapWritten.load(std::memory_order_relaxed);
+  uint32_t start = pos & TAP_MASK;
+  uint32_t first = TAP_FRAMES - start;
+  if (first > frames)
+    first = frames;
+
+  memcpy(&g_tap[start * 2], stereo, first * 2 * sizeof(int16_t));
+  if (first < frames) {
+    memcpy(&g_tap[0], stereo + first * 2, (frames - first) * 2 * sizeof(int16_t));
+  }
+
+  g_tapRate.store(sampleRate, std::memory_order_relaxed);
+  g_tapWritten.store(pos + frames, std::memory_order_relaxed);
+  g_tapSeq.store(seq + 2, std::memory_order_release);
+}
+
+// Copy the newest `frames` frames out of the tap. A copy that overlapped a
+// write (sequence odd or moved) is retried, then given up.
+static bool snapshotTap(int16_t* out, uint32_t frames)
+{
+  for (int attempt = 0; attempt < TAP_TRIES; attempt++) {
+    uint32_t seq = g_tapSeq.load(std::memory_order_acquire);
+    if (seq & 1)
+      continue;
+
+    uint32_t end = g_tapWritten.load(std::memory_order_relaxed);
+    if (end < frames)
+      return false;
+
+    uint32_t start = (end - frames) & TAP_MASK;
+    uint32_t first = TAP_FRAMES - start;
+    if (first > frames)
+      first = frames;
+
+    memcpy(out, &g_tap[start * 2], first * 2 * sizeof(int16_t));
+    if (first < frames) {
+      memcpy(out + first * 2, &g_tap[0], (frames - first) * 2 * sizeof(int16_t));
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (g_tapSeq.load(std::memory_order_relaxed) == seq)
+      return true;
+  }
+  return false;
+}
+
+static void buildTables()
+{
+  for (int i = 0; i < g_fftSize; i++) {
+    g_window[i] = 0.5f - 0.5f * cosf(2.0f * M_PI * i / (g_fftSize - 1));
+  }
+  for (int i = 0; i < g_fftSize / 2; i++) {
+    g_cos[i] = cosf(2.0f * M_PI * i / g_fftSize);
+    g_sin[i] = -sinf(2.0f * M_PI * i / g_fftSize);
+  }
+}
+
+// Map log-spaced bins to FFT bin ranges for the effective (decimated) rate.
+static void buildBins(uint32_t sampleRate)
+{
+  float rate    = (float)sampleRate / DECIMATION;
+  float binHz   = rate / g_fftSize;
+  float maxHz   = rate / 2.0f;
+  int   maxBin  = g_fftSize / 2 - 1;
+  float logSpan = logf(maxHz / SPECTRUM_MIN_HZ);
+
+  for (int b = 0; b < ANALYZER_BINS; b++) {
+    float loHz = SPECTRUM_MIN_HZ * expf(logSpan * b / ANALYZER_BINS);
+    float hiHz = SPECTRUM_MIN_HZ * expf(logSpan * (b + 1) / ANALYZER_BINS);
+    int   lo   = (int)(loHz / binHz + 0.5f);
+    int   hi   = (int)(hiHz / binHz + 0.5f);
+    if (lo < 1)
+      lo = 1;
+    if (lo > maxBin)
+      lo = maxBin;
+    if (hi <= lo)
+      hi = lo + 1;
+    if (hi > maxBin + 1)
+      hi = maxBin + 1;
+    g_binLo[b] = (uint16_t)lo;
+    g_binHi[b] = (uint16_t)hi;
+  }
+
+  g_binRate = sampleRate;
+}
+
+// In-place iterative radix-2 FFT on g_re/g_im.
+static void fft()
+{
+  int n = g_fftSize;
+
+  for (int i = 1, j = 0; i < n; i++) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      float t = g_re[i];
+      g_re[i] = g_re[j];
+      g_re[j] = t;
+      t       = g_im[i];
+      g_im[i] = g_im[j];
+      g_im[j] = t;
+    }
+  }
+
+  for (int len = 2; len <= n; len <<= 1) {
+    int half = len >> 1;
+    int step = n / len;
+    for (int i = 0; i < n; i += len) {
+      for (int k = 0; k < half; k++) {
+        float wr = g_cos[k * step];
+        float wi = g_sin[k * step];
+        int   a  = i + k;
+        int   b  = a + half;
+        float tr = g_re[b] * wr - g_im[b] * wi;
+        float ti = g_re[b] * wi + g_im[b] * wr;
+        g_re[b]  = g_re[a] - tr;
+        g_im[b]  = g_im[a] - ti;
+        g_re[a] += tr;
+        g_im[a] += ti;
+      }
+    }
+  }
+}
+
+static int16_t toCentiDb(float linear)
+{
+  if (linear <= 0.0f)
+    return (int16_t)(SPECTRUM_FLOOR_DB * 100);
+  float db = 20.0f * log10f(linear);
+  if (db < SPECTRUM_FLOOR_DB)
+    db = SPECTRUM_FLOOR_DB;
+  return (int16_t)(db * 100.0f);
+}
+
+static void put16(uint8_t* p, uint16_t v)
+{
+  p[0] = (uint8_t)(v & 0xFF);
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void analyzeOnce(uint32_t sampleRate)
+{
+  uint32_t frames = (uint32_t)g_fftSize * DECIMATION;
+  if (!snapshotTap(g_snapshot, frames))
+    return;
+
+  if (sampleRate != g_binRate)
+    buildBins(sampleRate);
+
+  // Meters over the snapshot block.
+  int32_t peakL = 0;
+  int32_t peakR = 0;
+  float   sumL  = 0.0f;
+  float   sumR  = 0.0f;
+  for (uint32_t i = 0; i < frames; i++) {
+    int32_t l = g_snapshot[i * 2];
+    int32_t r = g_snapshot[i * 2 + 1];
+    if (abs(l) > peakL)
+      peakL = abs(l);
+    if (abs(r) > peakR)
+      peakR = abs(r);
+    sumL += (float)l * (float)l;
+    sumR += (float)r * (float)r;
+  }
+
+  // Mono mix, boxcar decimation and window.
+  for (int i = 0; i < g_fftSize; i++) {
+    int32_t acc = 0;
+    for (int d = 0; d < DECIMATION; d++) {
+      const int16_t* fr = &g_snapshot[(i * DECIMATION + d) * 2];
+      acc += fr[0] + fr[1];
+    }
+    g_re[i] = (float)acc / (2.0f * DECIMATION * 32768.0f) * g_window[i];
+    g_im[i] = 0.0f;
+  }
+
+  fft();
+
+  // Full-scale sine with a Hann window peaks at fftSize / 4.
+  int      idx   = g_frameReady.load(std::memory_order_relaxed) == 0 ? 1 : 0;
+  uint8_t* frame = g_frames[idx];
+  float    norm  = 4.0f / g_fftSize;
+
+  for (int b = 0; b < ANALYZER_BINS; b++) {
+    float power = 0.0f;
+    for (int k = g_binLo[b]; k < g_binHi[b]; k++) {
+      float p = g_re[k] * g_re[k] + g_im[k] * g_im[k];
+      if (p > power)
+        power = p;
+    }
+    float db  = 10.0f * log10f(power * norm * norm + 1e-12f);
+    float lvl = (db - SPECTRUM_FLOOR_DB) * 255.0f / -SPECTRUM_FLOOR_DB;
+    if (lvl < 0.0f)
+      lvl = 0.0f;
+    if (lvl > 255.0f)
+      lvl = 255.0f;
+    frame[ANALYZER_FRAME_HEADER + b] = (uint8_t)lvl;
+  }
+
+  frame[0] = FRAME_VERSION;
+  frame[1] = ANALYZER_BINS;
+  put16(frame + 2, ++g_sequence);
+  put16(frame + 4, (uint16_t)(sampleRate / 10));
+  put16(frame + 6, (uint16_t)toCentiDb(peakL / 32768.0f));
+  put16(frame + 8, (uint16_t)toCentiDb(peakR / 32768.0f));
+  put16(frame + 10, (uint16_t)toCentiDb(sqrtf(sumL / frames) / 32768.0f));
+  put16(frame + 12, (uint16_t)toCentiDb(sqrtf(sumR / frames) / 32768.0f));
+  put16(frame + 14, (uint16_t)(g_analysisUs > 0xFFFF ? 0xFFFF : g_analysisUs));
+  frame[16] = (uint8_t)(1000 / g_periodMs);
+  frame[17] = (uint8_t)g_fftLog2;
+  frame[18] = 0;
+  frame[19] = 0;
+
+  g_frameReady.store(idx, std::memory_order_release);
+}
+
+static void analyzerTask(void* param)
+{
+  (void)param;
+
+  uint32_t lastWritten = 0;
+
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(g_periodMs));
+
+    // Nothing new since the last frame (playback stopped): skip the work.
+    uint32_t written = g_tapWritten.load(std::memory_order_acquire);
+    if (written == lastWritten)
+      continue;
+    lastWritten = written;
+
+    uint32_t start = micros();
+    analyzeOnce(g_tapRate.load(std::memory_order_relaxed));
+    g_analysisUs = micros() - start;
+
+    // Stretch the period so analysis stays within its CPU budget.
+    uint32_t period = g_analysisUs * 1000 / BUDGET_US_PER_SEC;
+    if (period < BASE_PERIOD_MS)
+      period = BASE_PERIOD_MS;
+    if (period > MAX_PERIOD_MS)
+      period = MAX_PERIOD_MS;
+    g_periodMs = period;
+  }
+}
+
+void analyzerBegin(int fftSize)
+{
+  if (g_task)
+    return;
+
+  g_fftSize = fftSize == 256 ? 256 : 512;
+  g_fftLog2 = g_fftSize == 256 ? 8 : 9;
+
+  g_snapshot = (int16_t*)malloc(g_fftSize * DECIMATION * 2 * sizeof(int16_t));
+  g_re       = (float*)malloc(g_fftSize * sizeof(float));
+  g_im       = (float*)malloc(g_fftSize * sizeof(float));
+  g_window   = (float*)malloc(g_fftSize * sizeof(float));
+  g_cos      = (float*)malloc(g_fftSize / 2 * sizeof(float));
+  g_sin      = (float*)malloc(g_fftSize / 2 * sizeof(float));
+
+  if (!g_snapshot || !g_re || !g_im || !g_window || !g_cos || !g_sin) {
+    WebLog.println("[ANALYZER] ❌ malloc failed, spectrum disabled");
+    free(g_snapshot);
+    free(g_re);
+    free(g_im);
+    free(g_window);
+    free(g_cos);
+    free(g_sin);
+    g_snapshot = nullptr;
+    return;
+  }
+
+  buildTables();
+
+  if (xTaskCreatePinnedToCore(analyzerTask, "analyzer", ANALYZER_STACK, nullptr, 1, &g_task,
+                              ANALYZER_CORE) != pdPASS) {
+    g_task = nullptr;
+    WebLog.println("[ANALYZER] ❌ Failed to start task");
+    return;
+  }
+
+  WebLog.print("[ANALYZER] ✅ Started on core 0, FFT ");
+  WebLog.print(g_fftSize);
+  WebLog.print(" points, ");
+  WebLog.print(ANALYZER_BINS);
+  WebLog.println(" bins");
+}
+
+bool analyzerGetFrame(uint8_t* out)
+{
+  int idx = g_frameReady.load(std::memory_order_acquire);
+  if (idx < 0)
+    return false;
+  memcpy(out, g_frames[idx], ANALYZER_FRAME_SIZE);
+  return true;
+}
+
+String analyzerGetStatsJson()
+{
+  String json = "{";
+  json += "\"running\":" + String(g_task ? "true" : "false") + ",";
+  json += "\"fftSize\":" + String(g_fftSize) + ",";
+  json += "\"analysisUs\":" + String(g_analysisUs) + ",";
+  json += "\"updateHz\":" + String(1000 / g_periodMs) + ",";
+  json += "\"budgetUsPerSec\":" + String(BUDGET_US_PER_SEC);
+  json += "}";
+  return json;
+}
@@ -0,0 +1,115 @@
+#include "audio_decoder.h"
+
+#include "decode_ahead.h"
+#include "flac_decoder.h"
+#include "mp3_decoder.h"
+#include "wav_decoder.h"
+#include "web_log.h"
+
+#include <SD.h>
+
+static const int DECODER_MAX_ENTRIES = 8;
+
+static AudioDecoderEntry g_decoders[DECODER_MAX_ENTRIES];
+static int               g_decoderCount  = 0;
+static bool              g_builtinsAdded = false;
+
+static void registerBuiltins()
+{
+  if (g_builtinsAdded)
+    return;
+  g_builtinsAdded = true;
+
+  decoderRegister(wavDecoderEntry());
+  decoderRegister(mp3DecoderEntry());
+  decoderRegister(flacDecoderEntry());
+}
+
+bool decoderRegister(const AudioDecoderEntry& entry)
+{
+  if (g_decoderCount >= DECODER_MAX_ENTRIES) {
+    WebLog.print("[DECODER] ❌ Registry full, cannot add ");
+    WebLog.println(entry.name);
+    return false;
+  }
+
+  g_decoders[g_decoderCount++] = entry;
+  return true;
+}
+
+const AudioDecoderEntry* decoderProbeFile(const String& path)
+{
+  registerBuiltins();
+
+  File f = SD.open(path);
+  if (!f)
+    return nullptr;
+
+  uint8_t head[DECODER_PROBE_BYTES];
+  size_t  len = f.read(head, sizeof(head));
+  f.close();
+
+  for (int i = 0; i < g_decoderCount; i++) {
+    if (g_decoders[i].probe(head, len))
+      return &g_decoders[i];
+  }
+
+  return nullptr;
+}
+
+IAudioDecoder* decoderOpen(const String& path, uint32_t decodeAheadMs)
+{
+  const AudioDecoderEntry* entry = decoderProbeFile(path);
+  if (!entry) {
+    WebLog.print("[DECODER] ❌ Unrecognized format: ");
+    WebLog.println(path);
+    return nullptr;
+  }
+
+  IAudioDecoder* dec = entry->create();
+  if (!dec) {
+    WebLog.println("[DECODER] ❌ Out of memory");
+    return nullptr;
+  }
+
+  if (!dec->open(path)) {
+    dec->close();
+    delete dec;
+    return nullptr;
+  }
+
+  WebLog.print("[DECODER] ✅ ");
+  WebLog.print(entry->name);
+  WebLog.print(": ");
+  WebLog.print(dec->info().sampleRate);
+  WebLog.print(" Hz, ");
+  WebLog.print(dec->info().channels);
+  WebLog.print(" ch, ");
+  WebLog.print(dec->info().totalMs / 1000);
+  WebLog.println(" sec");
+
+  if (entry->decodeAhead && decodeAheadMs > 0) {
+    return decodeAheadWrap(dec, decodeAheadMs);
+  }
+  return dec;
+}
+
+bool decoderKnowsExtension(const String& path)
+{
+  registerBuiltins();
+
+  int dot = path.lastIndexOf('.');
+  if (dot < 0)
+    return false;
+
+  String ext = path.substring(dot);
+  ext.toLowerCase();
+
+  for (int i = 0; i < g_decoderCount; i++) {
+    String list = String(" ") + g_decoders[i].extensions + " ";
+    if (list.indexOf(" " + ext + " ") >= 0)
+      return true;
+  }
+
+  return false;
+}
@@ -1,42 +1,45 @@
 #include "audio_player.h"
 
+#include "audio_analyzer.h"
+#include "audio_decoder.h"
 #include "audio_progress.h"
 #include "auto_tuner.h"
+#include "decode_ahead.h"
+#include "downmix.h"
+#include "dsp_planner.h"
 #include "equalizer.h"
 #include "i2s_audio.h"
-#include "mp3_player.h"
+#include "quality_governor.h"
+#include "render_cache.h"
 #include "resampler.h"
 #include "sd_browser.h"
+#include "sd_bus.h"
 #include "settings.h"
-#include "wav_reader.h"
 #include "web_log.h"
 
 #include <SD.h>
 #include <driver/i2s.h>
 
-// Audio format type.
-enum AudioFormat { FORMAT_UNKNOWN, FORMAT_WAV, FORMAT_MP3 };
-
-static TaskHandle_t         audioTaskHandle      = nullptr;
-static volatile bool        g_audioRunning       = false;
-static volatile bool        g_audioStopRequested = false;
-static volatile AudioFormat g_currentFormat      = FORMAT_UNKNOWN;
+static TaskHandle_t            audioTaskHandle      = nullptr;
+static volatile bool           g_audioRunning       = false;
+static volatile bool           g_audioStopRequested = false;
+static IAudioDecoder* volatile g_decoder            = nullptr;
+static volatile int32_t        g_seekRequestMs      = -1;
 
 // I2S write timeout in ticks (100ms). Allows checking stop flag periodically.
 static const TickType_t I2S_WRITE_TIMEOUT = pdMS_TO_TICKS(100);
 
-// Detect audio format by file extension.
-static AudioFormat detectFormat(const String& path)
+// Audio queued ahead of the DAC: the DMA ring (full after each write) plus
+// the decode-ahead ring. This is the deadline for the next SD read.
+static uint32_t bufferedMs(uint32_t outRate)
 {
-  String lower = path;
-  lower.toLowerCase();
-
-  if (lower.endsWith(".wav"))
-    return FORMAT_WAV;
-  if (lower.endsWith(".mp3"))
-    return FORMAT_MP3;
-
-  return FORMAT_UNKNOWN;
+  uint32_t ms = 0;
+  if (outRate > 0)
+    ms = (uint32_t)((uint64_t)g_settings.dmaBufCount * g_settings.dmaBufLen * 1000 / outRate);
+  if (g_decodeAheadStats.active && g_decodeAheadStats.sampleRate > 0)
+    ms += (uint32_t)((uint64_t)g_decodeAheadStats.fillFrames * 1000 /
+                     g_decodeAheadStats.sampleRate);
+  return ms;
 }
 
 bool audioIsRunning()
@@ -44,64 +47,17 @@ bool audioIsRunning()
   return g_audioRunning;
 }
 
-// WAV playback task (existing implementation).
-static void wavPlaybackTask(void* param)
+// Shared PCM path: decode a block, run the DSP chain, write to I2S.
+static void runPcm(IAudioDecoder* dec)
 {
-  (void)param;
-
-  WebLog.println("[AUDIO] WAV task started");
-  g_audioRunning       = true;
-  g_audioStopRequested = false;
-
-  // Get current file from settings or sd_browser.
-  String path = g_settings.currentFile;
-  if (path.length() == 0) {
-    path = sdGetCurrentFile();
-  }
-
-  File f = SD.open(path);
-  if (!f) {
-    WebLog.print("[AUDIO] ❌ Cannot open: ");
-    WebLog.println(path);
-    g_audioRunning = false;
-    vTaskDelete(NULL);
-    return;
-  }
-
-  WebLog.print("[AUDIO] ✅ Opened: ");
-  WebLog.println(path);
+  const AudioStreamInfo& info = dec->info();
 
-  WavInfo info = parseWavHeader(f);
-  if (!info.ok) {
-    WebLog.println("[AUDIO] ❌ WAV header invalid");
-    f.close();
-    g_audioRunning = false;
-    vTaskDelete(NULL);
-    return;
-  }
-
-  if (info.audioFormat != 1 || info.bitsPerSample != 16) {
-    WebLog.println("[AUDIO] ❌ WAV must be PCM 16-bit");
-    f.close();
-    g_audioRunning = false;
-    vTaskDelete(NULL);
-    return;
-  }
-
-  if (info.numChannels != 1 && info.numChannels != 2) {
-    WebLog.println("[AUDIO] ❌ WAV must be MONO or STEREO");
-    f.close();
-    g_audioRunning = false;
-    vTaskDelete(NULL);
-    return;
+  // More than two channels are matrixed to stereo right after each read.
+  bool multichannel = info.channels > 2;
+  if (multichannel) {
+    downmixInit(info.channels, info.channelMask);
   }
 
-  WebLog.print("[AUDIO] WAV channels = ");
-  WebLog.println(info.numChannels);
-
-  // Initialize progress tracking.
-  progressReset(path, info.dataSize, info.sampleRate, info.numChannels, info.bitsPerSample);
-
   // Initialize resampling if needed and enabled.
   uint32_t targetSampleRate = (uint32_t)g_settings.sampleRate;
   if (g_settings.resamplingEnabled && info.sampleRate != targetSampleRate) {
@@ -112,24 +68,22 @@ static void wavPlaybackTask(void* param)
     WebLog.print(targetSampleRate);
     WebLog.println(" Hz");
   } else {
-    // No resampling - reconfigure I2S to match WAV.
+    // No resampling - reconfigure I2S to match the stream.
     if (info.sampleRate != targetSampleRate) {
-      WebLog.print("[AUDIO] ⚠️ WAV sampleRate (");
+      WebLog.print("[AUDIO] ⚠️ Stream sampleRate (");
       WebLog.print(info.sampleRate);
       WebLog.print(") != settings (");
       WebLog.print(targetSampleRate);
       WebLog.println(")");
 
       if (!g_settings.resamplingEnabled) {
-        WebLog.println("[AUDIO] 🔧 Reconfiguring I2S to match WAV file...");
-        esp_err_t err = i2s_set_sample_rates(I2S_NUM_0, info.sampleRate);
-        if (err == ESP_OK) {
+        WebLog.println("[AUDIO] 🔧 Reconfiguring I2S to match stream...");
+        if (i2sSetSampleRate(info.sampleRate)) {
           WebLog.print("[AUDIO] ✅ I2S reconfigured to ");
           WebLog.print(info.sampleRate);
           WebLog.println(" Hz");
         } else {
-          WebLog.print("[AUDIO] ❌ Failed to reconfigure I2S: ");
-          WebLog.println(esp_err_to_name(err));
+          WebLog.println("[AUDIO] ❌ Failed to reconfigure I2S");
         }
       }
     }
@@ -150,43 +104,35 @@ static void wavPlaybackTask(void* param)
     g_eqSettings.enabled = false;
   }
 
-  f.seek(info.dataOffset);
-
   int inBytes = g_settings.inBufBytes;
   if (inBytes < 512)
     inBytes = 512;
   if (inBytes > 8192)
     inBytes = 8192;
 
-  int bytesPerFrame  = (int)info.numChannels * (int)sizeof(int16_t);
+  int bytesPerFrame  = (int)info.channels * (int)sizeof(int16_t);
   int framesPerChunk = inBytes / bytesPerFrame;
   if (framesPerChunk < 1)
     framesPerChunk = 1;
 
-  int inSamplesTotal  = framesPerChunk * info.numChannels;
-  int outSamplesTotal = framesPerChunk * 2;
-  int resampleOutMax  = (int)(framesPerChunk * 2.0f) + 16;
+  // The chain works in place on inBuf, so it must hold both the decoded block
+  // (up to 8 channels) and the stereo expansion.
+  int inSamplesTotal = framesPerChunk * (multichannel ? info.channels : 2);
+  int resampleOutMax = (int)resamplerCalcOutputFrames(framesPerChunk) + 16;
 
   int16_t* inBuf       = (int16_t*)malloc(inSamplesTotal * sizeof(int16_t));
-  int16_t* outBuf      = (int16_t*)malloc(outSamplesTotal * sizeof(int16_t));
   int16_t* resampleBuf = nullptr;
 
   if (resamplerIsActive()) {
     resampleBuf = (int16_t*)malloc(resampleOutMax * 2 * sizeof(int16_t));
   }
 
-  if (!inBuf || !outBuf || (resamplerIsActive() && !resampleBuf)) {
+  if (!inBuf || (resamplerIsActive() && !resampleBuf)) {
     WebLog.println("[AUDIO] ❌ malloc failed");
     if (inBuf)
       free(inBuf);
-    if (outBuf)
-      free(outBuf);
     if (resampleBuf)
       free(resampleBuf);
-    f.close();
-    g_audioRunning = false;
-    progressStop();
-    vTaskDelete(NULL);
     return;
   }
 
@@ -195,65 +141,78 @@ static void wavPlaybackTask(void* param)
   WebLog.print("[AUDIO] FramesPerChunk=");
   WebLog.println(framesPerChunk);
 
-  uint32_t bytesLeft   = info.dataSize;
-  uint32_t bytesPlayed = 0;
+  uint32_t outRate = resamplerIsActive() ? targetSampleRate : info.sampleRate;
 
   tunerResetStats();
-
-  while (bytesLeft > 0 && !g_audioStopRequested) {
-    size_t toRead    = (bytesLeft > (uint32_t)inBytes) ? (size_t)inBytes : (size_t)bytesLeft;
-    size_t bytesRead = f.read((uint8_t*)inBuf, toRead);
-
-    if (bytesRead == 0)
-      break;
-    bytesLeft -= bytesRead;
-    bytesPlayed += bytesRead;
-
-    progressUpdate(bytesPlayed);
-
-    size_t framesRead = bytesRead / bytesPerFrame;
-    float  vol        = g_settings.volume;
-
-    for (size_t i = 0; i < framesRead; i++) {
-      int16_t L = 0;
-      int16_t R = 0;
-
-      if (info.numChannels == 1) {
-        L = inBuf[i];
-        R = inBuf[i];
+  qualityReset();
+
+  DspPlanInput planIn;
+  planIn.srcRate     = info.sampleRate;
+  planIn.srcChannels = multichannel ? 2 : info.channels;
+  planIn.outRate     = outRate;
+  planIn.resample    = resamplerIsActive();
+
+  // Plan inputs that can change mid-track (EQ toggle, adaptive quality).
+  auto refreshPlanInput = [&planIn]() {
+    planIn.resampleHold = resamplerGetTier() == RESAMPLER_TIER_HOLD;
+    planIn.eqBands      = g_eqSettings.enabled ? eqGetActiveBandCount() : 0;
+    planIn.forceMono    = qualityGetLevel() >= QUALITY_MONO;
+    planIn.dualCore     = g_settings.dualCoreDsp;
+  };
+
+  refreshPlanInput();
+  DspPlan plan = dspPlanBuild(planIn);
+  dspPlanLog(plan);
+
+  while (!g_audioStopRequested) {
+    // Seeks are applied here, between blocks, so the decoder is never
+    // touched from another task.
+    int32_t seekMs = g_seekRequestMs;
+    if (seekMs >= 0) {
+      g_seekRequestMs = -1;
+      if (dec->seek((uint32_t)seekMs)) {
+        WebLog.print("[AUDIO] ⏩ Seek to ");
+        WebLog.print(dec->positionMs() / 1000);
+        WebLog.println(" sec");
       } else {
-        L = inBuf[i * 2];
-        R = inBuf[i * 2 + 1];
+        WebLog.println("[AUDIO] ⚠️ Seek not supported for this stream");
       }
+    }
 
-      int32_t sL = (int32_t)((float)L * vol);
-      int32_t sR = (int32_t)((float)R * vol);
+    uint32_t chunkStartUs = micros();
 
-      if (sL > 32767)
-        sL = 32767;
-      if (sL < -32768)
-        sL = -32768;
-      if (sR > 32767)
-        sR = 32767;
-      if (sR < -32768)
-        sR = -32768;
+    size_t framesRead = dec->decode(inBuf, framesPerChunk);
+    if (framesRead == 0)
+      break;
 
-      outBuf[2 * i]     = (int16_t)sL;
-      outBuf[2 * i + 1] = (int16_t)sR;
+    // Duration can be refined mid-track (an MP3 frame walk finishing).
+    uint32_t totalMs = dec->info().totalMs;
+    if (totalMs > 0 && totalMs != g_audioProgress.totalMs)
+      g_audioProgress.totalMs = totalMs;
+    progressUpdatePosition(dec->positionBytes(), dec->positionMs());
+
+    refreshPlanInput();
+    if (!dspPlanMatches(plan, planIn)) {
+      plan = dspPlanBuild(planIn);
     }
 
-    if (g_eqSettings.enabled) {
-      eqProcessBuffer(outBuf, framesRead, info.sampleRate);
+    // Fused with the read: the wide frames are reduced in place, never copied.
+    if (multichannel) {
+      downmixProcess(inBuf, framesRead, inBuf);
     }
 
-    int16_t* finalBuf    = outBuf;
-    size_t   finalFrames = framesRead;
+    int16_t* finalBuf    = inBuf;
+    size_t   finalFrames = dspPlanRun(plan, inBuf, framesRead, g_settings.volume, resampleBuf,
+                                      resampleOutMax, &finalBuf);
 
-    if (resamplerIsActive() && resampleBuf) {
-      finalFrames = resamplerProcess(outBuf, framesRead, resampleBuf, resampleOutMax);
-      finalBuf    = resampleBuf;
+    if (outRate > 0) {
+      qualityReportChunk(micros() - chunkStartUs,
+                         (uint32_t)((uint64_t)finalFrames * 1000000 / outRate));
     }
 
+    // Copy only; the analysis itself runs on core 0.
+    analyzerTap(finalBuf, finalFrames, outRate);
+
     size_t outBytes     = finalFrames * 2 * sizeof(int16_t);
     size_t totalWritten = 0;
 
@@ -275,6 +234,8 @@ static void wavPlaybackTask(void* param)
       totalWritten += written;
     }
 
+    sdBusReportAudioSlack(bufferedMs(outRate));
+
     if (g_settings.autoTuneEnabled && g_tunerStats.totalChunks % 200 == 0) {
       tunerCheck();
     }
@@ -283,80 +244,75 @@ static void wavPlaybackTask(void* param)
   }
 
   free(inBuf);
-  free(outBuf);
   if (resampleBuf)
     free(resampleBuf);
-  f.close();
-
-  i2s_zero_dma_buffer(I2S_NUM_0);
-  progressStop();
-
-  if (g_audioStopRequested)
-    WebLog.println("[AUDIO] ⏹ WAV stopped by request");
-  else
-    WebLog.println("[AUDIO] ✅ WAV playback finished");
-
-  g_audioRunning  = false;
-  audioTaskHandle = nullptr;
-  vTaskDelete(NULL);
 }
 
-// MP3 playback task.
-static void mp3PlaybackTask(void* param)
+// Playback task: one loop for every codec in the decoder registry.
+static void playbackTask(void* param)
 {
   (void)param;
 
-  WebLog.println("[AUDIO] MP3 task started");
+  WebLog.println("[AUDIO] Playback task started");
   g_audioRunning       = true;
   g_audioStopRequested = false;
 
+  // Get current file from settings or sd_browser.
   String path = g_settings.currentFile;
   if (path.length() == 0) {
     path = sdGetCurrentFile();
   }
 
-  // Initialize MP3 player.
-  mp3Init();
+  // A pre-rendered copy plays without codec, downmix or resampler work.
+  String source = path;
+  String cached;
+  if (renderCacheLookup(path, cached)) {
+    WebLog.print("[AUDIO] ⚡ Using pre-rendered ");
+    WebLog.println(cached);
+    source = cached;
+  }
 
-  if (!mp3StartFile(path)) {
-    WebLog.println("[AUDIO] ❌ Failed to start MP3");
+  IAudioDecoder* dec = decoderOpen(source, (uint32_t)g_settings.decodeAheadMs);
+  if (!dec) {
+    WebLog.print("[AUDIO] ❌ Cannot play: ");
+    WebLog.println(path);
     g_audioRunning  = false;
     audioTaskHandle = nullptr;
     vTaskDelete(NULL);
     return;
   }
 
-  // Initialize progress tracking.
-  progressReset(path, 0, mp3GetSampleRate(), mp3GetChannels(), mp3GetBitsPerSample());
-  g_audioProgress.totalMs = mp3GetDurationMs();
+  g_decoder = dec;
 
-  // Main playback loop.
-  while (!g_audioStopRequested && !mp3IsStopRequested()) {
-    // Pump the MP3 decoder.
-    if (!mp3Loop()) {
-      break; // Playback finished or stopped.
-    }
+  const AudioStreamInfo& info = dec->info();
+  progressReset(path, info.totalBytes, info.sampleRate, info.channels, info.bitsPerSample);
+  if (info.totalMs > 0) {
+    g_audioProgress.totalMs = info.totalMs;
+  }
 
-    // Update progress.
-    g_audioProgress.playedMs = mp3GetPositionMs();
-    if (g_audioProgress.totalMs > 0) {
-      g_audioProgress.percent =
-          (uint8_t)((uint64_t)g_audioProgress.playedMs * 100 / g_audioProgress.totalMs);
-      if (g_audioProgress.percent > 100)
-        g_audioProgress.percent = 100;
-    }
+  const AudioMarker* markers     = nullptr;
+  size_t             markerCount = dec->markers(&markers);
+  progressSetStreamMarks(info.loopStartMs, info.loopEndMs, markers, markerCount);
 
-    // Small delay to prevent watchdog.
-    vTaskDelay(1);
-  }
+  i2sInitFromSettings();
+  sdBusReportAudioSlack(0); // Nothing buffered yet: audio reads go first.
+  runPcm(dec);
+  sdBusReportAudioSlack(SD_BUS_NO_DEADLINE);
+  i2s_zero_dma_buffer(I2S_NUM_0);
+
+  g_decoder = nullptr;
+  dec->close();
 
-  // Cleanup is already done by mp3Stop() or mp3Loop().
   progressStop();
 
-  if (g_audioStopRequested || mp3IsStopRequested())
-    WebLog.println("[AUDIO] ⏹ MP3 stopped by request");
+  WebLog.print("[AUDIO] ");
+  WebLog.print(dec->name());
+  if (g_audioStopRequested)
+    WebLog.println(" ⏹ stopped by request");
   else
-    WebLog.println("[AUDIO] ✅ MP3 playback finished");
+    WebLog.println(" ✅ playback finished");
+
+  delete dec;
 
   g_audioRunning  = false;
   audioTaskHandle = nullptr;
@@ -373,11 +329,6 @@ void audioStop()
   WebLog.println("[AUDIO] Stop requested...");
   g_audioStopRequested = true;
 
-  // For MP3, signal stop (cleanup will happen in task).
-  if (g_currentFormat == FORMAT_MP3) {
-    mp3Stop();
-  }
-
   // Wait for task to finish.
   for (int i = 0; i < 100; i++) {
     if (!g_audioRunning)
@@ -391,17 +342,16 @@ void audioStop()
     audioTaskHandle = nullptr;
     g_audioRunning  = false;
 
-    // If MP3 was force-killed, cleanup resources.
-    if (g_currentFormat == FORMAT_MP3) {
-      mp3Cleanup();
+    // The task was killed mid-stream, release its decoder here.
+    IAudioDecoder* dec = g_decoder;
+    g_decoder          = nullptr;
+    if (dec) {
+      dec->close();
+      delete dec;
     }
   }
 
-  // Only clear DMA buffer for WAV (we manage I2S).
-  // For MP3, ESP8266Audio manages its own I2S.
-  if (g_currentFormat == FORMAT_WAV) {
-    i2s_zero_dma_buffer(I2S_NUM_0);
-  }
+  i2s_zero_dma_buffer(I2S_NUM_0);
 
   progressStop();
 
@@ -423,14 +373,16 @@ void audioStartFile(const String& path)
   WebLog.print("[AUDIO] Starting playback: ");
   WebLog.println(path);
 
-  // Detect format.
-  g_currentFormat = detectFormat(path);
-
-  if (g_currentFormat == FORMAT_UNKNOWN) {
-    WebLog.println("[AUDIO] ❌ Unknown audio format. Supported: .wav, .mp3");
+  // Detect format from the file header.
+  const AudioDecoderEntry* codec = decoderProbeFile(path);
+  if (!codec) {
+    WebLog.println("[AUDIO] ❌ Unknown audio format");
     return;
   }
 
+  WebLog.print("[AUDIO] Format: ");
+  WebLog.println(codec->name);
+
   // Update current file in settings and save.
   g_settings.currentFile = path;
   sdSetCurrentFile(path);
@@ -439,17 +391,15 @@ void audioStartFile(const String& path)
   settingsSaveToSD();
 
   g_audioStopRequested = false;
+  g_seekRequestMs      = -1;
 
-  if (g_currentFormat == FORMAT_WAV) {
-    // WAV uses I2S directly.
-    i2sDeinit();
-    i2sInitFromSettings();
-    xTaskCreatePinnedToCore(wavPlaybackTask, "wavTask", 10240, nullptr, 2, &audioTaskHandle, 1);
-  } else if (g_currentFormat == FORMAT_MP3) {
-    // MP3 uses ESP8266Audio library which handles I2S internally.
-    i2sDeinit(); // Deinit our I2S, let ESP8266Audio manage it.
-    xTaskCreatePinnedToCore(mp3PlaybackTask, "mp3Task", 16384, nullptr, 2, &audioTaskHandle, 1);
-  }
+  // The renderer shares the downmix and resampler state; it must be out of
+  // the way first. The track is queued so a later play can use the cache.
+  renderCacheYield();
+  renderCacheRequest(path);
+
+  // The task keeps the installed I2S driver and only reapplies settings.
+  xTaskCreatePinnedToCore(playbackTask, "audioTask", 16384, nullptr, 2, &audioTaskHandle, 1);
 }
 
 void audioRestart()
@@ -459,8 +409,17 @@ void audioRestart()
   audioStart();
 }
 
-// Check if file is a supported audio format.
+bool audioSeekMs(uint32_t ms)
+{
+  if (!g_audioRunning)
+    return false;
+
+  g_seekRequestMs = (int32_t)(ms > 0x7FFFFFFF ? 0x7FFFFFFF : ms);
+  return true;
+}
+
+// Check if the file header matches a registered decoder.
 bool audioIsSupportedFormat(const String& path)
 {
-  return detectFormat(path) != FORMAT_UNKNOWN;
+  return decoderProbeFile(path) != nullptr;
 }
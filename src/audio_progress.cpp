@@ -16,9 +16,12 @@ void progressInit()
   g_audioProgress.sampleRate    = 0;
   g_audioProgress.channels      = 0;
   g_audioProgress.bitsPerSample = 0;
+  g_audioProgress.loopStartMs   = 0;
+  g_audioProgress.loopEndMs     = 0;
+  g_audioProgress.markerCount   = 0;
 }
 
-uint32_t progressBytesToMs(uint32_t bytes, uint32_t sampleRate, uint16_t channels,
+uint32_t progressBytesToMs(uint64_t bytes, uint32_t sampleRate, uint16_t channels,
                            uint16_t bitsPerSample)
 {
   if (sampleRate == 0 || channels == 0 || bitsPerSample == 0)
@@ -29,10 +32,10 @@ uint32_t progressBytesToMs(uint32_t bytes, uint32_t sampleRate, uint16_t channel
   if (bytesPerSecond == 0)
     return 0;
 
-  return (uint32_t)((uint64_t)bytes * 1000 / bytesPerSecond);
+  return (uint32_t)(bytes * 1000 / bytesPerSecond);
 }
 
-void progressReset(const String& fileName, uint32_t totalBytes, uint32_t sampleRate,
+void progressReset(const String& fileName, uint64_t totalBytes, uint32_t sampleRate,
                    uint16_t channels, uint16_t bitsPerSample)
 {
   g_audioProgress.fileName      = fileName;
@@ -47,6 +50,10 @@ void progressReset(const String& fileName, uint32_t totalBytes, uint32_t sampleR
   g_audioProgress.totalMs  = progressBytesToMs(totalBytes, sampleRate, channels, bitsPerSample);
   g_audioProgress.playedMs = 0;
 
+  g_audioProgress.loopStartMs = 0;
+  g_audioProgress.loopEndMs   = 0;
+  g_audioProgress.markerCount = 0;
+
   WebLog.print("[PROGRESS] Started: ");
   WebLog.print(fileName);
   WebLog.print(" (");
@@ -54,7 +61,7 @@ void progressReset(const String& fileName, uint32_t totalBytes, uint32_t sampleR
   WebLog.println(" sec)");
 }
 
-void progressUpdate(uint32_t playedBytes)
+void progressUpdate(uint64_t playedBytes)
 {
   g_audioProgress.playedBytes = playedBytes;
   g_audioProgress.playedMs =
@@ -62,7 +69,21 @@ void progressUpdate(uint32_t playedBytes)
                         g_audioProgress.bitsPerSample);
 
   if (g_audioProgress.totalBytes > 0) {
-    g_audioProgress.percent = (uint8_t)((uint64_t)playedBytes * 100 / g_audioProgress.totalBytes);
+    g_audioProgress.percent = (uint8_t)(playedBytes * 100 / g_audioProgress.totalBytes);
+    if (g_audioProgress.percent > 100)
+      g_audioProgress.percent = 100;
+  } else {
+    g_audioProgress.percent = 0;
+  }
+}
+
+void progressUpdatePosition(uint64_t playedBytes, uint32_t playedMs)
+{
+  g_audioProgress.playedBytes = playedBytes;
+  g_audioProgress.playedMs    = playedMs;
+
+  if (g_audioProgress.totalMs > 0) {
+    g_audioProgress.percent = (uint8_t)((uint64_t)playedMs * 100 / g_audioProgress.totalMs);
     if (g_audioProgress.percent > 100)
       g_audioProgress.percent = 100;
   } else {
@@ -70,6 +91,31 @@ void progressUpdate(uint32_t playedBytes)
   }
 }
 
+void progressSetStreamMarks(uint32_t loopStartMs, uint32_t loopEndMs, const AudioMarker* markers,
+                            size_t count)
+{
+  g_audioProgress.loopStartMs = loopStartMs;
+  g_audioProgress.loopEndMs   = loopEndMs;
+
+  if (count > PROGRESS_MAX_MARKERS)
+    count = PROGRESS_MAX_MARKERS;
+  for (size_t i = 0; i < count; i++) {
+    g_audioProgress.markers[i] = markers[i];
+  }
+  g_audioProgress.markerCount = (uint8_t)count;
+}
+
+bool progressFindMarker(uint32_t id, uint32_t& ms)
+{
+  for (int i = 0; i < g_audioProgress.markerCount; i++) {
+    if (g_audioProgress.markers[i].id == id) {
+      ms = g_audioProgress.markers[i].ms;
+      return true;
+    }
+  }
+  return false;
+}
+
 void progressStop()
 {
   g_audioProgress.playing = false;
@@ -93,6 +139,19 @@ static String formatTime(uint32_t ms)
   return s;
 }
 
+// Labels come from the file; keep them valid inside a JSON string.
+static String labelToJson(const char* label)
+{
+  String out;
+  for (const char* p = label; *p; p++) {
+    if (*p == '"' || *p == '\\')
+      out += '\\';
+    if ((uint8_t)*p >= 32)
+      out += *p;
+  }
+  return out;
+}
+
 String progressGetJson()
 {
   String json = "{";
@@ -100,12 +159,29 @@ String progressGetJson()
   json += "\"percent\":" + String(g_audioProgress.percent) + ",";
   json += "\"playedMs\":" + String(g_audioProgress.playedMs) + ",";
   json += "\"totalMs\":" + String(g_audioProgress.totalMs) + ",";
+  json += "\"playedBytes\":" + String(g_audioProgress.playedBytes) + ",";
+  json += "\"totalBytes\":" + String(g_audioProgress.totalBytes) + ",";
   json += "\"playedTime\":\"" + formatTime(g_audioProgress.playedMs) + "\",";
   json += "\"totalTime\":\"" + formatTime(g_audioProgress.totalMs) + "\",";
   json += "\"fileName\":\"" + g_audioProgress.fileName + "\",";
   json += "\"sampleRate\":" + String(g_audioProgress.sampleRate) + ",";
   json += "\"channels\":" + String(g_audioProgress.channels) + ",";
-  json += "\"bitsPerSample\":" + String(g_audioProgress.bitsPerSample);
+  json += "\"bitsPerSample\":" + String(g_audioProgress.bitsPerSample) + ",";
+
+  if (g_audioProgress.loopEndMs > 0) {
+    json += "\"loop\":{\"startMs\":" + String(g_audioProgress.loopStartMs);
+    json += ",\"endMs\":" + String(g_audioProgress.loopEndMs) + "},";
+  }
+
+  json += "\"markers\":[";
+  for (int i = 0; i < g_audioProgress.markerCount; i++) {
+    const AudioMarker& m = g_audioProgress.markers[i];
+    if (i > 0)
+      json += ",";
+    json += "{\"id\":" + String(m.id) + ",\"ms\":" + String(m.ms);
+    json += ",\"label\":\"" + labelToJson(m.label) + "\"}";
+  }
+  json += "]";
   json += "}";
   return json;
 }
@@ -0,0 +1,74 @@
+#include "crc32.h"
+
+static const uint32_t CRC32_POLY = 0xEDB88320;
+
+static uint32_t (*s_table)[256] = nullptr;
+
+static bool crc32Init()
+{
+  if (s_table)
+    return true;
+
+  uint32_t (*table)[256] = (uint32_t (*)[256])malloc(8 * 256 * sizeof(uint32_t));
+  if (!table)
+    return false;
+
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int bit = 0; bit < 8; bit++) {
+      c = (c & 1) ? (c >> 1) ^ CRC32_POLY : c >> 1;
+    }
+    table[0][i] = c;
+  }
+
+  // table[k][i]: CRC of byte i followed by k zero bytes.
+  for (int k = 1; k < 8; k++) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c  = table[k - 1][i];
+      table[k][i] = (c >> 8) ^ table[0][c & 0xFF];
+    }
+  }
+
+  s_table = table;
+  return true;
+}
+
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len)
+{
+  crc = ~crc;
+
+  // No memory for the tables: bit at a time.
+  if (!crc32Init()) {
+    while (len--) {
+      crc ^= *data++;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 1) ? (crc >> 1) ^ CRC32_POLY : crc >> 1;
+      }
+    }
+    return ~crc;
+  }
+
+  const uint32_t (*t)[256] = s_table;
+  while (len > 0 && ((uintptr_t)data & 3) != 0) {
+    crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    len--;
+  }
+
+  // Little-endian words: the low byte of each is the earliest in the stream.
+  while (len >= 8) {
+    uint32_t lo;
+    uint32_t hi;
+    memcpy(&lo, data, 4);
+    memcpy(&hi, data + 4, 4);
+    lo ^= crc;
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    data += 8;
+    len -= 8;
+  }
+
+  while (len--) {
+    crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
@@ -0,0 +1,360 @@
+#include "decode_ahead.h"
+
+#include "web_log.h"
+
+#include <atomic>
+
+DecodeAheadStats g_decodeAheadStats;
+
+static const uint32_t    AHEAD_STACK = 12288;
+static const UBaseType_t AHEAD_PRIO  = 2;
+static const BaseType_t  AHEAD_CORE  = 0;
+
+// Largest single inner decode call, so the consumer sees data early.
+static const size_t AHEAD_MAX_BLOCK = 1152;
+
+class DecodeAheadDecoder : public IAudioDecoder
+{
+public:
+  explicit DecodeAheadDecoder(IAudioDecoder* inner) : m_inner(inner) {}
+  ~DecodeAheadDecoder() override
+  {
+    close();
+  }
+
+  bool start(uint32_t ringMs);
+
+  const char*            name() const override;
+  bool                   open(const String& path) override;
+  const AudioStreamInfo& info() const override;
+  size_t                 decode(int16_t* out, size_t maxFrames) override;
+  bool                   seek(uint32_t ms) override;
+  uint64_t               positionBytes() const override;
+  uint32_t               positionMs() const override;
+  size_t                 markers(const AudioMarker** out) const override;
+  void                   close() override;
+
+private:
+  static void producerTask(void* param);
+  void        produce();
+  void        pauseProducer();
+  void        resumeProducer();
+  uint32_t    fillBetween(uint32_t w, uint32_t r) const;
+  uint32_t    advance(uint32_t index, uint32_t frames) const;
+  uint32_t    slot(uint32_t index) const;
+
+  IAudioDecoder* m_inner    = nullptr;
+  int16_t*       m_ring     = nullptr;
+  uint32_t       m_capacity = 0; // Frames.
+  uint16_t       m_channels = 0;
+  TaskHandle_t   m_producer = nullptr;
+  TaskHandle_t   m_consumer = nullptr;
+
+  // Frame counters kept in [0, 2 * capacity) so full and empty stay distinct
+  // without relying on uint32 wrap-around; each is written by one side only.
+  std::atomic<uint32_t> m_written{0};
+  std::atomic<uint32_t> m_read{0};
+  std::atomic<bool>     m_eof{false};
+  std::atomic<bool>     m_quit{false};
+  std::atomic<bool>     m_pauseReq{false};
+  std::atomic<bool>     m_paused{false};
+  std::atomic<bool>     m_exited{false};
+
+  uint64_t m_framesOut = 0; // Consumed since baseMs.
+  uint32_t m_baseMs    = 0; // Position of the last seek.
+};
+
+const char* DecodeAheadDecoder::name() const
+{
+  return m_inner->name();
+}
+
+bool DecodeAheadDecoder::open(const String& path)
+{
+  // The inner decoder is opened before wrapping.
+  (void)path;
+  return m_inner != nullptr;
+}
+
+const AudioStreamInfo& DecodeAheadDecoder::info() const
+{
+  return m_inner->info();
+}
+
+bool DecodeAheadDecoder::start(uint32_t ringMs)
+{
+  m_channels = m_inner->info().channels;
+  m_capacity = (uint32_t)((uint64_t)m_inner->info().sampleRate * ringMs / 1000);
+  if (m_capacity < AHEAD_MAX_BLOCK * 2)
+    m_capacity = AHEAD_MAX_BLOCK * 2;
+
+  m_ring = (int16_t*)malloc((size_t)m_capacity * m_channels * sizeof(int16_t));
+  if (!m_ring) {
+    WebLog.println("[AHEAD] ❌ Ring malloc failed, decoding inline");
+    return false;
+  }
+
+  g_decodeAheadStats.active        = true;
+  g_decodeAheadStats.sampleRate    = m_inner->info().sampleRate;
+  g_decodeAheadStats.ringFrames    = m_capacity;
+  g_decodeAheadStats.fillFrames    = 0;
+  g_decodeAheadStats.minFillFrames = m_capacity;
+  g_decodeAheadStats.underruns     = 0;
+  g_decodeAheadStats.decodeCalls   = 0;
+  g_decodeAheadStats.decodeUs      = 0;
+  g_decodeAheadStats.decodedFrames = 0;
+
+  m_consumer = xTaskGetCurrentTaskHandle();
+  if (xTaskCreatePinnedToCore(producerTask, "decodeAhead", AHEAD_STACK, this, AHEAD_PRIO,
+                              &m_producer, AHEAD_CORE) != pdPASS) {
+    m_producer = nullptr;
+    free(m_ring);
+    m_ring                    = nullptr;
+    g_decodeAheadStats.active = false;
+    WebLog.println("[AHEAD] ❌ Failed to start task, decoding inline");
+    return false;
+  }
+
+  WebLog.print("[AHEAD] ✅ Decoding on core 0, ring ");
+  WebLog.print(m_capacity);
+  WebLog.print(" frames (");
+  WebLog.print(ringMs);
+  WebLog.println(" ms)");
+  return true;
+}
+
+uint32_t DecodeAheadDecoder::fillBetween(uint32_t w, uint32_t r) const
+{
+  return w >= r ? w - r : w + 2 * m_capacity - r;
+}
+
+uint32_t DecodeAheadDecoder::advance(uint32_t index, uint32_t frames) const
+{
+  index += frames;
+  return index >= 2 * m_capacity ? index - 2 * m_capacity : index;
+}
+
+uint32_t DecodeAheadDecoder::slot(uint32_t index) const
+{
+  return index >= m_capacity ? index - m_capacity : index;
+}
+
+void DecodeAheadDecoder::producerTask(void* param)
+{
+  static_cast<DecodeAheadDecoder*>(param)->produce();
+  vTaskDelete(NULL);
+}
+
+void DecodeAheadDecoder::produce()
+{
+  while (!m_quit.load()) {
+    if (m_pauseReq.load()) {
+      m_paused.store(true);
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+      continue;
+    }
+    m_paused.store(false);
+
+    uint32_t w    = m_written.load(std::memory_order_relaxed);
+    uint32_t r    = m_read.load(std::memory_order_acquire);
+    uint32_t room = m_capacity - fillBetween(w, r);
+
+    if (m_eof.load() || room < AHEAD_MAX_BLOCK) {
+      // Full or finished: sleep until the consumer drains or stops us.
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(20));
+      continue;
+    }
+
+    // Decode straight into the ring, never across the wrap point.
+    uint32_t pos   = slot(w);
+    size_t   space = m_capacity - pos;
+    if (space > room)
+      space = room;
+    if (space > AHEAD_MAX_BLOCK)
+      space = AHEAD_MAX_BLOCK;
+
+    uint32_t start = micros();
+    size_t   got   = m_inner->decode(&m_ring[(size_t)pos * m_channels], space);
+    g_decodeAheadStats.decodeUs += micros() - start;
+    g_decodeAheadStats.decodeCalls++;
+    g_decodeAheadStats.decodedFrames += got;
+
+    if (got == 0) {
+      m_eof.store(true);
+    } else {
+      m_written.store(advance(w, (uint32_t)got), std::memory_order_release);
+    }
+
+    xTaskNotifyGive(m_consumer);
+  }
+
+  m_exited.store(true);
+}
+
+size_t DecodeAheadDecoder::decode(int16_t* out, size_t maxFrames)
+{
+  if (!m_producer)
+    return m_inner->decode(out, maxFrames);
+
+  size_t produced = 0;
+
+  while (produced < maxFrames) {
+    uint32_t r     = m_read.load(std::memory_order_relaxed);
+    uint32_t w     = m_written.load(std::memory_order_acquire);
+    uint32_t avail = fillBetween(w, r);
+
+    if (avail == 0) {
+      if (m_eof.load() && m_written.load(std::memory_order_acquire) == r)
+        break;
+      if (produced > 0)
+        break; // Hand over what we have rather than stall the output.
+      g_decodeAheadStats.underruns++;
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+      continue;
+    }
+
+    uint32_t pos = slot(r);
+    size_t   n   = maxFrames - produced;
+    if (n > avail)
+      n = avail;
+    if (n > m_capacity - pos)
+      n = m_capacity - pos;
+
+    memcpy(out + produced * m_channels, &m_ring[(size_t)pos * m_channels],
+           n * m_channels * sizeof(int16_t));
+    produced += n;
+    m_read.store(advance(r, (uint32_t)n), std::memory_order_release);
+  }
+
+  uint32_t fill                 = fillBetween(m_written.load(), m_read.load());
+  g_decodeAheadStats.fillFrames = fill;
+  if (fill < g_decodeAheadStats.minFillFrames && !m_eof.load())
+    g_decodeAheadStats.minFillFrames = fill;
+
+  if (produced > 0)
+    xTaskNotifyGive(m_producer);
+
+  m_framesOut += produced;
+  return produced;
+}
+
+void DecodeAheadDecoder::pauseProducer()
+{
+  // Clear the flag first: a value left over from the previous pause would
+  // otherwise let us return while the producer is still decoding.
+  m_paused.store(false);
+  m_pauseReq.store(true);
+  xTaskNotifyGive(m_producer);
+  while (!m_paused.load() && !m_exited.load()) {
+    vTaskDelay(1);
+  }
+}
+
+void DecodeAheadDecoder::resumeProducer()
+{
+  m_pauseReq.store(false);
+  xTaskNotifyGive(m_producer);
+}
+
+bool DecodeAheadDecoder::seek(uint32_t ms)
+{
+  if (!m_producer)
+    return m_inner->seek(ms);
+
+  // The inner decoder belongs to the producer; park it before touching it.
+  pauseProducer();
+
+  bool ok = m_inner->seek(ms);
+  if (ok) {
+    m_read.store(0);
+    m_written.store(0);
+    m_eof.store(false);
+    m_framesOut                      = 0;
+    m_baseMs                         = m_inner->positionMs();
+    g_decodeAheadStats.minFillFrames = m_capacity;
+  }
+
+  resumeProducer();
+  return ok;
+}
+
+uint64_t DecodeAheadDecoder::positionBytes() const
+{
+  return m_inner->positionBytes();
+}
+
+size_t DecodeAheadDecoder::markers(const AudioMarker** out) const
+{
+  return m_inner->markers(out);
+}
+
+// Position of what has been handed to the engine, not of the decoder,
+// which runs up to a ring ahead.
+uint32_t DecodeAheadDecoder::positionMs() const
+{
+  uint32_t rate = m_inner->info().sampleRate;
+  if (rate == 0)
+    return 0;
+  return m_baseMs + (uint32_t)(m_framesOut * 1000 / rate);
+}
+
+void DecodeAheadDecoder::close()
+{
+  if (m_producer) {
+    m_quit.store(true);
+    xTaskNotifyGive(m_producer);
+    while (!m_exited.load()) {
+      vTaskDelay(1);
+    }
+    m_producer = nullptr;
+  }
+
+  if (m_ring) {
+    free(m_ring);
+    m_ring = nullptr;
+  }
+
+  if (m_inner) {
+    m_inner->close();
+    delete m_inner;
+    m_inner = nullptr;
+  }
+
+  g_decodeAheadStats.active = false;
+}
+
+IAudioDecoder* decodeAheadWrap(IAudioDecoder* inner, uint32_t ringMs)
+{
+  DecodeAheadDecoder* dec = new DecodeAheadDecoder(inner);
+  if (!dec)
+    return inner;
+
+  // On failure the wrapper simply forwards to inner on the calling task.
+  dec->start(ringMs);
+  return dec;
+}
+
+String decodeAheadGetStatsJson()
+{
+  const DecodeAheadStats& s = g_decodeAheadStats;
+
+  // Decode cost per 1000 frames, and as a share of real time.
+  uint32_t usPerKFrames = 0;
+  uint32_t loadPct      = 0;
+  if (s.decodedFrames > 0) {
+    usPerKFrames = (uint32_t)((uint64_t)s.decodeUs * 1000 / s.decodedFrames);
+    loadPct      = (uint32_t)((uint64_t)s.decodeUs * s.sampleRate / 10000 / s.decodedFrames);
+  }
+
+  String json = "{";
+  json += "\"active\":" + String(s.active ? "true" : "false") + ",";
+  json += "\"ringFrames\":" + String(s.ringFrames) + ",";
+  json += "\"fillFrames\":" + String(s.fillFrames) + ",";
+  json += "\"minFillFrames\":" + String(s.minFillFrames) + ",";
+  json += "\"underruns\":" + String(s.underruns) + ",";
+  json += "\"decodeCalls\":" + String(s.decodeCalls) + ",";
+  json += "\"decodeUsPer1kFrames\":" + String(usPerKFrames) + ",";
+  json += "\"decodeLoadPct\":" + String(loadPct);
+  json += "}";
+  return json;
+}
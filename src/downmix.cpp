@@ -0,0 +1,206 @@
+#include "downmix.h"
+
+#include "settings.h"
+#include "web_log.h"
+
+// Fixed-point coefficient format (Q14 leaves room for gains up to 2.0).
+static const int   COEFF_SHIFT = 14;
+static const float COEFF_ONE   = (float)(1 << COEFF_SHIFT);
+
+// -3 dB, the ITU-R BS.775 weight for centre and surround channels.
+static const float MINUS_3DB = 0.7071f;
+
+static int32_t  g_coeffL[DOWNMIX_MAX_CHANNELS];
+static int32_t  g_coeffR[DOWNMIX_MAX_CHANNELS];
+static uint16_t g_channels = 0;
+
+uint32_t downmixDefaultMask(uint16_t channels)
+{
+  switch (channels) {
+  case 1:
+    return SPEAKER_FRONT_CENTER;
+  case 2:
+    return SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
+  case 3:
+    return SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_FRONT_CENTER;
+  case 4:
+    return SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_BACK_LEFT | SPEAKER_BACK_RIGHT;
+  case 5:
+    return SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_FRONT_CENTER | SPEAKER_BACK_LEFT |
+           SPEAKER_BACK_RIGHT;
+  case 6:
+    return SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_FRONT_CENTER |
+           SPEAKER_LOW_FREQUENCY | SPEAKER_BACK_LEFT | SPEAKER_BACK_RIGHT;
+  case 7:
+    return SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_FRONT_CENTER |
+           SPEAKER_LOW_FREQUENCY | SPEAKER_BACK_CENTER | SPEAKER_SIDE_LEFT | SPEAKER_SIDE_RIGHT;
+  case 8:
+    return SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_FRONT_CENTER |
+           SPEAKER_LOW_FREQUENCY | SPEAKER_BACK_LEFT | SPEAKER_BACK_RIGHT | SPEAKER_SIDE_LEFT |
+           SPEAKER_SIDE_RIGHT;
+  }
+  return 0;
+}
+
+// Contribution of one speaker position to the L and R outputs.
+static void speakerWeights(uint32_t speaker, float& toL, float& toR)
+{
+  toL = 0.0f;
+  toR = 0.0f;
+
+  switch (speaker) {
+  case SPEAKER_FRONT_LEFT:
+  case SPEAKER_FRONT_LEFT_OF_CENTER:
+    toL = 1.0f;
+    break;
+  case SPEAKER_FRONT_RIGHT:
+  case SPEAKER_FRONT_RIGHT_OF_CENTER:
+    toR = 1.0f;
+    break;
+  case SPEAKER_FRONT_CENTER:
+    toL = MINUS_3DB;
+    toR = MINUS_3DB;
+    break;
+  case SPEAKER_BACK_LEFT:
+  case SPEAKER_SIDE_LEFT:
+    toL = MINUS_3DB;
+    break;
+  case SPEAKER_BACK_RIGHT:
+  case SPEAKER_SIDE_RIGHT:
+    toR = MINUS_3DB;
+    break;
+  case SPEAKER_BACK_CENTER:
+    toL = 0.5f;
+    toR = 0.5f;
+    break;
+  default:
+    break; // LFE and unknown positions are dropped.
+  }
+}
+
+void downmixSetDefaults(DownmixMatrix& m, uint16_t channels, uint32_t channelMask)
+{
+  m.valid = false;
+  for (int o = 0; o < 2; o++) {
+    for (int i = 0; i < DOWNMIX_MAX_CHANNELS; i++) {
+      m.coeffs[o][i] = 0.0f;
+    }
+  }
+
+  if (channelMask == 0)
+    channelMask = downmixDefaultMask(channels);
+
+  // Channels are stored in ascending mask bit order; unmasked extras are dropped.
+  uint16_t ch = 0;
+  for (uint32_t bit = 1; bit != 0 && ch < channels && ch < DOWNMIX_MAX_CHANNELS; bit <<= 1) {
+    if ((channelMask & bit) == 0)
+      continue;
+    speakerWeights(bit, m.coeffs[0][ch], m.coeffs[1][ch]);
+    ch++;
+  }
+
+  // Normalize so the sum of weights per output is at most 1 (no clipping).
+  for (int o = 0; o < 2; o++) {
+    float sum = 0.0f;
+    for (int i = 0; i < DOWNMIX_MAX_CHANNELS; i++) {
+      sum += fabsf(m.coeffs[o][i]);
+    }
+    if (sum > 1.0f) {
+      for (int i = 0; i < DOWNMIX_MAX_CHANNELS; i++) {
+        m.coeffs[o][i] /= sum;
+      }
+    }
+  }
+}
+
+bool downmixInit(uint16_t channels, uint32_t channelMask)
+{
+  if (channels < 2 || channels > DOWNMIX_MAX_CHANNELS)
+    return false;
+
+  DownmixMatrix m;
+  if (g_settings.downmix[channels].valid) {
+    m = g_settings.downmix[channels];
+    WebLog.print("[DOWNMIX] Custom matrix for ");
+  } else {
+    downmixSetDefaults(m, channels, channelMask);
+    WebLog.print("[DOWNMIX] ITU matrix for ");
+  }
+  WebLog.print(channels);
+  WebLog.println(" channels");
+
+  for (int i = 0; i < DOWNMIX_MAX_CHANNELS; i++) {
+    g_coeffL[i] = (int32_t)lroundf(m.coeffs[0][i] * COEFF_ONE);
+    g_coeffR[i] = (int32_t)lroundf(m.coeffs[1][i] * COEFF_ONE);
+  }
+
+  for (int o = 0; o < 2; o++) {
+    String row = o == 0 ? "[DOWNMIX] L =" : "[DOWNMIX] R =";
+    for (uint16_t i = 0; i < channels; i++) {
+      row += " " + String(m.coeffs[o][i], 3);
+    }
+    WebLog.println(row);
+  }
+
+  g_channels = channels;
+  return true;
+}
+
+static inline int16_t clampMix(int64_t acc)
+{
+  acc >>= COEFF_SHIFT;
+  if (acc > 32767)
+    return 32767;
+  if (acc < -32768)
+    return -32768;
+  return (int16_t)acc;
+}
+
+// Channel count is a template parameter so the inner loop fully unrolls.
+// Each product fits int32 (|coef| <= 2.0 in Q14), but a sum of three or more
+// does not, so the accumulators are 64-bit.
+template <int CH>
+static size_t mixFrames(const int16_t* src, size_t frames, int16_t* dst)
+{
+  int32_t cl[CH];
+  int32_t cr[CH];
+  for (int c = 0; c < CH; c++) {
+    cl[c] = g_coeffL[c];
+    cr[c] = g_coeffR[c];
+  }
+
+  for (size_t i = 0; i < frames; i++) {
+    const int16_t* in   = src + i * CH;
+    int64_t        accL = 0;
+    int64_t        accR = 0;
+    for (int c = 0; c < CH; c++) {
+      accL += (int32_t)in[c] * cl[c];
+      accR += (int32_t)in[c] * cr[c];
+    }
+    dst[i * 2]     = clampMix(accL);
+    dst[i * 2 + 1] = clampMix(accR);
+  }
+
+  return frames;
+}
+
+size_t downmixProcess(const int16_t* src, size_t frames, int16_t* dst)
+{
+  switch (g_channels) {
+  case 2:
+    return mixFrames<2>(src, frames, dst);
+  case 3:
+    return mixFrames<3>(src, frames, dst);
+  case 4:
+    return mixFrames<4>(src, frames, dst);
+  case 5:
+    return mixFrames<5>(src, frames, dst);
+  case 6:
+    return mixFrames<6>(src, frames, dst);
+  case 7:
+    return mixFrames<7>(src, frames, dst);
+  case 8:
+    return mixFrames<8>(src, frames, dst);
+  }
+  return 0;
+}
@@ -0,0 +1,252 @@
+#include "dsp_planner.h"
+
+#include "dsp_worker.h"
+#include "equalizer.h"
+#include "resampler.h"
+#include "web_log.h"
+
+// Rough ESP32 cycle costs per sample (per channel) of each stage.
+// Only relative values matter for ordering; absolute values feed the log.
+static const uint32_t CYCLES_DOWNMIX     = 6;  // Per source frame.
+static const uint32_t CYCLES_GAIN        = 14; // Float multiply + clamp.
+static const uint32_t CYCLES_BIQUAD      = 30; // One biquad section.
+static const uint32_t CYCLES_EQ_CLAMP    = 10; // Convert + clamp after the cascade.
+static const uint32_t CYCLES_RESAMPLE_LN = 32; // Linear interpolation.
+static const uint32_t CYCLES_RESAMPLE_ZH = 10; // Zero-order hold.
+static const uint32_t CYCLES_EXPAND      = 4;  // Per output frame.
+
+// A stereo EQ stage at least this expensive is split across both cores;
+// below it the hand-off overhead is not worth it.
+static const uint64_t SPLIT_EQ_MIN_CYCLES = 8000000;
+
+// Where a stage sits relative to the resampler.
+enum StagePos : uint8_t { POS_NONE, POS_PRE, POS_POST, POS_FOLDED };
+
+static const char* stageName(DspStage s)
+{
+  switch (s) {
+  case DSP_STAGE_DOWNMIX:
+    return "DOWNMIX";
+  case DSP_STAGE_GAIN:
+    return "GAIN";
+  case DSP_STAGE_EQ:
+    return "EQ";
+  case DSP_STAGE_RESAMPLE:
+    return "RESAMPLE";
+  case DSP_STAGE_EXPAND:
+    return "EXPAND";
+  }
+  return "?";
+}
+
+static uint64_t planCost(const DspPlanInput& in, uint8_t ch, StagePos gainPos, StagePos eqPos)
+{
+  uint64_t cost = 0;
+
+  if (in.srcChannels == 2 && ch == 1)
+    cost += (uint64_t)in.srcRate * CYCLES_DOWNMIX;
+
+  if (gainPos == POS_PRE)
+    cost += (uint64_t)in.srcRate * ch * CYCLES_GAIN;
+  else if (gainPos == POS_POST)
+    cost += (uint64_t)in.outRate * ch * CYCLES_GAIN;
+
+  uint32_t eqPerSample = (uint32_t)in.eqBands * CYCLES_BIQUAD + CYCLES_EQ_CLAMP;
+  if (eqPos == POS_PRE)
+    cost += (uint64_t)in.srcRate * ch * eqPerSample;
+  else if (eqPos == POS_POST)
+    cost += (uint64_t)in.outRate * ch * eqPerSample;
+
+  if (in.resample)
+    cost += (uint64_t)in.outRate * ch * (in.resampleHold ? CYCLES_RESAMPLE_ZH : CYCLES_RESAMPLE_LN);
+
+  if (ch == 1)
+    cost += (uint64_t)in.outRate * CYCLES_EXPAND;
+
+  return cost;
+}
+
+// Valid orders keep volume ahead of EQ (so EQ boosts see the attenuated signal)
+// and never apply the same stage twice.
+static bool orderValid(const DspPlanInput& in, StagePos gainPos, StagePos eqPos)
+{
+  bool hasEq = in.eqBands > 0;
+
+  if (!hasEq && (eqPos != POS_NONE || gainPos == POS_FOLDED))
+    return false;
+  if (hasEq && eqPos == POS_NONE)
+    return false;
+  if (!in.resample && (gainPos == POS_POST || eqPos == POS_POST))
+    return false;
+  if (gainPos == POS_NONE)
+    return false;
+  if (gainPos == POS_POST && eqPos == POS_PRE)
+    return false;
+
+  return true;
+}
+
+DspPlan dspPlanBuild(const DspPlanInput& in)
+{
+  DspPlan plan;
+  plan.input       = in;
+  plan.dspChannels = (in.srcChannels == 1 || in.forceMono) ? 1 : 2;
+
+  static const StagePos GAIN_CANDIDATES[] = {POS_PRE, POS_FOLDED, POS_POST};
+  static const StagePos EQ_CANDIDATES[]   = {POS_NONE, POS_PRE, POS_POST};
+
+  StagePos bestGain = POS_PRE;
+  StagePos bestEq   = in.eqBands > 0 ? POS_PRE : POS_NONE;
+  uint64_t bestCost = planCost(in, plan.dspChannels, bestGain, bestEq);
+
+  for (StagePos g : GAIN_CANDIDATES) {
+    for (StagePos e : EQ_CANDIDATES) {
+      if (!orderValid(in, g, e))
+        continue;
+      uint64_t c = planCost(in, plan.dspChannels, g, e);
+      if (c < bestCost) {
+        bestCost = c;
+        bestGain = g;
+        bestEq   = e;
+      }
+    }
+  }
+
+  plan.stageCount = 0;
+  if (in.srcChannels == 2 && plan.dspChannels == 1)
+    plan.stages[plan.stageCount++] = DSP_STAGE_DOWNMIX;
+  if (bestGain == POS_PRE)
+    plan.stages[plan.stageCount++] = DSP_STAGE_GAIN;
+  if (bestEq == POS_PRE)
+    plan.stages[plan.stageCount++] = DSP_STAGE_EQ;
+  if (in.resample)
+    plan.stages[plan.stageCount++] = DSP_STAGE_RESAMPLE;
+  if (bestGain == POS_POST)
+    plan.stages[plan.stageCount++] = DSP_STAGE_GAIN;
+  if (bestEq == POS_POST)
+    plan.stages[plan.stageCount++] = DSP_STAGE_EQ;
+  if (plan.dspChannels == 1)
+    plan.stages[plan.stageCount++] = DSP_STAGE_EXPAND;
+
+  plan.gainFolded      = bestGain == POS_FOLDED;
+  plan.eqRate          = bestEq == POS_POST ? in.outRate : in.srcRate;
+  plan.splitEq         = false;
+
+  if (in.dualCore && plan.dspChannels == 2 && bestEq != POS_NONE && dspWorkerReady()) {
+    uint32_t perSample = (uint32_t)in.eqBands * CYCLES_BIQUAD + CYCLES_EQ_CLAMP;
+    plan.splitEq       = (uint64_t)plan.eqRate * 2 * perSample >= SPLIT_EQ_MIN_CYCLES;
+  }
+  plan.estCyclesPerSec = bestCost > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t)bestCost;
+
+  return plan;
+}
+
+bool dspPlanMatches(const DspPlan& plan, const DspPlanInput& in)
+{
+  const DspPlanInput& a = plan.input;
+  return a.srcRate == in.srcRate && a.srcChannels == in.srcChannels && a.outRate == in.outRate &&
+         a.resample == in.resample && a.resampleHold == in.resampleHold &&
+         a.eqBands == in.eqBands && a.forceMono == in.forceMono && a.dualCore == in.dualCore;
+}
+
+void dspPlanLog(const DspPlan& plan)
+{
+  String line = "[DSP] Plan: ";
+  for (uint8_t i = 0; i < plan.stageCount; i++) {
+    if (i > 0)
+      line += " > ";
+    line += stageName(plan.stages[i]);
+    if (plan.stages[i] == DSP_STAGE_EQ) {
+      line += "@" + String(plan.eqRate);
+      if (plan.gainFolded)
+        line += "+gain";
+      if (plan.splitEq)
+        line += "[2 cores]";
+    }
+  }
+  if (plan.stageCount == 0)
+    line += "passthrough";
+
+  line += plan.dspChannels == 1 ? " (mono)" : " (stereo)";
+  WebLog.println(line);
+
+  WebLog.print("[DSP] Estimated cost: ");
+  WebLog.print((float)plan.estCyclesPerSec / 1000000.0f, 2);
+  WebLog.println(" Mcycles/s");
+}
+
+static inline int16_t clamp16(int32_t v)
+{
+  if (v > 32767)
+    return 32767;
+  if (v < -32768)
+    return -32768;
+  return (int16_t)v;
+}
+
+static void applyGain(int16_t* buf, size_t samples, float volume)
+{
+  for (size_t i = 0; i < samples; i++) {
+    buf[i] = clamp16((int32_t)((float)buf[i] * volume));
+  }
+}
+
+static void downmixInPlace(int16_t* buf, size_t frames)
+{
+  for (size_t i = 0; i < frames; i++) {
+    buf[i] = (int16_t)(((int32_t)buf[i * 2] + (int32_t)buf[i * 2 + 1]) >> 1);
+  }
+}
+
+// Expand mono samples to interleaved stereo in place (buffer holds 2 * frames).
+static void expandInPlace(int16_t* buf, size_t frames)
+{
+  for (size_t i = frames; i > 0; i--) {
+    int16_t s      = buf[i - 1];
+    buf[2 * i - 2] = s;
+    buf[2 * i - 1] = s;
+  }
+}
+
+size_t dspPlanRun(const DspPlan& plan, int16_t* buf, size_t frames, float volume,
+                  int16_t* resampleBuf, size_t resampleMaxFrames, int16_t** out)
+{
+  int16_t* cur = buf;
+  uint8_t  ch  = plan.input.srcChannels;
+
+  eqSetInputGain(plan.gainFolded ? volume : 1.0f);
+
+  for (uint8_t i = 0; i < plan.stageCount; i++) {
+    switch (plan.stages[i]) {
+    case DSP_STAGE_DOWNMIX:
+      downmixInPlace(cur, frames);
+      ch = 1;
+      break;
+    case DSP_STAGE_GAIN:
+      applyGain(cur, frames * ch, volume);
+      break;
+    case DSP_STAGE_EQ:
+      if (ch == 1)
+        eqProcessMono(cur, frames, plan.eqRate);
+      else if (plan.splitEq)
+        dspWorkerEqStereo(cur, frames, plan.eqRate);
+      else
+        eqProcessBuffer(cur, frames, plan.eqRate);
+      break;
+    case DSP_STAGE_RESAMPLE:
+      if (ch == 1)
+        frames = resamplerProcessMono(cur, frames, resampleBuf, resampleMaxFrames);
+      else
+        frames = resamplerProcess(cur, frames, resampleBuf, resampleMaxFrames);
+      cur = resampleBuf;
+      break;
+    case DSP_STAGE_EXPAND:
+      expandInPlace(cur, frames);
+      ch = 2;
+      break;
+    }
+  }
+
+  *out = cur;
+  return frames;
+}
@@ -0,0 +1,106 @@
+#include "dsp_worker.h"
+
+#include "equalizer.h"
+#include "web_log.h"
+
+DspWorkerStats g_dspWorkerStats;
+
+static const uint32_t    WORKER_STACK = 4096;
+static const UBaseType_t WORKER_PRIO  = 3;
+static const BaseType_t  WORKER_CORE  = 0;
+
+// Job descriptor written by the audio task before notifying the worker.
+// The notification itself orders the writes, so no lock is needed.
+struct DspJob {
+  int16_t* buffer;
+  size_t   frames;
+};
+
+static TaskHandle_t g_workerTask = nullptr;
+static DspJob       g_job        = {nullptr, 0};
+
+// Done signal back to the audio task. A binary semaphore rather than a task
+// notification: the audio task's notification slot is also given by the
+// decode-ahead producer, which would end the wait before the worker is done.
+static SemaphoreHandle_t g_jobDone = nullptr;
+
+static void workerTask(void* param)
+{
+  (void)param;
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    uint32_t start = micros();
+    eqProcessChannel(g_job.buffer, g_job.frames, 2, 1);
+    g_dspWorkerStats.workerUs += micros() - start;
+
+    xSemaphoreGive(g_jobDone);
+  }
+}
+
+void dspWorkerBegin()
+{
+  if (g_workerTask)
+    return;
+
+  g_dspWorkerStats.jobs     = 0;
+  g_dspWorkerStats.workerUs = 0;
+  g_dspWorkerStats.waitUs   = 0;
+
+  if (!g_jobDone)
+    g_jobDone = xSemaphoreCreateBinary();
+  if (!g_jobDone) {
+    WebLog.println("[DSPW] ❌ Failed to start worker, DSP stays single-core");
+    return;
+  }
+
+  BaseType_t ok = xTaskCreatePinnedToCore(workerTask, "dspWorker", WORKER_STACK, nullptr,
+                                          WORKER_PRIO, &g_workerTask, WORKER_CORE);
+  if (ok != pdPASS) {
+    g_workerTask = nullptr;
+    WebLog.println("[DSPW] ❌ Failed to start worker, DSP stays single-core");
+    return;
+  }
+
+  WebLog.println("[DSPW] ✅ Worker started on core 0");
+}
+
+bool dspWorkerReady()
+{
+  return g_workerTask != nullptr;
+}
+
+void dspWorkerEqStereo(int16_t* buffer, size_t frames, uint32_t sampleRate)
+{
+  // Coefficients are refreshed once here, never while both cores run.
+  eqPrepare(sampleRate);
+
+  if (!g_workerTask) {
+    eqProcessChannel(buffer, frames, 2, 0);
+    eqProcessChannel(buffer, frames, 2, 1);
+    return;
+  }
+
+  g_job.buffer = buffer;
+  g_job.frames = frames;
+  xTaskNotifyGive(g_workerTask);
+
+  eqProcessChannel(buffer, frames, 2, 0);
+
+  uint32_t waitStart = micros();
+  xSemaphoreTake(g_jobDone, portMAX_DELAY);
+  g_dspWorkerStats.waitUs += micros() - waitStart;
+  g_dspWorkerStats.jobs++;
+}
+
+String dspWorkerGetStatsJson()
+{
+  String json = "{";
+  json += "\"ready\":" + String(g_workerTask ? "true" : "false") + ",";
+  json += "\"jobs\":" + String(g_dspWorkerStats.jobs) + ",";
+  json += "\"workerUs\":" + String(g_dspWorkerStats.workerUs) + ",";
+  json += "\"waitUs\":" + String(g_dspWorkerStats.waitUs);
+  json += "}";
+  return json;
+}
@@ -2,6 +2,7 @@
 
 #include "web_log.h"
 
+#include <atomic>
 #include <math.h>
 
 // Global EQ settings.
@@ -21,10 +22,30 @@ struct BiquadCoeffs {
   float a1, a2;
 };
 
+// Bands closer to 0 dB than this are an identity filter and are skipped.
+static const float FLAT_GAIN_DB = 0.05f;
+
 static BiquadState  g_filterState[NUM_BANDS][2];
 static BiquadCoeffs g_filterCoeffs[NUM_BANDS];
 static uint32_t     g_lastSampleRate = 0;
 
+// Bands actually processed, strongest first (rebuilt when gains change).
+// Owned by the audio task: they are only rewritten from eqPrepare().
+static int  g_activeBands[NUM_BANDS];
+static int  g_activeBandCount = 0;
+static bool g_bandActive[NUM_BANDS];
+
+// Coefficients of the active bands in processing order. Stage 0 carries the
+// input gain so a separate volume pass can be folded into the EQ.
+static BiquadCoeffs g_activeCoeffs[NUM_BANDS];
+
+// Requests from other tasks (web panel, governor, planner). They only set these
+// and raise g_dirty; the audio task rebuilds the arrays above at its next
+// eqPrepare(), so coefficients never change under a running filter.
+static std::atomic<int>   g_maxBands(NUM_BANDS);
+static std::atomic<float> g_inputGain(1.0f);
+static std::atomic<bool>  g_dirty(false);
+
 void eqSetDefaults(EqSettings& eq)
 {
   eq.band60Hz  = 0.0f;
@@ -45,7 +66,14 @@ void eqInit()
     }
   }
 
-  g_lastSampleRate = 0;
+  for (int b = 0; b < NUM_BANDS; b++) {
+    g_bandActive[b] = false;
+  }
+
+  g_lastSampleRate  = 0;
+  g_activeBandCount = 0;
+  g_maxBands.store(NUM_BANDS);
+  g_dirty.store(false);
   WebLog.println("[EQ] ✅ Equalizer initialized");
 }
 
@@ -93,6 +121,105 @@ int eqGetBandFreq(int index)
   return BAND_FREQS[index];
 }
 
+// Copy active band coefficients in processing order and fold the input gain
+// into the feed-forward part of stage 0 (the cascade is linear, so this equals
+// scaling the input).
+static void refreshActiveCoeffs()
+{
+  float gain = g_inputGain.load();
+
+  for (int k = 0; k < g_activeBandCount; k++) {
+    g_activeCoeffs[k] = g_filterCoeffs[g_activeBands[k]];
+  }
+
+  if (g_activeBandCount > 0) {
+    g_activeCoeffs[0].b0 *= gain;
+    g_activeCoeffs[0].b1 *= gain;
+    g_activeCoeffs[0].b2 *= gain;
+  }
+}
+
+// Rebuild the list of processed bands: non-flat bands ordered by |gain|,
+// truncated to g_maxBands. Re-enabled bands start from a clean state.
+static void rebuildActiveBands()
+{
+  float* bands = &g_eqSettings.band60Hz;
+  int    count = 0;
+
+  for (int b = 0; b < NUM_BANDS; b++) {
+    if (fabsf(bands[b]) < FLAT_GAIN_DB)
+      continue;
+
+    int pos = count;
+    while (pos > 0 && fabsf(bands[g_activeBands[pos - 1]]) < fabsf(bands[b])) {
+      g_activeBands[pos] = g_activeBands[pos - 1];
+      pos--;
+    }
+    g_activeBands[pos] = b;
+    count++;
+  }
+
+  int maxBands = g_maxBands.load();
+  if (count > maxBands)
+    count = maxBands;
+
+  bool nowActive[NUM_BANDS] = {false, false, false, false, false};
+  for (int i = 0; i < count; i++) {
+    nowActive[g_activeBands[i]] = true;
+  }
+
+  for (int b = 0; b < NUM_BANDS; b++) {
+    if (nowActive[b] && !g_bandActive[b]) {
+      g_filterState[b][0] = {0, 0, 0, 0};
+      g_filterState[b][1] = {0, 0, 0, 0};
+    }
+    g_bandActive[b] = nowActive[b];
+  }
+
+  g_activeBandCount = count;
+  refreshActiveCoeffs();
+}
+
+void eqSetInputGain(float gain)
+{
+  if (gain == g_inputGain.load())
+    return;
+
+  g_inputGain.store(gain);
+  g_dirty.store(true, std::memory_order_release);
+}
+
+void eqSetMaxBands(int count)
+{
+  if (count < 1)
+    count = 1;
+  if (count > NUM_BANDS)
+    count = NUM_BANDS;
+  if (count == g_maxBands.load())
+    return;
+
+  g_maxBands.store(count);
+  g_dirty.store(true, std::memory_order_release);
+
+  WebLog.print("[EQ] Max bands: ");
+  WebLog.println(count);
+}
+
+// Counted from the settings rather than g_activeBandCount so the planner sees a
+// change before the audio task's next eqPrepare() has applied it.
+int eqGetActiveBandCount()
+{
+  const float* bands = &g_eqSettings.band60Hz;
+  int          count = 0;
+  for (int b = 0; b < NUM_BANDS; b++) {
+    if (fabsf(bands[b]) >= FLAT_GAIN_DB)
+      count++;
+  }
+
+  int maxBands = g_maxBands.load();
+  return count < maxBands ? count : maxBands;
+}
+
 static void calcPeakingEQ(float Fs, float f0, float gainDb, float Q, BiquadCoeffs& c)
 {
   float A     = powf(10.0f, gainDb / 40.0f);
@@ -115,11 +242,9 @@ static void calcPeakingEQ(float Fs, float f0, float gainDb, float Q, BiquadCoeff
   c.a2 = a2 / a0;
 }
 
-void eqUpdateCoefficients(uint32_t sampleRate)
+// Recompute all band coefficients for sampleRate. Audio task only.
+static void applyCoefficients(uint32_t sampleRate)
 {
-  if (sampleRate == 0)
-    return;
-
   static const float BAND_Q[NUM_BANDS] = {0.7f, 1.0f, 1.2f, 1.2f, 0.8f};
   float*             bands             = &g_eqSettings.band60Hz;
 
@@ -135,6 +260,16 @@ void eqUpdateCoefficients(uint32_t sampleRate)
     }
     g_lastSampleRate = sampleRate;
   }
+
+  rebuildActiveBands();
+}
+
+void eqUpdateCoefficients(uint32_t sampleRate)
+{
+  if (sampleRate == 0)
+    return;
+
+  g_dirty.store(true, std::memory_order_release);
 }
 
 static inline float biquadProcess(float x, BiquadCoeffs& c, BiquadState& s)
@@ -152,16 +287,15 @@ void eqProcessSample(int16_t& L, int16_t& R, uint32_t sampleRate)
   if (!g_eqSettings.enabled)
     return;
 
-  if (sampleRate != g_lastSampleRate) {
-    eqUpdateCoefficients(sampleRate);
-  }
+  eqPrepare(sampleRate);
 
   float fL = (float)L;
   float fR = (float)R;
 
-  for (int b = 0; b < NUM_BANDS; b++) {
-    fL = biquadProcess(fL, g_filterCoeffs[b], g_filterState[b][0]);
-    fR = biquadProcess(fR, g_filterCoeffs[b], g_filterState[b][1]);
+  for (int i = 0; i < g_activeBandCount; i++) {
+    int b = g_activeBands[i];
+    fL    = biquadProcess(fL, g_activeCoeffs[i], g_filterState[b][0]);
+    fR    = biquadProcess(fR, g_activeCoeffs[i], g_filterState[b][1]);
   }
 
   if (fL > 32767.0f)
@@ -177,37 +311,65 @@ void eqProcessSample(int16_t& L, int16_t& R, uint32_t sampleRate)
   R = (int16_t)fR;
 }
 
-void eqProcessBuffer(int16_t* buffer, size_t frames, uint32_t sampleRate)
+void eqPrepare(uint32_t sampleRate)
 {
-  if (!g_eqSettings.enabled)
+  if (sampleRate == 0)
     return;
 
-  if (sampleRate != g_lastSampleRate) {
-    eqUpdateCoefficients(sampleRate);
+  bool dirty = g_dirty.exchange(false, std::memory_order_acquire);
+  if (dirty || sampleRate != g_lastSampleRate) {
+    applyCoefficients(sampleRate);
   }
+}
 
-  for (size_t i = 0; i < frames; i++) {
-    int16_t& L = buffer[i * 2];
-    int16_t& R = buffer[i * 2 + 1];
+void eqResetState()
+{
+  for (int b = 0; b < NUM_BANDS; b++) {
+    for (int ch = 0; ch < 2; ch++) {
+      g_filterState[b][ch] = {0, 0, 0, 0};
+    }
+  }
+}
+
+void eqProcessChannel(int16_t* buffer, size_t frames, int stride, int ch)
+{
+  if (!g_eqSettings.enabled)
+    return;
 
-    float fL = (float)L;
-    float fR = (float)R;
+  int16_t* p = buffer + ch;
+  for (size_t i = 0; i < frames; i++, p += stride) {
+    float f = (float)*p;
 
-    for (int b = 0; b < NUM_BANDS; b++) {
-      fL = biquadProcess(fL, g_filterCoeffs[b], g_filterState[b][0]);
-      fR = biquadProcess(fR, g_filterCoeffs[b], g_filterState[b][1]);
+    for (int k = 0; k < g_activeBandCount; k++) {
+      f = biquadProcess(f, g_activeCoeffs[k], g_filterState[g_activeBands[k]][ch]);
     }
 
-    if (fL > 32767.0f)
-      fL = 32767.0f;
-    if (fL < -32768.0f)
-      fL = -32768.0f;
-    if (fR > 32767.0f)
-      fR = 32767.0f;
-    if (fR < -32768.0f)
-      fR = -32768.0f;
-
-    L = (int16_t)fL;
-    R = (int16_t)fR;
+    if (f > 32767.0f)
+      f = 32767.0f;
+    if (f < -32768.0f)
+      f = -32768.0f;
+
+    *p = (int16_t)f;
   }
 }
+
+void eqProcessBuffer(int16_t* buffer, size_t frames, uint32_t sampleRate)
+{
+  if (!g_eqSettings.enabled)
+    return;
+
+  // Channels are independent; running them one after another keeps this path
+  // bit-identical to the dual-core split in dsp_worker.
+  eqPrepare(sampleRate);
+  eqProcessChannel(buffer, frames, 2, 0);
+  eqProcessChannel(buffer, frames, 2, 1);
+}
+
+void eqProcessMono(int16_t* buffer, size_t frames, uint32_t sampleRate)
+{
+  if (!g_eqSettings.enabled)
+    return;
+
+  eqPrepare(sampleRate);
+  eqProcessChannel(buffer, frames, 1, 0);
+}
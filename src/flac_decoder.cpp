@@ -0,0 +1,904 @@
+#include "flac_decoder.h"
+
+#include "downmix.h"
+#include "sd_bus.h"
+#include "web_log.h"
+
+#include <SD.h>
+
+// Input buffer for the bit reader.
+static const size_t FLAC_IO_SIZE = 4096;
+
+// Upper bound for the per-channel sample buffers (channels x max block).
+static const size_t FLAC_MAX_SAMPLE_BYTES = 64 * 1024;
+
+// Seek points kept in memory; larger tables are thinned evenly.
+static const int FLAC_MAX_SEEK_POINTS = 256;
+
+// Give up on a stream after this many consecutive undecodable frames.
+static const int FLAC_MAX_BAD_FRAMES = 8;
+
+static const uint8_t CRC8_TABLE[256] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3,
+};
+
+// CRC-16 over a whole frame (polynomial 0x8005, MSB first, initial value 0).
+static const uint16_t CRC16_TABLE[256] = {
+    0x0000, 0x8005, 0x800F, 0x000A, 0x801B, 0x001E, 0x0014, 0x8011, 0x8033, 0x0036, 0x003C, 0x8039,
+    0x0028, 0x802D, 0x8027, 0x0022, 0x8063, 0x0066, 0x006C, 0x8069, 0x0078, 0x807D, 0x8077, 0x0072,
+    0x0050, 0x8055, 0x805F, 0x005A, 0x804B, 0x004E, 0x0044, 0x8041, 0x80C3, 0x00C6, 0x00CC, 0x80C9,
+    0x00D8, 0x80DD, 0x80D7, 0x00D2, 0x00F0, 0x80F5, 0x80FF, 0x00FA, 0x80EB, 0x00EE, 0x00E4, 0x80E1,
+    0x00A0, 0x80A5, 0x80AF, 0x00AA, 0x80BB, 0x00BE, 0x00B4, 0x80B1, 0x8093, 0x0096, 0x009C, 0x8099,
+    0x0088, 0x808D, 0x8087, 0x0082, 0x8183, 0x0186, 0x018C, 0x8189, 0x0198, 0x819D, 0x8197, 0x0192,
+    0x01B0, 0x81B5, 0x81BF, 0x01BA, 0x81AB, 0x01AE, 0x01A4, 0x81A1, 0x01E0, 0x81E5, 0x81EF, 0x01EA,
+    0x81FB, 0x01FE, 0x01F4, 0x81F1, 0x81D3, 0x01D6, 0x01DC, 0x81D9, 0x01C8, 0x81CD, 0x81C7, 0x01C2,
+    0x0140, 0x8145, 0x814F, 0x014A, 0x815B, 0x015E, 0x0154, 0x8151, 0x8173, 0x0176, 0x017C, 0x8179,
+    0x0168, 0x816D, 0x8167, 0x0162, 0x8123, 0x0126, 0x012C, 0x8129, 0x0138, 0x813D, 0x8137, 0x0132,
+    0x0110, 0x8115, 0x811F, 0x011A, 0x810B, 0x010E, 0x0104, 0x8101, 0x8303, 0x0306, 0x030C, 0x8309,
+    0x0318, 0x831D, 0x8317, 0x0312, 0x0330, 0x8335, 0x833F, 0x033A, 0x832B, 0x032E, 0x0324, 0x8321,
+    0x0360, 0x8365, 0x836F, 0x036A, 0x837B, 0x037E, 0x0374, 0x8371, 0x8353, 0x0356, 0x035C, 0x8359,
+    0x0348, 0x834D, 0x8347, 0x0342, 0x03C0, 0x83C5, 0x83CF, 0x03CA, 0x83DB, 0x03DE, 0x03D4, 0x83D1,
+    0x83F3, 0x03F6, 0x03FC, 0x83F9, 0x03E8, 0x83ED, 0x83E7, 0x03E2, 0x83A3, 0x03A6, 0x03AC, 0x83A9,
+    0x03B8, 0x83BD, 0x83B7, 0x03B2, 0x0390, 0x8395, 0x839F, 0x039A, 0x838B, 0x038E, 0x0384, 0x8381,
+    0x0280, 0x8285, 0x828F, 0x028A, 0x829B, 0x029E, 0x0294, 0x8291, 0x82B3, 0x02B6, 0x02BC, 0x82B9,
+    0x02A8, 0x82AD, 0x82A7, 0x02A2, 0x82E3, 0x02E6, 0x02EC, 0x82E9, 0x02F8, 0x82FD, 0x82F7, 0x02F2,
+    0x02D0, 0x82D5, 0x82DF, 0x02DA, 0x82CB, 0x02CE, 0x02C4, 0x82C1, 0x8243, 0x0246, 0x024C, 0x8249,
+    0x0258, 0x825D, 0x8257, 0x0252, 0x0270, 0x8275, 0x827F, 0x027A, 0x826B, 0x026E, 0x0264, 0x8261,
+    0x0220, 0x8225, 0x822F, 0x022A, 0x823B, 0x023E, 0x0234, 0x8231, 0x8213, 0x0216, 0x021C, 0x8219,
+    0x0208, 0x820D, 0x8207, 0x0202,
+};
+
+static inline uint16_t crc16Update(uint16_t crc, uint8_t v)
+{
+  return (uint16_t)((crc << 8) ^ CRC16_TABLE[(crc >> 8) ^ v]);
+}
+
+static const uint32_t SAMPLE_RATES[12] = {0,     88200, 176400, 192000, 8000,  16000,
+                                          22050, 24000, 32000,  44100,  48000, 96000};
+
+static const uint8_t SAMPLE_SIZES[8] = {0, 8, 12, 0, 16, 20, 24, 32};
+
+// MSB-first bit reader over an SD file with a block buffer. Up to 64 bits
+// are cached so most reads are a shift and a mask.
+class FlacBitReader
+{
+public:
+  void attach(File* f, uint8_t* buf)
+  {
+    m_file = f;
+    m_buf  = buf;
+    reset(f->position());
+  }
+
+  void reset(uint32_t filePos)
+  {
+    {
+      SdBusSlice slice(SD_IO_AUDIO);
+      m_file->seek(filePos);
+    }
+    m_bufPos  = 0;
+    m_bufLen  = 0;
+    m_nextPos = filePos;
+    m_cache   = 0;
+    m_bits    = 0;
+    m_error   = false;
+    m_crc     = 0;
+  }
+
+  bool error() const
+  {
+    return m_error;
+  }
+
+  // File offset of the next unread bit (rounded down to a byte).
+  uint32_t position() const
+  {
+    return m_nextPos - m_bits / 8;
+  }
+
+  uint32_t readBits(int n)
+  {
+    if (n == 0)
+      return 0;
+    if (m_bits < n && !refill(n))
+      return 0;
+    uint32_t v = (uint32_t)(m_cache >> (64 - n));
+    m_cache <<= n;
+    m_bits -= n;
+    return v;
+  }
+
+  int32_t readSigned(int n)
+  {
+    if (n == 0)
+      return 0;
+    uint32_t v = readBits(n);
+    return (int32_t)(v << (32 - n)) >> (32 - n);
+  }
+
+  uint32_t readUnary()
+  {
+    uint32_t count = 0;
+    for (;;) {
+      if (m_bits == 0 && !refill(1))
+        return 0;
+      uint64_t valid = m_cache & (~0ULL << (64 - m_bits));
+      if (valid == 0) {
+        count += m_bits;
+        m_cache = 0;
+        m_bits  = 0;
+        continue;
+      }
+      int lz = __builtin_clzll(valid);
+      count += lz;
+      m_cache <<= lz + 1;
+      m_bits -= lz + 1;
+      return count;
+    }
+  }
+
+  int32_t readRice(int param)
+  {
+    uint32_t q = readUnary();
+    uint32_t v = (q << param) | readBits(param);
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+  }
+
+  void alignToByte()
+  {
+    int drop = m_bits % 8;
+    m_cache <<= drop;
+    m_bits -= drop;
+  }
+
+  // Start a CRC-16 at the current (byte-aligned) position. seed covers the
+  // bytes already consumed; bytes sitting in the cache are folded in now.
+  void crcStart(uint16_t seed)
+  {
+    uint32_t pos            = position();
+    m_crc                   = seed;
+    m_crcAt[(pos - 1) & 15] = seed;
+    for (int k = 0; k < m_bits / 8; k++) {
+      m_crc                   = crc16Update(m_crc, (uint8_t)(m_cache >> (56 - 8 * k)));
+      m_crcAt[(pos + k) & 15] = m_crc;
+    }
+  }
+
+  // CRC-16 of everything consumed since crcStart() (byte-aligned). Bytes are
+  // summed as they enter the cache, so look up the value at the read position.
+  uint16_t crcValue() const
+  {
+    return m_crcAt[(position() - 1) & 15];
+  }
+
+private:
+  bool refill(int need)
+  {
+    while (m_bits <= 56) {
+      if (m_bufPos == m_bufLen) {
+        m_bufLen = sdBusRead(SD_IO_AUDIO, *m_file, m_buf, FLAC_IO_SIZE);
+        m_bufPos = 0;
+        if (m_bufLen == 0)
+          break;
+      }
+      uint8_t v = m_buf[m_bufPos++];
+      m_cache |= (uint64_t)v << (56 - m_bits);
+      m_bits += 8;
+      m_crc                   = crc16Update(m_crc, v);
+      m_crcAt[m_nextPos & 15] = m_crc;
+      m_nextPos++;
+    }
+
+    if (m_bits < need) {
+      m_error = true;
+      return false;
+    }
+    return true;
+  }
+
+  File*    m_file    = nullptr;
+  uint8_t* m_buf     = nullptr;
+  size_t   m_bufPos  = 0;
+  size_t   m_bufLen  = 0;
+  uint32_t m_nextPos = 0;
+  uint64_t m_cache   = 0;
+  int      m_bits    = 0;
+  bool     m_error   = false;
+  uint16_t m_crc     = 0;
+  uint16_t m_crcAt[16]; // Running CRC after each of the last 16 fetched bytes.
+};
+
+struct FlacSeekPoint {
+  uint64_t sample;
+  uint32_t offset; // From the first frame.
+};
+
+struct FlacFrameHeader {
+  uint32_t blockSize;
+  uint32_t sampleRate;
+  uint8_t  channelAssign;
+  uint8_t  channels;
+  uint8_t  bps;
+  uint64_t number; // Frame number (fixed blocking) or first sample.
+  bool     variable;
+};
+
+class FlacDecoder : public IAudioDecoder
+{
+public:
+  ~FlacDecoder() override
+  {
+    close();
+  }
+
+  const char*            name() const override;
+  bool                   open(const String& path) override;
+  const AudioStreamInfo& info() const override;
+  size_t                 decode(int16_t* out, size_t maxFrames) override;
+  bool                   seek(uint32_t ms) override;
+  uint64_t               positionBytes() const override;
+  uint32_t               positionMs() const override;
+  void                   close() override;
+
+private:
+  bool readMetadata();
+  bool readSeekTable(uint32_t length);
+  bool readFrameHeader(FlacFrameHeader& h);
+  bool decodeFrame();
+  bool decodeSubframe(int32_t* dst, uint32_t blockSize, int bps);
+  bool decodeResidual(int32_t* dst, uint32_t blockSize, int order);
+  bool seekToSample(uint64_t target);
+
+  File            m_file;
+  FlacBitReader   m_reader;
+  uint8_t*        m_io      = nullptr;
+  int32_t*        m_samples = nullptr; // channels x maxBlock, planar.
+  AudioStreamInfo m_info;
+
+  uint32_t m_minBlock     = 0;
+  uint32_t m_maxBlock     = 0;
+  uint8_t  m_bps          = 0;
+  uint64_t m_totalSamples = 0;
+  uint32_t m_firstFrame   = 0;
+  uint32_t m_fileSize     = 0;
+
+  FlacSeekPoint* m_seek      = nullptr;
+  int            m_seekCount = 0;
+
+  uint32_t m_blockSize  = 0; // Frames in the current decoded block.
+  uint32_t m_blockPos   = 0; // Next frame to hand out.
+  uint64_t m_frameStart = 0; // Sample number of the current block.
+  uint64_t m_samplePos  = 0; // Next sample handed to the engine.
+
+  uint64_t m_decodeUs      = 0;
+  uint64_t m_decodedFrames = 0;
+  int      m_badFrames     = 0;
+};
+
+const char* FlacDecoder::name() const
+{
+  return "FLAC";
+}
+
+const AudioStreamInfo& FlacDecoder::info() const
+{
+  return m_info;
+}
+
+bool FlacDecoder::open(const String& path)
+{
+  m_file = SD.open(path, FILE_READ);
+  if (!m_file) {
+    WebLog.print("[FLAC] ❌ Cannot open: ");
+    WebLog.println(path);
+    return false;
+  }
+
+  m_fileSize = m_file.size();
+
+  m_io = (uint8_t*)malloc(FLAC_IO_SIZE);
+  if (!m_io) {
+    WebLog.println("[FLAC] ❌ malloc failed");
+    return false;
+  }
+
+  m_reader.attach(&m_file, m_io);
+  if (!readMetadata())
+    return false;
+
+  if (m_bps < 8 || m_bps > 24) {
+    WebLog.println("[FLAC] ❌ Only 8..24-bit streams are supported");
+    return false;
+  }
+
+  if (m_info.channels < 1 || m_info.channels > DOWNMIX_MAX_CHANNELS) {
+    WebLog.println("[FLAC] ❌ FLAC must have 1..8 channels");
+    return false;
+  }
+
+  size_t sampleBytes = (size_t)m_info.channels * m_maxBlock * sizeof(int32_t);
+  if (m_maxBlock == 0 || sampleBytes > FLAC_MAX_SAMPLE_BYTES) {
+    WebLog.print("[FLAC] ❌ Block too large: ");
+    WebLog.print(m_info.channels);
+    WebLog.print(" ch x ");
+    WebLog.println(m_maxBlock);
+    return false;
+  }
+
+  m_samples = (int32_t*)malloc(sampleBytes);
+  if (!m_samples) {
+    WebLog.println("[FLAC] ❌ malloc failed");
+    return false;
+  }
+
+  m_firstFrame = m_reader.position();
+
+  m_info.bitsPerSample = m_bps;
+  m_info.totalBytes    = m_fileSize - m_firstFrame;
+  m_info.totalMs       = (uint32_t)(m_totalSamples * 1000 / m_info.sampleRate);
+
+  WebLog.print("[FLAC] Block ");
+  WebLog.print(m_minBlock);
+  WebLog.print("..");
+  WebLog.print(m_maxBlock);
+  WebLog.print(", ");
+  WebLog.print(m_bps);
+  WebLog.print(" bit, ");
+  WebLog.print(m_seekCount);
+  WebLog.println(" seek points");
+  return true;
+}
+
+bool FlacDecoder::readMetadata()
+{
+  if (m_reader.readBits(32) != 0x664C6143) { // "fLaC"
+    WebLog.println("[FLAC] ❌ Missing fLaC marker");
+    return false;
+  }
+
+  bool haveInfo = false;
+  bool last     = false;
+
+  while (!last) {
+    last            = m_reader.readBits(1) != 0;
+    uint32_t type   = m_reader.readBits(7);
+    uint32_t length = m_reader.readBits(24);
+    if (m_reader.error())
+      return false;
+
+    uint32_t blockEnd = m_reader.position() + length;
+
+    if (type == 0 && length >= 34) {
+      m_minBlock        = m_reader.readBits(16);
+      m_maxBlock        = m_reader.readBits(16);
+      m_reader.readBits(24); // Min frame size.
+      m_reader.readBits(24); // Max frame size.
+      m_info.sampleRate = m_reader.readBits(20);
+      m_info.channels   = (uint16_t)(m_reader.readBits(3) + 1);
+      m_bps             = (uint8_t)(m_reader.readBits(5) + 1);
+      m_totalSamples    = ((uint64_t)m_reader.readBits(4) << 32) | m_reader.readBits(32);
+      haveInfo          = m_info.sampleRate > 0;
+    } else if (type == 3) {
+      if (!readSeekTable(length))
+        return false;
+    }
+
+    // Skip the rest of the block (MD5, padding, tags, pictures, ...).
+    m_reader.reset(blockEnd);
+  }
+
+  if (!haveInfo) {
+    WebLog.println("[FLAC] ❌ STREAMINFO missing");
+    return false;
+  }
+  return true;
+}
+
+bool FlacDecoder::readSeekTable(uint32_t length)
+{
+  int points = (int)(length / 18);
+  if (points == 0)
+    return true;
+
+  // Thin large tables evenly so memory stays bounded.
+  int step    = (points + FLAC_MAX_SEEK_POINTS - 1) / FLAC_MAX_SEEK_POINTS;
+  m_seek      = (FlacSeekPoint*)malloc(((points + step - 1) / step) * sizeof(FlacSeekPoint));
+  m_seekCount = 0;
+  if (!m_seek)
+    return false;
+
+  for (int i = 0; i < points; i++) {
+    uint64_t sample = ((uint64_t)m_reader.readBits(32) << 32) | m_reader.readBits(32);
+    uint64_t offset = ((uint64_t)m_reader.readBits(32) << 32) | m_reader.readBits(32);
+    m_reader.readBits(16); // Frame samples.
+
+    bool placeholder = sample == 0xFFFFFFFFFFFFFFFFULL;
+    if (!placeholder && i % step == 0 && offset < 0xFFFFFFFFULL) {
+      m_seek[m_seekCount].sample = sample;
+      m_seek[m_seekCount].offset = (uint32_t)offset;
+      m_seekCount++;
+    }
+  }
+
+  return !m_reader.error();
+}
+
+// Find the next frame sync and parse its header, verifying CRC-8 so a stray
+// 0xFFF8 in audio data is not taken for a frame.
+bool FlacDecoder::readFrameHeader(FlacFrameHeader& h)
+{
+  m_reader.alignToByte();
+
+  for (;;) {
+    uint8_t hdr[16];
+    int     n = 0;
+
+    uint32_t b = m_reader.readBits(8);
+    if (m_reader.error())
+      return false;
+    if (b != 0xFF)
+      continue;
+
+    // Runs of 0xFF may hide the real sync byte pair.
+    uint32_t b2 = m_reader.readBits(8);
+    while (b2 == 0xFF && !m_reader.error()) {
+      b2 = m_reader.readBits(8);
+    }
+    if ((b2 & 0xFE) != 0xF8)
+      continue;
+
+    hdr[n++]         = 0xFF;
+    hdr[n++]         = (uint8_t)b2;
+    h.variable       = (b2 & 1) != 0;
+    uint32_t b3      = m_reader.readBits(8);
+    uint32_t b4      = m_reader.readBits(8);
+    hdr[n++]         = (uint8_t)b3;
+    hdr[n++]         = (uint8_t)b4;
+    uint32_t bsCode  = b3 >> 4;
+    uint32_t srCode  = b3 & 15;
+    h.channelAssign  = (uint8_t)(b4 >> 4);
+    uint32_t bpsCode = (b4 >> 1) & 7;
+
+    if (bsCode == 0 || srCode == 15 || h.channelAssign > 10 || bpsCode == 3)
+      continue;
+
+    // UTF-8 style coded frame/sample number.
+    uint32_t first = m_reader.readBits(8);
+    hdr[n++]       = (uint8_t)first;
+    int extra      = 0;
+    uint64_t num   = first;
+    if (first >= 0xC0) {
+      uint32_t mask = 0x20;
+      extra         = 1;
+      while ((first & mask) && extra < 6) {
+        mask >>= 1;
+        extra++;
+      }
+      num = first & (mask - 1);
+    }
+    for (int i = 0; i < extra; i++) {
+      uint32_t c = m_reader.readBits(8);
+      hdr[n++]   = (uint8_t)c;
+      num        = (num << 6) | (c & 0x3F);
+    }
+    h.number = num;
+
+    if (bsCode == 1)
+      h.blockSize = 192;
+    else if (bsCode <= 5)
+      h.blockSize = 576u << (bsCode - 2);
+    else if (bsCode == 6) {
+      uint32_t v  = m_reader.readBits(8);
+      hdr[n++]    = (uint8_t)v;
+      h.blockSize = v + 1;
+    } else if (bsCode == 7) {
+      uint32_t v  = m_reader.readBits(16);
+      hdr[n++]    = (uint8_t)(v >> 8);
+      hdr[n++]    = (uint8_t)v;
+      h.blockSize = v + 1;
+    } else
+      h.blockSize = 256u << (bsCode - 8);
+
+    if (srCode == 0)
+      h.sampleRate = m_info.sampleRate;
+    else if (srCode < 12)
+      h.sampleRate = SAMPLE_RATES[srCode];
+    else {
+      uint32_t v = m_reader.readBits(srCode == 12 ? 8 : 16);
+      if (srCode == 12) {
+        hdr[n++]     = (uint8_t)v;
+        h.sampleRate = v * 1000;
+      } else {
+        hdr[n++]     = (uint8_t)(v >> 8);
+        hdr[n++]     = (uint8_t)v;
+        h.sampleRate = srCode == 13 ? v : v * 10;
+      }
+    }
+
+    uint8_t crc = 0;
+    for (int i = 0; i < n; i++) {
+      crc = CRC8_TABLE[crc ^ hdr[i]];
+    }
+    if (m_reader.readBits(8) != crc || m_reader.error())
+      continue;
+
+    h.bps      = bpsCode == 0 ? m_bps : SAMPLE_SIZES[bpsCode];
+    h.channels = h.channelAssign < 8 ? h.channelAssign + 1 : 2;
+
+    if (h.blockSize > m_maxBlock || h.channels != m_info.channels || h.bps != m_bps)
+      continue;
+
+    // The frame CRC-16 covers the header too.
+    uint16_t crc16 = 0;
+    for (int i = 0; i < n; i++) {
+      crc16 = crc16Update(crc16, hdr[i]);
+    }
+    m_reader.crcStart(crc16Update(crc16, crc));
+    return true;
+  }
+}
+
+bool FlacDecoder::decodeResidual(int32_t* dst, uint32_t blockSize, int order)
+{
+  uint32_t method = m_reader.readBits(2);
+  if (method > 1)
+    return false;
+
+  int      paramBits  = method == 0 ? 4 : 5;
+  uint32_t escape     = method == 0 ? 15 : 31;
+  uint32_t partOrder  = m_reader.readBits(4);
+  uint32_t partitions = 1u << partOrder;
+  uint32_t partSize   = blockSize >> partOrder;
+
+  if (partSize * partitions != blockSize || partSize < (uint32_t)order)
+    return false;
+
+  int32_t* p = dst + order;
+  for (uint32_t part = 0; part < partitions; part++) {
+    uint32_t count = part == 0 ? partSize - order : partSize;
+    uint32_t param = m_reader.readBits(paramBits);
+
+    if (param == escape) {
+      int bits = (int)m_reader.readBits(5);
+      for (uint32_t i = 0; i < count; i++) {
+        *p++ = m_reader.readSigned(bits);
+      }
+    } else {
+      for (uint32_t i = 0; i < count; i++) {
+        *p++ = m_reader.readRice((int)param);
+      }
+    }
+
+    if (m_reader.error())
+      return false;
+  }
+
+  return true;
+}
+
+bool FlacDecoder::decodeSubframe(int32_t* dst, uint32_t blockSize, int bps)
+{
+  if (m_reader.readBits(1) != 0)
+    return false;
+
+  uint32_t type   = m_reader.readBits(6);
+  int      wasted = 0;
+  if (m_reader.readBits(1)) {
+    wasted = (int)m_reader.readUnary() + 1;
+    bps -= wasted;
+  }
+  if (bps <= 0 || bps > 32)
+    return false;
+
+  if (type == 0) {
+    // CONSTANT.
+    int32_t v = m_reader.readSigned(bps);
+    for (uint32_t i = 0; i < blockSize; i++) {
+      dst[i] = v;
+    }
+  } else if (type == 1) {
+    // VERBATIM.
+    for (uint32_t i = 0; i < blockSize; i++) {
+      dst[i] = m_reader.readSigned(bps);
+    }
+  } else if (type >= 8 && type <= 12) {
+    // FIXED predictor, order 0..4.
+    int order = (int)type - 8;
+    if ((uint32_t)order > blockSize)
+      return false;
+    for (int i = 0; i < order; i++) {
+      dst[i] = m_reader.readSigned(bps);
+    }
+    if (!decodeResidual(dst, blockSize, order))
+      return false;
+
+    switch (order) {
+    case 1:
+      for (uint32_t i = 1; i < blockSize; i++)
+        dst[i] += dst[i - 1];
+      break;
+    case 2:
+      for (uint32_t i = 2; i < blockSize; i++)
+        dst[i] += 2 * dst[i - 1] - dst[i - 2];
+      break;
+    case 3:
+      for (uint32_t i = 3; i < blockSize; i++)
+        dst[i] += 3 * dst[i - 1] - 3 * dst[i - 2] + dst[i - 3];
+      break;
+    case 4:
+      for (uint32_t i = 4; i < blockSize; i++)
+        dst[i] += 4 * dst[i - 1] - 6 * dst[i - 2] + 4 * dst[i - 3] - dst[i - 4];
+      break;
+    default:
+      break;
+    }
+  } else if (type >= 32) {
+    // LPC, order 1..32.
+    int order = (int)(type & 31) + 1;
+    if ((uint32_t)order > blockSize)
+      return false;
+    for (int i = 0; i < order; i++) {
+      dst[i] = m_reader.readSigned(bps);
+    }
+
+    int precision = (int)m_reader.readBits(4) + 1;
+    int shift     = m_reader.readSigned(5);
+    if (precision == 16 || shift < 0)
+      return false;
+
+    int32_t coefs[32];
+    for (int i = 0; i < order; i++) {
+      coefs[i] = m_reader.readSigned(precision);
+    }
+
+    if (!decodeResidual(dst, blockSize, order))
+      return false;
+
+    // 16-bit content fits a 32-bit accumulator; wider content needs 64.
+    if (bps + precision + 5 <= 32) {
+      for (uint32_t i = order; i < blockSize; i++) {
+        int32_t        sum = 0;
+        const int32_t* h   = dst + i;
+        for (int j = 0; j < order; j++) {
+          sum += coefs[j] * h[-j - 1];
+        }
+        dst[i] += sum >> shift;
+      }
+    } else {
+      for (uint32_t i = order; i < blockSize; i++) {
+        int64_t        sum = 0;
+        const int32_t* h   = dst + i;
+        for (int j = 0; j < order; j++) {
+          sum += (int64_t)coefs[j] * h[-j - 1];
+        }
+        dst[i] += (int32_t)(sum >> shift);
+      }
+    }
+  } else {
+    return false;
+  }
+
+  if (wasted > 0) {
+    for (uint32_t i = 0; i < blockSize; i++) {
+      dst[i] <<= wasted;
+    }
+  }
+
+  return !m_reader.error();
+}
+
+bool FlacDecoder::decodeFrame()
+{
+  uint32_t start = micros();
+
+  while (m_badFrames < FLAC_MAX_BAD_FRAMES) {
+    FlacFrameHeader h;
+    if (!readFrameHeader(h))
+      return false; // End of file.
+
+    bool ok = true;
+    for (int ch = 0; ch < h.channels && ok; ch++) {
+      // The side channel carries one extra bit.
+      int  bps  = h.bps;
+      bool side = (h.channelAssign == 8 && ch == 1) || (h.channelAssign == 9 && ch == 0) ||
+                  (h.channelAssign == 10 && ch == 1);
+      if (side)
+        bps++;
+      ok = decodeSubframe(m_samples + (size_t)ch * m_maxBlock, h.blockSize, bps);
+    }
+
+    if (!ok) {
+      m_badFrames++;
+      WebLog.println("[FLAC] ⚠️ Corrupt frame, resyncing");
+      continue;
+    }
+
+    m_reader.alignToByte();
+    uint16_t crc   = m_reader.crcValue();
+    bool     crcOk = m_reader.readBits(16) == crc;
+
+    int32_t* a = m_samples;
+    int32_t* b = m_samples + m_maxBlock;
+    switch (h.channelAssign) {
+    case 8: // Left/side.
+      for (uint32_t i = 0; i < h.blockSize; i++)
+        b[i] = a[i] - b[i];
+      break;
+    case 9: // Side/right.
+      for (uint32_t i = 0; i < h.blockSize; i++)
+        a[i] += b[i];
+      break;
+    case 10: // Mid/side.
+      for (uint32_t i = 0; i < h.blockSize; i++) {
+        int32_t mid  = (a[i] << 1) | (b[i] & 1);
+        int32_t side = b[i];
+        a[i]         = (mid + side) >> 1;
+        b[i]         = (mid - side) >> 1;
+      }
+      break;
+    default:
+      break;
+    }
+
+    if (!crcOk) {
+      // Damaged audio that still parsed: play silence for its length rather
+      // than a burst of noise, so the position stays right.
+      for (int ch = 0; ch < h.channels; ch++) {
+        memset(m_samples + (size_t)ch * m_maxBlock, 0, h.blockSize * sizeof(int32_t));
+      }
+      WebLog.println("[FLAC] ⚠️ Frame CRC mismatch, muted");
+    }
+
+    m_frameStart = h.variable ? h.number : h.number * m_maxBlock;
+    m_blockSize  = h.blockSize;
+    m_blockPos   = 0;
+    m_badFrames  = 0;
+
+    m_decodeUs += micros() - start;
+    m_decodedFrames += h.blockSize;
+    return true;
+  }
+
+  WebLog.println("[FLAC] ❌ Too many corrupt frames, stopping");
+  return false;
+}
+
+size_t FlacDecoder::decode(int16_t* out, size_t maxFrames)
+{
+  size_t produced = 0;
+  int    channels = m_info.channels;
+  int    shift    = (int)m_bps - 16;
+
+  while (produced < maxFrames) {
+    if (m_blockPos >= m_blockSize && !decodeFrame())
+      break;
+
+    size_t n = m_blockSize - m_blockPos;
+    if (n > maxFrames - produced)
+      n = maxFrames - produced;
+
+    // Planar int32 to interleaved 16-bit.
+    for (int ch = 0; ch < channels; ch++) {
+      const int32_t* src = m_samples + (size_t)ch * m_maxBlock + m_blockPos;
+      int16_t*       dst = out + produced * channels + ch;
+      if (shift > 0) {
+        for (size_t i = 0; i < n; i++, dst += channels)
+          *dst = (int16_t)(src[i] >> shift);
+      } else {
+        for (size_t i = 0; i < n; i++, dst += channels)
+          *dst = (int16_t)(src[i] << -shift);
+      }
+    }
+
+    m_blockPos += n;
+    produced += n;
+  }
+
+  m_samplePos += produced;
+  return produced;
+}
+
+// Position at a frame at or before target, then decode forward to it.
+bool FlacDecoder::seekToSample(uint64_t target)
+{
+  uint32_t offset = 0;
+
+  if (m_seekCount > 0) {
+    for (int i = 0; i < m_seekCount && m_seek[i].sample <= target; i++) {
+      offset = m_seek[i].offset;
+    }
+  } else if (m_totalSamples > 0) {
+    // No table: land slightly early by byte ratio and resync on a frame.
+    uint64_t bytes = (uint64_t)(m_fileSize - m_firstFrame) * target / m_totalSamples;
+    offset         = (uint32_t)(bytes * 95 / 100);
+  }
+
+  m_reader.reset(m_firstFrame + offset);
+  m_blockSize = 0;
+  m_blockPos  = 0;
+
+  while (decodeFrame()) {
+    if (m_frameStart + m_blockSize > target) {
+      m_blockPos  = target > m_frameStart ? (uint32_t)(target - m_frameStart) : 0;
+      m_samplePos = m_frameStart + m_blockPos;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool FlacDecoder::seek(uint32_t ms)
+{
+  uint64_t target = (uint64_t)ms * m_info.sampleRate / 1000;
+  if (m_totalSamples > 0 && target >= m_totalSamples)
+    target = m_totalSamples - 1;
+  return seekToSample(target);
+}
+
+uint64_t FlacDecoder::positionBytes() const
+{
+  uint32_t pos = m_reader.position();
+  return pos > m_firstFrame ? pos - m_firstFrame : 0;
+}
+
+uint32_t FlacDecoder::positionMs() const
+{
+  if (m_info.sampleRate == 0)
+    return 0;
+  return (uint32_t)(m_samplePos * 1000 / m_info.sampleRate);
+}
+
+void FlacDecoder::close()
+{
+  if (m_decodedFrames > 0 && m_info.sampleRate > 0) {
+    // Decode cost per second of audio, for sizing against the real-time budget.
+    uint64_t audioMs = m_decodedFrames * 1000 / m_info.sampleRate;
+    WebLog.print("[FLAC] Decode cost: ");
+    WebLog.print(audioMs ? (uint32_t)(m_decodeUs / audioMs) : 0);
+    WebLog.println(" ms per second of audio");
+    m_decodedFrames = 0;
+    m_decodeUs      = 0;
+  }
+
+  if (m_file)
+    m_file.close();
+  free(m_io);
+  free(m_samples);
+  free(m_seek);
+  m_io        = nullptr;
+  m_samples   = nullptr;
+  m_seek      = nullptr;
+  m_seekCount = 0;
+}
+
+static bool flacProbe(const uint8_t* head, size_t len)
+{
+  return len >= 4 && memcmp(head, "fLaC", 4) == 0;
+}
+
+static IAudioDecoder* flacCreate()
+{
+  return new FlacDecoder();
+}
+
+const AudioDecoderEntry& flacDecoderEntry()
+{
+  static const AudioDecoderEntry entry = {"FLAC", ".flac", flacProbe, flacCreate, true};
+  return entry;
+}
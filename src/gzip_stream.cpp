@@ -0,0 +1,224 @@
+#include "gzip_stream.h"
+
+#include "crc32.h"
+
+#include <rom/miniz.h>
+
+static const size_t GZIP_WINDOW = TINFL_LZ_DICT_SIZE;
+
+// Header flag bits (RFC 1952).
+static const uint8_t GZIP_FHCRC    = 0x02;
+static const uint8_t GZIP_FEXTRA   = 0x04;
+static const uint8_t GZIP_FNAME    = 0x08;
+static const uint8_t GZIP_FCOMMENT = 0x10;
+
+enum GzipState {
+  GZIP_HEADER,
+  GZIP_EXTRA_LEN,
+  GZIP_EXTRA,
+  GZIP_NAME,
+  GZIP_COMMENT,
+  GZIP_HCRC,
+  GZIP_DEFLATE,
+  GZIP_TRAILER,
+  GZIP_DONE,
+  GZIP_ERROR
+};
+
+struct GzipInflate {
+  tinfl_decompressor decomp;
+  uint8_t            window[GZIP_WINDOW]; // Output ring; tinfl reads matches from it.
+  size_t             pos;
+};
+
+static bool fail(GzipStream* gz, const char* error)
+{
+  gz->state = GZIP_ERROR;
+  gz->error = error;
+  return false;
+}
+
+static uint32_t le32(const uint8_t* p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// The state after the header field that just ended.
+static int nextHeaderState(const GzipStream* gz, int after)
+{
+  if (after < GZIP_EXTRA_LEN && (gz->flags & GZIP_FEXTRA))
+    return GZIP_EXTRA_LEN;
+  if (after < GZIP_NAME && (gz->flags & GZIP_FNAME))
+    return GZIP_NAME;
+  if (after < GZIP_COMMENT && (gz->flags & GZIP_FCOMMENT))
+    return GZIP_COMMENT;
+  if (after < GZIP_HCRC && (gz->flags & GZIP_FHCRC))
+    return GZIP_HCRC;
+  return GZIP_DEFLATE;
+}
+
+// Consume header bytes one at a time; the header is a few bytes long.
+static bool headerByte(GzipStream* gz, uint8_t b)
+{
+  switch (gz->state) {
+  case GZIP_HEADER:
+    gz->buf[gz->fill++] = b;
+    if (gz->fill < 10)
+      return true;
+    if (gz->buf[0] != 0x1F || gz->buf[1] != 0x8B || gz->buf[2] != 8)
+      return fail(gz, "not gzip/deflate");
+    gz->flags = gz->buf[3];
+    gz->fill  = 0;
+    gz->state = nextHeaderState(gz, GZIP_HEADER);
+    return true;
+
+  case GZIP_EXTRA_LEN:
+    gz->buf[gz->fill++] = b;
+    if (gz->fill < 2)
+      return true;
+    gz->skip  = gz->buf[0] | (gz->buf[1] << 8);
+    gz->fill  = 0;
+    gz->state = gz->skip > 0 ? GZIP_EXTRA : nextHeaderState(gz, GZIP_EXTRA);
+    return true;
+
+  case GZIP_EXTRA:
+    if (--gz->skip == 0)
+      gz->state = nextHeaderState(gz, GZIP_EXTRA);
+    return true;
+
+  case GZIP_NAME:
+  case GZIP_COMMENT:
+    if (b == 0)
+      gz->state = nextHeaderState(gz, gz->state);
+    return true;
+
+  case GZIP_HCRC:
+    if (++gz->fill == 2) {
+      gz->fill  = 0;
+      gz->state = GZIP_DEFLATE;
+    }
+    return true;
+  }
+  return true;
+}
+
+// Inflate from data; returns the bytes consumed.
+static size_t inflateSome(GzipStream* gz, const uint8_t* data, size_t len)
+{
+  GzipInflate* inf  = gz->inflate;
+  size_t       used = 0;
+
+  for (;;) {
+    size_t       inBytes  = len - used;
+    size_t       outBytes = GZIP_WINDOW - inf->pos;
+    tinfl_status status   = tinfl_decompress(&inf->decomp, data + used, &inBytes, inf->window,
+                                             inf->window + inf->pos, &outBytes,
+                                             TINFL_FLAG_HAS_MORE_INPUT);
+    used += inBytes;
+
+    if (outBytes > 0) {
+      const uint8_t* out = inf->window + inf->pos;
+      gz->crc            = crc32Update(gz->crc, out, outBytes);
+      gz->outBytes += outBytes;
+      inf->pos = (inf->pos + outBytes) & (GZIP_WINDOW - 1);
+      if (!gz->sink(out, outBytes, gz->ctx)) {
+        fail(gz, "stopped");
+        return used;
+      }
+    }
+
+    if (status == TINFL_STATUS_DONE) {
+      gz->state = GZIP_TRAILER;
+      gz->fill  = 0;
+      return used;
+    }
+    if (status < 0) {
+      fail(gz, "corrupt deflate data");
+      return used;
+    }
+    // Window full: drain it and go on; otherwise wait for more input.
+    if (status != TINFL_STATUS_HAS_MORE_OUTPUT && (used == len || (inBytes == 0 && outBytes == 0)))
+      return used;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Public API
+// ----------------------------------------------------------------------------
+
+bool gzipBegin(GzipStream* gz, GzipSinkFn sink, void* ctx)
+{
+  memset(gz, 0, sizeof(*gz));
+  gz->sink    = sink;
+  gz->ctx     = ctx;
+  gz->state   = GZIP_HEADER;
+  gz->inflate = (GzipInflate*)malloc(sizeof(GzipInflate));
+  if (!gz->inflate)
+    return fail(gz, "out of memory");
+
+  tinfl_init(&gz->inflate->decomp);
+  gz->inflate->pos = 0;
+  return true;
+}
+
+bool gzipFeed(GzipStream* gz, const uint8_t* data, size_t len)
+{
+  gz->inBytes += len;
+
+  while (len > 0) {
+    switch (gz->state) {
+    case GZIP_DEFLATE: {
+      size_t n = inflateSome(gz, data, len);
+      data += n;
+      len -= n;
+      break;
+    }
+
+    case GZIP_TRAILER:
+      gz->buf[gz->fill++] = *data++;
+      len--;
+      if (gz->fill == 8) {
+        if (le32(gz->buf) != gz->crc)
+          return fail(gz, "CRC mismatch");
+        if (le32(gz->buf + 4) != (uint32_t)gz->outBytes)
+          return fail(gz, "length mismatch");
+        gz->state = GZIP_DONE;
+      }
+      break;
+
+    case GZIP_DONE:
+      return true;
+
+    case GZIP_ERROR:
+      return false;
+
+    default:
+      if (!headerByte(gz, *data++))
+        return false;
+      len--;
+      break;
+    }
+  }
+  return gz->state != GZIP_ERROR;
+}
+
+bool gzipDone(const GzipStream* gz)
+{
+  return gz->state == GZIP_DONE;
+}
+
+const char* gzipError(const GzipStream* gz)
+{
+  return gz->error;
+}
+
+void gzipEnd(GzipStream* gz)
+{
+  free(gz->inflate);
+  gz->inflate = nullptr;
+}
+
+bool gzipSniff(const uint8_t* data, size_t len)
+{
+  return len >= 2 && data[0] == 0x1F && data[1] == 0x8B;
+}
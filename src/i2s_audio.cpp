@@ -6,13 +6,51 @@
 
 #include <driver/i2s.h>
 
+// Installed driver state, so a new track only touches what changed.
+static bool     g_i2sInstalled = false;
+static uint32_t g_i2sRate      = 0;
+static int      g_i2sDmaCount  = 0;
+static int      g_i2sDmaLen    = 0;
+
 void i2sDeinit()
 {
+  if (!g_i2sInstalled)
+    return;
+
   i2s_driver_uninstall(I2S_NUM_0);
+  g_i2sInstalled = false;
+}
+
+bool i2sSetSampleRate(uint32_t sampleRate)
+{
+  if (!g_i2sInstalled)
+    return false;
+  if (sampleRate == g_i2sRate)
+    return true;
+
+  esp_err_t err = i2s_set_sample_rates(I2S_NUM_0, sampleRate);
+  if (err != ESP_OK) {
+    WebLog.print("[I2S] ❌ Failed to set sample rate: ");
+    WebLog.println(esp_err_to_name(err));
+    return false;
+  }
+
+  g_i2sRate = sampleRate;
+  return true;
 }
 
 void i2sInitFromSettings()
 {
+  // DMA layout is fixed at install time; a rate change alone is applied live.
+  if (g_i2sInstalled && g_i2sDmaCount == g_settings.dmaBufCount &&
+      g_i2sDmaLen == g_settings.dmaBufLen) {
+    i2sSetSampleRate((uint32_t)g_settings.sampleRate);
+    i2s_zero_dma_buffer(I2S_NUM_0);
+    return;
+  }
+
+  i2sDeinit();
+
   i2s_config_t cfg = {
       .mode                 = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX),
       .sample_rate          = (uint32_t)g_settings.sampleRate,
@@ -36,6 +74,11 @@ void i2sInitFromSettings()
   i2s_set_pin(I2S_NUM_0, &pins);
   i2s_zero_dma_buffer(I2S_NUM_0);
 
+  g_i2sInstalled = true;
+  g_i2sRate      = (uint32_t)g_settings.sampleRate;
+  g_i2sDmaCount  = g_settings.dmaBufCount;
+  g_i2sDmaLen    = g_settings.dmaBufLen;
+
   WebLog.println("[I2S] ✅ Initialized from settings.json");
   WebLog.print("[I2S] sample_rate=");
   WebLog.println(g_settings.sampleRate);
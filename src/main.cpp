@@ -1,10 +1,18 @@
 #include "app_config.h"
+#include "audio_analyzer.h"
+#include "audio_decoder.h"
 #include "audio_player.h"
 #include "audio_progress.h"
 #include "auto_tuner.h"
+#include "dsp_worker.h"
 #include "equalizer.h"
+#include "media_library.h"
+#include "media_search.h"
 #include "net_utils.h"
 #include "ntp_time.h"
+#include "quality_governor.h"
+#include "render_cache.h"
+#include "sd_bus.h"
 #include "settings.h"
 #include "web_log.h"
 #include "web_panel.h"
@@ -70,6 +78,8 @@ void setup()
   progressInit();
   eqInit();
   tunerInit();
+  qualityInit();
+  dspWorkerBegin();
 
   // 1) Wi-Fi.
   wifiConnectAndLog();
@@ -87,6 +97,9 @@ void setup()
     return;
   }
 
+  // Every task shares the card through the bus arbiter.
+  sdBusBegin();
+
   // 3) settings.json.
   settingsLoadFromSD();
 
@@ -105,29 +118,48 @@ void setup()
 
   // Sync auto-tuner.
   tunerSetEnabled(g_settings.autoTuneEnabled);
+  qualitySetEnabled(g_settings.adaptiveQuality);
+
+  // Spectrum analyzer runs on core 0, sized from settings.
+  analyzerBegin(g_settings.spectrumFftSize);
+
+  // Idle-time pre-render cache on SD.
+  renderCacheBegin();
+
+  // Media library index (loaded now, maintained on core 0).
+  libraryBegin();
+
+  // Name and tag search over the library (rebuilt on core 0).
+  searchBegin();
 
   // 4) Check if current file exists.
   if (!SD.exists(g_settings.currentFile)) {
     WebLog.print("[SD] ⚠️ Current file not found: ");
     WebLog.println(g_settings.currentFile);
 
-    // Try to find any audio file (.wav or .mp3).
-    File root = SD.open("/");
-    if (root) {
-      File entry = root.openNextFile();
-      while (entry) {
-        String name  = entry.name();
-        String lower = name;
-        lower.toLowerCase();
-        if (lower.endsWith(".wav") || lower.endsWith(".mp3")) {
-          g_settings.currentFile = "/" + name;
-          WebLog.print("[SD] ✅ Found audio file: ");
-          WebLog.println(g_settings.currentFile);
-          break;
+    // Try to find any audio file with a registered extension, from the
+    // library index when it is loaded.
+    String found;
+    if (libraryFirstAudio(found)) {
+      g_settings.currentFile = found;
+      WebLog.print("[SD] ✅ Found audio file: ");
+      WebLog.println(g_settings.currentFile);
+    } else {
+      File root = SD.open("/");
+      if (root) {
+        File entry = root.openNextFile();
+        while (entry) {
+          String name = entry.name();
+          if (decoderKnowsExtension(name)) {
+            g_settings.currentFile = "/" + name;
+            WebLog.print("[SD] ✅ Found audio file: ");
+            WebLog.println(g_settings.currentFile);
+            break;
+          }
+          entry = root.openNextFile();
         }
-        entry = root.openNextFile();
+        root.close();
       }
-      root.close();
     }
   } else {
     WebLog.print("[SD] ✅ Current file: ");
@@ -0,0 +1,1405 @@
+#include "media_library.h"
+
+#include "audio_decoder.h"
+#include "audio_player.h"
+#include "media_tags.h"
+#include "sd_bus.h"
+#include "sd_upload.h"
+#include "web_log.h"
+
+#include <SD.h>
+#include <atomic>
+
+static const char* LIBRARY_DIR          = "/.library";
+static const char* LIBRARY_RECORDS_PATH = "/.library/records.bin";
+static const char* LIBRARY_STRINGS_PATH = "/.library/strings.bin";
+static const char* LIBRARY_RECORDS_TMP  = "/.library/records.tmp";
+static const char* LIBRARY_STRINGS_TMP  = "/.library/strings.tmp";
+
+static const uint32_t LIBRARY_MAGIC      = 0x31494C4D; // "MLI1"
+static const uint32_t LIBRARY_POOL_MAGIC = 0x31534C4D; // "MLS1"
+static const uint32_t LIBRARY_VERSION    = 1;
+
+static const int      LIBRARY_MAX_DIRS       = 256;
+static const int      LIBRARY_MAX_CHANGES    = 32;
+static const size_t   LIBRARY_PATH_MAX       = 255;
+static const uint32_t LIBRARY_BATCH          = 32;   // Records per SD read.
+static const uint32_t LIBRARY_PROBE_SCAN     = 256;  // Records checked per probe step.
+static const uint32_t LIBRARY_MERGE_DELAY_MS = 2000; // Quiet time before merging changes.
+static const int      LIBRARY_GEN_BUCKETS    = 64;   // Listing generations, by directory hash.
+
+enum : uint8_t {
+  LIBRARY_FLAG_DIR    = 0x01,
+  LIBRARY_FLAG_AUDIO  = 0x02, // Registered audio extension.
+  LIBRARY_FLAG_PROBED = 0x04, // Codec fields and tags are filled in.
+};
+
+// records.bin: header, records grouped by directory, directory table.
+struct LibraryHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t buildId; // Must match the string pool.
+  uint32_t recordCount;
+  uint32_t dirCount;
+  uint32_t dirty;          // Changes exist that are only held in RAM.
+  uint32_t contentVersion; // Bumped on every table change (search index key).
+  uint32_t reserved;
+};
+
+struct LibraryRecord {
+  uint32_t pathOff; // String pool offsets (0 = none).
+  uint32_t titleOff;
+  uint32_t artistOff;
+  uint32_t size;
+  uint32_t mtime;
+  uint32_t durationMs;
+  uint32_t sampleRate;
+  char     codec[4]; // NUL padded.
+  uint8_t  channels;
+  uint8_t  bitsPerSample;
+  uint8_t  pathLen;
+  uint8_t  nameOff; // File name start within the path.
+  uint8_t  titleLen;
+  uint8_t  artistLen;
+  uint8_t  flags;
+  uint8_t  reserved;
+};
+
+static_assert(sizeof(LibraryRecord) == 40, "LibraryRecord is an on-card format");
+
+struct LibraryDir {
+  uint32_t hash;  // FNV-1a of the directory path.
+  uint32_t sig;   // Sum of entry signatures, independent of listing order.
+  uint32_t first; // First record.
+  uint32_t count;
+};
+
+// strings.bin starts with this; offset 0 is never a valid string.
+struct PoolHeader {
+  uint32_t magic;
+  uint32_t buildId;
+};
+
+struct PoolWriter {
+  File     file;
+  uint32_t length;
+};
+
+// Edit made through the web panel and not merged into the table yet.
+struct LibraryChange {
+  String        path;
+  uint32_t      seq;
+  bool          removed;
+  bool          tree = false; // Everything below path is rescanned from the card too.
+  LibraryRecord rec;          // String offsets unused.
+  String        title;
+  String        artist;
+};
+
+typedef bool (*RecordFn)(const LibraryRecord& rec, const String& path, const String& title,
+                         const String& artist, void* ctx);
+
+static LibraryHeader     g_header;
+static LibraryDir        g_dirs[LIBRARY_MAX_DIRS];
+static LibraryChange     g_changes[LIBRARY_MAX_CHANGES];
+static int               g_changeCount  = 0;
+static uint32_t          g_changeSeq    = 0;
+static uint32_t          g_lastChangeMs = 0;
+static bool              g_ready        = false; // Index files are valid and served.
+static uint32_t          g_probeCursor  = 0;     // Next record to check for probing.
+static uint16_t          g_genEpoch     = 0;     // Bumped when every listing may change.
+static uint16_t          g_dirGen[LIBRARY_GEN_BUCKETS];
+static SemaphoreHandle_t g_lock         = nullptr;
+static TaskHandle_t      g_task         = nullptr;
+
+static std::atomic<bool> g_rebuildPending(false);
+static std::atomic<bool> g_verifyPending(false);
+static std::atomic<bool> g_building(false);
+
+// Stats.
+static uint32_t g_rebuilds    = 0;
+static uint32_t g_merges      = 0;
+static uint32_t g_probed      = 0;
+static uint32_t g_fallbacks   = 0;
+static uint32_t g_lastBuildMs = 0;
+static uint32_t g_lastListUs  = 0;
+
+static uint32_t fnv1a(uint32_t h, const void* data, size_t len)
+{
+  const uint8_t* p = (const uint8_t*)data;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+static uint32_t hashString(const String& s)
+{
+  return fnv1a(2166136261u, s.c_str(), s.length());
+}
+
+static String parentDir(const String& path)
+{
+  int slash = path.lastIndexOf('/');
+  return slash <= 0 ? String("/") : path.substring(0, slash);
+}
+
+static uint32_t dirBucket(String dir)
+{
+  if (dir.length() > 1 && dir.endsWith("/"))
+    dir.remove(dir.length() - 1);
+  return hashString(dir) % LIBRARY_GEN_BUCKETS;
+}
+
+// An entry of this path changed: its directory listing did too.
+static void bumpGeneration(const String& path)
+{
+  g_dirGen[dirBucket(parentDir(path))]++;
+}
+
+static String childPath(const String& dir, const String& name)
+{
+  return dir == "/" ? "/" + name : dir + "/" + name;
+}
+
+// Same filter as the directory listing: hidden and system entries are not
+// indexed (this also keeps /.library, /.cache and MP3 index sidecars out).
+static bool isHiddenName(const String& name)
+{
+  return name.length() == 0 || name.startsWith(".") || name.startsWith("_");
+}
+
+bool libraryIsHiddenPath(const String& path)
+{
+  int start = path.startsWith("/") ? 1 : 0;
+  while (start < (int)path.length()) {
+    int    slash = path.indexOf('/', start);
+    String part  = path.substring(start, slash < 0 ? path.length() : slash);
+    if (isHiddenName(part))
+      return true;
+    if (slash < 0)
+      break;
+    start = slash + 1;
+  }
+  return false;
+}
+
+static bool isIndexedPath(const String& path)
+{
+  return path.startsWith("/") && path.length() > 1 && path.length() <= LIBRARY_PATH_MAX &&
+         !libraryIsHiddenPath(path);
+}
+
+// Directory sizes and times are left out: FAT does not keep them meaningful.
+static uint32_t entrySig(const String& name, const LibraryRecord& rec)
+{
+  uint32_t h = hashString(name);
+  if (!(rec.flags & LIBRARY_FLAG_DIR)) {
+    h = fnv1a(h, &rec.size, sizeof(rec.size));
+    h = fnv1a(h, &rec.mtime, sizeof(rec.mtime));
+  }
+  return h;
+}
+
+static int findDir(uint32_t hash)
+{
+  for (uint32_t i = 0; i < g_header.dirCount; i++) {
+    if (g_dirs[i].hash == hash)
+      return (int)i;
+  }
+  return -1;
+}
+
+static int findChange(const LibraryChange* changes, int count, const String& path)
+{
+  for (int i = 0; i < count; i++) {
+    if (changes[i].path == path)
+      return i;
+  }
+  return -1;
+}
+
+// Inside the tree of a changed directory: the table does not know it.
+static bool inChangedTree(const LibraryChange* changes, int count, const String& path)
+{
+  for (int i = 0; i < count; i++) {
+    if (changes[i].tree && path.startsWith(changes[i].path) &&
+        path.length() > changes[i].path.length() && path[changes[i].path.length()] == '/')
+      return true;
+  }
+  return false;
+}
+
+static void initRecord(LibraryRecord& rec, const String& path)
+{
+  memset(&rec, 0, sizeof(rec));
+  rec.pathLen = (uint8_t)path.length();
+  rec.nameOff = (uint8_t)(path.lastIndexOf('/') + 1);
+}
+
+static bool recordFromFile(File& f, const String& path, LibraryRecord& rec)
+{
+  if (path.length() > LIBRARY_PATH_MAX)
+    return false;
+
+  initRecord(rec, path);
+  rec.mtime = (uint32_t)f.getLastWrite();
+  if (f.isDirectory()) {
+    rec.flags = LIBRARY_FLAG_DIR;
+  } else {
+    rec.size = f.size();
+    if (decoderKnowsExtension(path))
+      rec.flags = LIBRARY_FLAG_AUDIO;
+  }
+  return true;
+}
+
+// Codec parameters and tags. Opens the decoder directly, without the
+// decode-ahead wrapper and the open log line.
+static void probeFile(const String& path, LibraryRecord& rec, String& title, String& artist)
+{
+  const AudioDecoderEntry* entry = decoderProbeFile(path);
+  IAudioDecoder*           dec   = entry ? entry->create() : nullptr;
+  if (dec && dec->open(path)) {
+    const AudioStreamInfo& info = dec->info();
+    memset(rec.codec, 0, sizeof(rec.codec));
+    memcpy(rec.codec, entry->name, strnlen(entry->name, sizeof(rec.codec)));
+    rec.sampleRate    = info.sampleRate;
+    rec.channels      = (uint8_t)info.channels;
+    rec.bitsPerSample = (uint8_t)info.bitsPerSample;
+    rec.durationMs    = info.totalMs;
+  }
+  if (dec) {
+    dec->close();
+    delete dec;
+  }
+
+  tagsRead(path, title, artist);
+  rec.flags |= LIBRARY_FLAG_PROBED;
+  g_probed++;
+}
+
+// ----------------------------------------------------------------------------
+// Index files
+// ----------------------------------------------------------------------------
+
+static uint32_t poolAppend(PoolWriter& pool, const String& s)
+{
+  if (s.length() == 0)
+    return 0;
+
+  uint32_t off = pool.length;
+  pool.file.write((const uint8_t*)s.c_str(), s.length());
+  pool.length += s.length();
+  return off;
+}
+
+static String poolRead(File& pool, uint32_t off, uint8_t len)
+{
+  SdBusSlice slice(SD_IO_BROWSE);
+  char       buf[LIBRARY_PATH_MAX + 1];
+  if (off == 0 || len == 0 || !pool.seek(off) || pool.read((uint8_t*)buf, len) != len)
+    return String();
+  buf[len] = '\0';
+  return String(buf);
+}
+
+static bool writeRecord(File& rf, PoolWriter& pool, LibraryRecord rec, const String& path,
+                        const String& title, const String& artist)
+{
+  SdBusSlice slice(SD_IO_BACKGROUND);
+  rec.pathOff   = poolAppend(pool, path);
+  rec.titleOff  = poolAppend(pool, title);
+  rec.titleLen  = (uint8_t)title.length();
+  rec.artistOff = poolAppend(pool, artist);
+  rec.artistLen = (uint8_t)artist.length();
+  return rf.write((const uint8_t*)&rec, sizeof(rec)) == sizeof(rec);
+}
+
+static bool readRecords(File& rf, uint32_t index, LibraryRecord* out, uint32_t count)
+{
+  SdBusSlice slice(SD_IO_BROWSE);
+  size_t     bytes = count * sizeof(LibraryRecord);
+  return rf.seek(sizeof(LibraryHeader) + index * sizeof(LibraryRecord)) &&
+         rf.read((uint8_t*)out, bytes) == bytes;
+}
+
+// Directory scans take the bus one entry at a time.
+static File nextEntry(File& dir)
+{
+  SdBusSlice slice(SD_IO_BACKGROUND);
+  return dir.openNextFile();
+}
+
+static void writeHeader()
+{
+  File rf = SD.open(LIBRARY_RECORDS_PATH, "r+");
+  if (!rf)
+    return;
+  rf.write((const uint8_t*)&g_header, sizeof(g_header));
+  rf.close();
+}
+
+// Load the header and directory table (caller holds g_lock).
+static bool loadIndex()
+{
+  g_ready = false;
+
+  File rf   = SD.open(LIBRARY_RECORDS_PATH);
+  File pool = SD.open(LIBRARY_STRINGS_PATH);
+
+  LibraryHeader hdr;
+  PoolHeader    ph;
+  bool          ok = rf && pool;
+
+  ok = ok && rf.read((uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) && hdr.magic == LIBRARY_MAGIC &&
+       hdr.version == LIBRARY_VERSION && hdr.dirCount <= (uint32_t)LIBRARY_MAX_DIRS;
+  ok = ok && pool.read((uint8_t*)&ph, sizeof(ph)) == sizeof(ph) &&
+       ph.magic == LIBRARY_POOL_MAGIC && ph.buildId == hdr.buildId;
+  if (ok) {
+    size_t bytes = hdr.dirCount * sizeof(LibraryDir);
+    ok = rf.seek(sizeof(hdr) + hdr.recordCount * sizeof(LibraryRecord)) &&
+         rf.read((uint8_t*)g_dirs, bytes) == bytes;
+  }
+
+  if (rf)
+    rf.close();
+  if (pool)
+    pool.close();
+
+  if (!ok) {
+    memset(&g_header, 0, sizeof(g_header));
+    return false;
+  }
+
+  g_header = hdr;
+  g_ready  = !hdr.dirty;
+  return g_ready;
+}
+
+static bool createIndex(File& rf, PoolWriter& pool, uint32_t buildId)
+{
+  SD.remove(LIBRARY_RECORDS_TMP);
+  SD.remove(LIBRARY_STRINGS_TMP);
+
+  rf          = SD.open(LIBRARY_RECORDS_TMP, FILE_WRITE);
+  pool.file   = SD.open(LIBRARY_STRINGS_TMP, FILE_WRITE);
+  pool.length = sizeof(PoolHeader);
+  if (!rf || !pool.file)
+    return false;
+
+  LibraryHeader hdr = {};
+  PoolHeader    ph  = {LIBRARY_POOL_MAGIC, buildId};
+  return rf.write((const uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+         pool.file.write((const uint8_t*)&ph, sizeof(ph)) == sizeof(ph);
+}
+
+// Write the directory table and header, then swap the new files in.
+static bool finishIndex(File& rf, PoolWriter& pool, bool ok, const LibraryDir* dirs,
+                        uint32_t dirCount, uint32_t recordCount, uint32_t buildId)
+{
+  if (ok) {
+    LibraryHeader hdr  = {};
+    hdr.magic          = LIBRARY_MAGIC;
+    hdr.version        = LIBRARY_VERSION;
+    hdr.buildId        = buildId;
+    hdr.recordCount    = recordCount;
+    hdr.dirCount       = dirCount;
+    hdr.contentVersion = g_header.contentVersion + 1;
+
+    size_t bytes = dirCount * sizeof(LibraryDir);
+    ok = rf.write((const uint8_t*)dirs, bytes) == bytes && rf.seek(0) &&
+         rf.write((const uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr);
+  }
+  if (rf)
+    rf.close();
+  if (pool.file)
+    pool.file.close();
+
+  if (!ok) {
+    SD.remove(LIBRARY_RECORDS_TMP);
+    SD.remove(LIBRARY_STRINGS_TMP);
+    return false;
+  }
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  SD.remove(LIBRARY_RECORDS_PATH);
+  SD.remove(LIBRARY_STRINGS_PATH);
+  ok = SD.rename(LIBRARY_STRINGS_TMP, LIBRARY_STRINGS_PATH) &&
+       SD.rename(LIBRARY_RECORDS_TMP, LIBRARY_RECORDS_PATH) && loadIndex();
+  g_probeCursor = 0;
+  xSemaphoreGive(g_lock);
+  return ok;
+}
+
+static uint32_t nextBuildId()
+{
+  return (g_header.buildId + 1) ^ (millis() << 8);
+}
+
+// ----------------------------------------------------------------------------
+// Lookup (caller holds g_lock)
+// ----------------------------------------------------------------------------
+
+// Visit the indexed records of a directory with pending changes applied.
+// Returns false when neither the table nor the change list knows the
+// directory.
+static bool visitRecords(const String& dir, RecordFn fn, void* ctx)
+{
+  if (!g_ready)
+    return false;
+
+  if (inChangedTree(g_changes, g_changeCount, dir + "/"))
+    return false;
+
+  int  d          = findDir(hashString(dir));
+  bool hasChanges = false;
+  for (int i = 0; i < g_changeCount && !hasChanges; i++) {
+    hasChanges = !g_changes[i].removed && parentDir(g_changes[i].path) == dir;
+  }
+  if (d < 0 && !hasChanges)
+    return false;
+
+  bool go = true;
+  if (d >= 0) {
+    File rf   = SD.open(LIBRARY_RECORDS_PATH);
+    File pool = SD.open(LIBRARY_STRINGS_PATH);
+    if (!rf || !pool)
+      return false;
+
+    const LibraryDir& ld = g_dirs[d];
+    LibraryRecord     batch[LIBRARY_BATCH];
+    for (uint32_t i = 0; i < ld.count && go; i += LIBRARY_BATCH) {
+      uint32_t n = ld.count - i < LIBRARY_BATCH ? ld.count - i : LIBRARY_BATCH;
+      if (!readRecords(rf, ld.first + i, batch, n))
+        break;
+
+      for (uint32_t k = 0; k < n && go; k++) {
+        const LibraryRecord& rec  = batch[k];
+        String               path = poolRead(pool, rec.pathOff, rec.pathLen);
+        if (i == 0 && k == 0 && parentDir(path) != dir)
+          return false; // Hash collision with another directory.
+        if (findChange(g_changes, g_changeCount, path) >= 0)
+          continue;
+
+        String title  = poolRead(pool, rec.titleOff, rec.titleLen);
+        String artist = poolRead(pool, rec.artistOff, rec.artistLen);
+        go            = fn(rec, path, title, artist, ctx);
+      }
+    }
+    rf.close();
+    pool.close();
+  }
+
+  for (int i = 0; i < g_changeCount && go; i++) {
+    const LibraryChange& c = g_changes[i];
+    if (!c.removed && parentDir(c.path) == dir)
+      go = fn(c.rec, c.path, c.title, c.artist, ctx);
+  }
+  return true;
+}
+
+struct RecordMatch {
+  const String* path;
+  LibraryRecord rec;
+  String        title;
+  String        artist;
+  bool          found;
+};
+
+static bool matchRecord(const LibraryRecord& rec, const String& path, const String& title,
+                        const String& artist, void* ctx)
+{
+  RecordMatch* m = (RecordMatch*)ctx;
+  if (path != *m->path)
+    return true;
+
+  m->rec    = rec;
+  m->title  = title;
+  m->artist = artist;
+  m->found  = true;
+  return false;
+}
+
+static bool lookupRecord(const String& path, RecordMatch& m)
+{
+  m.path  = &path;
+  m.found = false;
+  visitRecords(parentDir(path), matchRecord, &m);
+  return m.found;
+}
+
+static void fillEntry(const LibraryRecord& rec, const String& path, const String& title,
+                      const String& artist, LibraryEntry& e)
+{
+  e.path   = path;
+  e.name   = path.substring(rec.nameOff);
+  e.size   = rec.size;
+  e.mtime  = rec.mtime;
+  e.isDir  = (rec.flags & LIBRARY_FLAG_DIR) != 0;
+  e.probed = (rec.flags & LIBRARY_FLAG_PROBED) != 0;
+  memcpy(e.codec, rec.codec, sizeof(rec.codec));
+  e.codec[sizeof(rec.codec)] = '\0';
+  e.sampleRate               = rec.sampleRate;
+  e.channels                 = rec.channels;
+  e.bitsPerSample            = rec.bitsPerSample;
+  e.durationMs               = rec.durationMs;
+  e.title                    = title;
+  e.artist                   = artist;
+}
+
+// Visit table records by range (indices == nullptr) or by index list.
+// Caller holds g_lock.
+static bool visitTable(uint32_t tableId, uint32_t first, uint32_t count, const uint32_t* indices,
+                       LibraryIndexVisitFn fn, void* ctx)
+{
+  if (!g_ready || g_header.buildId != tableId)
+    return false;
+
+  uint32_t total = g_header.recordCount;
+  if (!indices)
+    count = first < total ? (count < total - first ? count : total - first) : 0;
+
+  File rf   = SD.open(LIBRARY_RECORDS_PATH);
+  File pool = SD.open(LIBRARY_STRINGS_PATH);
+  if (!rf || !pool)
+    return false;
+
+  LibraryRecord batch[LIBRARY_BATCH];
+  bool          go = true;
+  for (uint32_t i = 0; i < count && go;) {
+    uint32_t index = indices ? indices[i] : first + i;
+    uint32_t n     = indices ? 1 : (count - i < LIBRARY_BATCH ? count - i : LIBRARY_BATCH);
+    i += n;
+    if (index >= total || !readRecords(rf, index, batch, n))
+      continue;
+
+    for (uint32_t k = 0; k < n && go; k++) {
+      const LibraryRecord& rec  = batch[k];
+      String               path = poolRead(pool, rec.pathOff, rec.pathLen);
+      if (findChange(g_changes, g_changeCount, path) >= 0 ||
+          inChangedTree(g_changes, g_changeCount, path))
+        continue;
+
+      LibraryEntry e;
+      fillEntry(rec, path, poolRead(pool, rec.titleOff, rec.titleLen),
+                poolRead(pool, rec.artistOff, rec.artistLen), e);
+      go = fn(e, index + k, ctx);
+    }
+  }
+
+  rf.close();
+  pool.close();
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Change list
+// ----------------------------------------------------------------------------
+
+// Stop serving and rebuild from the card (caller holds g_lock).
+static void invalidate()
+{
+  g_genEpoch++;
+  g_ready          = false;
+  g_changeCount    = 0;
+  g_rebuildPending = true;
+}
+
+// Caller holds g_lock.
+static void addChange(LibraryChange& c)
+{
+  int i = findChange(g_changes, g_changeCount, c.path);
+  if (i < 0) {
+    if (g_changeCount >= LIBRARY_MAX_CHANGES) {
+      WebLog.println("[LIBRARY] ⚠️ Too many unmerged changes, rebuilding");
+      invalidate();
+      return;
+    }
+    i = g_changeCount++;
+  } else if (g_changes[i].tree) {
+    c.tree = true;
+  }
+
+  c.seq          = ++g_changeSeq;
+  g_changes[i]   = c;
+  g_lastChangeMs = millis();
+  bumpGeneration(c.path);
+  if (c.tree)
+    g_genEpoch++;
+
+  // A reboot before the merge must not trust the table.
+  if (g_ready && !g_header.dirty) {
+    g_header.dirty = 1;
+    writeHeader();
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Maintenance
+// ----------------------------------------------------------------------------
+
+// Scan top and everything below it from the card, breadth first so each
+// directory's records are contiguous, appending to the new table.
+static bool scanTree(const String& top, File& rf, PoolWriter& pool, LibraryDir* dirs,
+                     uint32_t& dirCount, uint32_t& recordCount)
+{
+  String* queue = new String[LIBRARY_MAX_DIRS];
+  bool    ok    = true;
+  int     head  = 0;
+  int     tail  = 0;
+
+  queue[tail++] = top;
+  while (ok && head < tail) {
+    String dir  = queue[head++];
+    File   root = SD.open(dir);
+    if (!root || !root.isDirectory())
+      continue;
+
+    LibraryDir ld = {hashString(dir), 0, recordCount, 0};
+    File       f  = nextEntry(root);
+    while (f && ok) {
+      String name  = f.name();
+      int    slash = name.lastIndexOf('/');
+      if (slash >= 0)
+        name = name.substring(slash + 1);
+
+      LibraryRecord rec;
+      String        path = childPath(dir, name);
+      if (!isHiddenName(name) && recordFromFile(f, path, rec)) {
+        if ((rec.flags & LIBRARY_FLAG_DIR) && tail < LIBRARY_MAX_DIRS)
+          queue[tail++] = path;
+        ok = writeRecord(rf, pool, rec, path, String(), String());
+        ld.sig += entrySig(name, rec);
+        ld.count++;
+        recordCount++;
+        if ((recordCount & 15) == 0)
+          vTaskDelay(1);
+      }
+      f = nextEntry(root);
+    }
+    root.close();
+
+    if (ld.count > 0 && dirCount < (uint32_t)LIBRARY_MAX_DIRS)
+      dirs[dirCount++] = ld;
+  }
+
+  delete[] queue;
+  return ok;
+}
+
+// Full scan of the card. Codec fields are filled in later by probeStep().
+static void rebuildIndex()
+{
+  uint32_t    startMs = millis();
+  uint32_t    buildId = nextBuildId();
+  LibraryDir* dirs    = (LibraryDir*)malloc(LIBRARY_MAX_DIRS * sizeof(LibraryDir));
+
+  File       rf;
+  PoolWriter pool;
+  bool       ok          = dirs && createIndex(rf, pool, buildId);
+  uint32_t   dirCount    = 0;
+  uint32_t   recordCount = 0;
+
+  g_building = true;
+  WebLog.println("[LIBRARY] 🔄 Scanning card...");
+
+  ok = ok && scanTree("/", rf, pool, dirs, dirCount, recordCount);
+  ok = finishIndex(rf, pool, ok, dirs, dirCount, recordCount, buildId);
+  free(dirs);
+  g_building = false;
+
+  if (!ok) {
+    WebLog.println("[LIBRARY] ❌ Index build failed");
+    return;
+  }
+
+  // Edits made during the scan stay in the change list; it is idempotent.
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  g_genEpoch++;
+  if (g_changeCount > 0) {
+    g_header.dirty = 1;
+    writeHeader();
+  }
+  xSemaphoreGive(g_lock);
+
+  g_rebuilds++;
+  g_lastBuildMs = millis() - startMs;
+  WebLog.print("[LIBRARY] ✅ Indexed ");
+  WebLog.print(recordCount);
+  WebLog.print(" entries in ");
+  WebLog.print(dirCount);
+  WebLog.print(" dirs (");
+  WebLog.print(g_lastBuildMs);
+  WebLog.println(" ms)");
+}
+
+// Copy one directory's surviving records plus the changes that land in it.
+static bool mergeDir(File& rf, File& oldRf, File& oldPool, PoolWriter& pool, const LibraryDir& od,
+                     const LibraryChange* snap, int snapCount, bool* applied, LibraryDir& nd,
+                     uint32_t& recordCount)
+{
+  nd = {od.hash, 0, recordCount, 0};
+
+  LibraryRecord batch[LIBRARY_BATCH];
+  for (uint32_t i = 0; i < od.count; i += LIBRARY_BATCH) {
+    uint32_t n = od.count - i < LIBRARY_BATCH ? od.count - i : LIBRARY_BATCH;
+    if (!readRecords(oldRf, od.first + i, batch, n))
+      return false;
+
+    for (uint32_t k = 0; k < n; k++) {
+      const LibraryRecord& rec  = batch[k];
+      String               path = poolRead(oldPool, rec.pathOff, rec.pathLen);
+      if (findChange(snap, snapCount, path) >= 0 || inChangedTree(snap, snapCount, path))
+        continue;
+
+      String title  = poolRead(oldPool, rec.titleOff, rec.titleLen);
+      String artist = poolRead(oldPool, rec.artistOff, rec.artistLen);
+      if (!writeRecord(rf, pool, rec, path, title, artist))
+        return false;
+      nd.sig += entrySig(path.substring(rec.nameOff), rec);
+      nd.count++;
+      recordCount++;
+    }
+  }
+
+  for (int i = 0; i < snapCount; i++) {
+    const LibraryChange& c = snap[i];
+    if (c.removed || applied[i] || hashString(parentDir(c.path)) != od.hash)
+      continue;
+    if (!writeRecord(rf, pool, c.rec, c.path, c.title, c.artist))
+      return false;
+    nd.sig += entrySig(c.path.substring(c.rec.nameOff), c.rec);
+    nd.count++;
+    recordCount++;
+    applied[i] = true;
+  }
+  return true;
+}
+
+// Stream the table through once, dropping changed paths and appending the
+// pending changes to their directories. Changed trees are rescanned from
+// the card, which also covers any change inside them.
+static void mergeChanges()
+{
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  if (!g_ready || g_changeCount == 0) {
+    xSemaphoreGive(g_lock);
+    return;
+  }
+
+  int            snapCount = g_changeCount;
+  uint32_t       snapSeq   = g_changeSeq;
+  uint32_t       oldDirs   = g_header.dirCount;
+  LibraryChange* snap      = new LibraryChange[snapCount];
+  LibraryDir*    od        = (LibraryDir*)malloc(LIBRARY_MAX_DIRS * sizeof(LibraryDir));
+  LibraryDir*    nd        = (LibraryDir*)malloc(LIBRARY_MAX_DIRS * sizeof(LibraryDir));
+  bool*          applied   = new bool[snapCount]();
+  for (int i = 0; i < snapCount; i++) {
+    snap[i] = g_changes[i];
+  }
+  if (od)
+    memcpy(od, g_dirs, oldDirs * sizeof(LibraryDir));
+  xSemaphoreGive(g_lock);
+
+  // New files get their codec details now if the player leaves time for it.
+  for (int i = 0; i < snapCount && !audioIsRunning(); i++) {
+    LibraryChange& c = snap[i];
+    if (!c.removed && (c.rec.flags & LIBRARY_FLAG_AUDIO) && !(c.rec.flags & LIBRARY_FLAG_PROBED))
+      probeFile(c.path, c.rec, c.title, c.artist);
+  }
+
+  uint32_t   buildId     = nextBuildId();
+  uint32_t   dirCount    = 0;
+  uint32_t   recordCount = 0;
+  File       rf;
+  PoolWriter pool;
+  File       oldRf   = SD.open(LIBRARY_RECORDS_PATH);
+  File       oldPool = SD.open(LIBRARY_STRINGS_PATH);
+  bool       ok      = od && nd && oldRf && oldPool && createIndex(rf, pool, buildId);
+
+  for (int i = 0; i < snapCount; i++) {
+    if (inChangedTree(snap, snapCount, snap[i].path))
+      applied[i] = true;
+  }
+
+  for (uint32_t d = 0; ok && d < oldDirs; d++) {
+    LibraryDir ld;
+    ok = mergeDir(rf, oldRf, oldPool, pool, od[d], snap, snapCount, applied, ld, recordCount);
+    if (ok && ld.count > 0 && dirCount < (uint32_t)LIBRARY_MAX_DIRS)
+      nd[dirCount++] = ld;
+    vTaskDelay(1);
+  }
+
+  // Changes in directories the table does not have yet.
+  for (int i = 0; ok && i < snapCount; i++) {
+    if (snap[i].removed || applied[i] || dirCount >= (uint32_t)LIBRARY_MAX_DIRS)
+      continue;
+
+    LibraryDir empty = {hashString(parentDir(snap[i].path)), 0, 0, 0};
+    LibraryDir ld;
+    ok = mergeDir(rf, oldRf, oldPool, pool, empty, snap, snapCount, applied, ld, recordCount);
+    if (ok && ld.count > 0)
+      nd[dirCount++] = ld;
+  }
+
+  for (int i = 0; ok && i < snapCount; i++) {
+    const LibraryChange& c = snap[i];
+    if (c.tree && !c.removed && !inChangedTree(snap, snapCount, c.path))
+      ok = scanTree(c.path, rf, pool, nd, dirCount, recordCount);
+  }
+
+  if (oldRf)
+    oldRf.close();
+  if (oldPool)
+    oldPool.close();
+  ok = finishIndex(rf, pool, ok, nd, dirCount, recordCount, buildId);
+
+  free(od);
+  free(nd);
+  delete[] snap;
+  delete[] applied;
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  if (ok) {
+    // Drop what was merged; edits made meanwhile stay queued.
+    int kept = 0;
+    for (int i = 0; i < g_changeCount; i++) {
+      if (g_changes[i].seq > snapSeq)
+        g_changes[kept++] = g_changes[i];
+    }
+    g_changeCount = kept;
+    if (g_changeCount > 0) {
+      g_header.dirty = 1;
+      writeHeader();
+    }
+    g_merges++;
+  } else {
+    WebLog.println("[LIBRARY] ❌ Merge failed, rebuilding");
+    invalidate();
+  }
+  xSemaphoreGive(g_lock);
+}
+
+// Walk the card and compare each directory's signature with the table.
+static bool verifyIndex()
+{
+  String*  queue   = new String[LIBRARY_MAX_DIRS];
+  int      head    = 0;
+  int      tail    = 0;
+  uint32_t matched = 0;
+  bool     ok      = true;
+
+  queue[tail++] = "/";
+  while (ok && head < tail) {
+    String dir  = queue[head++];
+    File   root = SD.open(dir);
+    if (!root || !root.isDirectory())
+      continue;
+
+    uint32_t sig   = 0;
+    uint32_t count = 0;
+    File     f     = nextEntry(root);
+    while (f) {
+      String name  = f.name();
+      int    slash = name.lastIndexOf('/');
+      if (slash >= 0)
+        name = name.substring(slash + 1);
+
+      LibraryRecord rec;
+      String        path = childPath(dir, name);
+      if (!isHiddenName(name) && recordFromFile(f, path, rec)) {
+        if ((rec.flags & LIBRARY_FLAG_DIR) && tail < LIBRARY_MAX_DIRS)
+          queue[tail++] = path;
+        sig += entrySig(name, rec);
+        count++;
+        if ((count & 15) == 0)
+          vTaskDelay(1);
+      }
+      f = nextEntry(root);
+    }
+    root.close();
+
+    if (count == 0)
+      continue;
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    int d = findDir(hashString(dir));
+    ok    = d >= 0 && g_dirs[d].sig == sig && g_dirs[d].count == count;
+    xSemaphoreGive(g_lock);
+    matched++;
+  }
+
+  delete[] queue;
+  return ok && matched == g_header.dirCount;
+}
+
+// Probe the next unprobed audio record and patch it in place.
+static void probeStep()
+{
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  uint32_t      buildId = g_header.buildId;
+  uint32_t      total   = g_ready ? g_header.recordCount : 0;
+  uint32_t      found   = total;
+  LibraryRecord rec;
+  String        path;
+
+  File rf = SD.open(LIBRARY_RECORDS_PATH);
+  if (rf) {
+    uint32_t end = g_probeCursor + LIBRARY_PROBE_SCAN < total ? g_probeCursor + LIBRARY_PROBE_SCAN
+                                                               : total;
+    for (uint32_t i = g_probeCursor; i < end && found == total; i++) {
+      if (readRecords(rf, i, &rec, 1) && (rec.flags & LIBRARY_FLAG_AUDIO) &&
+          !(rec.flags & LIBRARY_FLAG_PROBED))
+        found = i;
+      else
+        g_probeCursor = i + 1;
+    }
+    rf.close();
+  }
+  if (found < total) {
+    File pool = SD.open(LIBRARY_STRINGS_PATH);
+    path      = poolRead(pool, rec.pathOff, rec.pathLen);
+    pool.close();
+  }
+  xSemaphoreGive(g_lock);
+
+  if (found >= total || path.length() == 0) {
+    if (found < total)
+      g_probeCursor = found + 1;
+    return;
+  }
+
+  String title, artist;
+  probeFile(path, rec, title, artist);
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  if (g_ready && g_header.buildId == buildId) {
+    File       records = SD.open(LIBRARY_RECORDS_PATH, "r+");
+    PoolWriter pool    = {SD.open(LIBRARY_STRINGS_PATH, "r+"), 0};
+    if (records && pool.file) {
+      pool.length = pool.file.size();
+      pool.file.seek(pool.length);
+      rec.titleOff  = poolAppend(pool, title);
+      rec.titleLen  = (uint8_t)title.length();
+      rec.artistOff = poolAppend(pool, artist);
+      rec.artistLen = (uint8_t)artist.length();
+      records.seek(sizeof(LibraryHeader) + found * sizeof(LibraryRecord));
+      records.write((const uint8_t*)&rec, sizeof(rec));
+
+      g_header.contentVersion++;
+      bumpGeneration(path);
+      records.seek(0);
+      records.write((const uint8_t*)&g_header, sizeof(g_header));
+    }
+    if (records)
+      records.close();
+    if (pool.file)
+      pool.file.close();
+    g_probeCursor = found + 1;
+  }
+  xSemaphoreGive(g_lock);
+}
+
+static void libraryTask(void* param)
+{
+  (void)param;
+
+  for (;;) {
+    // Files are changing under an upload; wait for it to finish.
+    if (sdUploadIsActive()) {
+      vTaskDelay(pdMS_TO_TICKS(500));
+      continue;
+    }
+
+    if (g_rebuildPending) {
+      g_rebuildPending = false;
+      g_verifyPending  = false;
+      rebuildIndex();
+      continue;
+    }
+
+    if (g_changeCount > 0 && millis() - g_lastChangeMs >= LIBRARY_MERGE_DELAY_MS) {
+      mergeChanges();
+      continue;
+    }
+
+    if (g_verifyPending && g_changeCount == 0) {
+      g_verifyPending = false;
+      if (!verifyIndex()) {
+        WebLog.println("[LIBRARY] ⚠️ Card changed since the last index, rebuilding");
+        g_rebuildPending = true;
+      }
+      continue;
+    }
+
+    // Decoder probing reads whole headers (and MP3 seek headers):
+    // only while the player is idle.
+    if (g_ready && g_probeCursor < g_header.recordCount && !audioIsRunning()) {
+      probeStep();
+      vTaskDelay(1);
+      continue;
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(500));
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Public API
+// ----------------------------------------------------------------------------
+
+void libraryBegin()
+{
+  SD.mkdir(LIBRARY_DIR);
+  SD.remove(LIBRARY_RECORDS_TMP);
+  SD.remove(LIBRARY_STRINGS_TMP);
+
+  g_lock = xSemaphoreCreateMutex();
+  if (!g_lock) {
+    WebLog.println("[LIBRARY] ❌ Cannot create lock");
+    return;
+  }
+
+  // Generations from before a reboot must not match.
+  g_genEpoch = (uint16_t)esp_random();
+
+  uint32_t startMs = millis();
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  bool loaded = loadIndex();
+  xSemaphoreGive(g_lock);
+
+  if (loaded) {
+    g_verifyPending = true;
+    WebLog.print("[LIBRARY] ✅ ");
+    WebLog.print(g_header.recordCount);
+    WebLog.print(" entries in ");
+    WebLog.print(g_header.dirCount);
+    WebLog.print(" dirs, loaded in ");
+    WebLog.print(millis() - startMs);
+    WebLog.println(" ms");
+  } else {
+    g_rebuildPending = true;
+    WebLog.println("[LIBRARY] ⚠️ Index missing or stale, rebuilding in background");
+  }
+
+  if (xTaskCreatePinnedToCore(libraryTask, "library", 8192, nullptr, 1, &g_task, 0) != pdPASS) {
+    WebLog.println("[LIBRARY] ❌ Cannot start task");
+    g_task = nullptr;
+  }
+}
+
+struct VisitAdapter {
+  LibraryVisitFn fn;
+  void*          ctx;
+};
+
+static bool visitEntry(const LibraryRecord& rec, const String& path, const String& title,
+                       const String& artist, void* ctx)
+{
+  VisitAdapter* a = (VisitAdapter*)ctx;
+  LibraryEntry  e;
+  fillEntry(rec, path, title, artist, e);
+  return a->fn(e, a->ctx);
+}
+
+bool libraryForEachInDir(const String& dir, LibraryVisitFn fn, void* ctx)
+{
+  if (!g_lock)
+    return false;
+
+  String normalized = dir;
+  if (normalized.length() == 0)
+    normalized = "/";
+  if (normalized.length() > 1 && normalized.endsWith("/"))
+    normalized.remove(normalized.length() - 1);
+
+  uint32_t     startUs = micros();
+  VisitAdapter a       = {fn, ctx};
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  bool ok = visitRecords(normalized, visitEntry, &a);
+  xSemaphoreGive(g_lock);
+
+  if (ok)
+    g_lastListUs = micros() - startUs;
+  else
+    g_fallbacks++;
+  return ok;
+}
+
+bool libraryLookup(const String& path, LibraryEntry& entry)
+{
+  if (!g_lock)
+    return false;
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  RecordMatch m;
+  bool        found = false;
+  int         i     = findChange(g_changes, g_changeCount, path);
+  if (i >= 0) {
+    found = !g_changes[i].removed;
+    if (found)
+      fillEntry(g_changes[i].rec, path, g_changes[i].title, g_changes[i].artist, entry);
+  } else if (lookupRecord(path, m)) {
+    found = true;
+    fillEntry(m.rec, path, m.title, m.artist, entry);
+  }
+  xSemaphoreGive(g_lock);
+  return found;
+}
+
+static bool firstAudio(const LibraryEntry& e, void* ctx)
+{
+  if (e.isDir || !decoderKnowsExtension(e.name))
+    return true;
+
+  *(String*)ctx = e.path;
+  return false;
+}
+
+bool libraryFirstAudio(String& path)
+{
+  String found;
+  if (!libraryForEachInDir("/", firstAudio, &found) || found.length() == 0)
+    return false;
+
+  path = found;
+  return true;
+}
+
+void libraryNoteChanged(const String& path)
+{
+  if (!g_lock || !isIndexedPath(path))
+    return;
+
+  File f = SD.open(path);
+  if (!f)
+    return;
+
+  LibraryChange c;
+  c.path    = path;
+  c.removed = false;
+  bool ok   = recordFromFile(f, path, c.rec);
+  f.close();
+  if (!ok)
+    return;
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  addChange(c);
+  xSemaphoreGive(g_lock);
+}
+
+void libraryNoteTreeChanged(const String& path)
+{
+  if (!g_lock)
+    return;
+  if (path.length() == 0 || path == "/") {
+    libraryRebuild();
+    return;
+  }
+  if (!isIndexedPath(path))
+    return;
+
+  LibraryChange c;
+  c.path = path;
+  c.tree = true;
+
+  File f    = SD.open(path);
+  c.removed = !f || !recordFromFile(f, path, c.rec);
+  if (f)
+    f.close();
+  if (c.removed)
+    initRecord(c.rec, path);
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  addChange(c);
+  xSemaphoreGive(g_lock);
+}
+
+void libraryNoteRemoved(const String& path)
+{
+  if (!g_lock || !isIndexedPath(path))
+    return;
+
+  LibraryChange c;
+  c.path    = path;
+  c.removed = true;
+  initRecord(c.rec, path);
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  addChange(c);
+  xSemaphoreGive(g_lock);
+}
+
+void libraryNoteRenamed(const String& oldPath, const String& newPath)
+{
+  if (!g_lock)
+    return;
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  RecordMatch m;
+  bool        found = false;
+  int         i     = findChange(g_changes, g_changeCount, oldPath);
+  if (i >= 0 && !g_changes[i].removed) {
+    m.rec    = g_changes[i].rec;
+    m.title  = g_changes[i].title;
+    m.artist = g_changes[i].artist;
+    found    = true;
+  } else if (i < 0) {
+    found = lookupRecord(oldPath, m);
+  }
+
+  // Every path below a renamed directory changes; rescan instead.
+  if (found && (m.rec.flags & LIBRARY_FLAG_DIR)) {
+    invalidate();
+    xSemaphoreGive(g_lock);
+    return;
+  }
+
+  if (isIndexedPath(oldPath)) {
+    LibraryChange gone;
+    gone.path    = oldPath;
+    gone.removed = true;
+    initRecord(gone.rec, oldPath);
+    addChange(gone);
+  }
+
+  // Same content under a new name: keep the probed details.
+  if (found && isIndexedPath(newPath)) {
+    LibraryChange moved;
+    moved.path        = newPath;
+    moved.removed     = false;
+    moved.rec         = m.rec;
+    moved.title       = m.title;
+    moved.artist      = m.artist;
+    moved.rec.pathLen = (uint8_t)newPath.length();
+    moved.rec.nameOff = (uint8_t)(newPath.lastIndexOf('/') + 1);
+    moved.rec.flags &= ~LIBRARY_FLAG_AUDIO;
+    if (decoderKnowsExtension(newPath))
+      moved.rec.flags |= LIBRARY_FLAG_AUDIO;
+    addChange(moved);
+  }
+  xSemaphoreGive(g_lock);
+
+  if (!found)
+    libraryNoteChanged(newPath);
+}
+
+void libraryRebuild()
+{
+  if (!g_lock)
+    return;
+
+  WebLog.println("[LIBRARY] Rebuild requested");
+  g_rebuildPending = true;
+}
+
+uint32_t libraryTableId()
+{
+  return g_ready ? g_header.buildId : 0;
+}
+
+uint32_t libraryContentVersion()
+{
+  return g_ready ? g_header.contentVersion : 0;
+}
+
+uint32_t libraryRecordCount()
+{
+  return g_ready ? g_header.recordCount : 0;
+}
+
+uint32_t libraryStableRecords()
+{
+  return g_ready ? g_probeCursor : 0;
+}
+
+bool libraryVisitRecords(uint32_t tableId, uint32_t first, uint32_t count, LibraryIndexVisitFn fn,
+                         void* ctx)
+{
+  if (!g_lock)
+    return false;
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  bool ok = visitTable(tableId, first, count, nullptr, fn, ctx);
+  xSemaphoreGive(g_lock);
+  return ok;
+}
+
+bool libraryGetRecords(uint32_t tableId, const uint32_t* indices, size_t count,
+                       LibraryIndexVisitFn fn, void* ctx)
+{
+  if (!g_lock)
+    return false;
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  bool ok = visitTable(tableId, 0, (uint32_t)count, indices, fn, ctx);
+  xSemaphoreGive(g_lock);
+  return ok;
+}
+
+void libraryForEachPending(LibraryVisitFn fn, void* ctx)
+{
+  if (!g_lock)
+    return;
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  for (int i = 0; i < g_changeCount; i++) {
+    const LibraryChange& c = g_changes[i];
+    if (c.removed)
+      continue;
+
+    LibraryEntry e;
+    fillEntry(c.rec, c.path, c.title, c.artist, e);
+    if (!fn(e, ctx))
+      break;
+  }
+  xSemaphoreGive(g_lock);
+}
+
+uint32_t libraryDirGeneration(const String& dir)
+{
+  return ((uint32_t)g_genEpoch << 16) | g_dirGen[dirBucket(dir)];
+}
+
+bool libraryCoversDir(const String& dir)
+{
+  if (!g_lock)
+    return false;
+
+  String normalized = dir;
+  if (normalized.length() == 0)
+    normalized = "/";
+  if (normalized.length() > 1 && normalized.endsWith("/"))
+    normalized.remove(normalized.length() - 1);
+  if (normalized != "/" && !isIndexedPath(normalized))
+    return false;
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  bool covered = g_ready && !inChangedTree(g_changes, g_changeCount, normalized + "/") &&
+                 findDir(hashString(normalized)) >= 0;
+  xSemaphoreGive(g_lock);
+  return covered;
+}
+
+String libraryGetStatsJson()
+{
+  uint32_t records = g_ready ? g_header.recordCount : 0;
+  uint32_t dirs    = g_ready ? g_header.dirCount : 0;
+
+  String json = "{";
+  json += "\"ready\":" + String(g_ready ? "true" : "false") + ",";
+  json += "\"building\":" + String(g_building ? "true" : "false") + ",";
+  json += "\"records\":" + String(records) + ",";
+  json += "\"dirs\":" + String(dirs) + ",";
+  json += "\"pendingChanges\":" + String(g_changeCount) + ",";
+  json += "\"probeCursor\":" + String(g_probeCursor) + ",";
+  json += "\"probed\":" + String(g_probed) + ",";
+  json += "\"rebuilds\":" + String(g_rebuilds) + ",";
+  json += "\"merges\":" + String(g_merges) + ",";
+  json += "\"fallbacks\":" + String(g_fallbacks) + ",";
+  json += "\"lastBuildMs\":" + String(g_lastBuildMs) + ",";
+  json += "\"lastListUs\":" + String(g_lastListUs);
+  json += "}";
+  return json;
+}
@@ -0,0 +1,980 @@
+#include "media_search.h"
+
+#include "sd_upload.h"
+#include "web_log.h"
+
+#include <SD.h>
+#include <algorithm>
+#include <vector>
+
+static const char* SEARCH_TOKENS_PATH   = "/.library/search.tok";
+static const char* SEARCH_POSTINGS_PATH = "/.library/search.pst";
+static const char* SEARCH_TOKENS_TMP    = "/.library/search.tok.tmp";
+static const char* SEARCH_POSTINGS_TMP  = "/.library/search.pst.tmp";
+static const char* SEARCH_RUNS_TMP      = "/.library/search.run.tmp";
+static const char* SEARCH_RUNS_ALT      = "/.library/search.run2.tmp"; // Compaction target.
+
+static const uint32_t SEARCH_MAGIC   = 0x3149534D; // "MSI1"
+static const uint32_t SEARCH_VERSION = 2;
+
+static const size_t   SEARCH_KEY_LEN      = 12;
+static const size_t   SEARCH_FENCE_LEN    = 8;
+static const uint32_t SEARCH_MAX_FENCES   = 1024;       // 8 KB of RAM.
+static const uint32_t SEARCH_MIN_STEP     = 16;         // Tokens per fence, at least.
+static const uint32_t SEARCH_RUN_SLOTS    = 2048;       // 32 KB sort buffer while building.
+static const uint32_t SEARCH_MAX_RUNS     = 128;        // Then compacted into one.
+static const uint32_t SEARCH_READ_SLOTS   = 16;         // Per run while merging.
+static const uint32_t SEARCH_TOKEN_BATCH  = 32;
+static const uint32_t SEARCH_CANDIDATES   = 32;         // Records fetched per library call.
+static const uint32_t SEARCH_SCAN_CHUNK   = 64;         // Records per linear-scan call.
+static const int      SEARCH_MAX_TERMS    = 4;
+static const uint32_t SEARCH_QUIET_MS     = 10000;      // Library quiet this long before a build.
+static const uint32_t SEARCH_REF_INNER    = 0x80000000; // Posting is a suffix, not a word start.
+static const uint32_t SEARCH_NO_INDEX     = 0xFFFFFFFF;
+
+// Sort record while building; also the layout of the final token table
+// (with ref = first posting).
+struct SearchSlot {
+  char     key[SEARCH_KEY_LEN]; // Lower-case UTF-8, NUL padded, truncated.
+  uint32_t ref;
+};
+
+static_assert(sizeof(SearchSlot) == 16, "SearchSlot is an on-card format");
+
+// search.tok: header, token table, fences. search.pst: uint32 postings.
+struct SearchHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t tableId;        // Library table the postings index into.
+  uint32_t contentVersion; // Library content the tokens were taken from.
+  uint32_t records;        // Records covered; later ones are scanned.
+  uint32_t stableRecords;  // Probed before the build; later ones may have new tags.
+  uint32_t tokenCount;
+  uint32_t postingCount;
+  uint32_t fenceStep;
+  uint32_t fenceCount;
+  uint32_t reserved[2];
+};
+
+struct BufferedWriter {
+  File     file;
+  uint8_t  buf[512];
+  size_t   len;
+  bool     ok;
+};
+
+struct RunReader {
+  uint32_t   pos;
+  uint32_t   end;
+  uint32_t   n;
+  uint32_t   i;
+  SearchSlot buf[SEARCH_READ_SLOTS];
+};
+
+// k-way merge over the sorted runs of one file.
+struct RunMerger {
+  RunReader* readers;
+  uint8_t*   heap;
+  uint32_t   size;
+};
+
+struct BuildContext {
+  SearchSlot* slots;
+  uint32_t    count;
+  File        runs;
+  const char* runsPath;
+  uint32_t    runStart[SEARCH_MAX_RUNS + 1];
+  uint32_t    runCount;
+  uint32_t    compactions;
+  bool        failed;
+};
+
+struct QueryState {
+  String         terms[SEARCH_MAX_TERMS];
+  int            termCount;
+  SearchMode     mode;
+  uint32_t       offset;
+  uint32_t       limit;
+  uint32_t       skipped;
+  uint32_t       delivered;
+  uint32_t       indexed; // Records the index answers for; later ones are scanned.
+  bool           more;
+  bool           stop;
+
+  std::vector<LibraryEntry> results; // Delivered once the locks are released.
+};
+
+static SearchHeader      g_header;
+static char*             g_fences = nullptr; // fenceCount x SEARCH_FENCE_LEN.
+static bool              g_loaded = false;
+static SemaphoreHandle_t g_lock   = nullptr;
+static TaskHandle_t      g_task   = nullptr;
+
+// Stats.
+static uint32_t g_builds      = 0;
+static uint32_t g_compactions = 0;
+static uint32_t g_queries     = 0;
+static uint32_t g_lastBuildMs = 0;
+static uint32_t g_lastQueryUs = 0;
+
+// ----------------------------------------------------------------------------
+// Text normalization
+// ----------------------------------------------------------------------------
+
+// Lower-case ASCII, Latin-1 and Cyrillic letters.
+static uint32_t foldCodePoint(uint32_t cp)
+{
+  if (cp >= 'A' && cp <= 'Z')
+    return cp + 32;
+  if (cp >= 0xC0 && cp <= 0xDE && cp != 0xD7)
+    return cp + 32;
+  if (cp >= 0x410 && cp <= 0x42F)
+    return cp + 32;
+  if (cp >= 0x400 && cp <= 0x40F)
+    return cp + 80;
+  return cp;
+}
+
+static bool isWordChar(uint32_t cp)
+{
+  if (cp < 0x80)
+    return (cp >= '0' && cp <= '9') || (cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z');
+  // Latin-1 punctuation and symbols, general punctuation.
+  if ((cp >= 0xA0 && cp <= 0xBF) || cp == 0xD7 || cp == 0xF7)
+    return false;
+  return cp < 0x2000 || cp > 0x206F;
+}
+
+static void appendUtf8(String& out, uint32_t cp)
+{
+  if (cp < 0x80) {
+    out += (char)cp;
+  } else if (cp < 0x800) {
+    out += (char)(0xC0 | (cp >> 6));
+    out += (char)(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    out += (char)(0xE0 | (cp >> 12));
+    out += (char)(0x80 | ((cp >> 6) & 0x3F));
+    out += (char)(0x80 | (cp & 0x3F));
+  } else {
+    out += (char)(0xF0 | (cp >> 18));
+    out += (char)(0x80 | ((cp >> 12) & 0x3F));
+    out += (char)(0x80 | ((cp >> 6) & 0x3F));
+    out += (char)(0x80 | (cp & 0x3F));
+  }
+}
+
+// Decode one code point; malformed bytes are taken as Latin-1.
+static uint32_t nextCodePoint(const char* s, size_t len, size_t& i)
+{
+  uint8_t c = (uint8_t)s[i];
+  size_t  n = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : 4;
+  if (c >= 0x80 && ((c & 0xC0) == 0x80 || c >= 0xF8 || i + n > len))
+    n = 0;
+
+  uint32_t cp = n == 1 ? c : c & (0x7F >> n);
+  for (size_t k = 1; k < n; k++) {
+    if (((uint8_t)s[i + k] & 0xC0) != 0x80) {
+      n = 0;
+      break;
+    }
+    cp = (cp << 6) | ((uint8_t)s[i + k] & 0x3F);
+  }
+
+  if (n == 0) {
+    i++;
+    return c;
+  }
+  i += n;
+  return cp;
+}
+
+// Lower-case words separated by single spaces.
+static String normalizeText(const String& s)
+{
+  String out;
+  out.reserve(s.length());
+  bool   gap = false;
+  size_t i   = 0;
+  while (i < s.length()) {
+    uint32_t cp = nextCodePoint(s.c_str(), s.length(), i);
+    if (!isWordChar(cp)) {
+      gap = out.length() > 0;
+      continue;
+    }
+    if (gap)
+      out += ' ';
+    gap = false;
+    appendUtf8(out, foldCodePoint(cp));
+  }
+  return out;
+}
+
+// Searchable text of an entry: name without extension, title, artist.
+static String entryText(const LibraryEntry& e)
+{
+  String name = e.name;
+  int    dot  = name.lastIndexOf('.');
+  if (!e.isDir && dot > 0)
+    name = name.substring(0, dot);
+  return normalizeText(name + " " + e.title + " " + e.artist);
+}
+
+static bool matchesTerms(const QueryState& q, const LibraryEntry& e)
+{
+  String text = " " + entryText(e);
+  for (int t = 0; t < q.termCount; t++) {
+    String needle = q.mode == SEARCH_PREFIX ? " " + q.terms[t] : q.terms[t];
+    if (text.indexOf(needle) < 0)
+      return false;
+  }
+  return true;
+}
+
+static void makeKey(const char* s, size_t len, char* key)
+{
+  memset(key, 0, SEARCH_KEY_LEN);
+  memcpy(key, s, len < SEARCH_KEY_LEN ? len : SEARCH_KEY_LEN);
+}
+
+static bool slotLess(const SearchSlot& a, const SearchSlot& b)
+{
+  int c = memcmp(a.key, b.key, SEARCH_KEY_LEN);
+  return c != 0 ? c < 0 : a.ref < b.ref;
+}
+
+// ----------------------------------------------------------------------------
+// Index files
+// ----------------------------------------------------------------------------
+
+static void writerPut(BufferedWriter& w, const void* data, size_t len)
+{
+  if (w.len + len > sizeof(w.buf)) {
+    w.ok  = w.ok && w.file.write(w.buf, w.len) == w.len;
+    w.len = 0;
+  }
+  if (len > sizeof(w.buf)) {
+    w.ok = w.ok && w.file.write((const uint8_t*)data, len) == len;
+    return;
+  }
+  memcpy(w.buf + w.len, data, len);
+  w.len += len;
+}
+
+static bool writerFlush(BufferedWriter& w)
+{
+  if (w.len > 0) {
+    w.ok  = w.ok && w.file.write(w.buf, w.len) == w.len;
+    w.len = 0;
+  }
+  return w.ok;
+}
+
+// Load header and fences (caller holds g_lock).
+static bool loadIndex()
+{
+  g_loaded = false;
+  free(g_fences);
+  g_fences = nullptr;
+
+  File tok = SD.open(SEARCH_TOKENS_PATH);
+  File pst = SD.open(SEARCH_POSTINGS_PATH);
+
+  SearchHeader hdr;
+  bool         ok = tok && pst;
+
+  ok = ok && tok.read((uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) && hdr.magic == SEARCH_MAGIC &&
+       hdr.version == SEARCH_VERSION && hdr.fenceCount <= SEARCH_MAX_FENCES &&
+       hdr.fenceStep > 0 && pst.size() == hdr.postingCount * sizeof(uint32_t);
+  if (ok && hdr.fenceCount > 0) {
+    size_t bytes = hdr.fenceCount * SEARCH_FENCE_LEN;
+    g_fences     = (char*)malloc(bytes);
+    ok           = g_fences && tok.seek(sizeof(hdr) + hdr.tokenCount * sizeof(SearchSlot)) &&
+         tok.read((uint8_t*)g_fences, bytes) == bytes;
+  }
+
+  if (tok)
+    tok.close();
+  if (pst)
+    pst.close();
+
+  if (!ok) {
+    free(g_fences);
+    g_fences = nullptr;
+    memset(&g_header, 0, sizeof(g_header));
+    return false;
+  }
+
+  g_header = hdr;
+  g_loaded = true;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Build: sorted runs of (string, record) slots, then a k-way merge
+// ----------------------------------------------------------------------------
+
+static bool compactRuns(BuildContext& b);
+
+static bool flushRun(BuildContext& b)
+{
+  if (b.count == 0)
+    return true;
+
+  std::sort(b.slots, b.slots + b.count, slotLess);
+
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < b.count; i++) {
+    if (kept == 0 || memcmp(&b.slots[i], &b.slots[kept - 1], sizeof(SearchSlot)) != 0)
+      b.slots[kept++] = b.slots[i];
+  }
+
+  size_t bytes = kept * sizeof(SearchSlot);
+  if (b.runs.write((const uint8_t*)b.slots, bytes) != bytes) {
+    b.failed = true;
+    return false;
+  }
+
+  b.runStart[b.runCount + 1] = b.runStart[b.runCount] + bytes;
+  b.runCount++;
+  b.count = 0;
+  return b.runCount < SEARCH_MAX_RUNS || compactRuns(b);
+}
+
+static void addSlot(BuildContext& b, const char* s, size_t len, uint32_t ref)
+{
+  if (b.failed || (b.count >= SEARCH_RUN_SLOTS && !flushRun(b))) {
+    b.failed = true;
+    return;
+  }
+  makeKey(s, len, b.slots[b.count].key);
+  b.slots[b.count].ref = ref;
+  b.count++;
+}
+
+static size_t nextCharStart(const char* s, size_t len, size_t i)
+{
+  i++;
+  while (i < len && ((uint8_t)s[i] & 0xC0) == 0x80) {
+    i++;
+  }
+  return i;
+}
+
+// Every word as a word-start slot, plus each suffix of two or more
+// characters as an inner slot.
+static bool addRecordSlots(const LibraryEntry& entry, uint32_t index, void* ctx)
+{
+  BuildContext& b = *(BuildContext*)ctx;
+
+  String      text  = entryText(entry);
+  const char* s     = text.c_str();
+  size_t      start = 0;
+  while (start < text.length() && !b.failed) {
+    int    space = text.indexOf(' ', start);
+    size_t end   = space < 0 ? text.length() : (size_t)space;
+    size_t len   = end - start;
+
+    addSlot(b, s + start, len, index);
+    for (size_t i = nextCharStart(s + start, len, 0); i < len;) {
+      size_t next = nextCharStart(s + start, len, i);
+      if (next >= len)
+        break; // One character left.
+      addSlot(b, s + start + i, len - i, index | SEARCH_REF_INNER);
+      i = next;
+    }
+    start = end + 1;
+  }
+  return !b.failed;
+}
+
+static bool refillReader(File& runs, RunReader& r)
+{
+  r.i = 0;
+  r.n = 0;
+  if (r.pos >= r.end)
+    return false;
+
+  uint32_t want = (r.end - r.pos) / sizeof(SearchSlot);
+  if (want > SEARCH_READ_SLOTS)
+    want = SEARCH_READ_SLOTS;
+  size_t bytes = want * sizeof(SearchSlot);
+  if (!runs.seek(r.pos) || runs.read((uint8_t*)r.buf, bytes) != bytes)
+    return false;
+
+  r.pos += bytes;
+  r.n = want;
+  return true;
+}
+
+static void siftDown(uint8_t* heap, uint32_t size, RunReader* readers, uint32_t i)
+{
+  for (;;) {
+    uint32_t smallest = i;
+    uint32_t l        = 2 * i + 1;
+    uint32_t r        = l + 1;
+    if (l < size && slotLess(readers[heap[l]].buf[readers[heap[l]].i],
+                             readers[heap[smallest]].buf[readers[heap[smallest]].i]))
+      smallest = l;
+    if (r < size && slotLess(readers[heap[r]].buf[readers[heap[r]].i],
+                             readers[heap[smallest]].buf[readers[heap[smallest]].i]))
+      smallest = r;
+    if (smallest == i)
+      return;
+    std::swap(heap[i], heap[smallest]);
+    i = smallest;
+  }
+}
+
+static bool mergerBegin(RunMerger& m, File& runs, const uint32_t* runStart, uint32_t runCount)
+{
+  m.readers = new RunReader[runCount];
+  m.heap    = new uint8_t[runCount];
+  m.size    = 0;
+  if (!m.readers || !m.heap)
+    return false;
+
+  for (uint32_t i = 0; i < runCount; i++) {
+    m.readers[i].pos = runStart[i];
+    m.readers[i].end = runStart[i + 1];
+    if (refillReader(runs, m.readers[i]))
+      m.heap[m.size++] = (uint8_t)i;
+  }
+  for (uint32_t i = m.size / 2; i-- > 0;) {
+    siftDown(m.heap, m.size, m.readers, i);
+  }
+  return true;
+}
+
+static const SearchSlot& mergerTop(const RunMerger& m)
+{
+  const RunReader& r = m.readers[m.heap[0]];
+  return r.buf[r.i];
+}
+
+static void mergerPop(RunMerger& m, File& runs)
+{
+  RunReader& r = m.readers[m.heap[0]];
+  if (++r.i >= r.n && !refillReader(runs, r))
+    m.heap[0] = m.heap[--m.size];
+  siftDown(m.heap, m.size, m.readers, 0);
+}
+
+static void mergerEnd(RunMerger& m)
+{
+  delete[] m.readers;
+  delete[] m.heap;
+  m.readers = nullptr;
+  m.heap    = nullptr;
+}
+
+// Fold all runs into one in the other runs file, so that any number of
+// records fits. The sort buffer is empty here; it is released while the
+// merge readers need the memory.
+static bool compactRuns(BuildContext& b)
+{
+  const char* into = b.runsPath == SEARCH_RUNS_TMP ? SEARCH_RUNS_ALT : SEARCH_RUNS_TMP;
+  b.runs.close();
+  free(b.slots);
+  b.slots = nullptr;
+
+  File           in  = SD.open(b.runsPath);
+  BufferedWriter out = {SD.open(into, FILE_WRITE), {0}, 0, true};
+  RunMerger      m   = {nullptr, nullptr, 0};
+  bool           ok  = in && out.file && mergerBegin(m, in, b.runStart, b.runCount);
+
+  SearchSlot last;
+  uint32_t   kept = 0;
+  for (uint32_t n = 1; ok && m.size > 0; n++) {
+    const SearchSlot& s = mergerTop(m);
+    if (kept == 0 || memcmp(&s, &last, sizeof(s)) != 0) {
+      writerPut(out, &s, sizeof(s));
+      last = s;
+      kept++;
+    }
+    mergerPop(m, in);
+    if ((n & 1023) == 0)
+      vTaskDelay(1);
+  }
+  ok = ok && writerFlush(out);
+
+  mergerEnd(m);
+  if (in)
+    in.close();
+  SD.remove(b.runsPath);
+
+  b.runs        = out.file;
+  b.runsPath    = into;
+  b.runStart[1] = kept * sizeof(SearchSlot);
+  b.runCount    = 1;
+  b.slots       = (SearchSlot*)malloc(SEARCH_RUN_SLOTS * sizeof(SearchSlot));
+  b.compactions++;
+  if (!ok || !b.slots || !b.runs)
+    b.failed = true;
+  return !b.failed;
+}
+
+// Merge the runs into the token table, postings and fences.
+static bool mergeRuns(BuildContext& b, SearchHeader& hdr)
+{
+  RunMerger m      = {nullptr, nullptr, 0};
+  char*     fences = (char*)malloc(SEARCH_MAX_FENCES * SEARCH_FENCE_LEN);
+
+  BufferedWriter tok = {SD.open(SEARCH_TOKENS_TMP, FILE_WRITE), {0}, 0, true};
+  BufferedWriter pst = {SD.open(SEARCH_POSTINGS_TMP, FILE_WRITE), {0}, 0, true};
+  bool           ok  = fences && tok.file && pst.file &&
+            mergerBegin(m, b.runs, b.runStart, b.runCount);
+
+  uint64_t totalSlots = b.runStart[b.runCount] / sizeof(SearchSlot);
+  hdr.fenceStep       = (uint32_t)((totalSlots + SEARCH_MAX_FENCES - 1) / SEARCH_MAX_FENCES);
+  if (hdr.fenceStep < SEARCH_MIN_STEP)
+    hdr.fenceStep = SEARCH_MIN_STEP;
+
+
+  SearchHeader placeholder = {};
+  if (ok)
+    writerPut(tok, &placeholder, sizeof(placeholder));
+
+  char     lastKey[SEARCH_KEY_LEN];
+  uint32_t lastRef = SEARCH_NO_INDEX;
+  while (ok && m.size > 0) {
+    const SearchSlot& s = mergerTop(m);
+
+    if (hdr.tokenCount == 0 || memcmp(s.key, lastKey, SEARCH_KEY_LEN) != 0) {
+      if (hdr.tokenCount % hdr.fenceStep == 0 && hdr.fenceCount < SEARCH_MAX_FENCES)
+        memcpy(fences + hdr.fenceCount++ * SEARCH_FENCE_LEN, s.key, SEARCH_FENCE_LEN);
+      SearchSlot token = s;
+      token.ref        = hdr.postingCount;
+      writerPut(tok, &token, sizeof(token));
+      memcpy(lastKey, s.key, SEARCH_KEY_LEN);
+      lastRef = SEARCH_NO_INDEX;
+      hdr.tokenCount++;
+    }
+    if (s.ref != lastRef) {
+      writerPut(pst, &s.ref, sizeof(s.ref));
+      lastRef = s.ref;
+      hdr.postingCount++;
+    }
+
+    mergerPop(m, b.runs);
+
+    if ((hdr.postingCount & 1023) == 0)
+      vTaskDelay(1);
+  }
+
+  if (ok) {
+    writerPut(tok, fences, hdr.fenceCount * SEARCH_FENCE_LEN);
+    ok = writerFlush(tok) && writerFlush(pst) && tok.file.seek(0) &&
+         tok.file.write((const uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr);
+  }
+
+  if (tok.file)
+    tok.file.close();
+  if (pst.file)
+    pst.file.close();
+  mergerEnd(m);
+  free(fences);
+  return ok;
+}
+
+static void buildIndex()
+{
+  uint32_t startMs = millis();
+  uint32_t tableId = libraryTableId();
+  uint32_t version = libraryContentVersion();
+  uint32_t total   = libraryRecordCount();
+  uint32_t stable  = libraryStableRecords();
+
+  BuildContext* b = new BuildContext();
+  b->slots        = (SearchSlot*)malloc(SEARCH_RUN_SLOTS * sizeof(SearchSlot));
+  b->runsPath     = SEARCH_RUNS_TMP;
+
+  SD.remove(SEARCH_RUNS_TMP);
+  SD.remove(SEARCH_RUNS_ALT);
+  b->runs = SD.open(SEARCH_RUNS_TMP, FILE_WRITE);
+  bool ok = b->slots && b->runs;
+
+  for (uint32_t first = 0; ok && first < total; first += SEARCH_SCAN_CHUNK) {
+    ok = libraryVisitRecords(tableId, first, SEARCH_SCAN_CHUNK, addRecordSlots, b) && !b->failed;
+    vTaskDelay(1);
+  }
+  ok = ok && flushRun(*b);
+  free(b->slots);
+  b->slots = nullptr;
+  if (b->runs)
+    b->runs.close();
+
+  SearchHeader hdr   = {};
+  hdr.magic          = SEARCH_MAGIC;
+  hdr.version        = SEARCH_VERSION;
+  hdr.tableId        = tableId;
+  hdr.contentVersion = version;
+  hdr.records        = total;
+  hdr.stableRecords  = stable < total ? stable : total;
+
+  if (ok) {
+    b->runs = SD.open(b->runsPath);
+    ok      = b->runs && mergeRuns(*b, hdr);
+    if (b->runs)
+      b->runs.close();
+  }
+  SD.remove(SEARCH_RUNS_TMP);
+  SD.remove(SEARCH_RUNS_ALT);
+  g_compactions += b->compactions;
+  delete b;
+
+  // The library moved on while we were reading it; try again later.
+  if (ok && libraryTableId() != tableId)
+    ok = false;
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  if (ok) {
+    SD.remove(SEARCH_TOKENS_PATH);
+    SD.remove(SEARCH_POSTINGS_PATH);
+    ok = SD.rename(SEARCH_POSTINGS_TMP, SEARCH_POSTINGS_PATH) &&
+         SD.rename(SEARCH_TOKENS_TMP, SEARCH_TOKENS_PATH);
+    loadIndex();
+  }
+  xSemaphoreGive(g_lock);
+  SD.remove(SEARCH_TOKENS_TMP);
+  SD.remove(SEARCH_POSTINGS_TMP);
+
+  if (!ok) {
+    WebLog.println("[SEARCH] ⚠️ Index build incomplete, will retry");
+    return;
+  }
+
+  g_builds++;
+  g_lastBuildMs = millis() - startMs;
+  WebLog.print("[SEARCH] ✅ Indexed ");
+  WebLog.print(hdr.records);
+  WebLog.print(" records: ");
+  WebLog.print(hdr.tokenCount);
+  WebLog.print(" strings, ");
+  WebLog.print(hdr.postingCount);
+  WebLog.print(" postings (");
+  WebLog.print(g_lastBuildMs);
+  WebLog.println(" ms)");
+}
+
+static void searchTask(void* param)
+{
+  (void)param;
+
+  uint32_t seenTable   = 0;
+  uint32_t seenVersion = 0;
+  uint32_t seenSince   = 0;
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(1000));
+
+    uint32_t table   = libraryTableId();
+    uint32_t version = libraryContentVersion();
+    if (table == 0 || (g_loaded && table == g_header.tableId && version == g_header.contentVersion))
+      continue;
+
+    // Wait for the library to settle (merges and tag probing bump it).
+    if (table != seenTable || version != seenVersion) {
+      seenTable   = table;
+      seenVersion = version;
+      seenSince   = millis();
+      continue;
+    }
+    if (millis() - seenSince < SEARCH_QUIET_MS || sdUploadIsActive())
+      continue;
+
+    buildIndex();
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Query
+// ----------------------------------------------------------------------------
+
+// Returns false once the caller should stop.
+static bool deliver(QueryState& q, const LibraryEntry& e)
+{
+  if (!matchesTerms(q, e))
+    return true;
+
+  if (q.skipped < q.offset) {
+    q.skipped++;
+    return true;
+  }
+  if (q.delivered < q.limit) {
+    q.delivered++;
+    q.results.push_back(e);
+    return true;
+  }
+
+  q.more = true;
+  q.stop = true;
+  return false;
+}
+
+static bool deliverEntry(const LibraryEntry& e, void* ctx)
+{
+  return deliver(*(QueryState*)ctx, e);
+}
+
+static bool deliverRecord(const LibraryEntry& e, uint32_t index, void* ctx)
+{
+  (void)index;
+  return deliver(*(QueryState*)ctx, e);
+}
+
+// Index of the first fence block that can hold a key with this prefix.
+// With upper set, the block that can hold the first key above it.
+static uint32_t fenceStart(const char* prefix, size_t len, bool upper)
+{
+  size_t   m  = len < SEARCH_FENCE_LEN ? len : SEARCH_FENCE_LEN;
+  uint32_t lo = 0;
+  uint32_t hi = g_header.fenceCount;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    int      c   = memcmp(g_fences + mid * SEARCH_FENCE_LEN, prefix, m);
+    if (upper ? c <= 0 : c < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo > 0 ? (lo - 1) * g_header.fenceStep : 0;
+}
+
+// First token from `from` not below (or, with upper, above) the prefix.
+static uint32_t scanTokens(File& tok, uint32_t from, const char* prefix, size_t len, bool upper)
+{
+  SearchSlot batch[SEARCH_TOKEN_BATCH];
+  uint32_t   count = g_header.tokenCount;
+  for (uint32_t i = from; i < count;) {
+    uint32_t n     = count - i < SEARCH_TOKEN_BATCH ? count - i : SEARCH_TOKEN_BATCH;
+    size_t   bytes = n * sizeof(SearchSlot);
+    if (!tok.seek(sizeof(SearchHeader) + i * sizeof(SearchSlot)) ||
+        tok.read((uint8_t*)batch, bytes) != bytes)
+      return count;
+
+    for (uint32_t k = 0; k < n; k++) {
+      int c = memcmp(batch[k].key, prefix, len);
+      if (upper ? c > 0 : c >= 0)
+        return i + k;
+    }
+    i += n;
+  }
+  return count;
+}
+
+static uint32_t postingStart(File& tok, uint32_t token)
+{
+  SearchSlot s;
+  if (token >= g_header.tokenCount)
+    return g_header.postingCount;
+  if (!tok.seek(sizeof(SearchHeader) + token * sizeof(SearchSlot)) ||
+      tok.read((uint8_t*)&s, sizeof(s)) != sizeof(s))
+    return g_header.postingCount;
+  return s.ref;
+}
+
+static void flushCandidates(QueryState& q, uint32_t* batch, uint32_t& n)
+{
+  if (n == 0 || q.stop)
+    return;
+  std::sort(batch, batch + n);
+  libraryGetRecords(g_header.tableId, batch, n, deliverRecord, &q);
+  n = 0;
+}
+
+// Postings of every string starting with the term: word starts first,
+// then (substring mode) inner matches.
+static void queryIndex(QueryState& q, const String& term)
+{
+  File tok = SD.open(SEARCH_TOKENS_PATH);
+  File pst = SD.open(SEARCH_POSTINGS_PATH);
+  if (!tok || !pst)
+    return;
+
+  const char* prefix = term.c_str();
+  size_t      len    = term.length() < SEARCH_KEY_LEN ? term.length() : SEARCH_KEY_LEN;
+
+  uint32_t first = scanTokens(tok, fenceStart(prefix, len, false), prefix, len, false);
+  uint32_t from  = first;
+  if (len <= SEARCH_FENCE_LEN) {
+    uint32_t upperFrom = fenceStart(prefix, len, true);
+    if (upperFrom > from)
+      from = upperFrom;
+  }
+  uint32_t last      = scanTokens(tok, from, prefix, len, true);
+  uint32_t postBegin = postingStart(tok, first);
+  uint32_t postEnd   = postingStart(tok, last);
+
+  uint32_t  records = q.indexed;
+  uint8_t*  seen    = (uint8_t*)calloc((records + 7) / 8 + 1, 1);
+  uint32_t  batch[SEARCH_CANDIDATES];
+  uint32_t  n      = 0;
+  int       passes = q.mode == SEARCH_SUBSTRING ? 2 : 1;
+  for (int pass = 0; pass < passes && seen && !q.stop; pass++) {
+    uint32_t refs[SEARCH_TOKEN_BATCH];
+    for (uint32_t p = postBegin; p < postEnd && !q.stop;) {
+      uint32_t cnt   = postEnd - p < SEARCH_TOKEN_BATCH ? postEnd - p : SEARCH_TOKEN_BATCH;
+      size_t   bytes = cnt * sizeof(uint32_t);
+      if (!pst.seek(p * sizeof(uint32_t)) || pst.read((uint8_t*)refs, bytes) != bytes)
+        break;
+      p += cnt;
+
+      for (uint32_t k = 0; k < cnt && !q.stop; k++) {
+        bool     inner = (refs[k] & SEARCH_REF_INNER) != 0;
+        uint32_t index = refs[k] & ~SEARCH_REF_INNER;
+        if (inner != (pass == 1) || index >= records || (seen[index / 8] & (1 << (index % 8))))
+          continue;
+        seen[index / 8] |= 1 << (index % 8);
+        batch[n++] = index;
+        if (n == SEARCH_CANDIDATES)
+          flushCandidates(q, batch, n);
+      }
+    }
+    flushCandidates(q, batch, n);
+  }
+
+  free(seen);
+  tok.close();
+  pst.close();
+}
+
+// Match records directly (no usable index, or past its coverage).
+static void queryLinear(QueryState& q, uint32_t tableId, uint32_t first)
+{
+  uint32_t total = libraryRecordCount();
+  for (uint32_t i = first; i < total && !q.stop; i += SEARCH_SCAN_CHUNK) {
+    if (!libraryVisitRecords(tableId, i, SEARCH_SCAN_CHUNK, deliverRecord, &q))
+      return;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Public API
+// ----------------------------------------------------------------------------
+
+void searchBegin()
+{
+  g_lock = xSemaphoreCreateMutex();
+  if (!g_lock) {
+    WebLog.println("[SEARCH] ❌ Cannot create lock");
+    return;
+  }
+
+  SD.remove(SEARCH_RUNS_TMP);
+  SD.remove(SEARCH_RUNS_ALT);
+  SD.remove(SEARCH_TOKENS_TMP);
+  SD.remove(SEARCH_POSTINGS_TMP);
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  bool loaded = loadIndex();
+  xSemaphoreGive(g_lock);
+
+  if (loaded) {
+    WebLog.print("[SEARCH] ✅ ");
+    WebLog.print(g_header.tokenCount);
+    WebLog.print(" strings over ");
+    WebLog.print(g_header.records);
+    WebLog.println(" records");
+  } else {
+    WebLog.println("[SEARCH] ⚠️ No index yet, it is built once the library settles");
+  }
+
+  if (xTaskCreatePinnedToCore(searchTask, "search", 8192, nullptr, 1, &g_task, 0) != pdPASS) {
+    WebLog.println("[SEARCH] ❌ Cannot start task");
+    g_task = nullptr;
+  }
+}
+
+size_t searchRun(const String& query, SearchMode mode, uint32_t offset, uint32_t limit,
+                 SearchResultFn fn, void* ctx, bool* more)
+{
+  uint32_t   startUs = micros();
+  QueryState q;
+  q.termCount = 0;
+  q.mode      = mode;
+  q.offset    = offset;
+  q.limit     = limit;
+  q.skipped   = 0;
+  q.delivered = 0;
+  q.indexed   = 0;
+  q.more      = false;
+  q.stop      = false;
+
+  // Split into terms; the longest one drives the index lookup.
+  String text    = normalizeText(query);
+  int    longest = -1;
+  size_t start   = 0;
+  while (start < text.length() && q.termCount < SEARCH_MAX_TERMS) {
+    int    space = text.indexOf(' ', start);
+    size_t end   = space < 0 ? text.length() : (size_t)space;
+    q.terms[q.termCount] = text.substring(start, end);
+    if (longest < 0 || q.terms[q.termCount].length() > q.terms[longest].length())
+      longest = q.termCount;
+    q.termCount++;
+    start = end + 1;
+  }
+
+  if (more)
+    *more = false;
+  if (q.termCount == 0 || !g_lock)
+    return 0;
+
+  // Inner slots start at the second character and are two or more long.
+  const String& key = q.terms[longest];
+  if (q.mode == SEARCH_SUBSTRING && nextCharStart(key.c_str(), key.length(), 0) >= key.length())
+    q.mode = SEARCH_PREFIX;
+
+  libraryForEachPending(deliverEntry, &q);
+
+  xSemaphoreTake(g_lock, portMAX_DELAY);
+  uint32_t tableId = libraryTableId();
+  if (g_loaded && g_header.tableId == tableId) {
+    // Tags probed since the build are not indexed: records the prober had
+    // not reached then are matched directly.
+    q.indexed = g_header.contentVersion == libraryContentVersion() ? g_header.records
+                                                                  : g_header.stableRecords;
+    queryIndex(q, key);
+    queryLinear(q, tableId, q.indexed);
+  } else {
+    queryLinear(q, tableId, 0);
+  }
+  xSemaphoreGive(g_lock);
+
+  g_queries++;
+  g_lastQueryUs = micros() - startUs;
+
+  // Sending may block on the client; no lock is held any more.
+  size_t sent = 0;
+  for (const LibraryEntry& e : q.results) {
+    if (!fn(e, ctx)) {
+      q.more = false;
+      break;
+    }
+    sent++;
+  }
+  if (more)
+    *more = q.more;
+  return sent;
+}
+
+String searchGetStatsJson()
+{
+  bool current = g_loaded && g_header.tableId == libraryTableId() &&
+                 g_header.contentVersion == libraryContentVersion();
+
+  String json = "{";
+  json += "\"loaded\":" + String(g_loaded ? "true" : "false") + ",";
+  json += "\"current\":" + String(current ? "true" : "false") + ",";
+  json += "\"records\":" + String(g_header.records) + ",";
+  json += "\"strings\":" + String(g_header.tokenCount) + ",";
+  json += "\"postings\":" + String(g_header.postingCount) + ",";
+  json += "\"fences\":" + String(g_header.fenceCount) + ",";
+  json += "\"stableRecords\":" + String(g_header.stableRecords) + ",";
+  json += "\"builds\":" + String(g_builds) + ",";
+  json += "\"compactions\":" + String(g_compactions) + ",";
+  json += "\"lastBuildMs\":" + String(g_lastBuildMs) + ",";
+  json += "\"queries\":" + String(g_queries) + ",";
+  json += "\"lastQueryUs\":" + String(g_lastQueryUs);
+  json += "}";
+  return json;
+}
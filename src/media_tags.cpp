@@ -0,0 +1,371 @@
+#include "media_tags.h"
+
+#include <SD.h>
+
+// Frames or comments longer than this are skipped without reading.
+static const size_t TAG_READ_MAX = 256;
+
+// RIFF chunks walked before giving up on finding LIST/INFO.
+static const int TAG_MAX_CHUNKS = 64;
+
+// ID3v2 text encodings.
+enum TagEncoding : uint8_t {
+  TAG_LATIN1   = 0,
+  TAG_UTF16    = 1, // With BOM.
+  TAG_UTF16_BE = 2,
+  TAG_UTF8     = 3,
+};
+
+static uint32_t readBE24(const uint8_t* p)
+{
+  return ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+}
+
+static uint32_t readBE32(const uint8_t* p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t readLE32(const uint8_t* p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t readSyncsafe(const uint8_t* p)
+{
+  return ((uint32_t)(p[0] & 0x7F) << 21) | ((uint32_t)(p[1] & 0x7F) << 14) |
+         ((uint32_t)(p[2] & 0x7F) << 7) | (p[3] & 0x7F);
+}
+
+// Append one code point as UTF-8. Returns false once TAGS_MAX_LEN is reached.
+static bool appendCodePoint(String& out, uint32_t cp)
+{
+  char   buf[4];
+  size_t n;
+  if (cp < 0x80) {
+    buf[0] = (char)cp;
+    n      = 1;
+  } else if (cp < 0x800) {
+    buf[0] = (char)(0xC0 | (cp >> 6));
+    buf[1] = (char)(0x80 | (cp & 0x3F));
+    n      = 2;
+  } else if (cp < 0x10000) {
+    buf[0] = (char)(0xE0 | (cp >> 12));
+    buf[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    buf[2] = (char)(0x80 | (cp & 0x3F));
+    n      = 3;
+  } else {
+    buf[0] = (char)(0xF0 | (cp >> 18));
+    buf[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    buf[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    buf[3] = (char)(0x80 | (cp & 0x3F));
+    n      = 4;
+  }
+
+  if (out.length() + n > TAGS_MAX_LEN)
+    return false;
+  for (size_t i = 0; i < n; i++) {
+    out += buf[i];
+  }
+  return true;
+}
+
+// Decode one UTF-8 sequence at p; returns its length, or 0 if malformed.
+static size_t utf8Sequence(const uint8_t* p, size_t len, uint32_t& cp)
+{
+  uint8_t c = p[0];
+  size_t  n = 0;
+  if (c < 0x80)
+    n = 1;
+  else if ((c & 0xE0) == 0xC0)
+    n = 2;
+  else if ((c & 0xF0) == 0xE0)
+    n = 3;
+  else if ((c & 0xF8) == 0xF0)
+    n = 4;
+  if (n == 0 || n > len)
+    return 0;
+
+  cp = n == 1 ? c : c & (0x7F >> n);
+  for (size_t i = 1; i < n; i++) {
+    if ((p[i] & 0xC0) != 0x80)
+      return 0;
+    cp = (cp << 6) | (p[i] & 0x3F);
+  }
+  return n;
+}
+
+static void decodeLatin1(const uint8_t* p, size_t len, String& out)
+{
+  for (size_t i = 0; i < len && p[i] != 0; i++) {
+    if (!appendCodePoint(out, p[i]))
+      return;
+  }
+}
+
+// UTF-8 as is; anything that fails to decode is taken as Latin-1 (RIFF INFO
+// has no declared encoding).
+static void decodeUtf8(const uint8_t* p, size_t len, String& out)
+{
+  size_t   i = 0;
+  uint32_t cp;
+  while (i < len && p[i] != 0) {
+    size_t n = utf8Sequence(p + i, len - i, cp);
+    if (n == 0) {
+      out = "";
+      decodeLatin1(p, len, out);
+      return;
+    }
+    if (!appendCodePoint(out, cp))
+      return;
+    i += n;
+  }
+}
+
+static void decodeUtf16(const uint8_t* p, size_t len, bool bigEndian, String& out)
+{
+  size_t i = 0;
+  if (len >= 2 && ((p[0] == 0xFF && p[1] == 0xFE) || (p[0] == 0xFE && p[1] == 0xFF))) {
+    bigEndian = p[0] == 0xFE;
+    i         = 2;
+  }
+
+  while (i + 1 < len) {
+    uint32_t unit = bigEndian ? (p[i] << 8) | p[i + 1] : p[i] | (p[i + 1] << 8);
+    i += 2;
+    if (unit == 0)
+      return;
+
+    if (unit >= 0xD800 && unit < 0xDC00 && i + 1 < len) {
+      uint32_t low = bigEndian ? (p[i] << 8) | p[i + 1] : p[i] | (p[i + 1] << 8);
+      if (low >= 0xDC00 && low < 0xE000) {
+        unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+        i += 2;
+      }
+    }
+    if (!appendCodePoint(out, unit))
+      return;
+  }
+}
+
+static void decodeText(const uint8_t* p, size_t len, uint8_t encoding, String& out)
+{
+  out = "";
+  switch (encoding) {
+    case TAG_LATIN1:
+      decodeLatin1(p, len, out);
+      break;
+    case TAG_UTF16:
+      decodeUtf16(p, len, false, out);
+      break;
+    case TAG_UTF16_BE:
+      decodeUtf16(p, len, true, out);
+      break;
+    default:
+      decodeUtf8(p, len, out);
+      break;
+  }
+  out.trim();
+}
+
+// ----------------------------------------------------------------------------
+// ID3v2
+// ----------------------------------------------------------------------------
+
+// Parse an ID3v2 tag at the start of the file. Returns the offset just past
+// the tag (0 when there is none).
+static uint32_t readId3v2(File& f, String& title, String& artist)
+{
+  uint8_t hdr[10];
+  f.seek(0);
+  if (f.read(hdr, sizeof(hdr)) != sizeof(hdr) || memcmp(hdr, "ID3", 3) != 0)
+    return 0;
+
+  uint8_t  version = hdr[3];
+  uint32_t tagEnd  = 10 + readSyncsafe(hdr + 6);
+  if (hdr[5] & 0x10)
+    tagEnd += 10; // v2.4 footer.
+  if (version < 2 || version > 4)
+    return tagEnd;
+
+  uint32_t pos = 10;
+  if ((hdr[5] & 0x40) && version >= 3) {
+    uint8_t ext[4];
+    if (f.read(ext, sizeof(ext)) != sizeof(ext))
+      return tagEnd;
+    pos += version == 4 ? readSyncsafe(ext) : readBE32(ext) + 4;
+  }
+
+  size_t  headerLen = version == 2 ? 6 : 10;
+  uint8_t data[TAG_READ_MAX];
+  while (pos + headerLen <= tagEnd && (title.length() == 0 || artist.length() == 0)) {
+    uint8_t fh[10];
+    if (!f.seek(pos) || f.read(fh, headerLen) != headerLen || fh[0] == 0)
+      break;
+
+    uint32_t size;
+    bool     isTitle, isArtist;
+    if (version == 2) {
+      size     = readBE24(fh + 3);
+      isTitle  = memcmp(fh, "TT2", 3) == 0;
+      isArtist = memcmp(fh, "TP1", 3) == 0;
+    } else {
+      size     = version == 4 ? readSyncsafe(fh + 4) : readBE32(fh + 4);
+      isTitle  = memcmp(fh, "TIT2", 4) == 0;
+      isArtist = memcmp(fh, "TPE1", 4) == 0;
+    }
+    pos += headerLen;
+
+    if ((isTitle || isArtist) && size >= 2) {
+      size_t n = size < sizeof(data) ? size : sizeof(data);
+      if (f.read(data, n) != n)
+        break;
+      decodeText(data + 1, n - 1, data[0], isTitle ? title : artist);
+    }
+    pos += size;
+  }
+
+  return tagEnd;
+}
+
+// ----------------------------------------------------------------------------
+// RIFF LIST/INFO
+// ----------------------------------------------------------------------------
+
+static void readInfoList(File& f, uint32_t end, String& title, String& artist)
+{
+  uint8_t data[TAG_READ_MAX];
+  while (f.position() + 8 <= end) {
+    uint8_t sub[8];
+    if (f.read(sub, sizeof(sub)) != sizeof(sub))
+      return;
+
+    uint32_t size     = readLE32(sub + 4);
+    uint32_t next     = f.position() + size + (size & 1);
+    bool     isTitle  = memcmp(sub, "INAM", 4) == 0;
+    bool     isArtist = memcmp(sub, "IART", 4) == 0;
+    if (isTitle || isArtist) {
+      size_t n = size < sizeof(data) ? size : sizeof(data);
+      if (f.read(data, n) != n)
+        return;
+      decodeText(data, n, TAG_UTF8, isTitle ? title : artist);
+    }
+    if (!f.seek(next))
+      return;
+  }
+}
+
+static void readRiff(File& f, String& title, String& artist)
+{
+  uint8_t hdr[12];
+  f.seek(0);
+  if (f.read(hdr, sizeof(hdr)) != sizeof(hdr) || memcmp(hdr + 8, "WAVE", 4) != 0)
+    return;
+
+  for (int i = 0; i < TAG_MAX_CHUNKS; i++) {
+    uint8_t chunk[12];
+    if (f.read(chunk, 8) != 8)
+      return;
+
+    uint32_t size  = readLE32(chunk + 4);
+    uint32_t start = f.position();
+    if (size == 0xFFFFFFFF)
+      return; // RF64 data chunk: the size lives in ds64 and nothing useful follows.
+
+    if (memcmp(chunk, "LIST", 4) == 0 && size >= 4) {
+      if (f.read(chunk + 8, 4) != 4)
+        return;
+      if (memcmp(chunk + 8, "INFO", 4) == 0) {
+        readInfoList(f, start + size, title, artist);
+        return;
+      }
+    }
+
+    uint64_t next = (uint64_t)start + size + (size & 1);
+    if (next >= f.size() || !f.seek((uint32_t)next))
+      return;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// FLAC Vorbis comments
+// ----------------------------------------------------------------------------
+
+static void readVorbisComments(File& f, uint32_t end, String& title, String& artist)
+{
+  uint8_t data[TAG_READ_MAX];
+  if (f.read(data, 4) != 4 || !f.seek(f.position() + readLE32(data)))
+    return; // Vendor string.
+  if (f.read(data, 4) != 4)
+    return;
+
+  uint32_t count = readLE32(data);
+  for (uint32_t i = 0; i < count && f.position() + 4 <= end; i++) {
+    if (f.read(data, 4) != 4)
+      return;
+
+    uint32_t len  = readLE32(data);
+    uint32_t next = f.position() + len;
+    if (len < sizeof(data) && f.read(data, len) == len) {
+      if (len > 6 && strncasecmp((const char*)data, "TITLE=", 6) == 0 && title.length() == 0)
+        decodeText(data + 6, len - 6, TAG_UTF8, title);
+      else if (len > 7 && strncasecmp((const char*)data, "ARTIST=", 7) == 0 &&
+               artist.length() == 0)
+        decodeText(data + 7, len - 7, TAG_UTF8, artist);
+    }
+    if (next > end || !f.seek(next))
+      return;
+  }
+}
+
+static void readFlac(File& f, uint32_t start, String& title, String& artist)
+{
+  uint8_t hdr[4];
+  if (!f.seek(start) || f.read(hdr, 4) != 4 || memcmp(hdr, "fLaC", 4) != 0)
+    return;
+
+  for (;;) {
+    if (f.read(hdr, 4) != 4)
+      return;
+
+    bool     last = (hdr[0] & 0x80) != 0;
+    uint32_t len  = readBE24(hdr + 1);
+    uint32_t next = f.position() + len;
+    if ((hdr[0] & 0x7F) == 4) {
+      readVorbisComments(f, next, title, artist);
+      return;
+    }
+    if (last || !f.seek(next))
+      return;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Public API
+// ----------------------------------------------------------------------------
+
+bool tagsRead(const String& path, String& title, String& artist)
+{
+  title  = "";
+  artist = "";
+
+  File f = SD.open(path);
+  if (!f || f.isDirectory())
+    return false;
+
+  uint8_t magic[4];
+  if (f.read(magic, sizeof(magic)) == sizeof(magic)) {
+    if (memcmp(magic, "RIFF", 4) == 0 || memcmp(magic, "RF64", 4) == 0 ||
+        memcmp(magic, "BW64", 4) == 0) {
+      readRiff(f, title, artist);
+    } else {
+      // FLAC files sometimes carry an ID3v2 tag in front of the stream.
+      uint32_t tagEnd = readId3v2(f, title, artist);
+      if (title.length() == 0 && artist.length() == 0)
+        readFlac(f, tagEnd, title, artist);
+    }
+  }
+
+  f.close();
+  return title.length() > 0 || artist.length() > 0;
+}
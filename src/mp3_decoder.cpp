@@ -0,0 +1,388 @@
+#include "mp3_decoder.h"
+
+#include "AudioFileSourceBuffer.h"
+#include "AudioFileSourceSD.h"
+#include "AudioGeneratorMP3.h"
+#include "AudioOutput.h"
+#include "mp3_index.h"
+#include "sd_bus.h"
+#include "web_log.h"
+
+// Buffer size for MP3 source (prevents SD read stuttering).
+// 8KB buffer provides ~0.5 sec of 128kbps MP3 data.
+static const size_t MP3_BUFFER_SIZE = 8192;
+
+// Sink block: one MPEG-1 Layer III frame of stereo PCM.
+static const size_t MP3_SINK_FRAMES = 1152;
+
+// Approximate MP3 bitrate for duration estimation when indexing fails.
+static const uint32_t MP3_APPROX_BITRATE = 128000;
+
+// File source whose reads go through the SD bus arbiter as audio.
+class Mp3BusSource : public AudioFileSourceSD
+{
+public:
+  explicit Mp3BusSource(const char* path) : AudioFileSourceSD(path) {}
+
+  uint32_t read(void* data, uint32_t len) override
+  {
+    SdBusSlice slice(SD_IO_AUDIO);
+    return (uint32_t)slice.done(AudioFileSourceSD::read(data, len));
+  }
+
+  bool seek(int32_t pos, int dir) override
+  {
+    SdBusSlice slice(SD_IO_AUDIO);
+    return AudioFileSourceSD::seek(pos, dir);
+  }
+};
+
+// Collects decoded stereo frames into a block instead of writing to I2S.
+// Returning false when full makes the generator keep the sample and retry
+// on the next loop(), so nothing is dropped.
+class Mp3PcmSink : public AudioOutput
+{
+public:
+  Mp3PcmSink()
+  {
+    hertz    = 0;
+    channels = 2;
+  }
+
+  bool begin() override
+  {
+    return true;
+  }
+
+  bool stop() override
+  {
+    return true;
+  }
+
+  bool ConsumeSample(int16_t sample[2]) override
+  {
+    if (m_count >= MP3_SINK_FRAMES)
+      return false;
+
+    int16_t* dst = &m_block[m_count * 2];
+    dst[0]       = sample[LEFTCHANNEL];
+    dst[1]       = channels == 1 ? sample[LEFTCHANNEL] : sample[RIGHTCHANNEL];
+    m_count++;
+    return true;
+  }
+
+  // Library builds that hand over whole runs get a single block copy.
+  uint16_t ConsumeSamples(int16_t* samples, uint16_t count) override
+  {
+    size_t room = MP3_SINK_FRAMES - m_count;
+    if (count > room)
+      count = (uint16_t)room;
+
+    memcpy(&m_block[m_count * 2], samples, count * 2 * sizeof(int16_t));
+    m_count += count;
+    return count;
+  }
+
+  int rate() const
+  {
+    return hertz;
+  }
+
+  void clear()
+  {
+    m_count   = 0;
+    m_readPos = 0;
+  }
+
+  bool full() const
+  {
+    return m_count >= MP3_SINK_FRAMES;
+  }
+
+  size_t available() const
+  {
+    return m_count - m_readPos;
+  }
+
+  // Copy up to maxFrames buffered frames to out; returns frames copied.
+  size_t drain(int16_t* out, size_t maxFrames)
+  {
+    size_t n = available();
+    if (n > maxFrames)
+      n = maxFrames;
+
+    memcpy(out, &m_block[m_readPos * 2], n * 2 * sizeof(int16_t));
+    m_readPos += n;
+
+    if (m_readPos == m_count) {
+      m_count   = 0;
+      m_readPos = 0;
+    }
+    return n;
+  }
+
+private:
+  int16_t m_block[MP3_SINK_FRAMES * 2];
+  size_t  m_count   = 0;
+  size_t  m_readPos = 0;
+};
+
+class Mp3Decoder : public IAudioDecoder
+{
+public:
+  ~Mp3Decoder() override
+  {
+    close();
+  }
+
+  const char*            name() const override;
+  bool                   open(const String& path) override;
+  const AudioStreamInfo& info() const override;
+  size_t                 decode(int16_t* out, size_t maxFrames) override;
+  bool                   seek(uint32_t ms) override;
+  uint64_t               positionBytes() const override;
+  uint32_t               positionMs() const override;
+  void                   close() override;
+
+private:
+  bool startChain(uint32_t offset);
+  void stopChain();
+  bool fill();
+
+  String                 m_path;
+  Mp3Index               m_index;
+  AudioFileSourceSD*     m_source = nullptr;
+  AudioFileSourceBuffer* m_buffer = nullptr;
+  AudioGeneratorMP3*     m_gen    = nullptr;
+  Mp3PcmSink*            m_sink   = nullptr;
+  AudioStreamInfo        m_info;
+  uint64_t               m_framesOut = 0;
+  bool                   m_ended     = false;
+  uint32_t               m_walkSeen  = 0; // mp3IndexWalkCount() at the last upgrade try.
+};
+
+const char* Mp3Decoder::name() const
+{
+  return "MP3";
+}
+
+const AudioStreamInfo& Mp3Decoder::info() const
+{
+  return m_info;
+}
+
+bool Mp3Decoder::open(const String& path)
+{
+  m_path = path;
+
+  // Parameters and seek table from the first frame (or the cached walk);
+  // playback still works without it.
+  if (!mp3IndexLoad(path, m_index)) {
+    WebLog.println("[MP3] ⚠️ No frame index, duration is estimated and seek is disabled");
+  }
+
+  // Estimated tables (notably headerless VBR) get the exact walk right away
+  // so duration and progress are corrected without waiting for a seek.
+  if (m_index.valid && !m_index.exact) {
+    m_walkSeen = mp3IndexWalkCount();
+    mp3IndexRequestWalk(path);
+  }
+
+  if (!startChain(m_index.valid ? m_index.dataStart : 0))
+    return false;
+
+  // Decode the first frame so the stream rate is confirmed before the
+  // engine configures the resampler and EQ.
+  if (!fill() || m_sink->rate() <= 0) {
+    WebLog.println("[MP3] ❌ No decodable frames");
+    return false;
+  }
+
+  uint32_t fileSize = m_source->getSize();
+
+  m_info.sampleRate    = (uint32_t)m_sink->rate();
+  m_info.channels      = 2;
+  m_info.bitsPerSample = 16;
+  m_info.totalBytes    = fileSize;
+  m_info.totalMs       = m_index.valid
+                             ? m_index.durationMs
+                             : (uint32_t)((uint64_t)fileSize * 8 * 1000 / MP3_APPROX_BITRATE);
+  return true;
+}
+
+// Open source, buffer, sink and generator with the file positioned at offset.
+// Callers pass a frame start: an exact index entry, or an estimated one
+// (Xing TOC entries are percentages of the file, not frame boundaries)
+// moved to the next confirmed frame by mp3IndexResync().
+bool Mp3Decoder::startChain(uint32_t offset)
+{
+  m_source = new Mp3BusSource(m_path.c_str());
+  if (!m_source || !m_source->isOpen()) {
+    WebLog.println("[MP3] ❌ Cannot open file");
+    return false;
+  }
+
+  if (offset > 0 && !m_source->seek(offset, SEEK_SET)) {
+    WebLog.println("[MP3] ❌ Seek failed");
+    return false;
+  }
+
+  // Wrap source with buffer for smoother playback.
+  m_buffer = new AudioFileSourceBuffer(m_source, MP3_BUFFER_SIZE);
+  if (!m_sink)
+    m_sink = new Mp3PcmSink();
+  m_gen = new AudioGeneratorMP3();
+  if (!m_buffer || !m_sink || !m_gen) {
+    WebLog.println("[MP3] ❌ Out of memory");
+    return false;
+  }
+
+  m_sink->clear();
+  m_ended = false;
+
+  if (!m_gen->begin(m_buffer, m_sink)) {
+    WebLog.println("[MP3] ❌ Failed to start decoder");
+    return false;
+  }
+
+  return true;
+}
+
+// Run the generator until the sink holds a full block or the stream ends.
+// Only called once the previous block has been drained. A failed restart
+// leaves no generator; that ends the stream.
+bool Mp3Decoder::fill()
+{
+  while (!m_ended && !m_sink->full()) {
+    if (!m_gen || !m_gen->isRunning() || !m_gen->loop()) {
+      m_ended = true;
+    }
+  }
+  return m_sink->available() > 0;
+}
+
+size_t Mp3Decoder::decode(int16_t* out, size_t maxFrames)
+{
+  size_t produced = 0;
+  if (!m_sink)
+    return 0;
+
+  // Swap in the exact table once a walk has finished (checked once per walk).
+  if (m_index.valid && !m_index.exact && mp3IndexWalkCount() != m_walkSeen) {
+    m_walkSeen = mp3IndexWalkCount();
+    if (mp3IndexUpgrade(m_path, m_index))
+      m_info.totalMs = m_index.durationMs;
+  }
+
+  while (produced < maxFrames) {
+    if (m_sink->available() == 0 && !fill())
+      break;
+    produced += m_sink->drain(out + produced * 2, maxFrames - produced);
+  }
+
+  m_framesOut += produced;
+  return produced;
+}
+
+// Restart the chain at the indexed frame: the generator keeps internal
+// bit-reservoir state, so a fresh instance is the only clean resync. Until
+// the walk requested at open has cached the exact table, the estimated
+// offset is resynced to a frame (a walk replaced by another file's request is
+// asked for again here). If the chain cannot be restarted at the target,
+// playback resumes at the frame it was on.
+bool Mp3Decoder::seek(uint32_t ms)
+{
+  if (!m_index.valid)
+    return false;
+
+  if (!m_index.exact) {
+    if (mp3IndexUpgrade(m_path, m_index))
+      m_info.totalMs = m_index.durationMs;
+    else
+      mp3IndexRequestWalk(m_path);
+  }
+
+  uint32_t entryMs = 0;
+  uint32_t offset  = mp3IndexResync(m_path, m_index, mp3IndexSeekOffset(m_index, ms, &entryMs));
+
+  uint32_t resumeMs = positionMs();
+
+  stopChain();
+  if (!startChain(offset)) {
+    stopChain();
+    uint32_t resume =
+        mp3IndexResync(m_path, m_index, mp3IndexSeekOffset(m_index, resumeMs, &entryMs));
+    if (startChain(resume)) {
+      m_framesOut = (uint64_t)entryMs * m_info.sampleRate / 1000;
+    } else {
+      WebLog.println("[MP3] ❌ Cannot resume after failed seek, stopping");
+      stopChain();
+      m_ended = true;
+    }
+    return false;
+  }
+
+  m_framesOut = (uint64_t)entryMs * m_info.sampleRate / 1000;
+  return true;
+}
+
+uint64_t Mp3Decoder::positionBytes() const
+{
+  return m_source ? m_source->getPos() : 0;
+}
+
+uint32_t Mp3Decoder::positionMs() const
+{
+  if (m_info.sampleRate == 0)
+    return 0;
+  return (uint32_t)(m_framesOut * 1000 / m_info.sampleRate);
+}
+
+void Mp3Decoder::close()
+{
+  stopChain();
+  if (m_sink) {
+    delete m_sink;
+    m_sink = nullptr;
+  }
+  mp3IndexFree(m_index);
+}
+
+void Mp3Decoder::stopChain()
+{
+  // Generator first, then the buffer and finally the source it wraps.
+  if (m_gen) {
+    if (m_gen->isRunning())
+      m_gen->stop();
+    delete m_gen;
+    m_gen = nullptr;
+  }
+  if (m_buffer) {
+    delete m_buffer;
+    m_buffer = nullptr;
+  }
+  if (m_source) {
+    delete m_source;
+    m_source = nullptr;
+  }
+}
+
+// A leading ID3v2 tag, or an MPEG audio frame sync with a valid layer
+// (layer 0 is ADTS/AAC, which shares the sync pattern).
+static bool mp3Probe(const uint8_t* head, size_t len)
+{
+  if (len >= 3 && memcmp(head, "ID3", 3) == 0)
+    return true;
+  return len >= 2 && head[0] == 0xFF && (head[1] & 0xE0) == 0xE0 && (head[1] & 0x06) != 0;
+}
+
+static IAudioDecoder* mp3Create()
+{
+  return new Mp3Decoder();
+}
+
+const AudioDecoderEntry& mp3DecoderEntry()
+{
+  static const AudioDecoderEntry entry = {"MP3", ".mp3", mp3Probe, mp3Create, true};
+  return entry;
+}
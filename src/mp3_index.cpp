@@ -0,0 +1,770 @@
+#include "mp3_index.h"
+
+#include "sd_bus.h"
+#include "web_log.h"
+
+#include <SD.h>
+#include <atomic>
+
+static const uint8_t  INDEX_MAGIC[4] = {'M', 'P', '3', 'X'};
+static const uint8_t  INDEX_VERSION  = 2;
+static const size_t   INDEX_HEADER   = 40;
+static const uint32_t BASE_INTERVAL  = 1000; // One entry per second.
+static const size_t   SCAN_BUF_SIZE  = 4096;
+static const uint32_t RESYNC_WINDOW  = 16384; // Searched for a frame after an estimated offset.
+static const uint32_t WALK_STACK     = 4096;
+
+// Bitrates in kbps: [MPEG1 L1, L2, L3, MPEG2/2.5 L1, L2/L3][index].
+static const uint16_t BITRATES[5][15] = {
+    {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+    {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+    {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+    {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+    {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+};
+
+// Sample rates by version bits (0 = MPEG2.5, 2 = MPEG2, 3 = MPEG1).
+static const uint32_t SAMPLE_RATES[4][3] = {
+    {11025, 12000, 8000},
+    {0, 0, 0},
+    {22050, 24000, 16000},
+    {44100, 48000, 32000},
+};
+
+struct FrameHeader {
+  uint8_t  version; // Raw version bits.
+  uint8_t  layer;   // 1..3.
+  uint32_t sampleRate;
+  uint8_t  channels;
+  uint16_t samples;
+  uint32_t bitrate;
+  uint32_t length;
+  uint8_t  sideInfo; // Bytes between header and Xing tag.
+};
+
+// Frame walks run on a core 0 task, one file at a time.
+static SemaphoreHandle_t g_walkLock = nullptr;
+static TaskHandle_t      g_walkTask = nullptr;
+static String            g_walkPath; // Requested and not started yet.
+
+static std::atomic<uint32_t> g_walksDone(0);
+
+static uint32_t readBE32(const uint8_t* p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint16_t readBE16(const uint8_t* p)
+{
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static void writeLE32(uint8_t* p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t readLE32(const uint8_t* p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool parseFrameHeader(const uint8_t* p, FrameHeader& h)
+{
+  if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0)
+    return false;
+
+  uint8_t version = (p[1] >> 3) & 3;
+  uint8_t layerId = (p[1] >> 1) & 3;
+  uint8_t brIndex = (p[2] >> 4) & 15;
+  uint8_t srIndex = (p[2] >> 2) & 3;
+  uint8_t padding = (p[2] >> 1) & 1;
+
+  if (version == 1 || layerId == 0 || brIndex == 0 || brIndex == 15 || srIndex == 3)
+    return false;
+
+  bool mpeg1 = version == 3;
+  h.version  = version;
+  h.layer    = 4 - layerId;
+
+  int      table = mpeg1 ? h.layer - 1 : (h.layer == 1 ? 3 : 4);
+  uint32_t bitrate = (uint32_t)BITRATES[table][brIndex] * 1000;
+  h.bitrate        = bitrate;
+
+  h.sampleRate = SAMPLE_RATES[version][srIndex];
+  h.channels   = ((p[3] >> 6) == 3) ? 1 : 2;
+
+  if (h.layer == 1) {
+    h.samples = 384;
+    h.length  = (12 * bitrate / h.sampleRate + padding) * 4;
+  } else if (h.layer == 2 || mpeg1) {
+    h.samples = 1152;
+    h.length  = 144 * bitrate / h.sampleRate + padding;
+  } else {
+    h.samples = 576;
+    h.length  = 72 * bitrate / h.sampleRate + padding;
+  }
+
+  if (mpeg1)
+    h.sideInfo = h.channels == 1 ? 17 : 32;
+  else
+    h.sideInfo = h.channels == 1 ? 9 : 17;
+
+  return h.length >= 4;
+}
+
+// Skip an ID3v2 tag at the start of the file; returns the first byte after it.
+static uint32_t skipId3v2(File& f)
+{
+  uint8_t hdr[10];
+  f.seek(0);
+  if (f.read(hdr, 10) != 10 || memcmp(hdr, "ID3", 3) != 0)
+    return 0;
+
+  uint32_t size = ((uint32_t)(hdr[6] & 0x7F) << 21) | ((uint32_t)(hdr[7] & 0x7F) << 14) |
+                  ((uint32_t)(hdr[8] & 0x7F) << 7) | (uint32_t)(hdr[9] & 0x7F);
+  uint32_t end = 10 + size;
+  if (hdr[5] & 0x10)
+    end += 10; // Footer present.
+  return end;
+}
+
+// Find the first valid frame at or after pos (checks the following frame
+// too, so stray sync bytes in tag padding are not mistaken for audio).
+static bool findFirstFrame(File& f, uint32_t pos, uint32_t end, uint32_t& framePos,
+                           FrameHeader& h)
+{
+  uint8_t buf[512];
+
+  while (pos + 4 <= end) {
+    f.seek(pos);
+    size_t got = f.read(buf, sizeof(buf));
+    if (got < 4)
+      return false;
+
+    for (size_t i = 0; i + 4 <= got; i++) {
+      if (!parseFrameHeader(buf + i, h))
+        continue;
+
+      uint8_t     next[4];
+      FrameHeader nh;
+      f.seek(pos + i + h.length);
+      if (f.read(next, 4) == 4 && parseFrameHeader(next, nh) && nh.sampleRate == h.sampleRate) {
+        framePos = pos + i;
+        return true;
+      }
+    }
+
+    pos += got - 3;
+  }
+
+  return false;
+}
+
+static void setEntryCount(Mp3Index& idx, uint32_t durationMs)
+{
+  idx.intervalMs = BASE_INTERVAL;
+  while (durationMs / idx.intervalMs + 1 > MP3_INDEX_MAX_ENTRIES) {
+    idx.intervalMs *= 2;
+  }
+  idx.entryCount = (uint16_t)(durationMs / idx.intervalMs + 1);
+}
+
+// Tables are built in a full-size buffer, then trimmed to what was used.
+static bool allocEntries(Mp3Index& idx)
+{
+  idx.offsets = (uint32_t*)malloc(MP3_INDEX_MAX_ENTRIES * sizeof(uint32_t));
+  return idx.offsets != nullptr;
+}
+
+static void shrinkEntries(Mp3Index& idx)
+{
+  if (idx.entryCount == 0)
+    return;
+  uint32_t* p = (uint32_t*)realloc(idx.offsets, idx.entryCount * sizeof(uint32_t));
+  if (p)
+    idx.offsets = p;
+}
+
+// Xing/Info tag in the first frame. Fills the table from its TOC, or linearly
+// for CBR "Info" files without one.
+static bool buildFromXing(File& f, uint32_t framePos, const FrameHeader& h, Mp3Index& idx)
+{
+  uint8_t tag[120];
+  f.seek(framePos + 4 + h.sideInfo);
+  if (f.read(tag, sizeof(tag)) != sizeof(tag))
+    return false;
+
+  if (memcmp(tag, "Xing", 4) != 0 && memcmp(tag, "Info", 4) != 0)
+    return false;
+
+  uint32_t       flags  = readBE32(tag + 4);
+  const uint8_t* p      = tag + 8;
+  uint32_t       frames = 0;
+  uint32_t       bytes  = 0;
+  const uint8_t* toc    = nullptr;
+
+  if (flags & 1) {
+    frames = readBE32(p);
+    p += 4;
+  }
+  if (flags & 2) {
+    bytes = readBE32(p);
+    p += 4;
+  }
+  if (flags & 4)
+    toc = p;
+
+  if (frames == 0)
+    return false;
+  if (bytes == 0)
+    bytes = idx.dataEnd - framePos;
+
+  idx.frameCount = frames;
+  idx.dataStart  = framePos + h.length; // The tag frame carries no audio.
+  idx.durationMs = (uint32_t)((uint64_t)frames * h.samples * 1000 / h.sampleRate);
+  setEntryCount(idx, idx.durationMs);
+
+  for (uint16_t i = 0; i < idx.entryCount; i++) {
+    uint32_t ms = (uint32_t)i * idx.intervalMs;
+    uint32_t off;
+
+    if (toc) {
+      float    pct = idx.durationMs ? 100.0f * ms / idx.durationMs : 0.0f;
+      int      a   = (int)pct;
+      float    fa  = a < 100 ? toc[a] : 256.0f;
+      float    fb  = a < 99 ? toc[a + 1] : 256.0f;
+      float    rel = fa + (fb - fa) * (pct - a);
+      uint64_t pos = (uint64_t)(rel / 256.0f * bytes);
+      off          = framePos + (uint32_t)pos;
+    } else {
+      uint64_t frame = (uint64_t)ms * h.sampleRate / 1000 / h.samples;
+      off            = idx.dataStart + (uint32_t)(frame * (bytes - h.length) / frames);
+    }
+
+    idx.offsets[i] = off < idx.dataStart ? idx.dataStart : off;
+  }
+
+  return true;
+}
+
+// VBRI tag (Fraunhofer encoders) at a fixed offset in the first frame.
+static bool buildFromVbri(File& f, uint32_t framePos, const FrameHeader& h, Mp3Index& idx)
+{
+  uint8_t hdr[26];
+  f.seek(framePos + 4 + 32);
+  if (f.read(hdr, sizeof(hdr)) != sizeof(hdr) || memcmp(hdr, "VBRI", 4) != 0)
+    return false;
+
+  uint32_t frames         = readBE32(hdr + 14);
+  uint16_t tocEntries     = readBE16(hdr + 18);
+  uint16_t scale          = readBE16(hdr + 20);
+  uint16_t entrySize      = readBE16(hdr + 22);
+  uint16_t framesPerEntry = readBE16(hdr + 24);
+
+  if (frames == 0 || entrySize == 0 || entrySize > 4 || framesPerEntry == 0)
+    return false;
+
+  idx.frameCount = frames;
+  idx.dataStart  = framePos + h.length;
+  idx.durationMs = (uint32_t)((uint64_t)frames * h.samples * 1000 / h.sampleRate);
+  setEntryCount(idx, idx.durationMs);
+
+  // Walk the TOC segments, emitting an entry at each time step crossed.
+  uint64_t segStartSamples = 0;
+  uint32_t segStartOffset  = idx.dataStart;
+  uint16_t next            = 0;
+  uint64_t segSamples      = (uint64_t)framesPerEntry * h.samples;
+
+  for (uint16_t s = 0; s <= tocEntries && next < idx.entryCount; s++) {
+    uint32_t segBytes = 0;
+    if (s < tocEntries) {
+      uint8_t e[4];
+      if (f.read(e, entrySize) != entrySize)
+        break;
+      for (uint16_t b = 0; b < entrySize; b++) {
+        segBytes = (segBytes << 8) | e[b];
+      }
+      segBytes *= scale;
+    }
+
+    uint64_t segEndSamples = segStartSamples + segSamples;
+    while (next < idx.entryCount) {
+      uint64_t target = (uint64_t)next * idx.intervalMs * h.sampleRate / 1000;
+      if (s < tocEntries && target >= segEndSamples)
+        break;
+      uint64_t into     = target > segStartSamples ? target - segStartSamples : 0;
+      uint32_t off      = segStartOffset + (uint32_t)(into * segBytes / segSamples);
+      idx.offsets[next] = off;
+      next++;
+    }
+
+    segStartSamples = segEndSamples;
+    segStartOffset += segBytes;
+  }
+
+  idx.entryCount = next;
+  return next > 0;
+}
+
+// No seek header: assume the first frame's bitrate throughout. Like TOC
+// entries, the offsets are estimates, not frame starts.
+static bool buildFromBitrate(uint32_t framePos, const FrameHeader& h, Mp3Index& idx)
+{
+  uint32_t bytes = idx.dataEnd > framePos ? idx.dataEnd - framePos : 0;
+  idx.frameCount = bytes / h.length;
+  idx.dataStart  = framePos;
+  idx.durationMs = (uint32_t)((uint64_t)idx.frameCount * h.samples * 1000 / h.sampleRate);
+  setEntryCount(idx, idx.durationMs);
+
+  for (uint16_t i = 0; i < idx.entryCount; i++) {
+    uint64_t pos   = (uint64_t)i * idx.intervalMs * h.bitrate / 8000;
+    idx.offsets[i] = framePos + (uint32_t)pos;
+  }
+  return idx.frameCount > 0;
+}
+
+// Make [pos, pos + len) of the file available in buf. Reads are background
+// slices of the bus.
+static bool scanWindow(File& f, uint8_t* buf, uint32_t& bufStart, size_t& bufLen, uint32_t pos,
+                       uint32_t len)
+{
+  if (pos >= bufStart && pos + len <= bufStart + bufLen)
+    return true;
+
+  SdBusSlice slice(SD_IO_BACKGROUND);
+  f.seek(pos);
+  bufStart = pos;
+  bufLen   = slice.done(f.read(buf, SCAN_BUF_SIZE));
+  return pos + len <= bufStart + bufLen;
+}
+
+// Walk every frame header. Reads sequentially through a block buffer, so
+// the cost is one pass over the file at SD read speed. A header is taken
+// only if another one follows it at pos + length (or the audio ends there),
+// so sync bytes inside frame data are not mistaken for frames.
+static bool buildByWalking(File& f, uint32_t framePos, Mp3Index& idx)
+{
+  uint8_t* buf = (uint8_t*)malloc(SCAN_BUF_SIZE);
+  if (!buf)
+    return false;
+
+  idx.intervalMs = BASE_INTERVAL;
+  idx.entryCount = 0;
+
+  uint32_t pos          = framePos;
+  uint32_t bufStart     = 0;
+  size_t   bufLen       = 0;
+  uint64_t samples      = 0;
+  uint64_t nextEntry    = 0; // Sample position of the next table entry.
+  uint64_t entryStep    = (uint64_t)idx.sampleRate * idx.intervalMs / 1000;
+  uint32_t frames       = 0;
+  uint32_t lostSyncRuns = 0;
+
+  while (pos + 4 <= idx.dataEnd) {
+    if (!scanWindow(f, buf, bufStart, bufLen, pos, 4))
+      break;
+
+    FrameHeader    h;
+    FrameHeader    nh;
+    const uint8_t* p      = buf + (pos - bufStart);
+    bool           synced = parseFrameHeader(p, h) && h.sampleRate == idx.sampleRate;
+    uint32_t       next   = synced ? pos + h.length : pos + 1;
+    if (synced && next + 4 <= idx.dataEnd) {
+      synced = scanWindow(f, buf, bufStart, bufLen, pos, h.length + 4) &&
+               parseFrameHeader(buf + (next - bufStart), nh) && nh.sampleRate == idx.sampleRate;
+    }
+    if (!synced) {
+      pos++; // Lost sync: scan forward byte by byte.
+      lostSyncRuns++;
+      continue;
+    }
+
+    if (samples >= nextEntry) {
+      if (idx.entryCount == MP3_INDEX_MAX_ENTRIES) {
+        // Table full: keep every other entry and double the step.
+        for (uint16_t i = 0; i < MP3_INDEX_MAX_ENTRIES / 2; i++) {
+          idx.offsets[i] = idx.offsets[i * 2];
+        }
+        idx.entryCount = MP3_INDEX_MAX_ENTRIES / 2;
+        idx.intervalMs *= 2;
+        entryStep *= 2;
+        nextEntry = (uint64_t)idx.entryCount * entryStep;
+      }
+      if (samples >= nextEntry) {
+        idx.offsets[idx.entryCount++] = pos;
+        nextEntry += entryStep;
+      }
+    }
+
+    samples += h.samples;
+    frames++;
+    pos = next;
+  }
+
+  free(buf);
+
+  if (lostSyncRuns > 0) {
+    WebLog.print("[MP3IDX] ⚠️ Skipped ");
+    WebLog.print(lostSyncRuns);
+    WebLog.println(" bytes of non-audio data");
+  }
+
+  idx.frameCount = frames;
+  idx.dataStart  = framePos;
+  idx.durationMs = (uint32_t)(samples * 1000 / idx.sampleRate);
+  return frames > 0;
+}
+
+String mp3IndexPath(const String& path)
+{
+  int    slash = path.lastIndexOf('/');
+  String dir   = slash >= 0 ? path.substring(0, slash + 1) : "/";
+  String name  = slash >= 0 ? path.substring(slash + 1) : path;
+  return dir + "." + name + ".idx";
+}
+
+// Cache layout (little-endian): 40-byte header, then entryCount offsets as
+// LEB128 varint deltas from the previous entry.
+static bool loadCache(const String& path, uint32_t fileSize, uint32_t mtime, Mp3Index& idx)
+{
+  File f = SD.open(mp3IndexPath(path), FILE_READ);
+  if (!f)
+    return false;
+
+  uint8_t hdr[INDEX_HEADER];
+  bool    ok = f.read(hdr, INDEX_HEADER) == INDEX_HEADER && memcmp(hdr, INDEX_MAGIC, 4) == 0 &&
+            hdr[4] == INDEX_VERSION && readLE32(hdr + 8) == fileSize && readLE32(hdr + 12) == mtime;
+
+  if (ok) {
+    idx.channels        = hdr[5];
+    idx.samplesPerFrame = (uint16_t)(hdr[6] | (hdr[7] << 8));
+    idx.sampleRate      = readLE32(hdr + 16);
+    idx.frameCount      = readLE32(hdr + 20);
+    idx.dataStart       = readLE32(hdr + 24);
+    idx.dataEnd         = readLE32(hdr + 28);
+    idx.intervalMs      = readLE32(hdr + 32);
+    idx.entryCount      = (uint16_t)(hdr[36] | (hdr[37] << 8));
+    idx.exact           = hdr[38] != 0;
+    ok = idx.sampleRate > 0 && idx.intervalMs > 0 && idx.entryCount <= MP3_INDEX_MAX_ENTRIES;
+  }
+
+  uint32_t prev = 0;
+  for (uint16_t i = 0; ok && i < idx.entryCount; i++) {
+    uint32_t delta = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      int c = f.read();
+      if (c < 0) {
+        ok = false;
+        break;
+      }
+      delta |= (uint32_t)(c & 0x7F) << shift;
+      if (!(c & 0x80))
+        break;
+    }
+    prev += delta;
+    idx.offsets[i] = prev;
+  }
+
+  f.close();
+
+  if (ok) {
+    idx.durationMs =
+        (uint32_t)((uint64_t)idx.frameCount * idx.samplesPerFrame * 1000 / idx.sampleRate);
+  }
+  return ok;
+}
+
+// Written aside and renamed, so a reader never sees half a table.
+static void saveCache(const String& path, uint32_t fileSize, uint32_t mtime, const Mp3Index& idx)
+{
+  String idxPath = mp3IndexPath(path);
+  String tmpPath = idxPath + ".tmp";
+  File   f       = SD.open(tmpPath, FILE_WRITE);
+  if (!f) {
+    WebLog.print("[MP3IDX] ⚠️ Cannot write ");
+    WebLog.println(idxPath);
+    return;
+  }
+
+  uint8_t hdr[INDEX_HEADER] = {0};
+  memcpy(hdr, INDEX_MAGIC, 4);
+  hdr[4] = INDEX_VERSION;
+  hdr[5] = idx.channels;
+  hdr[6] = (uint8_t)idx.samplesPerFrame;
+  hdr[7] = (uint8_t)(idx.samplesPerFrame >> 8);
+  writeLE32(hdr + 8, fileSize);
+  writeLE32(hdr + 12, mtime);
+  writeLE32(hdr + 16, idx.sampleRate);
+  writeLE32(hdr + 20, idx.frameCount);
+  writeLE32(hdr + 24, idx.dataStart);
+  writeLE32(hdr + 28, idx.dataEnd);
+  writeLE32(hdr + 32, idx.intervalMs);
+  hdr[36] = (uint8_t)idx.entryCount;
+  hdr[37] = (uint8_t)(idx.entryCount >> 8);
+  hdr[38] = idx.exact ? 1 : 0;
+  f.write(hdr, INDEX_HEADER);
+
+  uint8_t  out[256];
+  size_t   n    = 0;
+  uint32_t prev = 0;
+  for (uint16_t i = 0; i < idx.entryCount; i++) {
+    uint32_t delta = idx.offsets[i] - prev;
+    prev           = idx.offsets[i];
+    do {
+      uint8_t c = delta & 0x7F;
+      delta >>= 7;
+      out[n++] = delta ? (c | 0x80) : c;
+    } while (delta);
+
+    if (n > sizeof(out) - 5) {
+      f.write(out, n);
+      n = 0;
+    }
+  }
+  if (n > 0)
+    f.write(out, n);
+
+  f.close();
+  SD.remove(idxPath);
+  if (!SD.rename(tmpPath, idxPath))
+    SD.remove(tmpPath);
+}
+
+// Audio bounds and the first frame of an open file.
+static bool locateAudio(File& f, uint32_t fileSize, Mp3Index& idx, uint32_t& framePos,
+                        FrameHeader& h)
+{
+  // Audio ends before a trailing ID3v1 tag.
+  idx.dataEnd = fileSize;
+  if (fileSize > 128) {
+    uint8_t tag[3];
+    f.seek(fileSize - 128);
+    if (f.read(tag, 3) == 3 && memcmp(tag, "TAG", 3) == 0)
+      idx.dataEnd = fileSize - 128;
+  }
+
+  if (!findFirstFrame(f, skipId3v2(f), idx.dataEnd, framePos, h)) {
+    WebLog.println("[MP3IDX] ❌ No MPEG audio frames found");
+    return false;
+  }
+
+  idx.sampleRate      = h.sampleRate;
+  idx.channels        = h.channels;
+  idx.samplesPerFrame = h.samples;
+  return true;
+}
+
+bool mp3IndexLoad(const String& path, Mp3Index& idx)
+{
+  mp3IndexFree(idx);
+
+  File f = SD.open(path, FILE_READ);
+  if (!f)
+    return false;
+
+  uint32_t fileSize = f.size();
+  uint32_t mtime    = (uint32_t)f.getLastWrite();
+
+  if (!allocEntries(idx)) {
+    f.close();
+    return false;
+  }
+
+  if (loadCache(path, fileSize, mtime, idx)) {
+    f.close();
+    shrinkEntries(idx);
+    idx.valid = true;
+    return true;
+  }
+
+  uint32_t    framePos = 0;
+  FrameHeader h;
+  if (!locateAudio(f, fileSize, idx, framePos, h)) {
+    f.close();
+    mp3IndexFree(idx);
+    return false;
+  }
+
+  const char* method = "Xing";
+  bool        built  = buildFromXing(f, framePos, h, idx);
+  if (!built) {
+    method = "VBRI";
+    built  = buildFromVbri(f, framePos, h, idx);
+  }
+  if (!built) {
+    method = "bitrate estimate";
+    built  = buildFromBitrate(framePos, h, idx);
+  }
+
+  f.close();
+
+  if (!built) {
+    mp3IndexFree(idx);
+    return false;
+  }
+
+  shrinkEntries(idx);
+  idx.valid = true;
+
+  WebLog.print("[MP3IDX] Seek table from ");
+  WebLog.print(method);
+  WebLog.print(": ");
+  WebLog.print(idx.durationMs / 1000);
+  WebLog.print(" sec, ");
+  WebLog.print(idx.sampleRate);
+  WebLog.print(" Hz, ");
+  WebLog.print(idx.entryCount);
+  WebLog.println(" entries");
+  return true;
+}
+
+// Build the exact table of one file and cache it (walk task).
+static void walkAndCache(const String& path)
+{
+  uint32_t startMs = millis();
+  Mp3Index idx;
+  File     f = SD.open(path, FILE_READ);
+  if (!f)
+    return;
+
+  uint32_t fileSize = f.size();
+  uint32_t mtime    = (uint32_t)f.getLastWrite();
+  bool     cached   = allocEntries(idx) && loadCache(path, fileSize, mtime, idx) && idx.exact;
+
+  uint32_t    framePos = 0;
+  FrameHeader h;
+  bool        built = !cached && idx.offsets && locateAudio(f, fileSize, idx, framePos, h) &&
+               buildByWalking(f, framePos, idx);
+  f.close();
+
+  if (built) {
+    idx.exact = true;
+    saveCache(path, fileSize, mtime, idx);
+
+    WebLog.print("[MP3IDX] ✅ Indexed via frame walk: ");
+    WebLog.print(idx.durationMs / 1000);
+    WebLog.print(" sec, ");
+    WebLog.print(idx.frameCount);
+    WebLog.print(" frames, ");
+    WebLog.print(idx.entryCount);
+    WebLog.print(" entries, ");
+    WebLog.print(millis() - startMs);
+    WebLog.println(" ms");
+  }
+  mp3IndexFree(idx);
+}
+
+static void walkTask(void* param)
+{
+  (void)param;
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    xSemaphoreTake(g_walkLock, portMAX_DELAY);
+    String path = g_walkPath;
+    g_walkPath  = "";
+    xSemaphoreGive(g_walkLock);
+
+    if (path.length() > 0) {
+      walkAndCache(path);
+      g_walksDone.fetch_add(1);
+    }
+  }
+}
+
+void mp3IndexRequestWalk(const String& path)
+{
+  if (!g_walkTask) {
+    g_walkLock = xSemaphoreCreateMutex();
+    if (!g_walkLock ||
+        xTaskCreatePinnedToCore(walkTask, "mp3idx", WALK_STACK, nullptr, 1, &g_walkTask, 0) !=
+            pdPASS) {
+      WebLog.println("[MP3IDX] ❌ Cannot start walk task");
+      g_walkTask = nullptr;
+      return;
+    }
+  }
+
+  xSemaphoreTake(g_walkLock, portMAX_DELAY);
+  g_walkPath = path;
+  xSemaphoreGive(g_walkLock);
+  xTaskNotifyGive(g_walkTask);
+}
+
+uint32_t mp3IndexWalkCount()
+{
+  return g_walksDone.load();
+}
+
+bool mp3IndexUpgrade(const String& path, Mp3Index& idx)
+{
+  if (idx.exact)
+    return true;
+
+  File f = SD.open(path, FILE_READ);
+  if (!f)
+    return false;
+  uint32_t fileSize = f.size();
+  uint32_t mtime    = (uint32_t)f.getLastWrite();
+  f.close();
+
+  Mp3Index fresh;
+  if (!allocEntries(fresh) || !loadCache(path, fileSize, mtime, fresh) || !fresh.exact) {
+    mp3IndexFree(fresh);
+    return false;
+  }
+
+  shrinkEntries(fresh);
+  fresh.valid = true;
+  mp3IndexFree(idx);
+  idx = fresh;
+  return true;
+}
+
+uint32_t mp3IndexResync(const String& path, const Mp3Index& idx, uint32_t offset)
+{
+  if (!idx.valid || idx.exact)
+    return offset;
+
+  File f = SD.open(path, FILE_READ);
+  if (!f)
+    return offset;
+
+  uint32_t end = offset + RESYNC_WINDOW < idx.dataEnd ? offset + RESYNC_WINDOW : idx.dataEnd;
+
+  SdBusSlice  slice(SD_IO_AUDIO);
+  uint32_t    framePos = offset;
+  FrameHeader h;
+  bool        found = findFirstFrame(f, offset, end, framePos, h);
+  f.close();
+  return found ? framePos : offset;
+}
+
+void mp3IndexFree(Mp3Index& idx)
+{
+  if (idx.offsets)
+    free(idx.offsets);
+  idx = Mp3Index();
+}
+
+uint32_t mp3IndexSeekOffset(const Mp3Index& idx, uint32_t ms, uint32_t* entryMs)
+{
+  if (!idx.valid || idx.entryCount == 0) {
+    if (entryMs)
+      *entryMs = 0;
+    return idx.dataStart;
+  }
+
+  uint32_t i = ms / idx.intervalMs;
+  if (i >= idx.entryCount)
+    i = idx.entryCount - 1;
+
+  if (entryMs)
+    *entryMs = i * idx.intervalMs;
+  return idx.offsets[i];
+}
@@ -0,0 +1,93 @@
+#include "pcm_convert.h"
+
+static int16_t s_alaw[256];
+static int16_t s_mulaw[256];
+static bool    s_tablesReady = false;
+
+// G.711 expansion tables, built once on first use.
+static void buildTables()
+{
+  if (s_tablesReady)
+    return;
+
+  for (int i = 0; i < 256; i++) {
+    uint8_t a   = (uint8_t)i ^ 0x55;
+    int     seg = (a >> 4) & 7;
+    int     t   = (a & 0x0F) << 4;
+    t += seg == 0 ? 8 : 0x108;
+    if (seg > 1)
+      t <<= seg - 1;
+    s_alaw[i] = (int16_t)((a & 0x80) ? t : -t);
+
+    uint8_t u  = (uint8_t)~i;
+    int     m  = (((u & 0x0F) << 3) + 0x84) << ((u >> 4) & 7);
+    s_mulaw[i] = (int16_t)((u & 0x80) ? 0x84 - m : m - 0x84);
+  }
+
+  s_tablesReady = true;
+}
+
+void pcmConvertU8(const uint8_t* src, int16_t* dst, size_t samples)
+{
+  for (size_t i = 0; i < samples; i++) {
+    dst[i] = (int16_t)(((int)src[i] - 128) << 8);
+  }
+}
+
+void pcmConvertALaw(const uint8_t* src, int16_t* dst, size_t samples)
+{
+  buildTables();
+  for (size_t i = 0; i < samples; i++) {
+    dst[i] = s_alaw[src[i]];
+  }
+}
+
+void pcmConvertMuLaw(const uint8_t* src, int16_t* dst, size_t samples)
+{
+  buildTables();
+  for (size_t i = 0; i < samples; i++) {
+    dst[i] = s_mulaw[src[i]];
+  }
+}
+
+// Packed 24-bit: four samples per three 32-bit words, keeping the top two
+// bytes of each sample.
+void pcmConvertS24(const uint8_t* src, int16_t* dst, size_t samples)
+{
+  size_t i = 0;
+  for (; i + 4 <= samples; i += 4, src += 12) {
+    uint32_t w[3];
+    memcpy(w, src, sizeof(w));
+    dst[i + 0] = (int16_t)(w[0] >> 8);
+    dst[i + 1] = (int16_t)(w[1]);
+    dst[i + 2] = (int16_t)((w[1] >> 24) | (w[2] << 8));
+    dst[i + 3] = (int16_t)(w[2] >> 16);
+  }
+
+  for (; i < samples; i++, src += 3) {
+    dst[i] = (int16_t)((uint16_t)src[1] | ((uint16_t)src[2] << 8));
+  }
+}
+
+void pcmConvertS32(const uint8_t* src, int16_t* dst, size_t samples)
+{
+  for (size_t i = 0; i < samples; i++, src += 4) {
+    dst[i] = (int16_t)((uint16_t)src[2] | ((uint16_t)src[3] << 8));
+  }
+}
+
+void pcmConvertF32(const uint8_t* src, int16_t* dst, size_t samples)
+{
+  for (size_t i = 0; i < samples; i++, src += 4) {
+    float v;
+    memcpy(&v, src, sizeof(v));
+    v *= 32767.0f;
+    if (v > 32767.0f)
+      v = 32767.0f;
+    else if (v < -32768.0f)
+      v = -32768.0f;
+    else if (!(v == v))
+      v = 0.0f; // NaN.
+    dst[i] = (int16_t)lrintf(v);
+  }
+}
@@ -0,0 +1,163 @@
+#include "quality_governor.h"
+
+#include "equalizer.h"
+#include "resampler.h"
+#include "web_log.h"
+
+#include <atomic>
+
+QualityStats g_qualityStats;
+
+// One measurement window covers this much produced audio.
+static const uint32_t WINDOW_AUDIO_US = 1000000;
+
+// Step down when headroom stays below LOW for DOWN_WINDOWS windows,
+// step up when it stays above HIGH for UP_WINDOWS windows.
+static const int16_t  LOW_HEADROOM_PCT  = 15;
+static const int16_t  HIGH_HEADROOM_PCT = 45;
+static const uint32_t DOWN_WINDOWS      = 2;
+static const uint32_t UP_WINDOWS        = 5;
+
+// EQ bands kept at QUALITY_REDUCED_EQ and below.
+static const int REDUCED_EQ_BANDS = 2;
+static const int FULL_EQ_BANDS    = 5;
+
+static const char* LEVEL_NAMES[QUALITY_LEVEL_COUNT] = {"FULL", "FAST_RESAMPLE", "REDUCED_EQ",
+                                                       "MONO"};
+
+static uint64_t g_windowBusyUs  = 0;
+static uint64_t g_windowAudioUs = 0;
+static uint32_t g_lowWindows    = 0;
+static uint32_t g_highWindows   = 0;
+
+// Set when adaptive quality is switched off; the audio task then drops back to
+// full quality on its next report, so level changes stay on one thread.
+static std::atomic<bool> g_restorePending(false);
+
+// Push the level into the DSP modules. Mono is read by the audio task directly.
+static void applyLevel(uint8_t level)
+{
+  resamplerSetTier(level >= QUALITY_FAST_RESAMPLE ? RESAMPLER_TIER_HOLD : RESAMPLER_TIER_LINEAR);
+  eqSetMaxBands(level >= QUALITY_REDUCED_EQ ? REDUCED_EQ_BANDS : FULL_EQ_BANDS);
+}
+
+static void setLevel(uint8_t level)
+{
+  uint8_t old          = g_qualityStats.level;
+  g_qualityStats.level = level;
+  applyLevel(level);
+
+  WebLog.print("[QUALITY] ");
+  WebLog.print(level > old ? "⬇ " : "⬆ ");
+  WebLog.print(LEVEL_NAMES[old]);
+  WebLog.print(" -> ");
+  WebLog.print(LEVEL_NAMES[level]);
+  WebLog.print(" (headroom ");
+  WebLog.print(g_qualityStats.headroomPct);
+  WebLog.println("%)");
+}
+
+void qualityInit()
+{
+  g_qualityStats.level       = QUALITY_FULL;
+  g_qualityStats.headroomPct = 100;
+  g_qualityStats.stepDowns   = 0;
+  g_qualityStats.stepUps     = 0;
+  g_qualityStats.enabled     = true;
+
+  WebLog.println("[QUALITY] ✅ Adaptive quality initialized");
+}
+
+void qualitySetEnabled(bool enabled)
+{
+  g_qualityStats.enabled = enabled;
+  if (!enabled)
+    g_restorePending.store(true);
+  WebLog.print("[QUALITY] Adaptive quality ");
+  WebLog.println(enabled ? "enabled" : "disabled");
+}
+
+void qualityReset()
+{
+  g_windowBusyUs             = 0;
+  g_windowAudioUs            = 0;
+  g_lowWindows               = 0;
+  g_highWindows              = 0;
+  g_qualityStats.headroomPct = 100;
+  g_qualityStats.level       = QUALITY_FULL;
+  g_restorePending.store(false);
+  applyLevel(QUALITY_FULL);
+}
+
+void qualityReportChunk(uint32_t busyUs, uint32_t audioUs)
+{
+  if (g_restorePending.exchange(false)) {
+    g_lowWindows  = 0;
+    g_highWindows = 0;
+    if (g_qualityStats.level != QUALITY_FULL)
+      setLevel(QUALITY_FULL);
+  }
+
+  g_windowBusyUs += busyUs;
+  g_windowAudioUs += audioUs;
+
+  if (g_windowAudioUs < WINDOW_AUDIO_US)
+    return;
+
+  int64_t headroom = 100 - (int64_t)(g_windowBusyUs * 100 / g_windowAudioUs);
+  if (headroom < -100)
+    headroom = -100;
+  g_qualityStats.headroomPct = (int16_t)headroom;
+
+  g_windowBusyUs  = 0;
+  g_windowAudioUs = 0;
+
+  if (!g_qualityStats.enabled)
+    return;
+
+  if (headroom < LOW_HEADROOM_PCT) {
+    g_highWindows = 0;
+    g_lowWindows++;
+    if (g_lowWindows >= DOWN_WINDOWS && g_qualityStats.level + 1 < QUALITY_LEVEL_COUNT) {
+      setLevel(g_qualityStats.level + 1);
+      g_qualityStats.stepDowns++;
+      g_lowWindows = 0;
+    }
+  } else if (headroom > HIGH_HEADROOM_PCT) {
+    g_lowWindows = 0;
+    g_highWindows++;
+    if (g_highWindows >= UP_WINDOWS && g_qualityStats.level > QUALITY_FULL) {
+      setLevel(g_qualityStats.level - 1);
+      g_qualityStats.stepUps++;
+      g_highWindows = 0;
+    }
+  } else {
+    g_lowWindows  = 0;
+    g_highWindows = 0;
+  }
+}
+
+QualityLevel qualityGetLevel()
+{
+  return (QualityLevel)g_qualityStats.level;
+}
+
+const char* qualityGetLevelName(uint8_t level)
+{
+  if (level >= QUALITY_LEVEL_COUNT)
+    return "?";
+  return LEVEL_NAMES[level];
+}
+
+String qualityGetStatsJson()
+{
+  String json = "{";
+  json += "\"enabled\":" + String(g_qualityStats.enabled ? "true" : "false") + ",";
+  json += "\"level\":" + String(g_qualityStats.level) + ",";
+  json += "\"name\":\"" + String(qualityGetLevelName(g_qualityStats.level)) + "\",";
+  json += "\"headroom\":" + String(g_qualityStats.headroomPct) + ",";
+  json += "\"stepDowns\":" + String(g_qualityStats.stepDowns) + ",";
+  json += "\"stepUps\":" + String(g_qualityStats.stepUps);
+  json += "}";
+  return json;
+}
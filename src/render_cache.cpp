@@ -0,0 +1,620 @@
+#include "render_cache.h"
+
+#include "audio_decoder.h"
+#include "audio_player.h"
+#include "downmix.h"
+#include "resampler.h"
+#include "sd_bus.h"
+#include "sd_upload.h"
+#include "settings.h"
+#include "web_log.h"
+
+#include <SD.h>
+#include <atomic>
+
+static const char* CACHE_DIR        = "/.cache";
+static const char* CACHE_INDEX_PATH = "/.cache/index.bin";
+
+static const uint32_t CACHE_INDEX_MAGIC = 0x31494352; // "RCI1"
+static const uint32_t CACHE_VERSION     = 1;          // Bump when the render output changes.
+
+static const int      CACHE_MAX_ENTRIES  = 128;
+static const int      CACHE_QUEUE_LEN    = 8;
+static const int      CACHE_PATH_MAX     = 128;
+static const uint32_t CACHE_IDLE_MS      = 3000; // Player idle time before rendering.
+static const size_t   CACHE_CHUNK_FRAMES = 1024;
+static const uint64_t CACHE_FREE_MARGIN  = 16ULL * 1024 * 1024; // Keep free on the card.
+static const uint32_t WAV_HEADER_BYTES   = 44;
+
+struct CacheEntry {
+  uint32_t key;
+  uint32_t bytes;   // Size of the rendered file.
+  uint32_t lastUse; // Use clock value; lowest is evicted first.
+};
+
+struct CacheJob {
+  char path[CACHE_PATH_MAX];
+};
+
+static CacheEntry        g_entries[CACHE_MAX_ENTRIES];
+static int               g_entryCount = 0;
+static uint32_t          g_useClock   = 0;
+static bool              g_indexDirty = false; // Use clock advanced since the last save.
+static SemaphoreHandle_t g_indexLock  = nullptr;
+static QueueHandle_t     g_queue      = nullptr;
+static TaskHandle_t      g_task       = nullptr;
+
+static std::atomic<bool>     g_abort(false);
+static std::atomic<bool>     g_rendering(false);
+static std::atomic<uint32_t> g_lastActiveMs(0);
+
+// Stats.
+static uint32_t g_hits      = 0;
+static uint32_t g_misses    = 0;
+static uint32_t g_rendered  = 0;
+static uint32_t g_evictions = 0;
+static uint32_t g_aborted   = 0;
+
+static uint32_t fnv1a(uint32_t h, const void* data, size_t len)
+{
+  const uint8_t* p = (const uint8_t*)data;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+// Output rate for a source; resampling off keeps the source rate.
+static uint32_t pipelineOutRate(uint32_t srcRate)
+{
+  return g_settings.resamplingEnabled ? (uint32_t)g_settings.sampleRate : srcRate;
+}
+
+// Key over everything that changes the rendered PCM.
+static bool sourceKey(const String& path, uint32_t& key)
+{
+  File f = SD.open(path);
+  if (!f || f.isDirectory())
+    return false;
+
+  uint32_t size  = f.size();
+  uint32_t mtime = (uint32_t)f.getLastWrite();
+  f.close();
+
+  uint32_t outRate = g_settings.resamplingEnabled ? (uint32_t)g_settings.sampleRate : 0;
+
+  uint32_t h = 2166136261u;
+  h          = fnv1a(h, path.c_str(), path.length());
+  h          = fnv1a(h, &size, sizeof(size));
+  h          = fnv1a(h, &mtime, sizeof(mtime));
+  h          = fnv1a(h, &outRate, sizeof(outRate));
+  h          = fnv1a(h, &CACHE_VERSION, sizeof(CACHE_VERSION));
+  h          = fnv1a(h, g_settings.downmix, sizeof(g_settings.downmix));
+  key        = h;
+  return true;
+}
+
+static String entryPath(uint32_t key, const char* ext)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "/%08lx%s", (unsigned long)key, ext);
+  return String(CACHE_DIR) + name;
+}
+
+static int findEntry(uint32_t key)
+{
+  for (int i = 0; i < g_entryCount; i++) {
+    if (g_entries[i].key == key)
+      return i;
+  }
+  return -1;
+}
+
+static uint64_t usedBytes()
+{
+  uint64_t total = 0;
+  for (int i = 0; i < g_entryCount; i++) {
+    total += g_entries[i].bytes;
+  }
+  return total;
+}
+
+static uint64_t budgetBytes()
+{
+  return (uint64_t)g_settings.cacheMaxMB * 1024 * 1024;
+}
+
+// ----------------------------------------------------------------------------
+// Index (caller holds g_indexLock)
+// ----------------------------------------------------------------------------
+
+static void saveIndex()
+{
+  File f = SD.open(CACHE_INDEX_PATH, FILE_WRITE);
+  if (!f) {
+    WebLog.println("[CACHE] ❌ Cannot write index");
+    return;
+  }
+
+  uint32_t hdr[3] = {CACHE_INDEX_MAGIC, (uint32_t)g_entryCount, g_useClock};
+  f.write((const uint8_t*)hdr, sizeof(hdr));
+  f.write((const uint8_t*)g_entries, g_entryCount * sizeof(CacheEntry));
+  f.close();
+  g_indexDirty = false;
+}
+
+static void loadIndex()
+{
+  g_entryCount = 0;
+  g_useClock   = 0;
+
+  File f = SD.open(CACHE_INDEX_PATH);
+  if (!f)
+    return;
+
+  uint32_t hdr[3];
+  if (f.read((uint8_t*)hdr, sizeof(hdr)) == sizeof(hdr) && hdr[0] == CACHE_INDEX_MAGIC &&
+      hdr[1] <= (uint32_t)CACHE_MAX_ENTRIES) {
+    size_t bytes = hdr[1] * sizeof(CacheEntry);
+    if (f.read((uint8_t*)g_entries, bytes) == bytes) {
+      g_entryCount = (int)hdr[1];
+      g_useClock   = hdr[2];
+    }
+  }
+  f.close();
+
+  // Drop entries whose file went missing.
+  int kept = 0;
+  for (int i = 0; i < g_entryCount; i++) {
+    if (SD.exists(entryPath(g_entries[i].key, ".wav")))
+      g_entries[kept++] = g_entries[i];
+  }
+  if (kept != g_entryCount) {
+    g_entryCount = kept;
+    saveIndex();
+  }
+}
+
+// Write back use clock updates from lookups; called by the render task once the
+// player is idle so playback start never waits on an index write.
+static void flushIndex()
+{
+  xSemaphoreTake(g_indexLock, portMAX_DELAY);
+  if (g_indexDirty)
+    saveIndex();
+  xSemaphoreGive(g_indexLock);
+}
+
+// Remove renders interrupted by a reset; their .tmp files are never indexed.
+static void sweepTemp()
+{
+  File dir = SD.open(CACHE_DIR);
+  if (!dir)
+    return;
+
+  int removed = 0;
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+    String path = f.path();
+    f.close();
+    if (path.endsWith(".tmp") && SD.remove(path))
+      removed++;
+  }
+  dir.close();
+
+  if (removed > 0) {
+    WebLog.print("[CACHE] 🗑 Removed ");
+    WebLog.print(removed);
+    WebLog.println(" partial renders");
+  }
+}
+
+static void removeEntry(int i)
+{
+  SD.remove(entryPath(g_entries[i].key, ".wav"));
+  g_entries[i] = g_entries[--g_entryCount];
+}
+
+// Evict least recently used entries until `incoming` more bytes fit.
+static bool makeRoom(uint64_t incoming)
+{
+  uint64_t budget = budgetBytes();
+  if (incoming > budget)
+    return false;
+
+  bool changed = false;
+  while (g_entryCount > 0 &&
+         (usedBytes() + incoming > budget || g_entryCount >= CACHE_MAX_ENTRIES)) {
+    int oldest = 0;
+    for (int i = 1; i < g_entryCount; i++) {
+      if (g_entries[i].lastUse < g_entries[oldest].lastUse)
+        oldest = i;
+    }
+    removeEntry(oldest);
+    g_evictions++;
+    changed = true;
+  }
+
+  if (changed)
+    saveIndex();
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Rendering
+// ----------------------------------------------------------------------------
+
+static void writeLE16(uint8_t* p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void writeLE32(uint8_t* p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+// Canonical 44-byte header for 16-bit stereo PCM.
+static void buildWavHeader(uint8_t* h, uint32_t rate, uint32_t dataBytes)
+{
+  memcpy(h, "RIFF", 4);
+  writeLE32(h + 4, 36 + dataBytes);
+  memcpy(h + 8, "WAVEfmt ", 8);
+  writeLE32(h + 16, 16);
+  writeLE16(h + 20, 1);
+  writeLE16(h + 22, 2);
+  writeLE32(h + 24, rate);
+  writeLE32(h + 28, rate * 4);
+  writeLE16(h + 32, 4);
+  writeLE16(h + 34, 16);
+  memcpy(h + 36, "data", 4);
+  writeLE32(h + 40, dataBytes);
+}
+
+// Files that already play on the zero-DSP path gain nothing from a copy;
+// loops and cue markers would be lost by one.
+static bool worthRendering(IAudioDecoder* dec)
+{
+  const AudioStreamInfo& info = dec->info();
+  const AudioMarker*     markers;
+  if (info.loopEndMs > 0 || dec->markers(&markers) > 0)
+    return false;
+
+  bool plainWav = strcmp(dec->name(), "WAV") == 0 && info.bitsPerSample == 16;
+  return !plainWav || info.channels > 2 || info.sampleRate != pipelineOutRate(info.sampleRate);
+}
+
+static bool playerBusy()
+{
+  return audioIsRunning() || sdUploadIsActive();
+}
+
+static bool renderStream(IAudioDecoder* dec, File& out, uint32_t outRate, uint32_t& dataBytes)
+{
+  const AudioStreamInfo& info = dec->info();
+
+  bool multichannel = info.channels > 2;
+  if (multichannel && !downmixInit(info.channels, info.channelMask))
+    return false;
+
+  resamplerInit(info.sampleRate, outRate);
+  ResamplerTier savedTier = resamplerGetTier();
+  resamplerSetTier(RESAMPLER_TIER_LINEAR);
+
+  size_t   inSamples = CACHE_CHUNK_FRAMES * (info.channels > 2 ? info.channels : 2);
+  size_t   outMax    = resamplerCalcOutputFrames(CACHE_CHUNK_FRAMES) + 16;
+  int16_t* inBuf     = (int16_t*)malloc(inSamples * sizeof(int16_t));
+  int16_t* outBuf    = nullptr;
+  if (resamplerIsActive()) {
+    outBuf = (int16_t*)malloc(outMax * 2 * sizeof(int16_t));
+  }
+
+  bool ok = inBuf && (!resamplerIsActive() || outBuf);
+  dataBytes = 0;
+
+  while (ok) {
+    if (g_abort || playerBusy()) {
+      ok = false;
+      break;
+    }
+
+    size_t frames = dec->decode(inBuf, CACHE_CHUNK_FRAMES);
+    if (frames == 0)
+      break;
+
+    if (multichannel) {
+      downmixProcess(inBuf, frames, inBuf);
+    } else if (info.channels == 1) {
+      // Widen in place from the back.
+      for (size_t i = frames; i-- > 0;) {
+        inBuf[2 * i + 1] = inBuf[i];
+        inBuf[2 * i]     = inBuf[i];
+      }
+    }
+
+    int16_t* pcm = inBuf;
+    if (resamplerIsActive()) {
+      frames = resamplerProcess(inBuf, frames, outBuf, outMax);
+      pcm    = outBuf;
+    }
+
+    size_t bytes = frames * 2 * sizeof(int16_t);
+    if (sdBusWrite(SD_IO_BACKGROUND, out, (const uint8_t*)pcm, bytes) != bytes) {
+      WebLog.println("[CACHE] ❌ Write failed");
+      ok = false;
+      break;
+    }
+    dataBytes += bytes;
+
+    // Stay out of the way of the web server and analyzer on this core.
+    vTaskDelay(1);
+  }
+
+  free(inBuf);
+  free(outBuf);
+  resamplerSetTier(savedTier);
+  return ok;
+}
+
+static void renderOne(const String& path)
+{
+  uint32_t key;
+  if (!sourceKey(path, key))
+    return;
+
+  xSemaphoreTake(g_indexLock, portMAX_DELAY);
+  bool cached = findEntry(key) >= 0;
+  xSemaphoreGive(g_indexLock);
+  if (cached)
+    return;
+
+  IAudioDecoder* dec = decoderOpen(path, 0);
+  if (!dec)
+    return;
+
+  if (!worthRendering(dec)) {
+    dec->close();
+    delete dec;
+    return;
+  }
+
+  const AudioStreamInfo& info     = dec->info();
+  uint32_t               outRate  = pipelineOutRate(info.sampleRate);
+  uint64_t               estimate = (uint64_t)info.totalMs * outRate / 1000 * 4 + WAV_HEADER_BYTES;
+
+  uint64_t freeBytes = SD.totalBytes() - SD.usedBytes();
+  xSemaphoreTake(g_indexLock, portMAX_DELAY);
+  bool room = estimate + CACHE_FREE_MARGIN < freeBytes && estimate < 0xFFFFFFFFULL &&
+              makeRoom(estimate);
+  xSemaphoreGive(g_indexLock);
+
+  if (!room) {
+    WebLog.print("[CACHE] ⚠️ No room to render ");
+    WebLog.println(path);
+    dec->close();
+    delete dec;
+    return;
+  }
+
+  WebLog.print("[CACHE] 🎬 Rendering ");
+  WebLog.print(path);
+  WebLog.print(" -> ");
+  WebLog.print(outRate);
+  WebLog.println(" Hz");
+
+  String   tmpPath = entryPath(key, ".tmp");
+  File     out     = SD.open(tmpPath, FILE_WRITE);
+  uint8_t  header[WAV_HEADER_BYTES];
+  uint32_t dataBytes = 0;
+  uint32_t startMs   = millis();
+
+  bool ok = false;
+  if (out) {
+    buildWavHeader(header, outRate, 0);
+    ok = out.write(header, sizeof(header)) == sizeof(header) &&
+         renderStream(dec, out, outRate, dataBytes);
+  }
+
+  dec->close();
+  delete dec;
+
+  if (ok) {
+    buildWavHeader(header, outRate, dataBytes);
+    ok = out.seek(0) && out.write(header, sizeof(header)) == sizeof(header);
+  }
+  if (out)
+    out.close();
+
+  String finalPath = entryPath(key, ".wav");
+  if (ok) {
+    SD.remove(finalPath);
+    ok = SD.rename(tmpPath, finalPath);
+  }
+
+  if (!ok) {
+    SD.remove(tmpPath);
+    if (g_abort || playerBusy()) {
+      g_aborted++;
+      WebLog.println("[CACHE] ⏸ Render aborted for playback");
+      renderCacheRequest(path); // Retry on the next idle period.
+    }
+    return;
+  }
+
+  xSemaphoreTake(g_indexLock, portMAX_DELAY);
+  if (g_entryCount < CACHE_MAX_ENTRIES) {
+    g_entries[g_entryCount++] = {key, dataBytes + WAV_HEADER_BYTES, ++g_useClock};
+    saveIndex();
+  }
+  xSemaphoreGive(g_indexLock);
+  g_rendered++;
+
+  WebLog.print("[CACHE] ✅ Rendered ");
+  WebLog.print((dataBytes + WAV_HEADER_BYTES) / 1024);
+  WebLog.print(" KB in ");
+  WebLog.print((millis() - startMs) / 1000);
+  WebLog.println(" s");
+}
+
+static void renderTask(void* param)
+{
+  (void)param;
+
+  for (;;) {
+    if (playerBusy())
+      g_lastActiveMs = millis();
+
+    bool idle = !playerBusy() && millis() - g_lastActiveMs >= CACHE_IDLE_MS;
+    if (idle)
+      flushIndex();
+    if (!idle || g_settings.cacheMaxMB <= 0 || uxQueueMessagesWaiting(g_queue) == 0) {
+      vTaskDelay(pdMS_TO_TICKS(500));
+      continue;
+    }
+
+    // Flag first, then recheck: renderCacheYield() stamps g_lastActiveMs
+    // before it looks at g_rendering, so one side always sees the other.
+    g_rendering = true;
+    CacheJob job;
+    if (millis() - g_lastActiveMs >= CACHE_IDLE_MS && !g_abort &&
+        xQueueReceive(g_queue, &job, 0) == pdTRUE) {
+      renderOne(String(job.path));
+    }
+    g_rendering = false;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Public API
+// ----------------------------------------------------------------------------
+
+void renderCacheBegin()
+{
+  SD.mkdir(CACHE_DIR);
+
+  g_indexLock = xSemaphoreCreateMutex();
+  g_queue     = xQueueCreate(CACHE_QUEUE_LEN, sizeof(CacheJob));
+  if (!g_indexLock || !g_queue) {
+    WebLog.println("[CACHE] ❌ Cannot create queue");
+    return;
+  }
+
+  sweepTemp();
+  loadIndex();
+  g_lastActiveMs = millis();
+
+  if (xTaskCreatePinnedToCore(renderTask, "renderCache", 8192, nullptr, 1, &g_task, 0) != pdPASS) {
+    WebLog.println("[CACHE] ❌ Cannot start render task");
+    g_task = nullptr;
+    return;
+  }
+
+  WebLog.print("[CACHE] ✅ ");
+  WebLog.print(g_entryCount);
+  WebLog.print(" entries, ");
+  WebLog.print((uint32_t)(usedBytes() / 1024));
+  WebLog.println(" KB");
+}
+
+void renderCacheRequest(const String& path)
+{
+  if (!g_queue || g_settings.cacheMaxMB <= 0 || path.length() >= CACHE_PATH_MAX ||
+      path.startsWith(CACHE_DIR))
+    return;
+
+  CacheJob job;
+  strncpy(job.path, path.c_str(), sizeof(job.path) - 1);
+  job.path[sizeof(job.path) - 1] = '\0';
+  xQueueSend(g_queue, &job, 0); // Dropped when full; it is asked again on the next play.
+}
+
+bool renderCacheLookup(const String& path, String& cachedPath)
+{
+  uint32_t key;
+  if (!g_indexLock || g_settings.cacheMaxMB <= 0 || !sourceKey(path, key))
+    return false;
+
+  xSemaphoreTake(g_indexLock, portMAX_DELAY);
+  int i = findEntry(key);
+  if (i >= 0) {
+    g_entries[i].lastUse = ++g_useClock;
+    g_indexDirty         = true;
+  }
+  xSemaphoreGive(g_indexLock);
+
+  if (i < 0) {
+    g_misses++;
+    return false;
+  }
+
+  g_hits++;
+  cachedPath = entryPath(key, ".wav");
+  return true;
+}
+
+void renderCacheYield()
+{
+  g_lastActiveMs = millis();
+  if (!g_rendering)
+    return;
+
+  // Wait for the render to actually stop: returning early would let it run on
+  // the shared resampler and downmix state next to the starting playback.
+  g_abort        = true;
+  uint32_t start = millis();
+  bool     slow  = false;
+  while (g_rendering) {
+    if (!slow && millis() - start >= 2000) {
+      WebLog.println("[CACHE] ⚠️ Render slow to abort, still waiting");
+      slow = true;
+    }
+    delay(20);
+  }
+  g_abort = false;
+}
+
+void renderCacheClear()
+{
+  if (!g_indexLock)
+    return;
+
+  renderCacheYield();
+
+  xSemaphoreTake(g_indexLock, portMAX_DELAY);
+  while (g_entryCount > 0) {
+    removeEntry(g_entryCount - 1);
+  }
+  saveIndex();
+  xSemaphoreGive(g_indexLock);
+
+  WebLog.println("[CACHE] 🗑 Cleared");
+}
+
+String renderCacheGetStatsJson()
+{
+  uint64_t used = 0;
+  int      count = 0;
+  if (g_indexLock) {
+    xSemaphoreTake(g_indexLock, portMAX_DELAY);
+    used  = usedBytes();
+    count = g_entryCount;
+    xSemaphoreGive(g_indexLock);
+  }
+
+  String json = "{";
+  json += "\"entries\":" + String(count) + ",";
+  json += "\"usedKB\":" + String((uint32_t)(used / 1024)) + ",";
+  json += "\"budgetMB\":" + String(g_settings.cacheMaxMB) + ",";
+  json += "\"rendering\":" + String(g_rendering ? "true" : "false") + ",";
+  json += "\"queued\":" + String(g_queue ? (uint32_t)uxQueueMessagesWaiting(g_queue) : 0) + ",";
+  json += "\"hits\":" + String(g_hits) + ",";
+  json += "\"misses\":" + String(g_misses) + ",";
+  json += "\"rendered\":" + String(g_rendered) + ",";
+  json += "\"evictions\":" + String(g_evictions) + ",";
+  json += "\"aborted\":" + String(g_aborted);
+  json += "}";
+  return json;
+}
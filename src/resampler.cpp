@@ -2,7 +2,7 @@
 
 #include "web_log.h"
 
-ResamplerState g_resampler = {0, 0, 0, 0, 0, 1.0f, false};
+ResamplerState g_resampler = {0, 0, 0, 0, 0, 1.0f, false, RESAMPLER_TIER_LINEAR};
 
 void resamplerInit(uint32_t srcRate, uint32_t dstRate)
 {
@@ -40,6 +40,21 @@ bool resamplerIsActive()
   return g_resampler.active;
 }
 
+void resamplerSetTier(ResamplerTier tier)
+{
+  if (g_resampler.tier == tier)
+    return;
+
+  g_resampler.tier = tier;
+  WebLog.print("[RESAMPLE] Tier: ");
+  WebLog.println(tier == RESAMPLER_TIER_LINEAR ? "linear" : "hold");
+}
+
+ResamplerTier resamplerGetTier()
+{
+  return g_resampler.tier;
+}
+
 size_t resamplerCalcOutputFrames(size_t srcFrames)
 {
   if (!g_resampler.active)
@@ -59,50 +74,50 @@ static inline int16_t lerp16(int16_t a, int16_t b, float t)
   return (int16_t)((float)a + t * ((float)b - (float)a));
 }
 
-size_t resamplerProcess(const int16_t* srcBuf, size_t srcFrames, int16_t* dstBuf,
-                        size_t dstMaxFrames)
+// Shared kernel for interleaved buffers with CH channels per frame.
+template <int CH>
+static size_t resampleFrames(const int16_t* srcBuf, size_t srcFrames, int16_t* dstBuf,
+                             size_t dstMaxFrames)
 {
   if (!g_resampler.active || srcFrames == 0) {
     size_t toCopy = (srcFrames < dstMaxFrames) ? srcFrames : dstMaxFrames;
-    memcpy(dstBuf, srcBuf, toCopy * 2 * sizeof(int16_t));
+    memcpy(dstBuf, srcBuf, toCopy * CH * sizeof(int16_t));
     return toCopy;
   }
 
   size_t outFrames = 0;
   float  pos       = g_resampler.position;
   float  ratio     = g_resampler.ratio;
+  bool   hold      = g_resampler.tier == RESAMPLER_TIER_HOLD;
 
   while (outFrames < dstMaxFrames) {
     size_t srcIdx = (size_t)pos;
-    float  frac   = pos - (float)srcIdx;
 
     if (srcIdx >= srcFrames) {
       break;
     }
 
-    int16_t curL = srcBuf[srcIdx * 2];
-    int16_t curR = srcBuf[srcIdx * 2 + 1];
+    const int16_t* cur = srcBuf + srcIdx * CH;
+    int16_t*       out = dstBuf + outFrames * CH;
 
-    int16_t nextL, nextR;
-    if (srcIdx + 1 < srcFrames) {
-      nextL = srcBuf[(srcIdx + 1) * 2];
-      nextR = srcBuf[(srcIdx + 1) * 2 + 1];
+    if (hold) {
+      for (int ch = 0; ch < CH; ch++) {
+        out[ch] = cur[ch];
+      }
     } else {
-      nextL = curL;
-      nextR = curR;
+      float          frac = pos - (float)srcIdx;
+      const int16_t* next = (srcIdx + 1 < srcFrames) ? cur + CH : cur;
+      for (int ch = 0; ch < CH; ch++) {
+        out[ch] = lerp16(cur[ch], next[ch], frac);
+      }
     }
 
-    dstBuf[outFrames * 2]     = lerp16(curL, nextL, frac);
-    dstBuf[outFrames * 2 + 1] = lerp16(curR, nextR, frac);
-
     outFrames++;
     pos += ratio;
   }
 
-  if (srcFrames > 0) {
-    g_resampler.lastL = srcBuf[(srcFrames - 1) * 2];
-    g_resampler.lastR = srcBuf[(srcFrames - 1) * 2 + 1];
-  }
+  g_resampler.lastL = srcBuf[(srcFrames - 1) * CH];
+  g_resampler.lastR = srcBuf[(srcFrames - 1) * CH + (CH - 1)];
 
   g_resampler.position = pos - (float)srcFrames;
   if (g_resampler.position < 0)
@@ -110,3 +125,15 @@ size_t resamplerProcess(const int16_t* srcBuf, size_t srcFrames, int16_t* dstBuf
 
   return outFrames;
 }
+
+size_t resamplerProcess(const int16_t* srcBuf, size_t srcFrames, int16_t* dstBuf,
+                        size_t dstMaxFrames)
+{
+  return resampleFrames<2>(srcBuf, srcFrames, dstBuf, dstMaxFrames);
+}
+
+size_t resamplerProcessMono(const int16_t* srcBuf, size_t srcFrames, int16_t* dstBuf,
+                            size_t dstMaxFrames)
+{
+  return resampleFrames<1>(srcBuf, srcFrames, dstBuf, dstMaxFrames);
+}
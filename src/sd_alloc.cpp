@@ -0,0 +1,170 @@
+#include "sd_alloc.h"
+
+#include "sd_bus.h"
+#include "web_log.h"
+
+#include <ff.h>
+
+static const uint32_t FRAG_WALK_SLICE = 128; // Clusters stepped per bus slice.
+
+static uint32_t g_contiguous   = 0;
+static uint32_t g_extended     = 0;
+static uint32_t g_failed       = 0;
+static uint32_t g_lastSearchMs = 0;
+
+// Card path to a FatFs path on the card's drive ("/a.wav" -> "0:/a.wav").
+static bool fatPath(const String& path, String& out)
+{
+  int drive = sdBusFatDrive();
+  if (drive < 0)
+    return false;
+
+  out = String(drive) + ":" + (path.startsWith("/") ? path : "/" + path);
+  return true;
+}
+
+static uint32_t clusterBytesOf(const FIL& fil)
+{
+#if FF_MAX_SS != FF_MIN_SS
+  return (uint32_t)fil.obj.fs->csize * fil.obj.fs->ssize;
+#else
+  return (uint32_t)fil.obj.fs->csize * FF_MIN_SS;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Public API
+// ----------------------------------------------------------------------------
+
+SdPrealloc sdPreallocate(const String& path, uint64_t size)
+{
+  String fpath;
+  if (size == 0 || !fatPath(path, fpath))
+    return SD_PREALLOC_NONE;
+
+  // One slice: the free-run search reads the FAT, usually only a few
+  // sectors past the last allocation.
+  SdBusSlice slice(SD_IO_UPLOAD);
+  uint32_t   startMs = millis();
+
+  FIL fil;
+  if (f_open(&fil, fpath.c_str(), FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+    g_failed++;
+    return SD_PREALLOC_NONE;
+  }
+
+  SdPrealloc result = SD_PREALLOC_NONE;
+#if FF_USE_EXPAND
+  if (f_expand(&fil, (FSIZE_t)size, 1) == FR_OK)
+    result = SD_PREALLOC_CONTIGUOUS;
+#endif
+
+  // No run large enough (or no f_expand): extend by seeking past the end.
+  // FatFs chains the new clusters from its last allocation, which still
+  // keeps them in a few long runs.
+  if (result == SD_PREALLOC_NONE && f_lseek(&fil, (FSIZE_t)size) == FR_OK &&
+      fil.fptr == (FSIZE_t)size)
+    result = SD_PREALLOC_EXTENDED;
+
+  // Card full: give back whatever the seek managed to chain.
+  if (result == SD_PREALLOC_NONE) {
+    f_lseek(&fil, 0);
+    f_truncate(&fil);
+  }
+  f_close(&fil);
+
+  g_lastSearchMs = millis() - startMs;
+  if (result == SD_PREALLOC_CONTIGUOUS) {
+    g_contiguous++;
+  } else if (result == SD_PREALLOC_EXTENDED) {
+    g_extended++;
+  } else {
+    g_failed++;
+  }
+  return result;
+}
+
+bool sdTruncate(const String& path, uint64_t size)
+{
+  String fpath;
+  if (!fatPath(path, fpath))
+    return false;
+
+  SdBusSlice slice(SD_IO_UPLOAD);
+  FIL        fil;
+  if (f_open(&fil, fpath.c_str(), FA_OPEN_EXISTING | FA_WRITE) != FR_OK)
+    return false;
+
+  bool ok = f_lseek(&fil, (FSIZE_t)size) == FR_OK && f_truncate(&fil) == FR_OK;
+  return f_close(&fil) == FR_OK && ok;
+}
+
+bool sdFileFragments(const String& path, SdFragInfo* info)
+{
+  String fpath;
+  if (!info || !fatPath(path, fpath))
+    return false;
+
+  FIL fil;
+  {
+    SdBusSlice slice(SD_IO_BROWSE);
+    if (f_open(&fil, fpath.c_str(), FA_OPEN_EXISTING | FA_READ) != FR_OK)
+      return false;
+  }
+
+  info->size         = f_size(&fil);
+  info->clusterBytes = clusterBytesOf(fil);
+  info->clusters     = (uint32_t)((info->size + info->clusterBytes - 1) / info->clusterBytes);
+  info->fragments    = info->clusters > 0 ? 1 : 0;
+  info->firstCluster = fil.obj.sclust;
+
+  // Step one cluster at a time; a forward seek follows one FAT link, and
+  // landing one byte into cluster k leaves its number in fil.clust.
+  bool     ok   = true;
+  DWORD    prev = fil.obj.sclust;
+  uint32_t k    = 1;
+  while (ok && k < info->clusters) {
+    SdBusSlice slice(SD_IO_BROWSE);
+    for (uint32_t n = 0; n < FRAG_WALK_SLICE && k < info->clusters; n++, k++) {
+      if (f_lseek(&fil, (FSIZE_t)k * info->clusterBytes + 1) != FR_OK) {
+        ok = false;
+        break;
+      }
+      if (fil.clust != prev + 1)
+        info->fragments++;
+      prev = fil.clust;
+    }
+  }
+
+  SdBusSlice slice(SD_IO_BROWSE);
+  f_close(&fil);
+  return ok;
+}
+
+String sdFileFragmentsJson(const String& path)
+{
+  SdFragInfo info;
+  if (!sdFileFragments(path, &info))
+    return "{\"error\":\"cannot read\"}";
+
+  String json = "{";
+  json += "\"size\":" + String((uint32_t)info.size) + ",";
+  json += "\"clusterBytes\":" + String(info.clusterBytes) + ",";
+  json += "\"clusters\":" + String(info.clusters) + ",";
+  json += "\"fragments\":" + String(info.fragments) + ",";
+  json += "\"contiguous\":" + String(info.fragments <= 1 ? "true" : "false") + ",";
+  json += "\"firstCluster\":" + String(info.firstCluster);
+  json += "}";
+  return json;
+}
+
+String sdAllocGetStatsJson()
+{
+  String json = "{";
+  json += "\"contiguous\":" + String(g_contiguous) + ",";
+  json += "\"extended\":" + String(g_extended) + ",";
+  json += "\"failed\":" + String(g_failed) + ",";
+  json += "\"lastSearchMs\":" + String(g_lastSearchMs);
+  json += "}";
+  return json;
+}
@@ -1,12 +1,20 @@
 #include "sd_browser.h"
 
+#include "audio_decoder.h"
+#include "media_library.h"
+#include "mp3_index.h"
+#include "sd_bus.h"
 #include "web_log.h"
 
 #include <SD.h>
+#include <algorithm>
 
 // Current file selected for playback.
 static String g_currentFile = "/test.wav";
 
+// Largest listing page; also bounds the entries held while paging.
+static const uint32_t LIST_PAGE_MAX = 200;
+
 const String& sdGetCurrentFile()
 {
   return g_currentFile;
@@ -28,9 +36,7 @@ bool sdIsWavFile(const String& path)
 
 bool sdIsAudioFile(const String& path)
 {
-  String lower = path;
-  lower.toLowerCase();
-  return lower.endsWith(".wav") || lower.endsWith(".mp3");
+  return decoderKnowsExtension(path);
 }
 
 bool sdFileExists(const String& path)
@@ -48,76 +54,225 @@ uint32_t sdGetFileSize(const String& path)
   return sz;
 }
 
-String sdListDir(const String& path)
+// Names and tags come from the card; keep them valid inside a JSON string.
+static String textToJson(const String& s)
+{
+  String out;
+  for (size_t i = 0; i < s.length(); i++) {
+    char c = s[i];
+    if (c == '"' || c == '\\')
+      out += '\\';
+    if ((uint8_t)c >= 32)
+      out += c;
+  }
+  return out;
+}
+
+String sdEntryToJson(const LibraryEntry& e, bool withPath)
+{
+  String json = "{\"name\":\"";
+  json += textToJson(e.name);
+  if (withPath)
+    json += "\",\"path\":\"" + textToJson(e.path);
+  json += "\",\"size\":";
+  json += String(e.size);
+  json += ",\"isDir\":";
+  json += e.isDir ? "true" : "false";
+  if (e.mtime > 0)
+    json += ",\"mtime\":" + String(e.mtime);
+  if (e.probed && e.codec[0]) {
+    json += ",\"codec\":\"" + String(e.codec) + "\"";
+    json += ",\"ms\":" + String(e.durationMs);
+    json += ",\"rate\":" + String(e.sampleRate);
+    json += ",\"ch\":" + String(e.channels);
+  }
+  if (e.title.length() > 0)
+    json += ",\"title\":\"" + textToJson(e.title) + "\"";
+  if (e.artist.length() > 0)
+    json += ",\"artist\":\"" + textToJson(e.artist) + "\"";
+  json += "}";
+  return json;
+}
+
+// Directories first, then the sort key; names break ties (unique per
+// directory, so the order is total).
+static bool entryLess(const LibraryEntry& a, const LibraryEntry& b, SdSortKey sort)
+{
+  if (a.isDir != b.isDir)
+    return a.isDir;
+  if (sort == SD_SORT_SIZE && a.size != b.size)
+    return a.size < b.size;
+  if (sort == SD_SORT_MTIME && a.mtime != b.mtime)
+    return a.mtime < b.mtime;
+
+  int c = strcasecmp(a.name.c_str(), b.name.c_str());
+  return c != 0 ? c < 0 : strcmp(a.name.c_str(), b.name.c_str()) < 0;
+}
+
+// One pass over the directory keeps the `window` smallest entries above
+// `floor` in a max-heap.
+struct PageContext {
+  SdSortKey     sort;
+  LibraryEntry* heap;
+  uint32_t      window;
+  uint32_t      count;
+  LibraryEntry* floor; // Null on the first pass.
+  uint32_t      total;
+};
+
+static void heapSiftDown(PageContext& pc, uint32_t i)
 {
-  String json = "[";
+  for (;;) {
+    uint32_t largest = i;
+    uint32_t l       = 2 * i + 1;
+    uint32_t r       = l + 1;
+    if (l < pc.count && entryLess(pc.heap[largest], pc.heap[l], pc.sort))
+      largest = l;
+    if (r < pc.count && entryLess(pc.heap[largest], pc.heap[r], pc.sort))
+      largest = r;
+    if (largest == i)
+      return;
+    std::swap(pc.heap[i], pc.heap[largest]);
+    i = largest;
+  }
+}
 
-  // Normalize path.
-  String normalizedPath = path;
-  if (normalizedPath.length() == 0) {
-    normalizedPath = "/";
+static bool collectEntry(const LibraryEntry& e, void* ctx)
+{
+  PageContext& pc = *(PageContext*)ctx;
+  pc.total++;
+  if (pc.floor && !entryLess(*pc.floor, e, pc.sort))
+    return true;
+
+  if (pc.count < pc.window) {
+    uint32_t i = pc.count++;
+    pc.heap[i] = e;
+    while (i > 0 && entryLess(pc.heap[(i - 1) / 2], pc.heap[i], pc.sort)) {
+      std::swap(pc.heap[i], pc.heap[(i - 1) / 2]);
+      i = (i - 1) / 2;
+    }
+  } else if (pc.window > 0 && entryLess(e, pc.heap[0], pc.sort)) {
+    pc.heap[0] = e;
+    heapSiftDown(pc, 0);
   }
+  return true;
+}
 
-  WebLog.print("[SD] Opening directory: ");
-  WebLog.println(normalizedPath);
+// Visit every visible entry: from the media library when it covers the
+// directory, otherwise straight from the card.
+static bool forEachDirEntry(const String& path, LibraryVisitFn fn, void* ctx)
+{
+  if (libraryForEachInDir(path, fn, ctx))
+    return true;
 
-  File root = SD.open(normalizedPath);
+  File root;
+  {
+    SdBusSlice slice(SD_IO_BROWSE);
+    root = SD.open(path);
+  }
   if (!root) {
     WebLog.print("[SD] ❌ Cannot open path: ");
-    WebLog.println(normalizedPath);
-    return "[]";
+    WebLog.println(path);
+    return false;
   }
 
   if (!root.isDirectory()) {
     WebLog.print("[SD] ❌ Not a directory: ");
-    WebLog.println(normalizedPath);
+    WebLog.println(path);
     root.close();
-    return "[]";
+    return false;
   }
 
-  int       count    = 0;
-  const int maxFiles = 50;
-
-  File entry = root.openNextFile();
-  while (entry && count < maxFiles) {
-    String name = entry.name();
+  // One bus slice per entry; the callback runs outside it.
+  for (;;) {
+    LibraryEntry e;
+    {
+      SdBusSlice slice(SD_IO_BROWSE);
+      File       entry = root.openNextFile();
+      if (!entry)
+        break;
+      e.name  = entry.name();
+      e.size  = entry.size();
+      e.mtime = (uint32_t)entry.getLastWrite();
+      e.isDir = entry.isDirectory();
+      entry.close();
+    }
 
     // Remove leading path if present (ESP32 SD library quirk).
-    int lastSlash = name.lastIndexOf('/');
+    int lastSlash = e.name.lastIndexOf('/');
     if (lastSlash >= 0) {
-      name = name.substring(lastSlash + 1);
+      e.name = e.name.substring(lastSlash + 1);
     }
 
     // Skip hidden files, system files, and empty names.
-    if (name.length() == 0 || name.startsWith(".") || name.startsWith("_")) {
-      entry = root.openNextFile();
+    if (e.name.length() == 0 || e.name.startsWith(".") || e.name.startsWith("_"))
       continue;
-    }
 
-    if (count > 0)
-      json += ",";
+    e.path = path + (path.endsWith("/") ? "" : "/") + e.name;
+    if (!fn(e, ctx))
+      break;
+  }
 
-    json += "{\"name\":\"";
-    json += name;
-    json += "\",\"size\":";
-    json += String(entry.size());
-    json += ",\"isDir\":";
-    json += entry.isDirectory() ? "true" : "false";
-    json += "}";
+  root.close();
+  return true;
+}
 
-    count++;
-    entry = root.openNextFile();
+bool sdListDirPage(const String& path, SdSortKey sort, uint32_t offset, uint32_t limit,
+                   LibraryVisitFn fn, void* ctx, uint32_t* total)
+{
+  String dir = path.length() == 0 ? String("/") : path;
+  if (limit > LIST_PAGE_MAX)
+    limit = LIST_PAGE_MAX;
+
+  // Skipped entries are walked past in windows of the same bounded size,
+  // one pass each; the last pass collects the page.
+  uint32_t capacity = offset > limit ? offset : limit;
+  if (capacity > LIST_PAGE_MAX)
+    capacity = LIST_PAGE_MAX;
+
+  LibraryEntry* heap = new LibraryEntry[capacity > 0 ? capacity : 1];
+  LibraryEntry  floor;
+  PageContext   pc   = {sort, heap, 0, 0, nullptr, 0};
+  uint32_t      skip = offset;
+  bool          ok   = true;
+  for (;;) {
+    pc.window = skip > 0 ? (skip < capacity ? skip : capacity) : limit;
+    pc.count  = 0;
+    pc.total  = 0;
+    if (!forEachDirEntry(dir, collectEntry, &pc)) {
+      ok = false;
+      break;
+    }
+    if (skip == 0 || pc.count < pc.window)
+      break;
+
+    skip -= pc.count;
+
+    floor    = heap[0];
+    pc.floor = &floor;
   }
 
-  root.close();
-  json += "]";
+  // Offset past the end: nothing to show.
+  uint32_t found = skip > 0 ? 0 : pc.count;
+
+  if (ok) {
+    // Heap to ascending order.
+    for (uint32_t n = found; n > 1; n--) {
+      std::swap(heap[0], heap[n - 1]);
+      pc.count = n - 1;
+      heapSiftDown(pc, 0);
+    }
 
-  WebLog.print("[SD] Listed ");
-  WebLog.print(count);
-  WebLog.print(" items in ");
-  WebLog.println(normalizedPath);
+    if (total)
+      *total = pc.total;
+    for (uint32_t i = 0; i < found; i++) {
+      if (!fn(heap[i], ctx))
+        break;
+    }
+  }
 
-  return json;
+  delete[] heap;
+  return ok;
 }
 
 bool sdDeleteFile(const String& path)
@@ -134,20 +289,28 @@ bool sdDeleteFile(const String& path)
     return false;
   }
 
-  File f     = SD.open(path);
-  bool isDir = f.isDirectory();
-  f.close();
-
-  bool ok = false;
-  if (isDir) {
-    ok = SD.rmdir(path);
-  } else {
-    ok = SD.remove(path);
+  // The bus is taken for the card work only: the library takes its own
+  // lock first and the bus inside it.
+  bool ok    = false;
+  bool isDir = false;
+  {
+    SdBusSlice slice(SD_IO_BROWSE);
+    File       f = SD.open(path);
+    isDir        = f.isDirectory();
+    f.close();
+    ok = isDir ? SD.rmdir(path) : SD.remove(path);
+
+    // Drop the cached MP3 frame index along with its file.
+    String idxPath = mp3IndexPath(path);
+    if (ok && !isDir && SD.exists(idxPath)) {
+      SD.remove(idxPath);
+    }
   }
 
   if (ok) {
     WebLog.print("[SD] ✅ Deleted: ");
     WebLog.println(path);
+    libraryNoteRemoved(path);
   } else {
     WebLog.print("[SD] ❌ Failed to delete: ");
     WebLog.println(path);
@@ -176,13 +339,24 @@ bool sdRenameFile(const String& oldPath, const String& newPath)
     return false;
   }
 
-  bool ok = SD.rename(oldPath, newPath);
+  bool ok = false;
+  {
+    SdBusSlice slice(SD_IO_BROWSE);
+    ok = SD.rename(oldPath, newPath);
+
+    // Move the cached MP3 frame index with its file.
+    String oldIdx = mp3IndexPath(oldPath);
+    if (ok && SD.exists(oldIdx)) {
+      SD.rename(oldIdx, mp3IndexPath(newPath));
+    }
+  }
 
   if (ok) {
     WebLog.print("[SD] ✅ Renamed: ");
     WebLog.print(oldPath);
     WebLog.print(" -> ");
     WebLog.println(newPath);
+    libraryNoteRenamed(oldPath, newPath);
 
     // Update current file if it was renamed.
     if (g_currentFile == oldPath) {
@@ -0,0 +1,244 @@
+#include "sd_bus.h"
+
+#include "web_log.h"
+
+#include <ff.h>
+
+static const uint32_t SD_BUS_MIN_SLACK_MS = 40;    // Below this only audio starts a slice.
+static const uint32_t SD_BUS_MAX_DEFER_MS = 250;   // Longest hold-off, so uploads never stall.
+static const uint32_t SD_BUS_SLICE_US     = 20000; // Target slice length with audio running.
+static const size_t   SD_BUS_MIN_SLICE    = 4096;
+static const size_t   SD_BUS_MAX_SLICE    = 32768;
+static const uint32_t SD_BUS_DEFAULT_RATE = 1000;  // Bytes per ms assumed until measured.
+static const uint32_t SD_BUS_CLUSTER      = 32768; // Typical SDHC cluster when FatFs won't say.
+
+struct SdClassStats {
+  uint32_t slices;
+  uint64_t bytes;
+  uint64_t busyUs;
+  uint64_t waitUs;
+  uint32_t maxWaitUs;
+  uint32_t deferred; // Slices that held off for audio.
+  uint32_t rateBpms; // Smoothed throughput in bytes per ms.
+};
+
+static const char* const CLASS_NAMES[SD_IO_CLASSES] = {"audio", "upload", "browse", "background"};
+
+static SemaphoreHandle_t g_bus       = nullptr;
+static volatile uint32_t g_slackMs   = SD_BUS_NO_DEADLINE;
+static volatile int      g_audioWait = 0;
+
+// Per-class stats and the slice in progress (touched with g_bus held).
+static SdClassStats g_stats[SD_IO_CLASSES];
+static int          g_depth          = 0;
+static uint32_t     g_sliceStartUs   = 0;
+static uint32_t     g_deadlineMisses = 0;
+static uint32_t     g_clusterBytes   = 0;
+static int          g_fatDrive       = -1;
+
+static bool holdsBus()
+{
+  return g_bus && xSemaphoreGetMutexHolder(g_bus) == xTaskGetCurrentTaskHandle();
+}
+
+// ----------------------------------------------------------------------------
+// Public API
+// ----------------------------------------------------------------------------
+
+void sdBusBegin()
+{
+  if (g_bus)
+    return;
+
+  g_bus = xSemaphoreCreateRecursiveMutex();
+  if (!g_bus) {
+    WebLog.println("[SDBUS] ❌ Cannot create lock");
+    return;
+  }
+  WebLog.println("[SDBUS] ✅ Arbiter ready");
+}
+
+void sdBusAcquire(SdIoClass cls)
+{
+  if (!g_bus)
+    return;
+
+  uint32_t startUs = micros();
+  if (cls == SD_IO_AUDIO) {
+    g_audioWait = g_audioWait + 1;
+  } else if (!holdsBus()) {
+    // Let audio go first while it is waiting or short of buffered data.
+    bool deferred = false;
+    while ((g_audioWait > 0 || g_slackMs < SD_BUS_MIN_SLACK_MS) &&
+           micros() - startUs < SD_BUS_MAX_DEFER_MS * 1000) {
+      deferred = true;
+      vTaskDelay(1);
+    }
+    if (deferred)
+      g_stats[cls].deferred++;
+  }
+
+  xSemaphoreTakeRecursive(g_bus, portMAX_DELAY);
+
+  uint32_t waitUs = micros() - startUs;
+  if (cls == SD_IO_AUDIO) {
+    g_audioWait = g_audioWait - 1;
+    if (g_slackMs != SD_BUS_NO_DEADLINE && waitUs / 1000 > g_slackMs)
+      g_deadlineMisses++;
+  }
+
+  // Nested slices count their bytes only; the outer one owns the time.
+  if (g_depth++ > 0)
+    return;
+
+  SdClassStats& s = g_stats[cls];
+  s.waitUs += waitUs;
+  if (waitUs > s.maxWaitUs)
+    s.maxWaitUs = waitUs;
+  g_sliceStartUs = micros();
+}
+
+void sdBusRelease(SdIoClass cls, size_t bytes)
+{
+  if (!g_bus)
+    return;
+
+  SdClassStats& s = g_stats[cls];
+  s.bytes += bytes;
+  if (--g_depth > 0) {
+    xSemaphoreGiveRecursive(g_bus);
+    return;
+  }
+
+  uint32_t busyUs = micros() - g_sliceStartUs;
+  s.slices++;
+  s.busyUs += busyUs;
+  if (bytes >= SD_BUS_MIN_SLICE && busyUs > 0) {
+    uint32_t rate = (uint32_t)((uint64_t)bytes * 1000 / busyUs);
+    s.rateBpms    = s.rateBpms == 0 ? rate : (s.rateBpms * 7 + rate) / 8;
+  }
+
+  xSemaphoreGiveRecursive(g_bus);
+}
+
+void sdBusReportAudioSlack(uint32_t ms)
+{
+  g_slackMs = ms;
+}
+
+size_t sdBusSliceBytes(SdIoClass cls)
+{
+  uint32_t slackMs = g_slackMs;
+  if (cls == SD_IO_AUDIO || slackMs == SD_BUS_NO_DEADLINE)
+    return SD_BUS_MAX_SLICE;
+
+  // Finish within half the audio deadline, and never longer than a target slice.
+  uint32_t budgetUs = slackMs * 500;
+  if (budgetUs > SD_BUS_SLICE_US)
+    budgetUs = SD_BUS_SLICE_US;
+
+  uint32_t rate  = g_stats[cls].rateBpms > 0 ? g_stats[cls].rateBpms : SD_BUS_DEFAULT_RATE;
+  size_t   bytes = (size_t)((uint64_t)rate * budgetUs / 1000);
+  if (bytes < SD_BUS_MIN_SLICE)
+    bytes = SD_BUS_MIN_SLICE;
+  if (bytes > SD_BUS_MAX_SLICE)
+    bytes = SD_BUS_MAX_SLICE;
+
+  // A power of two, so slices of a cluster-aligned write stay aligned.
+  size_t slice = SD_BUS_MIN_SLICE;
+  while (slice * 2 <= bytes) {
+    slice *= 2;
+  }
+  return slice;
+}
+
+int sdBusFatDrive()
+{
+  if (g_fatDrive >= 0)
+    return g_fatDrive;
+
+  // The card is the only FAT volume: take the first mounted drive.
+  SdBusSlice slice(SD_IO_BACKGROUND);
+  for (int pdrv = 0; pdrv < FF_VOLUMES; pdrv++) {
+    char   drv[3]       = {(char)('0' + pdrv), ':', '\0'};
+    DWORD  freeClusters = 0;
+    FATFS* fs           = nullptr;
+    if (f_getfree(drv, &freeClusters, &fs) != FR_OK || !fs)
+      continue;
+
+    g_fatDrive = pdrv;
+#if FF_MAX_SS != FF_MIN_SS
+    g_clusterBytes = (uint32_t)fs->csize * fs->ssize;
+#else
+    g_clusterBytes = (uint32_t)fs->csize * FF_MIN_SS;
+#endif
+    break;
+  }
+  return g_fatDrive;
+}
+
+uint32_t sdBusClusterBytes()
+{
+  if (g_clusterBytes > 0)
+    return g_clusterBytes;
+
+  sdBusFatDrive();
+
+  if (g_clusterBytes == 0) {
+    WebLog.println("[SDBUS] ⚠️ Cluster size unknown, assuming 32 KB");
+    g_clusterBytes = SD_BUS_CLUSTER;
+  } else {
+    WebLog.print("[SDBUS] Cluster size: ");
+    WebLog.print(g_clusterBytes / 1024);
+    WebLog.println(" KB");
+  }
+  return g_clusterBytes;
+}
+
+size_t sdBusRead(SdIoClass cls, File& f, uint8_t* buf, size_t len)
+{
+  SdBusSlice slice(cls);
+  return slice.done(f.read(buf, len));
+}
+
+size_t sdBusWrite(SdIoClass cls, File& f, const uint8_t* buf, size_t len)
+{
+  size_t done = 0;
+  while (done < len) {
+    size_t n   = len - done;
+    size_t max = sdBusSliceBytes(cls);
+    if (n > max)
+      n = max;
+
+    SdBusSlice slice(cls);
+    size_t     wrote = slice.done(f.write(buf + done, n));
+    done += wrote;
+    if (wrote < n)
+      break;
+  }
+  return done;
+}
+
+String sdBusGetStatsJson()
+{
+  String json = "{";
+  json += "\"slackMs\":";
+  json += g_slackMs == SD_BUS_NO_DEADLINE ? String("null") : String(g_slackMs);
+  json += ",\"deadlineMisses\":" + String(g_deadlineMisses);
+  for (int c = 0; c < SD_IO_CLASSES; c++) {
+    const SdClassStats& s = g_stats[c];
+    uint32_t kbps = s.busyUs > 0 ? (uint32_t)(s.bytes * 1000000 / s.busyUs / 1024) : 0;
+
+    json += ",\"" + String(CLASS_NAMES[c]) + "\":{";
+    json += "\"slices\":" + String(s.slices) + ",";
+    json += "\"kb\":" + String((uint32_t)(s.bytes / 1024)) + ",";
+    json += "\"busyMs\":" + String((uint32_t)(s.busyUs / 1000)) + ",";
+    json += "\"kbps\":" + String(kbps) + ",";
+    json += "\"waitMs\":" + String((uint32_t)(s.waitUs / 1000)) + ",";
+    json += "\"maxWaitMs\":" + String(s.maxWaitUs / 1000) + ",";
+    json += "\"deferred\":" + String(s.deferred);
+    json += "}";
+  }
+  json += "}";
+  return json;
+}
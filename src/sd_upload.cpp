@@ -1,16 +1,51 @@
 #include "sd_upload.h"
 
-#include "audio_player.h"
+#include "crc32.h"
+#include "gzip_stream.h"
+#include "media_library.h"
+#include "sd_alloc.h"
+#include "sd_bus.h"
+#include "tar_stream.h"
 #include "web_log.h"
 
 #include <SD.h>
 
-// Upload buffer for faster writes.
-// Larger buffer = fewer SD writes = faster upload.
-// 32KB is a good balance between speed and memory usage.
-static const size_t UPLOAD_BUFFER_SIZE = 32768; // 32KB buffer.
-static uint8_t*     g_uploadBuffer     = nullptr;
-static size_t       g_uploadBufferPos  = 0;
+// Pipelined writes: the web thread fills one buffer while a core 0 writer
+// task commits the previous ones, so TCP receive continues during card
+// writes. A buffer is one FAT cluster, or a power-of-two share of one, so
+// every write except the last starts and ends on a cluster boundary.
+static const size_t UPLOAD_BUFFER_MIN  = 16384;
+static const size_t UPLOAD_BUFFER_MAX  = 32768;
+static const size_t UPLOAD_POOL_BYTES  = 65536; // All buffers together.
+static const int    UPLOAD_MAX_BUFFERS = 3;
+
+struct UploadBlock {
+  uint8_t index;
+  size_t  len;
+};
+
+static uint8_t*      g_buffers[UPLOAD_MAX_BUFFERS];
+static int           g_bufferCount = 0;
+static size_t        g_bufferSize  = 0;
+static int           g_fillIndex   = -1; // Buffer the web thread is filling.
+static size_t        g_fillPos     = 0;
+static QueueHandle_t g_freeQueue   = nullptr; // uint8_t buffer indices.
+static QueueHandle_t g_fullQueue   = nullptr; // UploadBlock.
+static TaskHandle_t  g_writerTask  = nullptr;
+static volatile bool g_writeFailed = false;
+
+// Phase timing of the current upload.
+static uint64_t          g_netWaitUs      = 0; // Between upload callbacks (network receive).
+static uint64_t          g_stallUs        = 0; // Web thread waiting for a free buffer.
+static uint32_t          g_lastCallbackUs = 0;
+static volatile uint32_t g_sdWriteMs      = 0; // Writer task inside SD writes.
+static volatile size_t   g_sdBytes        = 0;
+
+// Clusters reserved up front from Content-Length, and the layout the
+// finished file ended up with.
+static SdPrealloc g_prealloc  = SD_PREALLOC_NONE;
+static SdFragInfo g_fragments = {};
+static bool       g_fragKnown = false;
 
 static File          g_uploadFile;
 static String        g_uploadStatus     = "";
@@ -19,7 +54,51 @@ static size_t        g_uploadSize       = 0;
 static size_t        g_uploadTotalSize  = 0;
 static unsigned long g_uploadStartTime  = 0;
 static bool          g_uploadInProgress = false;
-static bool          g_audioWasPlaying  = false; // Track if we stopped audio.
+
+// Endpoints, for the throughput comparison in /upload-progress.
+enum UploadKind {
+  UPLOAD_MULTIPART, // POST /upload
+  UPLOAD_PUT,       // PUT /fs/<path>
+  UPLOAD_TAR,       // POST /upload-tar, per member
+  UPLOAD_KINDS
+};
+
+static const char* const UPLOAD_KIND_NAMES[UPLOAD_KINDS] = {"multipart", "put", "tar"};
+static float             g_lastKBps[UPLOAD_KINDS]        = {0, 0, 0};
+
+// Archive members log one line each instead of the full report, and the
+// library hears about the unpacked tree once at the end, not per member.
+static bool g_uploadQuiet = false;
+
+// Content-Encoding: gzip bodies are inflated on the way to the card.
+static const size_t BODY_READ_CHUNK = 4096;
+static GzipStream   g_gzip;
+static uint64_t     g_gzipInBytes  = 0; // Compressed bytes of the last upload, 0 if plain.
+static uint64_t     g_gzipOutBytes = 0;
+
+// PUT gives up when the client sends nothing for this long.
+static const uint32_t PUT_IDLE_TIMEOUT_MS = 5000;
+
+// Resumable sessions: the file is written to SESSION_DIR/<id>.part and
+// renamed into place once complete and verified. Sessions live in RAM; part
+// files left by a reboot are removed when the first session starts.
+static const char*    SESSION_DIR     = "/.upload";
+static const int      SESSION_MAX     = 4;
+static const uint32_t SESSION_IDLE_MS = 60UL * 60 * 1000; // Reusable after 1 h idle.
+
+struct UploadSession {
+  char     id[9]; // 8 hex digits, "" when the slot is free.
+  String   path;
+  size_t   size;
+  size_t   offset; // Bytes on the card, in order from 0.
+  uint32_t crc;    // CRC-32 of bytes [0, offset).
+  uint32_t chunks;
+  size_t   resent; // Retransmitted bytes dropped as already present.
+  uint32_t lastActiveMs;
+};
+
+static UploadSession g_sessions[SESSION_MAX];
+static bool          g_sessionDirReady = false;
 
 // Progress logging interval (bytes).
 static const size_t LOG_INTERVAL  = 1024 * 1024; // Every 1MB.
@@ -30,10 +109,30 @@ String sdUploadGetStatus()
   return g_uploadStatus;
 }
 
+bool sdUploadIsActive()
+{
+  return g_uploadInProgress;
+}
+
 String sdUploadGetProgressJson()
 {
+  // Speed of the last completed upload per endpoint.
+  String last = "\"lastKBps\":{";
+  for (int k = 0; k < UPLOAD_KINDS; k++) {
+    last += String(k > 0 ? "," : "") + "\"" + UPLOAD_KIND_NAMES[k] + "\":";
+    last += String(g_lastKBps[k], 1);
+  }
+  last += "}";
+
+  int sessions = 0;
+  for (int i = 0; i < SESSION_MAX; i++) {
+    if (g_sessions[i].id[0] != '\0')
+      sessions++;
+  }
+  last += ",\"sessions\":" + String(sessions);
+
   if (!g_uploadInProgress) {
-    return "{\"inProgress\":false}";
+    return "{\"inProgress\":false," + last + "}";
   }
 
   unsigned long elapsed    = millis() - g_uploadStartTime;
@@ -61,21 +160,186 @@ String sdUploadGetProgressJson()
   json += "\"total\":" + String(g_uploadTotalSize) + ",";
   json += "\"percent\":" + String(percent) + ",";
   json += "\"speedKBps\":" + String(speedKBps, 1) + ",";
-  json += "\"etaSeconds\":" + String(etaSeconds);
+  json += "\"etaSeconds\":" + String(etaSeconds) + ",";
+
+  // Where the time goes: a pipeline that keeps up shows stallMs near zero.
+  uint32_t sdWriteMs = g_sdWriteMs;
+  uint32_t sdKBps    = 0;
+  if (sdWriteMs > 0)
+    sdKBps = (uint32_t)((uint64_t)g_sdBytes * 1000 / sdWriteMs / 1024);
+  json += "\"netWaitMs\":" + String((uint32_t)(g_netWaitUs / 1000)) + ",";
+  json += "\"sdWriteMs\":" + String(sdWriteMs) + ",";
+  json += "\"stallMs\":" + String((uint32_t)(g_stallUs / 1000)) + ",";
+  json += "\"sdKBps\":" + String(sdKBps) + ",";
+  json += "\"buffers\":" + String(g_bufferCount) + ",";
+  json += "\"bufferKB\":" + String((uint32_t)(g_bufferSize / 1024)) + ",";
+  json += last;
   json += "}";
 
   return json;
 }
 
-// Flush buffer to SD card.
-static void flushUploadBuffer()
+static void uploadWriterTask(void* param)
+{
+  (void)param;
+
+  uint32_t    carryUs = 0;
+  UploadBlock block;
+  for (;;) {
+    if (xQueueReceive(g_fullQueue, &block, portMAX_DELAY) != pdTRUE)
+      continue;
+
+    // Bus slices let playback reads in between.
+    uint32_t startUs = micros();
+    if (!g_writeFailed &&
+        sdBusWrite(SD_IO_UPLOAD, g_uploadFile, g_buffers[block.index], block.len) != block.len)
+      g_writeFailed = true;
+
+    uint32_t us = micros() - startUs + carryUs;
+    g_sdWriteMs = g_sdWriteMs + us / 1000;
+    carryUs     = us % 1000;
+    g_sdBytes   = g_sdBytes + block.len;
+
+    xQueueSend(g_freeQueue, &block.index, portMAX_DELAY);
+  }
+}
+
+// Buffers, queues and the writer task are created on the first upload and
+// kept, like the single buffer they replace.
+static bool pipelineInit()
+{
+  if (g_writerTask)
+    return true;
+
+  size_t cluster = sdBusClusterBytes();
+  g_bufferSize   = cluster < UPLOAD_BUFFER_MIN   ? UPLOAD_BUFFER_MIN
+                   : cluster > UPLOAD_BUFFER_MAX ? UPLOAD_BUFFER_MAX
+                                                 : cluster;
+  int count = (int)(UPLOAD_POOL_BYTES / g_bufferSize);
+  if (count > UPLOAD_MAX_BUFFERS)
+    count = UPLOAD_MAX_BUFFERS;
+
+  for (g_bufferCount = 0; g_bufferCount < count; g_bufferCount++) {
+    if (!g_buffers[g_bufferCount])
+      g_buffers[g_bufferCount] = (uint8_t*)malloc(g_bufferSize);
+    if (!g_buffers[g_bufferCount])
+      break;
+  }
+
+  // One buffer still works, just without overlap.
+  if (g_bufferCount == 0)
+    return false;
+
+  if (!g_freeQueue)
+    g_freeQueue = xQueueCreate(UPLOAD_MAX_BUFFERS, sizeof(uint8_t));
+  if (!g_fullQueue)
+    g_fullQueue = xQueueCreate(UPLOAD_MAX_BUFFERS, sizeof(UploadBlock));
+  if (!g_freeQueue || !g_fullQueue)
+    return false;
+  xQueueReset(g_freeQueue);
+
+  for (int i = 0; i < g_bufferCount; i++) {
+    uint8_t index = (uint8_t)i;
+    xQueueSend(g_freeQueue, &index, 0);
+  }
+
+  if (xTaskCreatePinnedToCore(uploadWriterTask, "upload", 4096, nullptr, 3, &g_writerTask, 0) !=
+      pdPASS) {
+    g_writerTask = nullptr;
+    return false;
+  }
+
+  WebLog.print("[UPLOAD] Pipeline: ");
+  WebLog.print(g_bufferCount);
+  WebLog.print(" x ");
+  WebLog.print(g_bufferSize / 1024);
+  WebLog.println(" KB buffers");
+  return true;
+}
+
+// Clear the counters; every buffer is free between uploads.
+static void pipelineReset()
+{
+  g_fillIndex   = -1;
+  g_fillPos     = 0;
+  g_writeFailed = false;
+  g_netWaitUs   = 0;
+  g_stallUs     = 0;
+  g_sdWriteMs   = 0;
+  g_sdBytes     = 0;
+}
+
+// Hand the buffer being filled to the writer.
+static void pipelineSubmit()
+{
+  if (g_fillIndex < 0)
+    return;
+
+  UploadBlock block = {(uint8_t)g_fillIndex, g_fillPos};
+  if (block.len > 0) {
+    xQueueSend(g_fullQueue, &block, portMAX_DELAY);
+  } else {
+    xQueueSend(g_freeQueue, &block.index, portMAX_DELAY);
+  }
+  g_fillIndex = -1;
+  g_fillPos   = 0;
+}
+
+// Free space in the buffer being filled, taking a free buffer if needed.
+static uint8_t* pipelineReserve(size_t* room)
+{
+  if (g_fillIndex < 0) {
+    // All buffers queued: the card is the bottleneck right now.
+    uint32_t startUs = micros();
+    uint8_t  index   = 0;
+    xQueueReceive(g_freeQueue, &index, portMAX_DELAY);
+    g_stallUs += micros() - startUs;
+    g_fillIndex = index;
+    g_fillPos   = 0;
+  }
+
+  *room = g_bufferSize - g_fillPos;
+  return g_buffers[g_fillIndex] + g_fillPos;
+}
+
+// Account n bytes placed at pipelineReserve(); full buffers go to the writer.
+static void pipelineCommit(size_t n)
 {
-  if (g_uploadFile && g_uploadBufferPos > 0) {
-    g_uploadFile.write(g_uploadBuffer, g_uploadBufferPos);
-    g_uploadBufferPos = 0;
+  g_fillPos += n;
+  if (g_fillPos == g_bufferSize)
+    pipelineSubmit();
+}
+
+static void pipelinePut(const uint8_t* data, size_t len)
+{
+  while (len > 0) {
+    size_t   n   = 0;
+    uint8_t* dst = pipelineReserve(&n);
+    if (n > len)
+      n = len;
+    memcpy(dst, data, n);
+    pipelineCommit(n);
+    data += n;
+    len -= n;
   }
 }
 
+// Submit the partial buffer and wait until the writer has committed all.
+static void pipelineDrain()
+{
+  pipelineSubmit();
+
+  uint32_t startUs = micros();
+  uint8_t  held[UPLOAD_MAX_BUFFERS];
+  for (int i = 0; i < g_bufferCount; i++) {
+    xQueueReceive(g_freeQueue, &held[i], portMAX_DELAY);
+  }
+  for (int i = 0; i < g_bufferCount; i++) {
+    xQueueSend(g_freeQueue, &held[i], 0);
+  }
+  g_stallUs += micros() - startUs;
+}
+
 static void handleUploadPage(WebServer& server)
 {
   String html = R"HTML(
@@ -85,9 +349,16 @@ static void handleUploadPage(WebServer& server)
 <body style="background:#0b1020;color:#e7e9ee;font-family:sans-serif;padding:20px">
 <h2>📤 Загрузка файла на SD</h2>
 <form method="POST" action="/upload" enctype="multipart/form-data">
-  <input type="file" name="file" accept=".wav,.mp3,.txt,.json" style="margin:10px 0"><br>
+  <input type="file" name="file" accept=".wav,.mp3,.flac,.txt,.json" style="margin:10px 0"><br>
   <input type="submit" value="Загрузить" style="padding:10px 20px;cursor:pointer">
 </form>
+<h3>📦 Архив .tar / .tar.gz</h3>
+<form method="POST" action="/upload-tar" enctype="multipart/form-data"
+      onsubmit="this.action='/upload-tar?dest='+encodeURIComponent(this.querySelector('#dest').value)">
+  <input id="dest" type="text" value="/" placeholder="Папка назначения" style="margin:10px 0"><br>
+  <input type="file" name="file" accept=".tar,.tar.gz,.tgz" style="margin:10px 0"><br>
+  <input type="submit" value="Распаковать" style="padding:10px 20px;cursor:pointer">
+</form>
 <p id="status"></p>
 </body>
 </html>
@@ -95,177 +366,1263 @@ static void handleUploadPage(WebServer& server)
   server.send(200, "text/html", html);
 }
 
+// Create the target and reset progress; false with g_uploadStatus set on
+// failure. reserve is an upper bound of the file size (0 if unknown).
+static bool uploadOpen(const String& path, size_t reserve)
+{
+  // Hidden paths hold the library, search and cache files.
+  if (libraryIsHiddenPath(path)) {
+    WebLog.print("[UPLOAD] ❌ Hidden path rejected: ");
+    WebLog.println(path);
+    g_uploadStatus = "Ошибка: недопустимый путь";
+    return false;
+  }
+
+  g_uploadPath       = path.startsWith("/") ? path : "/" + path;
+  g_uploadSize       = 0;
+  g_uploadTotalSize  = reserve;
+  g_uploadStartTime  = millis();
+  g_uploadInProgress = true;
+  g_lastLogSize      = 0;
+
+  // A previous upload that never reached END or ABORTED still owns the writer.
+  if (g_uploadFile) {
+    pipelineDrain();
+    g_uploadFile.close();
+  }
+
+  if (!pipelineInit()) {
+    WebLog.println("[UPLOAD] ❌ Failed to allocate buffer");
+    g_uploadStatus     = "Ошибка: недостаточно памяти";
+    g_uploadInProgress = false;
+    return false;
+  }
+  pipelineReset();
+
+  if (!g_uploadQuiet) {
+    WebLog.print("[UPLOAD] Starting: ");
+    WebLog.println(g_uploadPath);
+  }
+  if (g_uploadTotalSize > 0 && !g_uploadQuiet) {
+    WebLog.print("[UPLOAD] Total size: ");
+    WebLog.print(g_uploadTotalSize / 1024);
+    WebLog.println(" KB");
+  }
+
+  {
+    SdBusSlice slice(SD_IO_UPLOAD);
+    if (SD.exists(g_uploadPath)) {
+      SD.remove(g_uploadPath);
+    }
+  }
+
+  // Reserve up to the bound and cut the rest off at the end. "r+" writes
+  // into the reservation, FILE_WRITE would release it.
+  g_prealloc     = SD_PREALLOC_NONE;
+  g_fragKnown    = false;
+  g_gzipInBytes  = 0;
+  g_gzipOutBytes = 0;
+  if (reserve > 0)
+    g_prealloc = sdPreallocate(g_uploadPath, reserve);
+
+  {
+    SdBusSlice slice(SD_IO_UPLOAD);
+    g_uploadFile = SD.open(g_uploadPath, g_prealloc != SD_PREALLOC_NONE ? "r+" : FILE_WRITE);
+  }
+  if (!g_uploadFile) {
+    WebLog.println("[UPLOAD] ❌ Failed to create file");
+    g_uploadStatus     = "Ошибка: не удалось создать файл";
+    g_uploadInProgress = false;
+    return false;
+  }
+
+  g_uploadStatus = "Загрузка...";
+  return true;
+}
+
+static void uploadLogProgress()
+{
+  if (g_uploadSize - g_lastLogSize < LOG_INTERVAL)
+    return;
+
+  unsigned long elapsed   = millis() - g_uploadStartTime;
+  float         speedKBps = (float)g_uploadSize / 1024.0f / ((float)elapsed / 1000.0f);
+
+  WebLog.print("[UPLOAD] ");
+  WebLog.print(g_uploadSize / 1024);
+  WebLog.print(" KB");
+  if (g_uploadTotalSize > 0) {
+    int percent = (int)((uint64_t)g_uploadSize * 100 / g_uploadTotalSize);
+    WebLog.print(" (");
+    WebLog.print(percent);
+    WebLog.print("%)");
+  }
+  WebLog.print(" @ ");
+  WebLog.print(speedKBps, 1);
+  WebLog.println(" KB/s");
+
+  g_lastLogSize = g_uploadSize;
+}
+
+// Commit everything, trim the reservation and report. A failed write
+// removes the file. kind names the endpoint in the throughput stats.
+static bool uploadFinish(UploadKind kind)
+{
+  g_uploadInProgress = false;
+  if (!g_uploadFile)
+    return false;
+
+  // Commit the partial buffer and whatever the writer still holds.
+  pipelineDrain();
+  g_uploadFile.close();
+
+  // A short file is worse than none: drop it like an aborted upload.
+  if (g_writeFailed) {
+    SD.remove(g_uploadPath);
+    if (!g_uploadQuiet)
+      libraryNoteRemoved(g_uploadPath);
+    WebLog.println("[UPLOAD] ❌ Write failed (card full?)");
+    g_uploadStatus = "Ошибка: не удалось записать файл";
+    return false;
+  }
+
+  if (g_prealloc != SD_PREALLOC_NONE && !sdTruncate(g_uploadPath, g_uploadSize))
+    WebLog.println("[UPLOAD] ⚠️ Cannot trim reserved space");
+
+  unsigned long elapsed = millis() - g_uploadStartTime;
+  float         speedKBps =
+      elapsed > 0 ? (float)g_uploadSize / 1024.0f / ((float)elapsed / 1000.0f) : 0;
+  g_lastKBps[kind] = speedKBps;
+
+  WebLog.print("[UPLOAD] ✅ Complete: ");
+  WebLog.print(g_uploadPath);
+  WebLog.print(" (");
+  WebLog.print(g_uploadSize / 1024);
+  WebLog.print(" KB in ");
+  WebLog.print(elapsed / 1000);
+  WebLog.print("s @ ");
+  WebLog.print(speedKBps, 1);
+  WebLog.print(" KB/s, ");
+  WebLog.print(UPLOAD_KIND_NAMES[kind]);
+  WebLog.println(")");
+
+  g_uploadStatus = "✅ Загружено: " + g_uploadPath + " (" + String(g_uploadSize / 1024) + " KB)";
+  if (g_uploadQuiet)
+    return true;
+  libraryNoteChanged(g_uploadPath);
+
+  WebLog.print("[UPLOAD] Network ");
+  WebLog.print((uint32_t)(g_netWaitUs / 1000));
+  WebLog.print(" ms, SD write ");
+  WebLog.print(g_sdWriteMs);
+  WebLog.print(" ms, stalled on SD ");
+  WebLog.print((uint32_t)(g_stallUs / 1000));
+  WebLog.println(" ms");
+
+  g_fragKnown = sdFileFragments(g_uploadPath, &g_fragments);
+  if (g_fragKnown) {
+    WebLog.print("[UPLOAD] Layout: ");
+    WebLog.print(g_fragments.fragments <= 1 ? "contiguous" : "fragmented");
+    WebLog.print(", ");
+    WebLog.print(g_fragments.fragments);
+    WebLog.print(" run(s) of ");
+    WebLog.print(g_fragments.clusters);
+    WebLog.print(" clusters");
+    WebLog.println(g_prealloc == SD_PREALLOC_CONTIGUOUS ? " (reserved)" : "");
+  }
+  return true;
+}
+
+static void uploadAbort()
+{
+  g_uploadInProgress = false;
+
+  if (g_uploadFile) {
+    pipelineDrain();
+    g_uploadFile.close();
+    SD.remove(g_uploadPath);
+    if (!g_uploadQuiet)
+      libraryNoteRemoved(g_uploadPath);
+  }
+  WebLog.println("[UPLOAD] ❌ Aborted");
+  g_uploadStatus = "❌ Загрузка прервана";
+}
+
+// ",\"gzip\":{...}" for a compressed body, else "". speedKBps of the
+// result is the effective rate (inflated bytes); wireKBps is what crossed
+// the network.
+static String gzipResultJson(uint32_t elapsedMs)
+{
+  if (g_gzipInBytes == 0)
+    return "";
+
+  float  ratio = (float)g_gzipOutBytes / (float)g_gzipInBytes;
+  String json  = ",\"gzip\":{";
+  json += "\"compressed\":" + String((uint32_t)g_gzipInBytes) + ",";
+  json += "\"inflated\":" + String((uint32_t)g_gzipOutBytes) + ",";
+  json += "\"ratio\":" + String(ratio, 2) + ",";
+  json += "\"wireKBps\":";
+  json += String(elapsedMs > 0 ? (float)g_gzipInBytes / 1024.0f * 1000.0f / elapsedMs : 0, 1);
+  json += "}";
+  return json;
+}
+
+// Read length body bytes from the client in BODY_READ_CHUNK pieces and pass
+// them to fn (false stops). Returns the bytes read, short if the client
+// stalls, disconnects or fn stops.
+typedef bool (*BodyFn)(const uint8_t* data, size_t len, void* ctx);
+
+static size_t clientStream(WebServer& server, size_t length, BodyFn fn, void* ctx)
+{
+  uint8_t* buf = (uint8_t*)malloc(BODY_READ_CHUNK);
+  if (!buf)
+    return 0;
+
+  WiFiClient client     = server.client();
+  size_t     received   = 0;
+  uint32_t   lastDataMs = millis();
+  while (received < length) {
+    size_t   want    = length - received < BODY_READ_CHUNK ? length - received : BODY_READ_CHUNK;
+    uint32_t startUs = micros();
+    int      n       = client.available() > 0 ? client.read(buf, want) : 0;
+    if (n > 0) {
+      g_netWaitUs += micros() - startUs;
+      received += (size_t)n;
+      lastDataMs = millis();
+      if (!fn(buf, (size_t)n, ctx))
+        break;
+      continue;
+    }
+    if (!client.connected() || millis() - lastDataMs > PUT_IDLE_TIMEOUT_MS)
+      break;
+    delay(1);
+    g_netWaitUs += micros() - startUs;
+  }
+  free(buf);
+  return received;
+}
+
+static bool gzipBodyFeed(const uint8_t* data, size_t len, void* ctx)
+{
+  return gzipFeed((GzipStream*)ctx, data, len);
+}
+
+// Inflated upload data into the pipeline.
+static bool gzipToPipeline(const uint8_t* data, size_t len, void* ctx)
+{
+  (void)ctx;
+  pipelinePut(data, len);
+  g_uploadSize += len;
+  uploadLogProgress();
+  return !g_writeFailed;
+}
+
+// Result of the last upload: path, size, throughput and file layout.
+static String uploadResultJson()
+{
+  unsigned long elapsed = millis() - g_uploadStartTime;
+
+  String json = "{\"status\":\"";
+  json += g_uploadStatus;
+  json += "\",\"path\":\"";
+  json += g_uploadPath;
+  json += "\",\"size\":";
+  json += String(g_uploadSize);
+  json += ",\"elapsedMs\":";
+  json += String(elapsed);
+  json += ",\"speedKBps\":";
+  json += String(elapsed > 0 ? (float)g_uploadSize / 1024.0f * 1000.0f / elapsed : 0, 1);
+  json += ",\"preallocated\":";
+  json += g_prealloc == SD_PREALLOC_CONTIGUOUS ? "\"contiguous\""
+          : g_prealloc == SD_PREALLOC_EXTENDED ? "\"extended\""
+                                               : "false";
+  if (g_fragKnown) {
+    json += ",\"contiguous\":";
+    json += g_fragments.fragments <= 1 ? "true" : "false";
+    json += ",\"fragments\":";
+    json += String(g_fragments.fragments);
+  }
+  json += gzipResultJson(elapsed);
+  json += "}";
+  return json;
+}
+
 static void handleUploadData(WebServer& server)
 {
   HTTPUpload& upload = server.upload();
 
   if (upload.status == UPLOAD_FILE_START) {
-    String filename = upload.filename;
-    if (!filename.startsWith("/")) {
-      filename = "/" + filename;
-    }
-    g_uploadPath       = filename;
-    g_uploadSize       = 0;
-    g_uploadTotalSize  = upload.totalSize;
-    g_uploadStartTime  = millis();
-    g_uploadInProgress = true;
-    g_lastLogSize      = 0;
-    g_uploadBufferPos  = 0;
-
-    // Stop audio playback to free SD bandwidth.
-    g_audioWasPlaying = audioIsRunning();
-    if (g_audioWasPlaying) {
-      WebLog.println("[UPLOAD] ⏸ Pausing audio for faster upload");
-      audioStop();
-    }
-
-    // Allocate upload buffer if not already allocated.
-    if (!g_uploadBuffer) {
-      g_uploadBuffer = (uint8_t*)malloc(UPLOAD_BUFFER_SIZE);
-      if (!g_uploadBuffer) {
-        WebLog.println("[UPLOAD] ❌ Failed to allocate buffer");
-        g_uploadStatus     = "Ошибка: недостаточно памяти";
-        g_uploadInProgress = false;
+    // The request body bounds the file size (multipart adds a few hundred
+    // bytes of headers).
+    size_t reserve = server.clientContentLength();
+    if (reserve == CONTENT_LENGTH_UNKNOWN)
+      reserve = 0;
+    uploadOpen(upload.filename, reserve);
+    g_lastCallbackUs = micros();
+
+  } else if (upload.status == UPLOAD_FILE_WRITE) {
+    if (g_uploadFile && g_writerTask) {
+      // The time since the last callback went to receiving this chunk.
+      g_netWaitUs += micros() - g_lastCallbackUs;
+
+      pipelinePut(upload.buf, upload.currentSize);
+      g_uploadSize += upload.currentSize;
+      uploadLogProgress();
+      g_lastCallbackUs = micros();
+    }
+
+  } else if (upload.status == UPLOAD_FILE_END) {
+    uploadFinish(UPLOAD_MULTIPART);
+
+  } else if (upload.status == UPLOAD_FILE_ABORTED) {
+    uploadAbort();
+  }
+}
+
+static void handleUploadComplete(WebServer& server)
+{
+  server.send(200, "application/json", uploadResultJson());
+}
+
+// ----------------------------------------------------------------------------
+// PUT /fs/<path>: raw request body straight into the pipeline.
+// ----------------------------------------------------------------------------
+
+// Percent-decode a request path ("%20" -> " ").
+static String decodePath(const String& uri)
+{
+  String out;
+  out.reserve(uri.length());
+  for (size_t i = 0; i < uri.length(); i++) {
+    char c = uri[i];
+    if (c == '%' && i + 2 < uri.length() && isxdigit(uri[i + 1]) && isxdigit(uri[i + 2])) {
+      char hex[3] = {uri[i + 1], uri[i + 2], '\0'};
+      out += (char)strtol(hex, nullptr, 16);
+      i += 2;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+// Read length body bytes from the client into the pipeline, dropping the
+// first skip of them (already on the card). crc, if given, runs over the
+// bytes kept. Returns the bytes read, short if the client stalls or
+// disconnects first.
+static size_t uploadReceive(WebServer& server, size_t length, size_t skip, uint32_t* crc)
+{
+  WiFiClient client     = server.client();
+  size_t     received   = 0;
+  uint32_t   lastDataMs = millis();
+  uint8_t    scratch[256];
+
+  while (received < length) {
+    size_t   room = 0;
+    uint8_t* dst  = nullptr;
+    if (received < skip) {
+      dst  = scratch;
+      room = skip - received < sizeof(scratch) ? skip - received : sizeof(scratch);
+    } else {
+      dst = pipelineReserve(&room);
+      if (room > length - received)
+        room = length - received;
+    }
+
+    uint32_t startUs = micros();
+    int      n       = client.available() > 0 ? client.read(dst, room) : 0;
+    if (n > 0) {
+      g_netWaitUs += micros() - startUs;
+      received += (size_t)n;
+      lastDataMs = millis();
+      if (dst == scratch)
+        continue;
+
+      if (crc)
+        *crc = crc32Update(*crc, dst, (size_t)n);
+      pipelineCommit((size_t)n);
+      g_uploadSize += (size_t)n;
+      uploadLogProgress();
+      continue;
+    }
+
+    if (!client.connected() || millis() - lastDataMs > PUT_IDLE_TIMEOUT_MS)
+      break;
+    delay(1);
+    g_netWaitUs += micros() - startUs;
+  }
+  return received;
+}
+
+// The multipart path reads the body a byte at a time while it scans for the
+// boundary, then copies it through HTTP_UPLOAD_BUFLEN chunks. Here the raw
+// body is read from the socket straight into the writer's buffers. The
+// handler takes over at RAW_START and marks the body consumed, so the
+// server's own HTTP_RAW_BUFLEN loop never runs.
+class FsPutHandler : public RequestHandler
+{
+public:
+  bool canHandle(HTTPMethod method, String uri) override
+  {
+    return method == HTTP_PUT && uri.startsWith(FS_PUT_PREFIX);
+  }
+
+  bool canRaw(String uri) override { return uri.startsWith(FS_PUT_PREFIX); }
+
+  void raw(WebServer& server, String requestUri, HTTPRaw& raw) override
+  {
+    if (raw.status != RAW_START)
+      return;
+
+    size_t length = server.clientContentLength();
+    m_code        = 500;
+    m_error       = "";
+
+    String path = decodePath(requestUri.substring(strlen(FS_PUT_PREFIX) - 1));
+    if (path.length() < 2 || path.endsWith("/") || path.indexOf("..") >= 0 ||
+        libraryIsHiddenPath(path)) {
+      m_code  = 400;
+      m_error = "bad path";
+    } else if (server.header("Content-Encoding") == "gzip") {
+      receiveGzip(server, path, length);
+    } else if (!uploadOpen(path, length)) {
+      m_error = "cannot create file";
+    } else if (uploadReceive(server, length, 0, nullptr) < length) {
+      m_error = "connection lost";
+      uploadAbort();
+    } else if (uploadFinish(UPLOAD_PUT)) {
+      m_code = 200;
+    }
+
+    // Whatever is left of the body is ours to drop, not the server's to read.
+    raw.totalSize = length;
+  }
+
+  bool handle(WebServer& server, HTTPMethod method, String uri) override
+  {
+    (void)method;
+    (void)uri;
+
+    // No body, so raw() never ran for this request.
+    if (m_code == 0) {
+      server.send(411, "application/json", "{\"error\":\"empty body\"}");
+    } else if (m_error.length() > 0) {
+      server.send(m_code, "application/json", "{\"error\":\"" + m_error + "\"}");
+    } else {
+      server.send(m_code, "application/json", uploadResultJson());
+    }
+    m_code = 0;
+    return true;
+  }
+
+private:
+  static constexpr const char* FS_PUT_PREFIX = "/fs/";
+
+  int    m_code = 0; // Response for the body raw() consumed; 0 before one.
+  String m_error;
+
+  // Content-Length is the compressed size, so only an explicit ?size= hint
+  // reserves space.
+  void receiveGzip(WebServer& server, const String& path, size_t length)
+  {
+    size_t reserve = server.hasArg("size") ? (size_t)server.arg("size").toInt() : 0;
+    if (!uploadOpen(path, reserve)) {
+      m_error = "cannot create file";
+      return;
+    }
+    if (!gzipBegin(&g_gzip, gzipToPipeline, nullptr)) {
+      m_error = "out of memory";
+      uploadAbort();
+      return;
+    }
+
+    clientStream(server, length, gzipBodyFeed, &g_gzip);
+    const char* error = gzipError(&g_gzip);
+    bool        done  = gzipDone(&g_gzip);
+    g_gzipInBytes     = g_gzip.inBytes;
+    g_gzipOutBytes    = g_gzip.outBytes;
+    gzipEnd(&g_gzip);
+
+    // A short body leaves the stream unfinished without an error.
+    if (!done) {
+      m_code  = error && !g_writeFailed ? 400 : 500;
+      m_error = error ? error : "connection lost";
+      uploadAbort();
+    } else if (uploadFinish(UPLOAD_PUT)) {
+      m_code = 200;
+    }
+  }
+};
+
+// ----------------------------------------------------------------------------
+// Resumable sessions: /upload-session
+//   POST   /upload-session?path=&size=       start, returns the id
+//   PUT    /upload-session/<id>              body at Content-Range offset
+//   GET    /upload-session/<id>              resume query: offset and CRC
+//   POST   /upload-session/<id>[?crc32=&verify=1]  check and rename into place
+//   DELETE /upload-session/<id>              cancel
+// ----------------------------------------------------------------------------
+
+static String sessionPartPath(const UploadSession& session)
+{
+  return String(SESSION_DIR) + "/" + session.id + ".part";
+}
+
+static String sessionJson(const UploadSession& session)
+{
+  char crc[9];
+  snprintf(crc, sizeof(crc), "%08x", (unsigned)session.crc);
+
+  String json = "{";
+  json += "\"id\":\"" + String(session.id) + "\",";
+  json += "\"path\":\"" + session.path + "\",";
+  json += "\"size\":" + String(session.size) + ",";
+  json += "\"offset\":" + String(session.offset) + ",";
+  json += "\"crc32\":\"" + String(crc) + "\",";
+  json += "\"chunks\":" + String(session.chunks) + ",";
+  json += "\"resent\":" + String(session.resent);
+  json += "}";
+  return json;
+}
+
+static String errorJson(const String& error)
+{
+  return "{\"error\":\"" + error + "\"}";
+}
+
+static UploadSession* sessionFind(const String& id)
+{
+  for (int i = 0; i < SESSION_MAX; i++) {
+    if (g_sessions[i].id[0] != '\0' && id == g_sessions[i].id)
+      return &g_sessions[i];
+  }
+  return nullptr;
+}
+
+static void sessionFree(UploadSession& session)
+{
+  session.id[0] = '\0';
+  session.path  = "";
+}
+
+// Make the part directory and drop parts whose sessions died with a reboot.
+static void sessionDirPrepare()
+{
+  if (g_sessionDirReady)
+    return;
+
+  SdBusSlice slice(SD_IO_UPLOAD);
+  SD.mkdir(SESSION_DIR);
+  File dir = SD.open(SESSION_DIR);
+  if (dir) {
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+      String path = f.path();
+      f.close();
+      SD.remove(path);
+    }
+    dir.close();
+  }
+  g_sessionDirReady = true;
+}
+
+// Reopen a part file at offset for the next chunk.
+static bool uploadResume(const UploadSession& session, size_t chunkLength)
+{
+  g_uploadPath       = session.path;
+  g_uploadSize       = 0;
+  g_uploadTotalSize  = chunkLength;
+  g_uploadStartTime  = millis();
+  g_uploadInProgress = true;
+  g_lastLogSize      = LOG_INTERVAL; // Chunks are short; log per chunk only.
+
+  if (g_uploadFile) {
+    pipelineDrain();
+    g_uploadFile.close();
+  }
+  if (!pipelineInit()) {
+    g_uploadInProgress = false;
+    return false;
+  }
+  pipelineReset();
+
+  SdBusSlice slice(SD_IO_UPLOAD);
+  g_uploadFile = SD.open(sessionPartPath(session), "r+");
+  if (g_uploadFile && !g_uploadFile.seek(session.offset))
+    g_uploadFile.close();
+  g_uploadInProgress = (bool)g_uploadFile;
+  return g_uploadInProgress;
+}
+
+// Commit the chunk; false if a card write failed.
+static bool uploadSuspend()
+{
+  g_uploadInProgress = false;
+  if (!g_uploadFile)
+    return false;
+
+  pipelineDrain();
+  g_uploadFile.close();
+  return !g_writeFailed;
+}
+
+// CRC-32 of the part file as it is on the card.
+static bool sessionVerify(const UploadSession& session, uint32_t* crc)
+{
+  File f;
+  {
+    SdBusSlice slice(SD_IO_UPLOAD);
+    f = SD.open(sessionPartPath(session), FILE_READ);
+  }
+  if (!f || !pipelineInit())
+    return false;
+
+  // The pipeline is idle between requests; borrow its first buffer.
+  uint8_t* buf  = g_buffers[0];
+  size_t   left = session.size;
+  *crc          = 0;
+  while (left > 0) {
+    size_t n = left < g_bufferSize ? left : g_bufferSize;
+    if (sdBusRead(SD_IO_UPLOAD, f, buf, n) != n)
+      break;
+    *crc = crc32Update(*crc, buf, n);
+    left -= n;
+  }
+
+  SdBusSlice slice(SD_IO_UPLOAD);
+  f.close();
+  return left == 0;
+}
+
+class SessionHandler : public RequestHandler
+{
+public:
+  bool canHandle(HTTPMethod method, String uri) override
+  {
+    (void)method;
+    return uri == SESSION_PREFIX || uri.startsWith(String(SESSION_PREFIX) + "/");
+  }
+
+  bool canRaw(String uri) override { return canHandle(HTTP_PUT, uri); }
+
+  void raw(WebServer& server, String requestUri, HTTPRaw& raw) override
+  {
+    if (raw.status != RAW_START || server.method() != HTTP_PUT)
+      return;
+
+    m_code = 0;
+    UploadSession* session = sessionFind(idOf(requestUri));
+    if (!session)
+      return; // Let the server drain the body; handle() answers 404.
+
+    size_t length = server.clientContentLength();
+    size_t start  = session->offset;
+
+    // "bytes <first>-<last>/<size>"; a bare PUT appends.
+    String range = server.header("Content-Range");
+    if (range.length() > 0) {
+      unsigned long first = 0;
+      unsigned long last  = 0;
+      if (sscanf(range.c_str(), "bytes %lu-%lu", &first, &last) != 2 || last < first ||
+          last - first + 1 != length) {
+        respond(400, errorJson("bad Content-Range"));
         return;
       }
+      start = first;
+    } else if (server.hasArg("offset")) {
+      start = (size_t)server.arg("offset").toInt();
     }
 
-    WebLog.print("[UPLOAD] Starting: ");
-    WebLog.println(g_uploadPath);
-    if (g_uploadTotalSize > 0) {
-      WebLog.print("[UPLOAD] Total size: ");
-      WebLog.print(g_uploadTotalSize / 1024);
-      WebLog.println(" KB");
+    // A gap would leave a hole; the client must resume from offset.
+    if (start > session->offset || start + length > session->size) {
+      respond(416, sessionJson(*session));
+      return;
     }
 
-    if (SD.exists(g_uploadPath)) {
-      SD.remove(g_uploadPath);
+    // Bytes before offset were already stored (a chunk acknowledged late,
+    // or resent in full): read and drop them.
+    size_t skip = session->offset - start;
+    if (skip > length)
+      skip = length;
+
+    if (!uploadResume(*session, length)) {
+      respond(500, errorJson("cannot open part file"));
+      return;
+    }
+
+    uint32_t crc      = session->crc;
+    size_t   received = uploadReceive(server, length, skip, &crc);
+    bool     stored   = uploadSuspend();
+
+    // Keep whatever arrived before a drop: the retry starts from there.
+    if (stored && received > skip) {
+      session->offset += received - skip;
+      session->crc = crc;
     }
+    session->resent += received < skip ? received : skip;
+    session->chunks++;
+    session->lastActiveMs = millis();
 
-    g_uploadFile = SD.open(g_uploadPath, FILE_WRITE);
-    if (!g_uploadFile) {
-      WebLog.println("[UPLOAD] ❌ Failed to create file");
-      g_uploadStatus     = "Ошибка: не удалось создать файл";
-      g_uploadInProgress = false;
+    if (!stored) {
+      respond(500, errorJson("write failed"));
     } else {
-      g_uploadStatus = "Загрузка...";
+      respond(received == length ? 200 : 408, sessionJson(*session));
     }
+    raw.totalSize = length;
+  }
 
-  } else if (upload.status == UPLOAD_FILE_WRITE) {
-    if (g_uploadFile && g_uploadBuffer) {
-      size_t   bytesToWrite = upload.currentSize;
-      uint8_t* srcPtr       = upload.buf;
-
-      while (bytesToWrite > 0) {
-        size_t spaceInBuffer = UPLOAD_BUFFER_SIZE - g_uploadBufferPos;
-        size_t toCopy        = (bytesToWrite < spaceInBuffer) ? bytesToWrite : spaceInBuffer;
-
-        memcpy(g_uploadBuffer + g_uploadBufferPos, srcPtr, toCopy);
-        g_uploadBufferPos += toCopy;
-        srcPtr += toCopy;
-        bytesToWrite -= toCopy;
-
-        // Flush buffer when full.
-        if (g_uploadBufferPos >= UPLOAD_BUFFER_SIZE) {
-          flushUploadBuffer();
-        }
+  bool handle(WebServer& server, HTTPMethod method, String uri) override
+  {
+    if (method == HTTP_PUT && m_code != 0) {
+      server.send(m_code, "application/json", m_body);
+      m_code = 0;
+      return true;
+    }
+
+    if (uri == SESSION_PREFIX) {
+      if (method != HTTP_POST) {
+        server.send(405, "application/json", errorJson("method not allowed"));
+        return true;
       }
+      handleCreate(server);
+      return true;
+    }
 
-      g_uploadSize += upload.currentSize;
+    UploadSession* session = sessionFind(idOf(uri));
+    if (!session) {
+      server.send(404, "application/json", errorJson("no such session"));
+      return true;
+    }
 
-      if (g_uploadTotalSize == 0 && upload.totalSize > 0) {
-        g_uploadTotalSize = upload.totalSize;
+    if (method == HTTP_GET) {
+      server.send(200, "application/json", sessionJson(*session));
+    } else if (method == HTTP_POST) {
+      handleCommit(server, *session);
+    } else if (method == HTTP_DELETE) {
+      {
+        SdBusSlice slice(SD_IO_UPLOAD);
+        SD.remove(sessionPartPath(*session));
       }
+      WebLog.print("[UPLOAD] Session cancelled: ");
+      WebLog.println(session->path);
+      sessionFree(*session);
+      server.send(200, "application/json", "{\"cancelled\":true}");
+    } else {
+      server.send(405, "application/json", errorJson("method not allowed"));
+    }
+    return true;
+  }
 
-      // Log progress at intervals (reduced logging for speed).
-      if (g_uploadSize - g_lastLogSize >= LOG_INTERVAL) {
-        unsigned long elapsed   = millis() - g_uploadStartTime;
-        float         speedKBps = (float)g_uploadSize / 1024.0f / ((float)elapsed / 1000.0f);
-
-        WebLog.print("[UPLOAD] ");
-        WebLog.print(g_uploadSize / 1024);
-        WebLog.print(" KB");
-        if (g_uploadTotalSize > 0) {
-          int percent = (int)((uint64_t)g_uploadSize * 100 / g_uploadTotalSize);
-          WebLog.print(" (");
-          WebLog.print(percent);
-          WebLog.print("%)");
-        }
-        WebLog.print(" @ ");
-        WebLog.print(speedKBps, 1);
-        WebLog.println(" KB/s");
-
-        g_lastLogSize = g_uploadSize;
+private:
+  static constexpr const char* SESSION_PREFIX = "/upload-session";
+
+  int    m_code = 0; // Response for the chunk raw() consumed; 0 before one.
+  String m_body;
+
+  void respond(int code, const String& body)
+  {
+    m_code = code;
+    m_body = body;
+  }
+
+  static String idOf(const String& uri) { return uri.substring(strlen(SESSION_PREFIX) + 1); }
+
+  static void handleCreate(WebServer& server)
+  {
+    String path = server.arg("path");
+    size_t size = (size_t)server.arg("size").toInt();
+    if (!path.startsWith("/"))
+      path = "/" + path;
+    if (path.length() < 2 || path.endsWith("/") || path.indexOf("..") >= 0 || size == 0 ||
+        libraryIsHiddenPath(path)) {
+      server.send(400, "application/json", errorJson("need path and size"));
+      return;
+    }
+
+    // A free slot, else the one idle longest past the limit.
+    UploadSession* session = nullptr;
+    for (int i = 0; i < SESSION_MAX && !session; i++) {
+      if (g_sessions[i].id[0] == '\0')
+        session = &g_sessions[i];
+    }
+    for (int i = 0; i < SESSION_MAX && !session; i++) {
+      if (millis() - g_sessions[i].lastActiveMs > SESSION_IDLE_MS) {
+        session = &g_sessions[i];
+        SdBusSlice slice(SD_IO_UPLOAD);
+        SD.remove(sessionPartPath(*session));
       }
     }
+    if (!session) {
+      server.send(503, "application/json", errorJson("too many sessions"));
+      return;
+    }
 
-  } else if (upload.status == UPLOAD_FILE_END) {
-    // Flush remaining data in buffer.
-    flushUploadBuffer();
+    sessionDirPrepare();
+    snprintf(session->id, sizeof(session->id), "%08x", (unsigned)esp_random());
+    session->path         = path;
+    session->size         = size;
+    session->offset       = 0;
+    session->crc          = 0;
+    session->chunks       = 0;
+    session->resent       = 0;
+    session->lastActiveMs = millis();
 
-    g_uploadInProgress = false;
+    // Reserve the whole file now; chunks are written into it with "r+".
+    String part = sessionPartPath(*session);
+    if (sdPreallocate(part, size) == SD_PREALLOC_NONE) {
+      SdBusSlice slice(SD_IO_UPLOAD);
+      File       f = SD.open(part, FILE_WRITE);
+      if (!f) {
+        sessionFree(*session);
+        server.send(500, "application/json", errorJson("cannot create part file"));
+        return;
+      }
+      f.close();
+    }
 
-    if (g_uploadFile) {
-      g_uploadFile.close();
+    WebLog.print("[UPLOAD] Session ");
+    WebLog.print(session->id);
+    WebLog.print(": ");
+    WebLog.print(path);
+    WebLog.print(" (");
+    WebLog.print(size / 1024);
+    WebLog.println(" KB)");
+    server.send(200, "application/json", sessionJson(*session));
+  }
 
-      unsigned long elapsed = millis() - g_uploadStartTime;
-      float         speedKBps =
-          elapsed > 0 ? (float)g_uploadSize / 1024.0f / ((float)elapsed / 1000.0f) : 0;
+  static void handleCommit(WebServer& server, UploadSession& session)
+  {
+    if (session.offset != session.size) {
+      server.send(409, "application/json", sessionJson(session));
+      return;
+    }
 
-      WebLog.print("[UPLOAD] ✅ Complete: ");
-      WebLog.print(g_uploadPath);
-      WebLog.print(" (");
-      WebLog.print(g_uploadSize / 1024);
-      WebLog.print(" KB in ");
-      WebLog.print(elapsed / 1000);
-      WebLog.print("s @ ");
-      WebLog.print(speedKBps, 1);
-      WebLog.println(" KB/s)");
+    if (server.hasArg("crc32") &&
+        strtoul(server.arg("crc32").c_str(), nullptr, 16) != session.crc) {
+      WebLog.println("[UPLOAD] ❌ Session CRC mismatch");
+      server.send(422, "application/json", sessionJson(session));
+      return;
+    }
 
-      g_uploadStatus =
-          "✅ Загружено: " + g_uploadPath + " (" + String(g_uploadSize / 1024) + " KB)";
+    // Optional read-back: what the card holds, not just what was received.
+    bool verified = false;
+    if (server.arg("verify") == "1") {
+      uint32_t crc = 0;
+      if (!sessionVerify(session, &crc) || crc != session.crc) {
+        WebLog.println("[UPLOAD] ❌ Session read-back mismatch");
+        server.send(500, "application/json", errorJson("card data mismatch"));
+        return;
+      }
+      verified = true;
     }
 
-    // Resume audio if it was playing before.
-    if (g_audioWasPlaying) {
-      WebLog.println("[UPLOAD] ▶ Resuming audio playback");
-      audioStart();
-      g_audioWasPlaying = false;
+    // FAT has no rename-over: the old file goes first, then the complete
+    // part takes its name in one directory update.
+    String part = sessionPartPath(session);
+    bool   ok   = false;
+    {
+      SdBusSlice slice(SD_IO_UPLOAD);
+      if (SD.exists(session.path))
+        SD.remove(session.path);
+      ok = SD.rename(part, session.path);
+    }
+    if (!ok) {
+      server.send(500, "application/json", errorJson("rename failed"));
+      return;
     }
 
-  } else if (upload.status == UPLOAD_FILE_ABORTED) {
-    g_uploadInProgress = false;
-    g_uploadBufferPos  = 0;
+    WebLog.print("[UPLOAD] ✅ Session complete: ");
+    WebLog.print(session.path);
+    WebLog.print(" (");
+    WebLog.print(session.chunks);
+    WebLog.print(" chunks, ");
+    WebLog.print(session.resent / 1024);
+    WebLog.println(" KB resent)");
+    libraryNoteChanged(session.path);
 
-    if (g_uploadFile) {
-      g_uploadFile.close();
-      SD.remove(g_uploadPath);
+    String json = sessionJson(session);
+    json.remove(json.length() - 1);
+    json += ",\"verified\":" + String(verified ? "true" : "false") + "}";
+    sessionFree(session);
+    server.send(200, "application/json", json);
+  }
+};
+
+// ----------------------------------------------------------------------------
+// POST /upload-tar?dest=: unpack an archive as it arrives.
+// ----------------------------------------------------------------------------
+
+// Top-level entries under dest remembered for the library; past this the
+// whole destination is rescanned.
+static const uint32_t TAR_MAX_TOPS = 8;
+
+struct TarJob {
+  String      dest;     // Directory the archive is unpacked into, no trailing '/'.
+  String      created;  // First directory of dest that did not exist, or "".
+  String      lastDir;  // Last directory known to exist.
+  bool        skipping; // Current member could not be created.
+  bool        sniffed;  // First body bytes checked for gzip.
+  bool        gzip;     // .tar.gz: body goes through g_gzip first.
+  uint32_t    files;
+  uint32_t    dirs;
+  uint32_t    failed;
+  uint64_t    bytes;
+  uint32_t    startMs;
+  const char* error;    // Job-level failure (bad destination), or nullptr.
+
+  // Distinct top-level entries under dest; topCount may exceed the array.
+  String   tops[TAR_MAX_TOPS];
+  uint32_t topCount;
+};
+
+static TarReader g_tar;
+static TarJob    g_tarJob;
+
+// Member name to a card path under dest; "" if it would escape it or has a
+// hidden component.
+static String tarMemberPath(const TarJob& job, const char* name)
+{
+  String rel = name;
+  while (rel.startsWith("./") || rel.startsWith("/")) {
+    rel = rel.substring(rel.startsWith("/") ? 1 : 2);
+  }
+  while (rel.endsWith("/")) {
+    rel.remove(rel.length() - 1);
+  }
+  if (rel.length() == 0 || rel == ".." || rel.startsWith("../") || rel.indexOf("/../") >= 0 ||
+      rel.endsWith("/..") || libraryIsHiddenPath(rel))
+    return "";
+  return job.dest + "/" + rel;
+}
+
+// Create dir and any missing parents.
+static void tarMakeDirs(TarJob& job, const String& dir)
+{
+  if (dir.length() == 0 || dir == job.lastDir)
+    return;
+
+  SdBusSlice slice(SD_IO_UPLOAD);
+  for (int slash = dir.indexOf('/', 1); slash >= 0; slash = dir.indexOf('/', slash + 1)) {
+    String parent = dir.substring(0, slash);
+    if (!SD.exists(parent))
+      SD.mkdir(parent);
+  }
+  if (!SD.exists(dir))
+    SD.mkdir(dir);
+  job.lastDir = dir;
+}
+
+// First directory of dir (or dir itself) that does not exist yet, or "".
+static String tarFirstMissing(const String& dir)
+{
+  SdBusSlice slice(SD_IO_UPLOAD);
+  for (int slash = dir.indexOf('/', 1); slash >= 0; slash = dir.indexOf('/', slash + 1)) {
+    String parent = dir.substring(0, slash);
+    if (!SD.exists(parent))
+      return parent;
+  }
+  return dir.length() > 0 && !SD.exists(dir) ? dir : String();
+}
+
+// Remember which top-level entry under dest a member belongs to.
+static void tarNoteTop(TarJob& job, const String& path)
+{
+  int    slash = path.indexOf('/', job.dest.length() + 1);
+  String top   = slash < 0 ? path : path.substring(0, slash);
+  for (uint32_t i = 0; i < job.topCount && i < TAR_MAX_TOPS; i++) {
+    if (job.tops[i] == top)
+      return;
+  }
+  if (job.topCount < TAR_MAX_TOPS)
+    job.tops[job.topCount] = top;
+  job.topCount++;
+}
+
+// Tell the library what the archive unpacked in as few changes as
+// possible: the directory it created, its top-level entries, or the
+// whole destination.
+static void tarNoteLibrary(const TarJob& job)
+{
+  if (job.created.length() > 0) {
+    libraryNoteTreeChanged(job.created);
+  } else if (job.topCount > TAR_MAX_TOPS) {
+    libraryNoteTreeChanged(job.dest);
+  } else {
+    for (uint32_t i = 0; i < job.topCount; i++) {
+      libraryNoteTreeChanged(job.tops[i]);
     }
-    WebLog.println("[UPLOAD] ❌ Aborted");
-    g_uploadStatus = "❌ Загрузка прервана";
+  }
+}
 
-    // Resume audio if it was playing before.
-    if (g_audioWasPlaying) {
-      WebLog.println("[UPLOAD] ▶ Resuming audio playback");
-      audioStart();
-      g_audioWasPlaying = false;
+static bool tarEvent(TarEvent event, const char* name, const uint8_t* data, size_t len, void* ctx)
+{
+  TarJob& job = *(TarJob*)ctx;
+
+  switch (event) {
+  case TAR_DIR: {
+    String path = tarMemberPath(job, name);
+    if (path.length() > 0) {
+      tarMakeDirs(job, path);
+      tarNoteTop(job, path);
+      job.dirs++;
     }
+    break;
   }
+
+  case TAR_FILE_BEGIN: {
+    String path  = tarMemberPath(job, name);
+    job.skipping = true;
+    if (path.length() == 0) {
+      job.failed++;
+      break;
+    }
+    tarMakeDirs(job, path.substring(0, path.lastIndexOf('/')));
+    tarNoteTop(job, path);
+    job.skipping = !uploadOpen(path, len);
+    if (job.skipping)
+      job.failed++;
+    break;
+  }
+
+  case TAR_FILE_DATA:
+    if (!job.skipping) {
+      pipelinePut(data, len);
+      g_uploadSize += len;
+      job.bytes += len;
+    }
+    break;
+
+  case TAR_FILE_END:
+    if (!job.skipping) {
+      if (uploadFinish(UPLOAD_TAR)) {
+        job.files++;
+      } else {
+        job.failed++;
+      }
+    }
+    job.skipping = true;
+    break;
+  }
+  return true;
 }
 
-static void handleUploadComplete(WebServer& server)
+// Normalize ?dest= to "/a/b" ("" for the root): an absolute path without
+// empty, "." or ".." components, nor hidden ones. False if it is anything else.
+static bool tarDestPath(const String& dest, String& out)
 {
-  String json = "{\"status\":\"";
-  json += g_uploadStatus;
-  json += "\",\"path\":\"";
-  json += g_uploadPath;
-  json += "\",\"size\":";
-  json += String(g_uploadSize);
-  json += "}";
+  out = "";
+  if (dest.length() == 0)
+    return true;
+  if (!dest.startsWith("/"))
+    return false;
+
+  for (int start = 1; start < (int)dest.length();) {
+    int    slash = dest.indexOf('/', start);
+    int    end   = slash < 0 ? dest.length() : slash;
+    String part  = dest.substring(start, end);
+    if (part == "." || part == ".." || (part.length() > 0 && libraryIsHiddenPath(part)))
+      return false;
+    if (part.length() > 0)
+      out += "/" + part;
+    start = end + 1;
+  }
+  return true;
+}
 
-  server.send(200, "application/json", json);
+// False (with g_tarJob.error set) if the destination is not acceptable.
+static bool tarStart(const String& dest)
+{
+  g_tarJob          = TarJob();
+  g_tarJob.skipping = true;
+  g_tarJob.startMs  = millis();
+
+  tarBegin(&g_tar, tarEvent, &g_tarJob);
+  if (!tarDestPath(dest, g_tarJob.dest)) {
+    g_tarJob.error = "bad destination";
+    WebLog.print("[UPLOAD] ❌ Archive destination rejected: ");
+    WebLog.println(dest);
+    return false;
+  }
+  g_tarJob.created = tarFirstMissing(g_tarJob.dest);
+  tarMakeDirs(g_tarJob, g_tarJob.dest);
+  g_uploadQuiet = true;
+
+  WebLog.print("[UPLOAD] Unpacking archive into ");
+  WebLog.println(g_tarJob.dest.length() > 0 ? g_tarJob.dest : String("/"));
+  return true;
 }
 
+static bool tarArchiveFeed(const uint8_t* data, size_t len, void* ctx)
+{
+  (void)ctx;
+  return tarFeed(&g_tar, data, len);
+}
+
+// Archive body bytes as they arrive; a gzip magic at the start (or
+// Content-Encoding: gzip) routes them through the inflater first.
+static bool tarBodyFeed(const uint8_t* data, size_t len, void* ctx)
+{
+  (void)ctx;
+  if (!g_tarJob.sniffed) {
+    g_tarJob.sniffed = true;
+    if (g_tarJob.gzip || gzipSniff(data, len)) {
+      g_tarJob.gzip = true;
+      if (!gzipBegin(&g_gzip, tarArchiveFeed, nullptr))
+        return false;
+    }
+  }
+  if (g_tarJob.gzip)
+    return gzipFeed(&g_gzip, data, len);
+  return tarFeed(&g_tar, data, len);
+}
+
+// Why the archive stopped, or nullptr.
+static const char* tarStopError()
+{
+  if (g_tarJob.error)
+    return g_tarJob.error;
+  if (tarError(&g_tar))
+    return tarError(&g_tar);
+  return g_tarJob.gzip ? gzipError(&g_gzip) : nullptr;
+}
+
+// Stop after the archive ended or broke off; a member cut short is removed.
+static void tarStop(bool complete)
+{
+  if (!g_tarJob.skipping)
+    uploadAbort();
+  g_tarJob.skipping = true;
+  g_uploadQuiet     = false;
+  tarNoteLibrary(g_tarJob);
+
+  if (g_tarJob.gzip) {
+    g_gzipInBytes  = g_gzip.inBytes;
+    g_gzipOutBytes = g_gzip.outBytes;
+    gzipEnd(&g_gzip);
+  }
+
+  bool ok = complete && tarDone(&g_tar);
+  WebLog.print(ok ? "[UPLOAD] ✅ Archive: " : "[UPLOAD] ❌ Archive incomplete: ");
+  WebLog.print(g_tarJob.files);
+  WebLog.print(" files, ");
+  WebLog.print(g_tarJob.dirs);
+  WebLog.print(" dirs, ");
+  WebLog.print((uint32_t)(g_tarJob.bytes / 1024));
+  WebLog.print(" KB");
+  if (g_tarJob.failed > 0) {
+    WebLog.print(", ");
+    WebLog.print(g_tarJob.failed);
+    WebLog.print(" failed");
+  }
+  if (g_tarJob.gzip && g_gzipInBytes > 0) {
+    WebLog.print(", gzip ratio ");
+    WebLog.print((float)g_gzipOutBytes / (float)g_gzipInBytes, 2);
+  }
+  if (tarStopError()) {
+    WebLog.print(" (");
+    WebLog.print(tarStopError());
+    WebLog.print(")");
+  }
+  WebLog.println("");
+}
+
+static String tarResultJson()
+{
+  uint32_t elapsed = millis() - g_tarJob.startMs;
+
+  String json = "{";
+  json += "\"complete\":" + String(tarDone(&g_tar) ? "true" : "false") + ",";
+  json += "\"files\":" + String(g_tarJob.files) + ",";
+  json += "\"dirs\":" + String(g_tarJob.dirs) + ",";
+  json += "\"failed\":" + String(g_tarJob.failed) + ",";
+  json += "\"bytes\":" + String((uint32_t)g_tarJob.bytes) + ",";
+  json += "\"elapsedMs\":" + String(elapsed) + ",";
+  json += "\"speedKBps\":";
+  json += String(elapsed > 0 ? (float)g_tarJob.bytes / 1024.0f * 1000.0f / elapsed : 0, 1);
+  if (g_tarJob.gzip)
+    json += gzipResultJson(elapsed);
+  if (tarStopError())
+    json += ",\"error\":\"" + String(tarStopError()) + "\"";
+  json += "}";
+  return json;
+}
+
+// Takes the archive either as the raw body (Content-Type: application/x-tar)
+// or as the file of a multipart form, and feeds the reader as data arrives.
+// Either may be a .tar.gz.
+class TarUploadHandler : public RequestHandler
+{
+public:
+  bool canHandle(HTTPMethod method, String uri) override
+  {
+    return method == HTTP_POST && uri == TAR_URI;
+  }
+
+  bool canUpload(String uri) override { return uri == TAR_URI; }
+
+  bool canRaw(String uri) override { return uri == TAR_URI; }
+
+  void raw(WebServer& server, String requestUri, HTTPRaw& raw) override
+  {
+    (void)requestUri;
+    if (raw.status != RAW_START)
+      return;
+
+    m_started    = true;
+    size_t length = server.clientContentLength();
+    if (tarStart(server.arg("dest"))) {
+      g_tarJob.gzip   = server.header("Content-Encoding") == "gzip";
+      size_t received = clientStream(server, length, tarBodyFeed, nullptr);
+      tarStop(received == length || tarDone(&g_tar));
+    }
+
+    // The rest of the body (padding after the end blocks) is dropped.
+    raw.totalSize = length;
+  }
+
+  void upload(WebServer& server, String requestUri, HTTPUpload& upload) override
+  {
+    (void)requestUri;
+    if (upload.status == UPLOAD_FILE_START) {
+      m_started = true;
+      m_feeding = tarStart(server.arg("dest"));
+      return;
+    }
+
+    // Rejected or broken off: the rest of the form is read and dropped.
+    if (!m_feeding)
+      return;
+    if (upload.status == UPLOAD_FILE_WRITE) {
+      if (!tarBodyFeed(upload.buf, upload.currentSize, nullptr)) {
+        tarStop(false);
+        m_feeding = false;
+      }
+    } else {
+      tarStop(upload.status == UPLOAD_FILE_END);
+      m_feeding = false;
+    }
+  }
+
+  bool handle(WebServer& server, HTTPMethod method, String uri) override
+  {
+    (void)method;
+    (void)uri;
+
+    if (!m_started) {
+      server.send(400, "application/json", "{\"error\":\"empty body\"}");
+    } else {
+      server.send(tarDone(&g_tar) ? 200 : 400, "application/json", tarResultJson());
+    }
+    m_started = false;
+    return true;
+  }
+
+private:
+  static constexpr const char* TAR_URI = "/upload-tar";
+
+  bool m_started = false; // An archive was read for this request.
+  bool m_feeding = false; // Multipart: the reader still takes data.
+};
+
 static void handleUploadProgress(WebServer& server)
 {
   server.send(200, "application/json", sdUploadGetProgressJson());
@@ -281,5 +1638,9 @@ void sdUploadBegin(WebServer& server)
 
   server.on("/upload-progress", HTTP_GET, [&server]() { handleUploadProgress(server); });
 
+  server.addHandler(new FsPutHandler());
+  server.addHandler(new SessionHandler());
+  server.addHandler(new TarUploadHandler());
+
   WebLog.println("[UPLOAD] ✅ Upload handlers registered");
 }
@@ -1,5 +1,6 @@
 #include "settings.h"
 
+#include "media_library.h"
 #include "web_log.h"
 
 #include <ArduinoJson.h>
@@ -36,12 +37,27 @@ static void sanitize(AudioSettings& s)
   s.dmaBufCount = clampInt(s.dmaBufCount, 4, 16);
   s.dmaBufLen   = clampInt(s.dmaBufLen, 128, 1024);
 
+  s.decodeAheadMs = clampInt(s.decodeAheadMs, 0, 1000);
+  s.cacheMaxMB    = clampInt(s.cacheMaxMB, 0, 4096);
+
+  if (s.spectrumFftSize != 256 && s.spectrumFftSize != 512) {
+    s.spectrumFftSize = 512;
+  }
+
   s.eq.band60Hz  = clampFloat(s.eq.band60Hz, -12.0f, 12.0f);
   s.eq.band250Hz = clampFloat(s.eq.band250Hz, -12.0f, 12.0f);
   s.eq.band1kHz  = clampFloat(s.eq.band1kHz, -12.0f, 12.0f);
   s.eq.band4kHz  = clampFloat(s.eq.band4kHz, -12.0f, 12.0f);
   s.eq.band12kHz = clampFloat(s.eq.band12kHz, -12.0f, 12.0f);
 
+  for (int ch = 0; ch <= DOWNMIX_MAX_CHANNELS; ch++) {
+    for (int o = 0; o < 2; o++) {
+      for (int i = 0; i < DOWNMIX_MAX_CHANNELS; i++) {
+        s.downmix[ch].coeffs[o][i] = clampFloat(s.downmix[ch].coeffs[o][i], -2.0f, 2.0f);
+      }
+    }
+  }
+
   if (s.currentFile.length() == 0) {
     s.currentFile = "/test.wav";
   }
@@ -68,8 +84,18 @@ void settingsSetDefaults(AudioSettings& s)
   s.eq.band12kHz      = 0.0f;
   s.autoTuneEnabled   = true;
   s.resamplingEnabled = true;
+  s.adaptiveQuality   = true;
+  s.dualCoreDsp       = true;
+  s.spectrumFftSize   = 512;
+  s.decodeAheadMs     = 200;
+  s.wavLoops          = false;
+  s.cacheMaxMB        = 256;
   s.timezone          = "Europe/Moscow";
   s.timezoneOffset    = 10800; // UTC+3 (Moscow).
+
+  for (int ch = 0; ch <= DOWNMIX_MAX_CHANNELS; ch++) {
+    downmixSetDefaults(s.downmix[ch], ch, 0);
+  }
 }
 
 bool settingsSaveToSD()
@@ -86,6 +112,12 @@ bool settingsSaveToSD()
   doc["eqEnabled"]         = g_settings.eqEnabled;
   doc["autoTuneEnabled"]   = g_settings.autoTuneEnabled;
   doc["resamplingEnabled"] = g_settings.resamplingEnabled;
+  doc["adaptiveQuality"]   = g_settings.adaptiveQuality;
+  doc["dualCoreDsp"]       = g_settings.dualCoreDsp;
+  doc["spectrumFftSize"]   = g_settings.spectrumFftSize;
+  doc["decodeAheadMs"]     = g_settings.decodeAheadMs;
+  doc["wavLoops"]          = g_settings.wavLoops;
+  doc["cacheMaxMB"]        = g_settings.cacheMaxMB;
   doc["timezone"]          = g_settings.timezone;
   doc["timezoneOffset"]    = g_settings.timezoneOffset;
 
@@ -96,6 +128,20 @@ bool settingsSaveToSD()
   eq["band4kHz"]  = g_settings.eq.band4kHz;
   eq["band12kHz"] = g_settings.eq.band12kHz;
 
+  // Only custom matrices are stored: "downmix": {"6": [[L coeffs], [R coeffs]]}.
+  JsonObject downmix = doc["downmix"].to<JsonObject>();
+  for (int ch = 3; ch <= DOWNMIX_MAX_CHANNELS; ch++) {
+    if (!g_settings.downmix[ch].valid)
+      continue;
+    JsonArray rows = downmix[String(ch).c_str()].to<JsonArray>();
+    for (int o = 0; o < 2; o++) {
+      JsonArray row = rows.add<JsonArray>();
+      for (int i = 0; i < ch; i++) {
+        row.add(g_settings.downmix[ch].coeffs[o][i]);
+      }
+    }
+  }
+
   if (SD.exists(TMP_PATH))
     SD.remove(TMP_PATH);
 
@@ -123,6 +169,7 @@ bool settingsSaveToSD()
     return false;
   }
 
+  libraryNoteChanged(SETTINGS_PATH);
   WebLog.println("[SET] ✅ Saved /settings.json");
   return true;
 }
@@ -162,6 +209,12 @@ bool settingsLoadFromSD()
   g_settings.eqEnabled         = doc["eqEnabled"] | false;
   g_settings.autoTuneEnabled   = doc["autoTuneEnabled"] | true;
   g_settings.resamplingEnabled = doc["resamplingEnabled"] | true;
+  g_settings.adaptiveQuality   = doc["adaptiveQuality"] | true;
+  g_settings.dualCoreDsp       = doc["dualCoreDsp"] | true;
+  g_settings.spectrumFftSize   = doc["spectrumFftSize"] | 512;
+  g_settings.decodeAheadMs     = doc["decodeAheadMs"] | 200;
+  g_settings.wavLoops          = doc["wavLoops"] | false;
+  g_settings.cacheMaxMB        = doc["cacheMaxMB"] | 256;
   g_settings.timezone          = doc["timezone"] | "Europe/Moscow";
   g_settings.timezoneOffset    = doc["timezoneOffset"] | 10800;
 
@@ -180,6 +233,32 @@ bool settingsLoadFromSD()
     g_settings.eq.band12kHz = 0.0f;
   }
 
+  for (int ch = 0; ch <= DOWNMIX_MAX_CHANNELS; ch++) {
+    downmixSetDefaults(g_settings.downmix[ch], ch, 0);
+  }
+
+  JsonObject downmix = doc["downmix"];
+  for (int ch = 3; !downmix.isNull() && ch <= DOWNMIX_MAX_CHANNELS; ch++) {
+    JsonArray rows = downmix[String(ch).c_str()];
+    if (rows.isNull() || rows.size() != 2)
+      continue;
+
+    JsonArray rowL = rows[0];
+    JsonArray rowR = rows[1];
+    if (rowL.size() != (size_t)ch || rowR.size() != (size_t)ch) {
+      WebLog.print("[SET] ⚠️ Downmix matrix for ");
+      WebLog.print(ch);
+      WebLog.println(" channels has wrong size, using ITU default");
+      continue;
+    }
+
+    for (int i = 0; i < ch; i++) {
+      g_settings.downmix[ch].coeffs[0][i] = rowL[i] | 0.0f;
+      g_settings.downmix[ch].coeffs[1][i] = rowR[i] | 0.0f;
+    }
+    g_settings.downmix[ch].valid = true;
+  }
+
   sanitize(g_settings);
 
   WebLog.println("[SET] ✅ Loaded /settings.json");
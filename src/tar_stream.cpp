@@ -0,0 +1,292 @@
+#include "tar_stream.h"
+
+// ustar header field offsets.
+static const size_t TAR_NAME     = 0;
+static const size_t TAR_SIZE     = 124;
+static const size_t TAR_CHKSUM   = 148;
+static const size_t TAR_TYPEFLAG = 156;
+static const size_t TAR_MAGIC    = 257;
+static const size_t TAR_PREFIX   = 345;
+
+static void fail(TarReader* tar, const char* error)
+{
+  tar->state = TAR_STATE_ERROR;
+  tar->error = error;
+}
+
+// A NUL-padded header field as a string.
+static String field(const uint8_t* p, size_t len)
+{
+  size_t n = 0;
+  while (n < len && p[n] != '\0') {
+    n++;
+  }
+  String s;
+  s.reserve(n);
+  for (size_t i = 0; i < n; i++) {
+    s += (char)p[i];
+  }
+  return s;
+}
+
+// Octal with optional spaces and NULs, or GNU base-256 for large sizes.
+static uint64_t numberField(const uint8_t* p, size_t len)
+{
+  uint64_t v = 0;
+  if (p[0] & 0x80) {
+    for (size_t i = 1; i < len; i++) {
+      v = (v << 8) | p[i];
+    }
+    return v;
+  }
+  for (size_t i = 0; i < len; i++) {
+    if (p[i] >= '0' && p[i] <= '7') {
+      v = (v << 3) | (uint64_t)(p[i] - '0');
+    } else if (v > 0 && (p[i] == ' ' || p[i] == '\0')) {
+      break;
+    }
+  }
+  return v;
+}
+
+static bool checksumOk(const uint8_t* h)
+{
+  uint32_t sum = 0;
+  for (size_t i = 0; i < TAR_BLOCK; i++) {
+    sum += (i >= TAR_CHKSUM && i < TAR_CHKSUM + 8) ? ' ' : h[i];
+  }
+  return sum == numberField(h + TAR_CHKSUM, 8);
+}
+
+// "<len> path=<value>\n" records of a pax extended header.
+static String paxPath(const String& meta)
+{
+  int pos = 0;
+  while (pos < (int)meta.length()) {
+    int space = meta.indexOf(' ', pos);
+    int len   = meta.substring(pos, space).toInt();
+    if (space < 0 || len <= 0)
+      break;
+
+    String record = meta.substring(space + 1, pos + len - 1);
+    if (record.startsWith("path="))
+      return record.substring(5);
+    pos += len;
+  }
+  return "";
+}
+
+static uint32_t padOf(uint64_t size)
+{
+  return (uint32_t)((TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK);
+}
+
+// A full header block is in tar->header.
+static void parseHeader(TarReader* tar)
+{
+  const uint8_t* h = tar->header;
+
+  bool zero = true;
+  for (size_t i = 0; i < TAR_BLOCK && zero; i++) {
+    zero = h[i] == 0;
+  }
+  if (zero) {
+    if (++tar->zeroBlocks >= 2)
+      tar->state = TAR_STATE_END;
+    return;
+  }
+  tar->zeroBlocks = 0;
+
+  if (!checksumOk(h)) {
+    fail(tar, "bad header checksum");
+    return;
+  }
+
+  char     type = (char)h[TAR_TYPEFLAG];
+  uint64_t size = numberField(h + TAR_SIZE, 12);
+
+  if (tar->longName.length() > 0) {
+    tar->name     = tar->longName;
+    tar->longName = "";
+  } else {
+    tar->name     = field(h + TAR_NAME, 100);
+    String prefix = memcmp(h + TAR_MAGIC, "ustar", 5) == 0 ? field(h + TAR_PREFIX, 155) : "";
+    if (prefix.length() > 0)
+      tar->name = prefix + "/" + tar->name;
+  }
+
+  tar->remaining = size;
+  tar->pad       = padOf(size);
+
+  switch (type) {
+  case '0':
+  case '\0':
+  case '7':
+    if (tar->name.endsWith("/")) {
+      // Old archives mark directories with a trailing slash only.
+      if (!tar->fn(TAR_DIR, tar->name.c_str(), nullptr, 0, tar->ctx))
+        fail(tar, "stopped");
+      tar->state = TAR_STATE_SKIP;
+      tar->remaining += tar->pad;
+      tar->pad = 0;
+      return;
+    }
+    if (!tar->fn(TAR_FILE_BEGIN, tar->name.c_str(), nullptr, (size_t)size, tar->ctx)) {
+      fail(tar, "stopped");
+      return;
+    }
+    tar->state = TAR_STATE_DATA;
+    break;
+
+  case '5':
+    if (!tar->fn(TAR_DIR, tar->name.c_str(), nullptr, 0, tar->ctx)) {
+      fail(tar, "stopped");
+      return;
+    }
+    tar->state = TAR_STATE_SKIP;
+    tar->remaining += tar->pad;
+    tar->pad = 0;
+    break;
+
+  case 'L':
+  case 'x':
+    tar->state    = TAR_STATE_META;
+    tar->metaType = type;
+    tar->meta     = "";
+    break;
+
+  default:
+    // Links, devices, global pax headers: nothing to write.
+    tar->state = TAR_STATE_SKIP;
+    tar->remaining += tar->pad;
+    tar->pad = 0;
+    break;
+  }
+
+  // An empty file is complete as soon as its header is read.
+  if (tar->state == TAR_STATE_DATA && tar->remaining == 0) {
+    if (!tar->fn(TAR_FILE_END, tar->name.c_str(), nullptr, 0, tar->ctx)) {
+      fail(tar, "stopped");
+      return;
+    }
+    tar->state = TAR_STATE_HEADER;
+  }
+}
+
+static void metaDone(TarReader* tar)
+{
+  if (tar->metaType == 'L') {
+    tar->longName = tar->meta;
+  } else {
+    tar->longName = paxPath(tar->meta);
+  }
+  tar->meta = "";
+}
+
+// ----------------------------------------------------------------------------
+// Public API
+// ----------------------------------------------------------------------------
+
+void tarBegin(TarReader* tar, TarEventFn fn, void* ctx)
+{
+  tar->fn         = fn;
+  tar->ctx        = ctx;
+  tar->state      = TAR_STATE_HEADER;
+  tar->fill       = 0;
+  tar->remaining  = 0;
+  tar->pad        = 0;
+  tar->metaType   = 0;
+  tar->name       = "";
+  tar->longName   = "";
+  tar->meta       = "";
+  tar->zeroBlocks = 0;
+  tar->error      = nullptr;
+}
+
+bool tarFeed(TarReader* tar, const uint8_t* data, size_t len)
+{
+  while (len > 0) {
+    switch (tar->state) {
+    case TAR_STATE_HEADER: {
+      size_t n = TAR_BLOCK - tar->fill;
+      if (n > len)
+        n = len;
+      memcpy(tar->header + tar->fill, data, n);
+      tar->fill += n;
+      data += n;
+      len -= n;
+      if (tar->fill == TAR_BLOCK) {
+        tar->fill = 0;
+        parseHeader(tar);
+      }
+      break;
+    }
+
+    case TAR_STATE_DATA: {
+      size_t n = tar->remaining < len ? (size_t)tar->remaining : len;
+      if (!tar->fn(TAR_FILE_DATA, tar->name.c_str(), data, n, tar->ctx)) {
+        fail(tar, "stopped");
+        break;
+      }
+      tar->remaining -= n;
+      data += n;
+      len -= n;
+      if (tar->remaining == 0) {
+        if (!tar->fn(TAR_FILE_END, tar->name.c_str(), nullptr, 0, tar->ctx)) {
+          fail(tar, "stopped");
+          break;
+        }
+        tar->remaining = tar->pad;
+        tar->pad       = 0;
+        tar->state     = tar->remaining > 0 ? TAR_STATE_SKIP : TAR_STATE_HEADER;
+      }
+      break;
+    }
+
+    case TAR_STATE_META: {
+      size_t n = tar->remaining < len ? (size_t)tar->remaining : len;
+      for (size_t i = 0; i < n && tar->meta.length() < TAR_MAX_META; i++) {
+        if (data[i] != '\0')
+          tar->meta += (char)data[i];
+      }
+      tar->remaining -= n;
+      data += n;
+      len -= n;
+      if (tar->remaining == 0) {
+        metaDone(tar);
+        tar->remaining = tar->pad;
+        tar->pad       = 0;
+        tar->state     = tar->remaining > 0 ? TAR_STATE_SKIP : TAR_STATE_HEADER;
+      }
+      break;
+    }
+
+    case TAR_STATE_SKIP: {
+      size_t n = tar->remaining < len ? (size_t)tar->remaining : len;
+      tar->remaining -= n;
+      data += n;
+      len -= n;
+      if (tar->remaining == 0)
+        tar->state = TAR_STATE_HEADER;
+      break;
+    }
+
+    case TAR_STATE_END:
+      return true;
+
+    case TAR_STATE_ERROR:
+      return false;
+    }
+  }
+  return tar->state != TAR_STATE_ERROR;
+}
+
+bool tarDone(const TarReader* tar)
+{
+  return tar->state == TAR_STATE_END;
+}
+
+const char* tarError(const TarReader* tar)
+{
+  return tar->error;
+}
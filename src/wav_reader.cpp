@@ -2,16 +2,144 @@
 
 #include "web_log.h"
 
+// Largest fmt chunk read in full (MS-ADPCM with 16 coefficient pairs).
+static const uint32_t WAV_FMT_MAX_BYTES = 18 + 4 + ADPCM_MS_MAX_COEFS * 4;
+
 static uint32_t readLE32(const uint8_t* p)
 {
   return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
 }
 
+static uint64_t readLE64(const uint8_t* p)
+{
+  return (uint64_t)readLE32(p) | ((uint64_t)readLE32(p + 4) << 32);
+}
+
 static uint16_t readLE16(const uint8_t* p)
 {
   return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
 }
 
+// KSDATAFORMAT_SUBTYPE_* GUIDs share these 14 bytes after the format tag.
+static const uint8_t KSDATAFORMAT_TAIL[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                              0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+
+// Format-specific fields after cbSize.
+static bool parseFmtExtension(WavInfo& info, const uint8_t* ext, uint16_t len)
+{
+  if (info.audioFormat == WAV_FORMAT_EXTENSIBLE) {
+    if (len < 22 || memcmp(ext + 8, KSDATAFORMAT_TAIL, sizeof(KSDATAFORMAT_TAIL)) != 0) {
+      WebLog.println("[WAV] ❌ Unknown WAVE_FORMAT_EXTENSIBLE subformat");
+      return false;
+    }
+    info.validBits   = readLE16(ext);
+    info.channelMask = readLE32(ext + 2);
+    info.audioFormat = readLE16(ext + 6);
+    info.extensible  = true;
+  } else if (info.audioFormat == WAV_FORMAT_IMA_ADPCM) {
+    if (len >= 2)
+      info.samplesPerBlock = readLE16(ext);
+    if (info.samplesPerBlock == 0)
+      info.samplesPerBlock = adpcmImaFramesPerBlock(info.blockAlign, info.numChannels);
+  } else if (info.audioFormat == WAV_FORMAT_MS_ADPCM) {
+    if (len >= 4) {
+      info.samplesPerBlock = readLE16(ext);
+      uint16_t numCoefs    = readLE16(ext + 2);
+      for (uint16_t i = 0; i < numCoefs && i < ADPCM_MS_MAX_COEFS && 4u + i * 4 + 4 <= len; i++) {
+        info.msCoefs[i][0] = (int16_t)readLE16(ext + 4 + i * 4);
+        info.msCoefs[i][1] = (int16_t)readLE16(ext + 6 + i * 4);
+        info.msNumCoefs    = (uint8_t)(i + 1);
+      }
+    }
+    if (info.msNumCoefs == 0) {
+      static const int16_t STANDARD[7][2] = {{256, 0},   {512, -256}, {0, 0},     {192, 64},
+                                             {240, 0},   {460, -208}, {392, -232}};
+      memcpy(info.msCoefs, STANDARD, sizeof(STANDARD));
+      info.msNumCoefs = 7;
+    }
+    if (info.samplesPerBlock == 0)
+      info.samplesPerBlock = adpcmMsFramesPerBlock(info.blockAlign, info.numChannels);
+  }
+  return true;
+}
+
+static void parseSmpl(WavInfo& info, File& f, uint32_t chunkSize)
+{
+  uint8_t hdr[36];
+  if (chunkSize < sizeof(hdr) + 24 || f.read(hdr, sizeof(hdr)) != sizeof(hdr))
+    return;
+  if (readLE32(hdr + 28) == 0)
+    return;
+
+  // Only the first loop is played.
+  uint8_t loop[24];
+  if (f.read(loop, sizeof(loop)) != sizeof(loop))
+    return;
+
+  info.loopStart = readLE32(loop + 8);
+  info.loopEnd   = readLE32(loop + 12);
+  info.loopCount = readLE32(loop + 20);
+  info.hasLoop   = info.loopEnd > info.loopStart;
+}
+
+static void parseCue(WavInfo& info, File& f, uint32_t chunkSize)
+{
+  uint8_t countBuf[4];
+  if (chunkSize < 4 || f.read(countBuf, 4) != 4)
+    return;
+
+  uint32_t count = readLE32(countBuf);
+  for (uint32_t i = 0; i < count && info.cueCount < WAV_MAX_CUES; i++) {
+    if (4 + (i + 1) * 24 > chunkSize)
+      break;
+
+    uint8_t cue[24];
+    if (f.read(cue, sizeof(cue)) != sizeof(cue))
+      break;
+
+    WavCue& c  = info.cues[info.cueCount++];
+    c.id       = readLE32(cue);
+    c.frame    = readLE32(cue + 20); // dwSampleOffset.
+    c.label[0] = '\0';
+  }
+}
+
+// LIST/adtl: attach labl texts to cues already seen.
+static void parseAdtl(WavInfo& info, File& f, uint32_t chunkSize)
+{
+  uint8_t type[4];
+  if (chunkSize < 4 || f.read(type, 4) != 4 || memcmp(type, "adtl", 4) != 0)
+    return;
+
+  uint32_t pos = 4;
+  while (pos + 8 <= chunkSize) {
+    uint8_t sub[8];
+    if (f.read(sub, 8) != 8)
+      return;
+    uint32_t subSize  = readLE32(sub + 4);
+    uint32_t subStart = f.position();
+
+    if (memcmp(sub, "labl", 4) == 0 && subSize > 4) {
+      uint8_t id[4];
+      char    text[WAV_CUE_LABEL_LEN];
+      size_t  textLen = subSize - 4 < sizeof(text) - 1 ? subSize - 4 : sizeof(text) - 1;
+      if (f.read(id, 4) != 4 || f.read((uint8_t*)text, textLen) != textLen)
+        return;
+      text[textLen] = '\0';
+
+      for (int i = 0; i < info.cueCount; i++) {
+        if (info.cues[i].id == readLE32(id)) {
+          memcpy(info.cues[i].label, text, textLen + 1);
+          break;
+        }
+      }
+    }
+
+    pos += 8 + subSize + (subSize & 1);
+    f.seek(subStart + subSize + (subSize & 1));
+  }
+}
+
 WavInfo parseWavHeader(File& f)
 {
   WavInfo info;
@@ -20,13 +148,16 @@ WavInfo parseWavHeader(File& f)
   if (f.read(hdr, 12) != 12)
     return info;
 
-  if (memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0) {
+  info.rf64 = memcmp(hdr, "RF64", 4) == 0 || memcmp(hdr, "BW64", 4) == 0;
+  if ((!info.rf64 && memcmp(hdr, "RIFF", 4) != 0) || memcmp(hdr + 8, "WAVE", 4) != 0) {
     WebLog.println("[WAV] ❌ Not RIFF/WAVE");
     return info;
   }
 
-  bool fmtFound  = false;
-  bool dataFound = false;
+  bool     fmtFound    = false;
+  bool     dataFound   = false;
+  uint64_t ds64Data    = 0;
+  uint64_t ds64Samples = 0;
 
   while (f.available()) {
     uint8_t chunkHdr[8];
@@ -35,33 +166,81 @@ WavInfo parseWavHeader(File& f)
 
     char id[5] = {0};
     memcpy(id, chunkHdr, 4);
-    uint32_t chunkSize = readLE32(chunkHdr + 4);
+    uint32_t chunkSize  = readLE32(chunkHdr + 4);
+    uint32_t chunkStart = f.position();
 
-    if (memcmp(id, "fmt ", 4) == 0) {
+    if (memcmp(id, "ds64", 4) == 0 && chunkSize >= 28) {
+      // 64-bit RIFF, data and sample counts; the 32-bit fields read 0xFFFFFFFF.
+      uint8_t ds64[28];
+      if (f.read(ds64, sizeof(ds64)) != sizeof(ds64))
+        return info;
+      ds64Data    = readLE64(ds64 + 8);
+      ds64Samples = readLE64(ds64 + 16);
+      f.seek(f.position() + (chunkSize - sizeof(ds64)));
+    } else if (memcmp(id, "fmt ", 4) == 0) {
       if (chunkSize < 16) {
         WebLog.println("[WAV] ❌ fmt chunk too small");
         return info;
       }
 
-      uint8_t fmt[16];
-      if (f.read(fmt, 16) != 16)
+      uint8_t  fmt[WAV_FMT_MAX_BYTES];
+      uint32_t fmtLen = chunkSize < sizeof(fmt) ? chunkSize : sizeof(fmt);
+      if (f.read(fmt, fmtLen) != fmtLen)
         return info;
 
       info.audioFormat   = readLE16(fmt + 0);
       info.numChannels   = readLE16(fmt + 2);
       info.sampleRate    = readLE32(fmt + 4);
+      info.blockAlign    = readLE16(fmt + 12);
       info.bitsPerSample = readLE16(fmt + 14);
 
-      if (chunkSize > 16) {
-        f.seek(f.position() + (chunkSize - 16));
+      uint16_t cbSize = 0;
+      if (fmtLen >= 18) {
+        cbSize = readLE16(fmt + 16);
+        if (cbSize > fmtLen - 18)
+          cbSize = fmtLen - 18;
+      }
+      if (!parseFmtExtension(info, fmt + 18, cbSize))
+        return info;
+
+      if (chunkSize > fmtLen) {
+        f.seek(f.position() + (chunkSize - fmtLen));
       }
 
       fmtFound = true;
+    } else if (memcmp(id, "fact", 4) == 0 && chunkSize >= 4) {
+      uint8_t fact[4];
+      if (f.read(fact, 4) != 4)
+        return info;
+      info.factFrames = readLE32(fact);
+      if (info.factFrames == 0xFFFFFFFF)
+        info.factFrames = ds64Samples;
+      f.seek(f.position() + (chunkSize - 4));
     } else if (memcmp(id, "data", 4) == 0) {
       info.dataOffset = f.position();
       info.dataSize   = chunkSize;
-      dataFound       = true;
-      break;
+      if (info.rf64 && chunkSize == 0xFFFFFFFF)
+        info.dataSize = ds64Data;
+      dataFound = true;
+
+      // Loop and cue chunks usually follow the audio; look past it when the
+      // size is known and the end is inside the file. File offsets are 32-bit,
+      // so chunks behind an RF64 data chunk past 4 GiB are not reachable.
+      if (chunkSize == 0 || (chunkSize == 0xFFFFFFFF && !info.rf64))
+        break;
+      uint64_t end = (uint64_t)info.dataOffset + info.dataSize + (info.dataSize & 1);
+      if (end > UINT32_MAX || end >= (uint64_t)f.size() || !f.seek((uint32_t)end))
+        break;
+      continue;
+    } else if (memcmp(id, "smpl", 4) == 0) {
+      parseSmpl(info, f, chunkSize);
+      f.seek(chunkStart + chunkSize);
+    } else if (memcmp(id, "cue ", 4) == 0) {
+      parseCue(info, f, chunkSize);
+      f.seek(chunkStart + chunkSize);
+    } else if (memcmp(id, "LIST", 4) == 0) {
+      parseAdtl(info, f, chunkSize);
+      f.seek(chunkStart + chunkSize);
     } else {
       f.seek(f.position() + chunkSize);
     }
@@ -73,14 +252,28 @@ WavInfo parseWavHeader(File& f)
 
   info.ok = fmtFound && dataFound;
 
+  // Streaming writers leave the size unknown; truncated files overstate it.
+  uint64_t available = f.size() > info.dataOffset ? f.size() - info.dataOffset : 0;
+  bool unknownSize = info.dataSize == 0xFFFFFFFF || info.dataSize == 0;
+  if (info.ok && (unknownSize || info.dataSize > available)) {
+    WebLog.println("[WAV] ⚠️ Data size unknown or past EOF, using file length");
+    info.dataSize = available;
+  }
+
   if (!info.ok) {
     WebLog.println("[WAV] ❌ Failed to find fmt/data chunks");
     return info;
   }
 
-  WebLog.println("[WAV] ✅ Header parsed:");
+  WebLog.println(info.rf64 ? "[WAV] ✅ Header parsed (RF64):" : "[WAV] ✅ Header parsed:");
   WebLog.print("[WAV] Format: ");
-  WebLog.println(info.audioFormat);
+  WebLog.print(info.audioFormat);
+  if (info.extensible) {
+    WebLog.print(" (extensible, mask 0x");
+    WebLog.print(String(info.channelMask, HEX));
+    WebLog.print(")");
+  }
+  WebLog.println();
   WebLog.print("[WAV] Channels: ");
   WebLog.println(info.numChannels);
   WebLog.print("[WAV] SampleRate: ");
@@ -89,6 +282,18 @@ WavInfo parseWavHeader(File& f)
   WebLog.println(info.bitsPerSample);
   WebLog.print("[WAV] DataSize: ");
   WebLog.println(info.dataSize);
+  if (info.hasLoop) {
+    WebLog.print("[WAV] Loop: ");
+    WebLog.print(info.loopStart);
+    WebLog.print("..");
+    WebLog.print(info.loopEnd);
+    WebLog.print(" x");
+    WebLog.println(info.loopCount);
+  }
+  if (info.cueCount > 0) {
+    WebLog.print("[WAV] Cues: ");
+    WebLog.println(info.cueCount);
+  }
 
   return info;
 }
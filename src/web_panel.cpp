@@ -1,12 +1,21 @@
 #include "web_panel.h"
 
+#include "audio_analyzer.h"
 #include "audio_player.h"
 #include "audio_progress.h"
 #include "auto_tuner.h"
+#include "decode_ahead.h"
+#include "dsp_worker.h"
 #include "equalizer.h"
+#include "media_library.h"
+#include "media_search.h"
 #include "net_utils.h"
 #include "ntp_time.h"
+#include "quality_governor.h"
+#include "render_cache.h"
+#include "sd_alloc.h"
 #include "sd_browser.h"
+#include "sd_bus.h"
 #include "sd_upload.h"
 #include "settings.h"
 #include "web_log.h"
@@ -28,8 +37,15 @@ static void handleFiles();
 static void handlePlay();
 static void handleDelete();
 static void handleRename();
+static void handleFrag();
 static void handleLogs();
 static void handleEq();
+static void handleSpectrum();
+static void handleSeek();
+static void handleCue();
+static void handleCache();
+static void handleLibrary();
+static void handleSearch();
 
 static String htmlPage()
 {
@@ -79,6 +95,7 @@ static String htmlPage()
     .btn-primary{background:linear-gradient(135deg,#2a5090,#3a70c0);border-color:#4a80d0}
     .btn-danger{background:linear-gradient(135deg,#802020,#a03030);border-color:#c04040}
     .btn-success{background:linear-gradient(135deg,#206030,#308040);border-color:#40a050}
+    .btn-small{padding:4px 10px;font-size:12px;border-radius:8px}
     .status-bar{background:#0b1020;border:1px solid #24304d;border-radius:10px;padding:10px 14px;font-size:12px;line-height:1.8}
     .status-ok{color:#6fcf97}
     .status-fail{color:#eb5757}
@@ -131,12 +148,13 @@ static String htmlPage()
   <div id="panel-player" class="panel active">
     <div class="now-playing">
       <div class="title" id="np-file">Загрузка...</div>
-      <div class="progress-bar"><div class="progress-fill" id="np-progress" style="width:0%"></div></div>
+      <div class="progress-bar" style="cursor:pointer" onclick="seekTo(event, this)"><div class="progress-fill" id="np-progress" style="width:0%"></div></div>
       <div style="display:flex;justify-content:space-between;align-items:center">
         <div class="time"><span id="np-time">00:00</span> / <span id="np-total">00:00</span></div>
         <div id="np-percent">0%</div>
       </div>
       <div class="info" id="np-info">-</div>
+      <div id="np-markers" style="margin-top:6px"></div>
     </div>
     
     <div class="card">
@@ -158,6 +176,12 @@ static String htmlPage()
       </div>
     </div>
     
+    <div class="card">
+      <div class="box-title">📊 Спектр</div>
+      <canvas id="spectrum" width="640" height="160" style="width:100%;height:160px;background:#0a0f1c;border-radius:8px"></canvas>
+      <div class="info" id="meters">L: - / R: -</div>
+    </div>
+    
     <div class="status-bar" id="status">Загрузка...</div>
   </div>
 
@@ -169,6 +193,16 @@ static String htmlPage()
         <button onclick="refreshFiles()">🔄 Обновить</button>
         <button onclick="goUp()">⬆️ Вверх</button>
         <input type="text" id="current-path" value="/" style="flex:1" readonly>
+        <select id="files-sort" onchange="refreshFiles()">
+          <option value="name">По имени</option>
+          <option value="size">По размеру</option>
+          <option value="mtime">По дате</option>
+        </select>
+      </div>
+      <div class="btns">
+        <input type="text" id="search-query" placeholder="Название, исполнитель..." style="flex:1"
+            onkeydown="if(event.key==='Enter')searchFiles()">
+        <button onclick="searchFiles()">🔍 Найти</button>
       </div>
       <div class="file-list" id="file-list"></div>
       
@@ -184,9 +218,9 @@ static String htmlPage()
       <div class="upload-zone" id="upload-zone" onclick="document.getElementById('upload-input').click()">
         <div style="font-size:32px;margin-bottom:10px">📁</div>
         <div>Нажмите или перетащите файл сюда</div>
-        <div class="hint">Поддерживаются: .wav, .mp3</div>
+        <div class="hint">Поддерживаются: .wav, .mp3, .flac</div>
       </div>
-      <input type="file" id="upload-input" accept=".wav,.mp3" style="display:none" onchange="uploadFile(this.files[0])">
+      <input type="file" id="upload-input" accept=".wav,.mp3,.flac" style="display:none" onchange="uploadFile(this.files[0])">
       <div id="upload-status" class="hint" style="margin-top:10px"></div>
     </div>
   </div>
@@ -195,10 +229,6 @@ static String htmlPage()
   <div id="panel-eq" class="panel">
     <div class="card">
       <h2>🎛 5-полосный эквалайзер</h2>
-      <div class="hint" style="background:#3d2c00;border:1px solid #f0a000;padding:10px;border-radius:8px;margin-bottom:15px">
-        ⚠️ <b>Важно:</b> Эквалайзер работает только с WAV файлами!<br>
-        Для MP3 используется обход — конвертируйте в WAV для полного контроля звука.
-      </div>
       <div class="checkbox-row">
         <input type="checkbox" id="eq-enabled" onchange="toggleEq()">
         <label for="eq-enabled">Включить эквалайзер</label>
@@ -300,6 +330,14 @@ static String htmlPage()
               <input type="checkbox" id="resampling">
               <label for="resampling">Ресемплинг</label>
             </div>
+            <div class="checkbox-row">
+              <input type="checkbox" id="adaptive-quality">
+              <label for="adaptive-quality">Адаптивное качество DSP</label>
+            </div>
+            <div class="checkbox-row">
+              <input type="checkbox" id="wav-loops">
+              <label for="wav-loops">Петли smpl в WAV</label>
+            </div>
             <div class="hint">Авто-тюнинг увеличивает буферы при хрипах.<br>Ресемплинг конвертирует частоту WAV под настройки.</div>
           </div>
         </div>
@@ -360,6 +398,7 @@ static String htmlPage()
 <script>
 let currentPath = '/';
 let selectedFile = null;
+let filesShown = 0;
 let logAutoRefresh = true;
 
 function showPanel(name) {
@@ -381,12 +420,21 @@ async function refreshStatus() {
     html += `<span style="margin-right:16px">📡 WiFi: <b class="${j.wifi==='OK'?'status-ok':'status-fail'}">${j.wifi}</b></span>`;
     html += `<span style="margin-right:16px">🎵 Аудио: <b class="${j.audio==='PLAYING'?'status-ok':'status-warn'}">${j.audio}</b></span>`;
     html += `<span style="margin-right:16px">💾 Heap: <b>${j.heap}</b></span>`;
+    if (j.quality) {
+      html += `<span style="margin-right:16px">🎚 DSP: <b class="${j.quality.level===0?'status-ok':'status-warn'}">${j.quality.name}</b> (${j.quality.headroom}%)</span>`;
+    }
+    if (j.decodeAhead && j.decodeAhead.active) {
+      const fill = Math.round(j.decodeAhead.fillFrames * 100 / j.decodeAhead.ringFrames);
+      html += `<span style="margin-right:16px">🧵 Буфер: <b class="${j.decodeAhead.underruns===0?'status-ok':'status-warn'}">${fill}%</b> (${j.decodeAhead.decodeLoadPct}% CPU)</span>`;
+    }
     html += `<span>📄 Settings: <b class="${j.settings==='OK'?'status-ok':'status-fail'}">${j.settings}</b></span>`;
     document.getElementById('status').innerHTML = html;
     
     // Update checkboxes.
     document.getElementById('auto-tune').checked = j.autoTune === 'ON';
     document.getElementById('resampling').checked = j.resampling === 'ON';
+    document.getElementById('adaptive-quality').checked = j.adaptiveQuality === 'ON';
+    document.getElementById('wav-loops').checked = j.wavLoops === 'ON';
     document.getElementById('eq-enabled').checked = j.eqEnabled === 'ON';
     
     // Update timezone selector.
@@ -398,10 +446,13 @@ async function refreshStatus() {
   }
 }
 
+let npTotalMs = 0;
+
 async function refreshProgress() {
   try {
     const r = await fetch('/progress');
     const j = await r.json();
+    npTotalMs = j.playing ? j.totalMs : 0;
     
     document.getElementById('np-file').innerText = j.fileName || 'Нет файла';
     document.getElementById('np-time').innerText = j.playedTime || '00:00';
@@ -409,10 +460,48 @@ async function refreshProgress() {
     document.getElementById('np-percent').innerText = j.percent + '%';
     document.getElementById('np-progress').style.width = j.percent + '%';
     document.getElementById('np-info').innerText = 
-      `${j.sampleRate} Hz | ${j.channels} ch | ${j.bitsPerSample} bit`;
+      `${j.sampleRate} Hz | ${j.channels} ch | ${j.bitsPerSample} bit` +
+      (j.loop ? ` | 🔁 ${formatMs(j.loop.startMs)}–${formatMs(j.loop.endMs)}` : '');
+    renderMarkers(j.playing ? (j.markers || []) : []);
   } catch(e) {}
 }
 
+function formatMs(ms) {
+  const s = Math.floor(ms / 1000);
+  return String(Math.floor(s / 60)).padStart(2, '0') + ':' + String(s % 60).padStart(2, '0');
+}
+
+let npMarkersKey = '';
+
+function renderMarkers(markers) {
+  const key = markers.map(m => m.id + '@' + m.ms).join(',');
+  if (key === npMarkersKey) return;
+  npMarkersKey = key;
+  const box = document.getElementById('np-markers');
+  box.innerHTML = '';
+  markers.forEach(m => {
+    const b = document.createElement('button');
+    b.className = 'btn-small';
+    b.style.margin = '2px 4px 2px 0';
+    b.innerText = '📍 ' + (m.label || ('#' + m.id)) + ' ' + formatMs(m.ms);
+    b.onclick = () => jumpToCue(m.id);
+    box.appendChild(b);
+  });
+}
+
+async function jumpToCue(id) {
+  await fetch(`/cue?id=${id}`);
+  setTimeout(refreshProgress, 300);
+}
+
+async function seekTo(ev, bar) {
+  if (!npTotalMs) return;
+  const rect = bar.getBoundingClientRect();
+  const ms = Math.round((ev.clientX - rect.left) / rect.width * npTotalMs);
+  await fetch(`/seek?ms=${ms}`);
+  setTimeout(refreshProgress, 300);
+}
+
 async function applyVolume() {
   const vol = document.getElementById('vol').value;
   await fetch(`/set?vol=${vol}`);
@@ -427,9 +516,11 @@ async function applySettings() {
   const dmal = document.getElementById('dmal').value;
   const autoTune = document.getElementById('auto-tune').checked ? 1 : 0;
   const resampling = document.getElementById('resampling').checked ? 1 : 0;
+  const aq = document.getElementById('adaptive-quality').checked ? 1 : 0;
+  const loops = document.getElementById('wav-loops').checked ? 1 : 0;
   const tz = document.getElementById('timezone').value;
   
-  await fetch(`/set?vol=${vol}&sr=${sr}&inbuf=${inbuf}&dmac=${dmac}&dmal=${dmal}&autoTune=${autoTune}&resampling=${resampling}&tz=${tz}`);
+  await fetch(`/set?vol=${vol}&sr=${sr}&inbuf=${inbuf}&dmac=${dmac}&dmal=${dmal}&autoTune=${autoTune}&resampling=${resampling}&aq=${aq}&loops=${loops}&tz=${tz}`);
   alert('Настройки сохранены!');
   refreshStatus();
 }
@@ -450,17 +541,21 @@ async function restartAudio() {
 }
 
 // FILES
-async function refreshFiles() {
+async function refreshFiles(more) {
   try {
-    const r = await fetch('/files?path=' + encodeURIComponent(currentPath));
-    const files = await r.json();
+    const offset = more ? filesShown : 0;
+    const sort = document.getElementById('files-sort').value;
+    const r = await fetch('/files?path=' + encodeURIComponent(currentPath) + '&sort=' + sort +
+        '&offset=' + offset + '&limit=50');
+    const page = await r.json();
     
     document.getElementById('current-path').value = currentPath;
     
     let html = '';
-    files.forEach(f => {
+    page.entries.forEach(f => {
       const lowerName = f.name.toLowerCase();
-      const isAudio = lowerName.endsWith('.wav') || lowerName.endsWith('.mp3');
+      const isAudio = lowerName.endsWith('.wav') || lowerName.endsWith('.mp3') ||
+          lowerName.endsWith('.flac');
       const icon = f.isDir ? '📁' : (isAudio ? '🎵' : '📄');
       const size = f.isDir ? '' : formatSize(f.size);
       html += `<div class="file-item" onclick="selectFile('${f.name}', ${f.isDir})" ondblclick="openFile('${f.name}', ${f.isDir})">
@@ -469,13 +564,59 @@ async function refreshFiles() {
         <span class="size">${size}</span>
       </div>`;
     });
-    document.getElementById('file-list').innerHTML = html || '<div style="padding:20px;text-align:center;opacity:.5">Пусто</div>';
+    filesShown = offset + page.count;
+    if (page.more) {
+      html += `<div class="file-item" id="files-more" onclick="refreshFiles(true)">
+        <span class="name" style="opacity:.7">Ещё (${filesShown} из ${page.total})</span>
+      </div>`;
+    }
+
+    const list = document.getElementById('file-list');
+    if (more) {
+      const old = document.getElementById('files-more');
+      if (old) old.remove();
+      list.insertAdjacentHTML('beforeend', html);
+      return;
+    }
+    list.innerHTML = html || '<div style="padding:20px;text-align:center;opacity:.5">Пусто</div>';
     selectedFile = null;
   } catch(e) {
     document.getElementById('file-list').innerHTML = '<div style="padding:20px;color:#eb5757">Ошибка загрузки</div>';
   }
 }
 
+async function searchFiles() {
+  const q = document.getElementById('search-query').value.trim();
+  if (!q) { refreshFiles(); return; }
+  try {
+    const r = await fetch('/search?limit=100&q=' + encodeURIComponent(q));
+    const res = await r.json();
+
+    let html = '';
+    res.results.forEach(f => {
+      const icon = f.isDir ? '📁' : '🎵';
+      const label = f.title ? (f.artist ? f.artist + ' — ' : '') + f.title : f.path;
+      const size = f.isDir ? '' : formatSize(f.size);
+      html += `<div class="file-item" onclick="selectPath('${f.path}', ${f.isDir})" ondblclick="playSelected()">
+        <span class="icon">${icon}</span>
+        <span class="name" title="${f.path}">${label}</span>
+        <span class="size">${size}</span>
+      </div>`;
+    });
+    if (res.more) html += '<div class="hint" style="padding:8px">Показаны первые ' + res.count + '</div>';
+    document.getElementById('file-list').innerHTML = html || '<div style="padding:20px;text-align:center;opacity:.5">Ничего не найдено</div>';
+    selectedFile = null;
+  } catch(e) {
+    document.getElementById('file-list').innerHTML = '<div style="padding:20px;color:#eb5757">Ошибка поиска</div>';
+  }
+}
+
+function selectPath(path, isDir) {
+  document.querySelectorAll('.file-item').forEach(el => el.classList.remove('selected'));
+  event.currentTarget.classList.add('selected');
+  selectedFile = { name: path.substring(path.lastIndexOf('/') + 1), isDir, path };
+}
+
 function formatSize(bytes) {
   if (bytes < 1024) return bytes + ' B';
   if (bytes < 1024*1024) return (bytes/1024).toFixed(1) + ' KB';
@@ -494,7 +635,7 @@ function openFile(name, isDir) {
     refreshFiles();
   } else {
     const lowerName = name.toLowerCase();
-    if (lowerName.endsWith('.wav') || lowerName.endsWith('.mp3')) {
+    if (lowerName.endsWith('.wav') || lowerName.endsWith('.mp3') || lowerName.endsWith('.flac')) {
       playSelected();
     }
   }
@@ -512,12 +653,12 @@ function goUp() {
 
 async function playSelected() {
   if (!selectedFile || selectedFile.isDir) {
-    alert('Выберите аудио файл (WAV или MP3)');
+    alert('Выберите аудио файл (WAV, MP3 или FLAC)');
     return;
   }
   const lowerName = selectedFile.name.toLowerCase();
-  if (!lowerName.endsWith('.wav') && !lowerName.endsWith('.mp3')) {
-    alert('Поддерживаются только WAV и MP3 файлы');
+  if (!lowerName.endsWith('.wav') && !lowerName.endsWith('.mp3') && !lowerName.endsWith('.flac')) {
+    alert('Поддерживаются только WAV, MP3 и FLAC файлы');
     return;
   }
   await fetch('/play?file=' + encodeURIComponent(selectedFile.path));
@@ -700,6 +841,41 @@ async function copyLogs() {
   }
 }
 
+// Spectrum: binary frames from /spectrum, polled only while the player is visible.
+let spectrumSeq = -1;
+function drawSpectrum(buf) {
+  const v = new DataView(buf);
+  if (v.byteLength < 20 || v.getUint8(0) !== 1) return;
+  const seq = v.getUint16(2, true);
+  if (seq === spectrumSeq) return;
+  spectrumSeq = seq;
+  
+  const db = o => (v.getInt16(o, true) / 100).toFixed(1);
+  document.getElementById('meters').innerText =
+    `L: ${db(6)} / ${db(10)} dB  R: ${db(8)} / ${db(12)} dB  (peak / RMS, ${v.getUint8(16)} Hz, ${v.getUint16(14, true)} µs)`;
+  
+  const bins = v.getUint8(1);
+  const c = document.getElementById('spectrum');
+  const g = c.getContext('2d');
+  const w = c.width / bins;
+  g.clearRect(0, 0, c.width, c.height);
+  g.fillStyle = '#6fcf97';
+  for (let i = 0; i < bins && 20 + i < v.byteLength; i++) {
+    const h = v.getUint8(20 + i) * c.height / 255;
+    g.fillRect(i * w + 1, c.height - h, w - 2, h);
+  }
+}
+
+async function pollSpectrum() {
+  if (document.getElementById('panel-player').classList.contains('active')) {
+    try {
+      const r = await fetch('/spectrum');
+      if (r.status === 200) drawSpectrum(await r.arrayBuffer());
+    } catch (e) {}
+  }
+  setTimeout(pollSpectrum, 66);
+}
+
 // Auto-refresh
 setInterval(() => {
   refreshStatus();
@@ -713,6 +889,7 @@ setInterval(() => {
 // Init
 refreshStatus();
 refreshProgress();
+pollSpectrum();
 </script>
 </body>
 </html>
@@ -740,12 +917,37 @@ static void handleStatus()
   json += "\"autoTune\":\"" + String(g_settings.autoTuneEnabled ? "ON" : "OFF") + "\",";
   json += "\"resampling\":\"" + String(g_settings.resamplingEnabled ? "ON" : "OFF") + "\",";
   json += "\"eqEnabled\":\"" + String(g_settings.eqEnabled ? "ON" : "OFF") + "\",";
+  json += "\"adaptiveQuality\":\"" + String(g_settings.adaptiveQuality ? "ON" : "OFF") + "\",";
+  json += "\"wavLoops\":\"" + String(g_settings.wavLoops ? "ON" : "OFF") + "\",";
+  json += "\"quality\":" + qualityGetStatsJson() + ",";
+  json += "\"dspWorker\":" + dspWorkerGetStatsJson() + ",";
+  json += "\"analyzer\":" + analyzerGetStatsJson() + ",";
+  json += "\"decodeAhead\":" + decodeAheadGetStatsJson() + ",";
+  json += "\"renderCache\":" + renderCacheGetStatsJson() + ",";
+  json += "\"library\":" + libraryGetStatsJson() + ",";
+  json += "\"search\":" + searchGetStatsJson() + ",";
+  json += "\"sdBus\":" + sdBusGetStatsJson() + ",";
+  json += "\"sdAlloc\":" + sdAllocGetStatsJson() + ",";
   json += "\"timezoneOffset\":" + String(g_settings.timezoneOffset);
   json += "}";
 
   server.send(200, "application/json", json);
 }
 
+// Binary frame: the panel polls this at the analyzer rate, so keep it small
+// and free of JSON formatting work.
+static void handleSpectrum()
+{
+  uint8_t frame[ANALYZER_FRAME_SIZE];
+  if (!analyzerGetFrame(frame)) {
+    server.send(204, "application/octet-stream", "");
+    return;
+  }
+
+  server.sendHeader("Cache-Control", "no-store");
+  server.send_P(200, "application/octet-stream", (const char*)frame, sizeof(frame));
+}
+
 static void handleProgress()
 {
   server.send(200, "application/json", progressGetJson());
@@ -800,6 +1002,19 @@ static void handleSet()
     WebLog.println(g_settings.resamplingEnabled);
   }
 
+  if (server.hasArg("aq")) {
+    g_settings.adaptiveQuality = server.arg("aq").toInt() == 1;
+    qualitySetEnabled(g_settings.adaptiveQuality);
+    WebLog.print("[WEB] adaptiveQuality=");
+    WebLog.println(g_settings.adaptiveQuality);
+  }
+
+  if (server.hasArg("loops")) {
+    g_settings.wavLoops = server.arg("loops").toInt() == 1;
+    WebLog.print("[WEB] wavLoops=");
+    WebLog.println(g_settings.wavLoops);
+  }
+
   if (server.hasArg("tz")) {
     g_settings.timezoneOffset = server.arg("tz").toInt();
     WebLog.print("[WEB] timezoneOffset=");
@@ -827,11 +1042,88 @@ static void handleRestart()
   server.send(200, "text/plain", "Restarted");
 }
 
+// Library entries streamed as a JSON array with chunked encoding. The
+// response starts with the first entry, so errors can still be reported.
+struct EntryStream {
+  String   chunk;
+  uint32_t count;
+  bool     withPath;
+  bool     started;
+};
+
+static void streamStart(EntryStream& r)
+{
+  if (r.started)
+    return;
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+  r.started = true;
+}
+
+static bool streamEntry(const LibraryEntry& e, void* ctx)
+{
+  EntryStream* r = (EntryStream*)ctx;
+  streamStart(*r);
+  if (r->count > 0)
+    r->chunk += ",";
+  r->chunk += sdEntryToJson(e, r->withPath);
+  r->count++;
+
+  if (r->chunk.length() >= 1024) {
+    server.sendContent(r->chunk);
+    r->chunk = "";
+  }
+  return true;
+}
+
+// Close the array; `fields` follow it in the enclosing object.
+static void streamFinish(EntryStream& r, const String& fields)
+{
+  streamStart(r);
+  r.chunk += "]," + fields + "}";
+  server.sendContent(r.chunk);
+  server.sendContent("");
+}
+
+// Directory page: ?path=&offset=&limit=&sort=name|size|mtime
+// Entries are streamed; an unchanged directory answers 304 to If-None-Match.
+// Only directories the library indexes get an ETag: elsewhere nothing tracks
+// changes, so the generation could stay put while the listing moves.
 static void handleFiles()
 {
   String path = server.hasArg("path") ? server.arg("path") : "/";
-  String json = sdListDir(path);
-  server.send(200, "application/json", json);
+  server.sendHeader("Cache-Control", "no-cache");
+  if (libraryCoversDir(path)) {
+    String etag = "\"" + String(libraryDirGeneration(path), HEX) + "\"";
+    server.sendHeader("ETag", etag);
+    if (server.header("If-None-Match") == etag) {
+      server.send(304);
+      return;
+    }
+  }
+
+  SdSortKey sort = SD_SORT_NAME;
+  if (server.hasArg("sort") && server.arg("sort") == "size")
+    sort = SD_SORT_SIZE;
+  else if (server.hasArg("sort") && server.arg("sort") == "mtime")
+    sort = SD_SORT_MTIME;
+
+  uint32_t offset = server.hasArg("offset") ? (uint32_t)server.arg("offset").toInt() : 0;
+  int      limit  = server.hasArg("limit") ? server.arg("limit").toInt() : 50;
+  if (limit < 1)
+    limit = 1;
+  if (limit > 200)
+    limit = 200;
+
+  EntryStream r     = {"{\"entries\":[", 0, false, false};
+  uint32_t    total = 0;
+  if (!sdListDirPage(path, sort, offset, (uint32_t)limit, streamEntry, &r, &total)) {
+    server.send(404, "text/plain", "Not a directory");
+    return;
+  }
+
+  streamFinish(r, "\"total\":" + String(total) + ",\"offset\":" + String(offset) +
+                      ",\"more\":" + String(offset + r.count < total ? "true" : "false"));
 }
 
 static void handlePlay()
@@ -849,7 +1141,7 @@ static void handlePlay()
   }
 
   if (!audioIsSupportedFormat(file)) {
-    server.send(400, "text/plain", "Unsupported format. Use WAV or MP3.");
+    server.send(400, "text/plain", "Unsupported format. Use WAV, MP3 or FLAC.");
     return;
   }
 
@@ -857,6 +1149,90 @@ static void handlePlay()
   server.send(200, "text/plain", "Playing: " + file);
 }
 
+static void handleSeek()
+{
+  if (!server.hasArg("ms")) {
+    server.send(400, "text/plain", "No ms");
+    return;
+  }
+
+  uint32_t ms = (uint32_t)server.arg("ms").toInt();
+  if (!audioSeekMs(ms)) {
+    server.send(409, "text/plain", "Not playing");
+    return;
+  }
+
+  server.send(200, "text/plain", "OK");
+}
+
+static void handleCue()
+{
+  if (!server.hasArg("id")) {
+    server.send(400, "text/plain", "No id");
+    return;
+  }
+
+  uint32_t ms = 0;
+  if (!progressFindMarker((uint32_t)server.arg("id").toInt(), ms)) {
+    server.send(404, "text/plain", "Unknown cue");
+    return;
+  }
+
+  if (!audioSeekMs(ms)) {
+    server.send(409, "text/plain", "Not playing");
+    return;
+  }
+
+  server.send(200, "text/plain", "OK");
+}
+
+// Pre-render cache stats; ?clear=1 drops every rendered file.
+static void handleCache()
+{
+  if (server.hasArg("clear") && server.arg("clear").toInt() == 1) {
+    renderCacheClear();
+  }
+
+  server.send(200, "application/json", renderCacheGetStatsJson());
+}
+
+// Media library stats; ?rebuild=1 rescans the card in the background.
+static void handleLibrary()
+{
+  if (server.hasArg("rebuild") && server.arg("rebuild").toInt() == 1) {
+    libraryRebuild();
+  }
+
+  server.send(200, "application/json", libraryGetStatsJson());
+}
+
+// Search names and tags: ?q=&mode=prefix|substring&offset=&limit=
+// Results are streamed with chunked encoding.
+static void handleSearch()
+{
+  if (!server.hasArg("q")) {
+    server.send(400, "text/plain", "No q");
+    return;
+  }
+
+  SearchMode mode = SEARCH_SUBSTRING;
+  if (server.hasArg("mode") && server.arg("mode") == "prefix")
+    mode = SEARCH_PREFIX;
+
+  uint32_t offset = server.hasArg("offset") ? (uint32_t)server.arg("offset").toInt() : 0;
+  int      limit  = server.hasArg("limit") ? server.arg("limit").toInt() : 50;
+  if (limit < 1)
+    limit = 1;
+  if (limit > 200)
+    limit = 200;
+
+  EntryStream r    = {"{\"results\":[", 0, true, false};
+  bool        more = false;
+  searchRun(server.arg("q"), mode, offset, (uint32_t)limit, streamEntry, &r, &more);
+  streamFinish(r, "\"count\":" + String(r.count) + ",\"offset\":" + String(offset) +
+                      ",\"more\":" + String(more ? "true" : "false"));
+}
+
 static void handleDelete()
 {
   if (!server.hasArg("path")) {
@@ -882,6 +1258,15 @@ static void handleRename()
   server.send(200, "text/plain", ok ? "Переименовано" : "Ошибка переименования");
 }
 
+static void handleFrag()
+{
+  if (!server.hasArg("path")) {
+    server.send(400, "text/plain", "Missing path");
+    return;
+  }
+  server.send(200, "application/json", sdFileFragmentsJson(server.arg("path")));
+}
+
 static void handleLogs()
 {
   if (server.hasArg("clear") && server.arg("clear") == "1") {
@@ -932,6 +1317,10 @@ void webPanelBegin(RestartAudioFn restartCb)
 {
   g_restartCb = restartCb;
 
+  // Conditional listings, resumable upload chunks and compressed uploads.
+  const char* headers[] = {"If-None-Match", "Content-Range", "Content-Encoding"};
+  server.collectHeaders(headers, 3);
+
   server.on("/", handleRoot);
   server.on("/status", handleStatus);
   server.on("/progress", handleProgress);
@@ -941,8 +1330,15 @@ void webPanelBegin(RestartAudioFn restartCb)
   server.on("/play", handlePlay);
   server.on("/delete", handleDelete);
   server.on("/rename", handleRename);
+  server.on("/frag", handleFrag);
   server.on("/logs", handleLogs);
   server.on("/eq", handleEq);
+  server.on("/spectrum", handleSpectrum);
+  server.on("/seek", handleSeek);
+  server.on("/cue", handleCue);
+  server.on("/cache", handleCache);
+  server.on("/library", handleLibrary);
+  server.on("/search", handleSearch);
 
   // Initialize upload handlers.
   sdUploadBegin(server);
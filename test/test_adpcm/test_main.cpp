@@ -0,0 +1,313 @@
+#include <Arduino.h>
+#include <math.h>
+#include <unity.h>
+
+#include "adpcm.h"
+
+// ADPCM block decoders against blocks made by reference encoders written
+// from the IMA and Microsoft descriptions. Each encoder tracks the decoder
+// state it expects, so the decoded block must match it sample for sample.
+// Runs on the board: pio test -e test -f test_adpcm
+
+static const uint32_t TEST_RATE   = 22050;
+static const size_t   BLOCK_ALIGN = 256; // Per channel for the stereo cases too.
+static const size_t   MAX_FRAMES  = 1024;
+
+// Against the source: a 440 Hz tone with a jump halfway. The error peaks
+// right after the jump while the step size adapts; a wrong sign or table
+// is off by thousands everywhere.
+static const int MAX_TRACK_ERROR = 2000;
+
+// The seven predictor pairs every MS-ADPCM fmt chunk lists first.
+static const int16_t MS_STANDARD_COEFS[7][2] = {
+    {256, 0}, {512, -256}, {0, 0}, {192, 64}, {240, 0}, {460, -208}, {392, -232}};
+
+static uint8_t g_block[BLOCK_ALIGN * 2];
+static int16_t g_source[MAX_FRAMES * 2];
+static int16_t g_expected[MAX_FRAMES * 2];
+static int16_t g_output[MAX_FRAMES * 2 + 1];
+
+static void fillSource(size_t frames, uint16_t channels)
+{
+  for (size_t i = 0; i < frames; i++) {
+    float tone = 6000.0f * sinf(2.0f * M_PI * 440.0f * i / TEST_RATE);
+    for (uint16_t ch = 0; ch < channels; ch++) {
+      float v = ch == 0 ? tone : -tone;
+      if (i > frames / 2)
+        v += ch == 0 ? 8000.0f : -4000.0f;
+      g_source[i * channels + ch] = (int16_t)v;
+    }
+  }
+}
+
+static int16_t clampSample(int32_t v)
+{
+  return v > 32767 ? 32767 : v < -32768 ? -32768 : (int16_t)v;
+}
+
+// ----------------------------------------------------------------------------
+// IMA reference encoder
+// ----------------------------------------------------------------------------
+
+static int imaStepSize(int index)
+{
+  // step(n) = round(7 * 1.1^n), the table in the IMA recommendation.
+  static const int16_t steps[89] = {
+      7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,
+      25,    28,    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,
+      88,    97,    107,   118,   130,   143,   157,   173,   190,   209,   230,   253,   279,
+      307,   337,   371,   408,   449,   494,   544,   598,   658,   724,   796,   876,   963,
+      1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,  2272,  2499,  2749,  3024,  3327,
+      3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487,
+      12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+  return steps[index];
+}
+
+struct ImaEncoder {
+  int32_t predictor;
+  int     index;
+
+  uint8_t encode(int16_t sample)
+  {
+    int     step   = imaStepSize(index);
+    int32_t diff   = sample - predictor;
+    uint8_t nibble = 0;
+    if (diff < 0) {
+      nibble = 8;
+      diff   = -diff;
+    }
+
+    // Successive approximation, reconstructing exactly as a decoder does.
+    int32_t delta = step >> 3;
+    if (diff >= step) {
+      nibble |= 4;
+      diff -= step;
+      delta += step;
+    }
+    if (diff >= step >> 1) {
+      nibble |= 2;
+      diff -= step >> 1;
+      delta += step >> 1;
+    }
+    if (diff >= step >> 2) {
+      nibble |= 1;
+      delta += step >> 2;
+    }
+
+    predictor = clampSample(nibble & 8 ? predictor - delta : predictor + delta);
+
+    static const int adjust[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+    index += adjust[nibble & 7];
+    index = index < 0 ? 0 : index > 88 ? 88 : index;
+    return nibble;
+  }
+};
+
+// One IMA block from g_source; g_expected gets what a decoder must produce.
+static size_t encodeImaBlock(uint16_t channels, size_t blockAlign)
+{
+  size_t     frames = adpcmImaFramesPerBlock(blockAlign, channels);
+  ImaEncoder enc[2];
+  for (uint16_t ch = 0; ch < channels; ch++) {
+    int16_t  first = g_source[ch];
+    uint8_t* h     = g_block + 4 * ch;
+    enc[ch]        = {first, 20};
+    h[0]           = (uint8_t)first;
+    h[1]           = (uint8_t)((uint16_t)first >> 8);
+    h[2]           = 20;
+    h[3]           = 0;
+    g_expected[ch] = first;
+  }
+
+  // Groups of 8 samples per channel, 4 bytes each, low nibble first.
+  uint8_t* p = g_block + 4 * channels;
+  for (size_t base = 1; base < frames; base += 8) {
+    for (uint16_t ch = 0; ch < channels; ch++) {
+      for (size_t i = 0; i < 8; i++) {
+        size_t  frame  = base + i;
+        uint8_t nibble = enc[ch].encode(g_source[frame * channels + ch]);
+        if (i & 1)
+          p[i >> 1] |= (uint8_t)(nibble << 4);
+        else
+          p[i >> 1] = nibble;
+        g_expected[frame * channels + ch] = (int16_t)enc[ch].predictor;
+      }
+      p += 4;
+    }
+  }
+  return frames;
+}
+
+// ----------------------------------------------------------------------------
+// Microsoft ADPCM reference encoder
+// ----------------------------------------------------------------------------
+
+struct MsEncoder {
+  int32_t c1, c2;
+  int32_t delta;
+  int32_t s1, s2;
+
+  uint8_t encode(int16_t sample)
+  {
+    static const int adaptation[16] = {230, 230, 230, 230, 307, 409, 512, 614,
+                                       768, 614, 512, 409, 307, 230, 230, 230};
+
+    int32_t predicted = (s1 * c1 + s2 * c2) >> 8;
+    int32_t err       = sample - predicted;
+    int32_t q         = (err >= 0 ? err + delta / 2 : err - delta / 2) / delta;
+    q                 = q < -8 ? -8 : q > 7 ? 7 : q;
+    uint8_t nibble    = (uint8_t)(q & 0x0F);
+
+    s2    = s1;
+    s1    = clampSample(predicted + q * delta);
+    delta = adaptation[nibble] * delta >> 8;
+    if (delta < 16)
+      delta = 16;
+    return nibble;
+  }
+};
+
+// One MS block with predictor pair `coef` for every channel.
+static size_t encodeMsBlock(uint16_t channels, size_t blockAlign, int coef)
+{
+  size_t    frames = adpcmMsFramesPerBlock(blockAlign, channels);
+  MsEncoder enc[2];
+  uint8_t*  p = g_block;
+
+  // Header field by field across channels: index, delta, sample1, sample2.
+  for (uint16_t ch = 0; ch < channels; ch++) {
+    int16_t s2 = g_source[ch];
+    int16_t s1 = g_source[channels + ch];
+    enc[ch]    = {MS_STANDARD_COEFS[coef][0], MS_STANDARD_COEFS[coef][1], 64, s1, s2};
+
+    p[ch]                        = (uint8_t)coef;
+    p[channels + 2 * ch]         = 64;
+    p[channels + 2 * ch + 1]     = 0;
+    p[3 * channels + 2 * ch]     = (uint8_t)s1;
+    p[3 * channels + 2 * ch + 1] = (uint8_t)((uint16_t)s1 >> 8);
+    p[5 * channels + 2 * ch]     = (uint8_t)s2;
+    p[5 * channels + 2 * ch + 1] = (uint8_t)((uint16_t)s2 >> 8);
+    g_expected[ch]               = s2;
+    g_expected[channels + ch]    = s1;
+  }
+  p += 7 * channels;
+
+  // Nibbles high first, interleaved across channels sample by sample.
+  size_t total = (frames - 2) * channels;
+  for (size_t n = 0; n < total; n++) {
+    size_t   at     = 2 * channels + n;
+    uint16_t ch     = n % channels;
+    uint8_t  nibble = enc[ch].encode(g_source[at]);
+    if (n & 1)
+      p[n >> 1] |= nibble;
+    else
+      p[n >> 1] = (uint8_t)(nibble << 4);
+    g_expected[at] = (int16_t)enc[ch].s1;
+  }
+  return frames;
+}
+
+static int worstTrackError(size_t samples)
+{
+  int worst = 0;
+  for (size_t i = 0; i < samples; i++) {
+    int err = abs((int)g_output[i] - (int)g_source[i]);
+    if (err > worst)
+      worst = err;
+  }
+  return worst;
+}
+
+void setUp()
+{
+  memset(g_block, 0, sizeof(g_block));
+  memset(g_output, 0, sizeof(g_output));
+}
+
+void tearDown() {}
+
+void test_frames_per_block()
+{
+  TEST_ASSERT_EQUAL_UINT32(505, adpcmImaFramesPerBlock(256, 1));
+  TEST_ASSERT_EQUAL_UINT32(505, adpcmImaFramesPerBlock(512, 2));
+  TEST_ASSERT_EQUAL_UINT32(2041, adpcmImaFramesPerBlock(1024, 1));
+  TEST_ASSERT_EQUAL_UINT32(0, adpcmImaFramesPerBlock(4, 1));
+  TEST_ASSERT_EQUAL_UINT32(0, adpcmImaFramesPerBlock(256, 0));
+
+  TEST_ASSERT_EQUAL_UINT32(500, adpcmMsFramesPerBlock(256, 1));
+  TEST_ASSERT_EQUAL_UINT32(500, adpcmMsFramesPerBlock(512, 2));
+  TEST_ASSERT_EQUAL_UINT32(2, adpcmMsFramesPerBlock(7, 1));
+  TEST_ASSERT_EQUAL_UINT32(0, adpcmMsFramesPerBlock(6, 1));
+}
+
+void test_ima_matches_reference()
+{
+  for (uint16_t channels = 1; channels <= 2; channels++) {
+    size_t blockAlign = BLOCK_ALIGN * channels;
+    fillSource(MAX_FRAMES, channels);
+    size_t frames = encodeImaBlock(channels, blockAlign);
+
+    size_t decoded = adpcmImaDecodeBlock(g_block, blockAlign, channels, g_output, MAX_FRAMES);
+    TEST_ASSERT_EQUAL_size_t(frames, decoded);
+    TEST_ASSERT_EQUAL_MEMORY(g_expected, g_output, frames * channels * sizeof(int16_t));
+    TEST_ASSERT_LESS_OR_EQUAL_INT(MAX_TRACK_ERROR, worstTrackError(frames * channels));
+  }
+}
+
+void test_ms_matches_reference()
+{
+  for (uint16_t channels = 1; channels <= 2; channels++) {
+    for (int coef = 0; coef < 7; coef++) {
+      size_t blockAlign = BLOCK_ALIGN * channels;
+      fillSource(MAX_FRAMES, channels);
+      size_t frames = encodeMsBlock(channels, blockAlign, coef);
+
+      size_t decoded = adpcmMsDecodeBlock(g_block, blockAlign, channels, MS_STANDARD_COEFS, 7,
+                                          g_output, MAX_FRAMES);
+      TEST_ASSERT_EQUAL_size_t(frames, decoded);
+      TEST_ASSERT_EQUAL_MEMORY(g_expected, g_output, frames * channels * sizeof(int16_t));
+      TEST_ASSERT_LESS_OR_EQUAL_INT(MAX_TRACK_ERROR, worstTrackError(frames * channels));
+    }
+  }
+}
+
+// The last block of a file is often short, and the caller may want fewer
+// frames than the block holds; nothing past maxFrames may be written.
+void test_short_block_and_frame_limit()
+{
+  fillSource(MAX_FRAMES, 1);
+  encodeImaBlock(1, BLOCK_ALIGN);
+
+  TEST_ASSERT_EQUAL_size_t(17, adpcmImaDecodeBlock(g_block, 4 + 2 * 4, 1, g_output, MAX_FRAMES));
+  TEST_ASSERT_EQUAL_MEMORY(g_expected, g_output, 17 * sizeof(int16_t));
+
+  g_output[5] = 0x5A5A;
+  TEST_ASSERT_EQUAL_size_t(5, adpcmImaDecodeBlock(g_block, BLOCK_ALIGN, 1, g_output, 5));
+  TEST_ASSERT_EQUAL_MEMORY(g_expected, g_output, 5 * sizeof(int16_t));
+  TEST_ASSERT_EQUAL_INT16(0x5A5A, g_output[5]);
+
+  encodeMsBlock(1, BLOCK_ALIGN, 1);
+  g_output[9] = 0x5A5A;
+  TEST_ASSERT_EQUAL_size_t(9, adpcmMsDecodeBlock(g_block, 7 + 20, 1, MS_STANDARD_COEFS, 7,
+                                                 g_output, 9));
+  TEST_ASSERT_EQUAL_MEMORY(g_expected, g_output, 9 * sizeof(int16_t));
+  TEST_ASSERT_EQUAL_INT16(0x5A5A, g_output[9]);
+
+  TEST_ASSERT_EQUAL_size_t(0, adpcmImaDecodeBlock(g_block, 3, 1, g_output, MAX_FRAMES));
+  TEST_ASSERT_EQUAL_size_t(0, adpcmMsDecodeBlock(g_block, 6, 1, MS_STANDARD_COEFS, 7, g_output,
+                                                 MAX_FRAMES));
+}
+
+void setup()
+{
+  delay(2000); // Let the test runner open the port.
+
+  UNITY_BEGIN();
+  RUN_TEST(test_frames_per_block);
+  RUN_TEST(test_ima_matches_reference);
+  RUN_TEST(test_ms_matches_reference);
+  RUN_TEST(test_short_block_and_frame_limit);
+  UNITY_END();
+}
+
+void loop() {}
@@ -0,0 +1,89 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "crc32.h"
+
+// Slice-by-8 CRC-32 against the standard check value and a bit-at-a-time
+// reference. Runs on the board: pio test -e test -f test_crc32
+
+static const size_t TEST_BYTES = 1024;
+
+static uint8_t g_data[TEST_BYTES + 8];
+
+// Reflected 0xEDB88320, one bit per step, as in the gzip specification.
+static uint32_t referenceCrc(const uint8_t* data, size_t len)
+{
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+    }
+  }
+  return ~crc;
+}
+
+static void fillData()
+{
+  uint32_t seed = 12345;
+  for (size_t i = 0; i < sizeof(g_data); i++) {
+    seed      = seed * 1103515245u + 12345u;
+    g_data[i] = (uint8_t)(seed >> 16);
+  }
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_check_value()
+{
+  const char* check = "123456789";
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32Update(0, (const uint8_t*)check, 9));
+}
+
+void test_empty_input_keeps_crc()
+{
+  TEST_ASSERT_EQUAL_HEX32(0, crc32Update(0, g_data, 0));
+  TEST_ASSERT_EQUAL_HEX32(0x12345678, crc32Update(0x12345678, g_data, 0));
+}
+
+// Every length and start alignment around the 8-byte step and the aligned
+// head, so the byte loops on either side of the word loop are covered.
+void test_matches_reference()
+{
+  for (size_t start = 0; start < 8; start++) {
+    for (size_t len = 0; len <= 64; len++) {
+      TEST_ASSERT_EQUAL_HEX32(referenceCrc(g_data + start, len),
+                              crc32Update(0, g_data + start, len));
+    }
+  }
+  TEST_ASSERT_EQUAL_HEX32(referenceCrc(g_data + 3, TEST_BYTES),
+                          crc32Update(0, g_data + 3, TEST_BYTES));
+}
+
+// Upload chunks arrive in arbitrary sizes; the running CRC must not care.
+void test_split_matches_whole()
+{
+  uint32_t whole = crc32Update(0, g_data, TEST_BYTES);
+  for (size_t split = 0; split <= TEST_BYTES; split += 37) {
+    uint32_t crc = crc32Update(0, g_data, split);
+    crc          = crc32Update(crc, g_data + split, TEST_BYTES - split);
+    TEST_ASSERT_EQUAL_HEX32(whole, crc);
+  }
+}
+
+void setup()
+{
+  delay(2000); // Let the test runner open the port.
+  fillData();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_check_value);
+  RUN_TEST(test_empty_input_keeps_crc);
+  RUN_TEST(test_matches_reference);
+  RUN_TEST(test_split_matches_whole);
+  UNITY_END();
+}
+
+void loop() {}
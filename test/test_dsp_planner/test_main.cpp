@@ -0,0 +1,98 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "dsp_planner.h"
+#include "equalizer.h"
+#include "web_log.h"
+
+// Stage selection of the DSP planner from the equalizer's reported band count.
+// Runs on the board: pio test -e test -f test_dsp_planner
+
+static const uint32_t TEST_RATE = 44100;
+
+static DspPlanInput stereoInput()
+{
+  DspPlanInput in;
+  in.srcRate      = TEST_RATE;
+  in.srcChannels  = 2;
+  in.outRate      = TEST_RATE;
+  in.resample     = false;
+  in.resampleHold = false;
+  in.eqBands      = g_eqSettings.enabled ? eqGetActiveBandCount() : 0;
+  in.forceMono    = false;
+  in.dualCore     = false;
+  return in;
+}
+
+static bool hasStage(const DspPlan& plan, DspStage stage)
+{
+  for (int i = 0; i < plan.stageCount; i++) {
+    if (plan.stages[i] == stage)
+      return true;
+  }
+  return false;
+}
+
+void setUp()
+{
+  eqSetDefaults(g_eqSettings);
+  eqSetMaxBands(5);
+  eqUpdateCoefficients(TEST_RATE);
+}
+
+void tearDown() {}
+
+void test_flat_eq_not_planned()
+{
+  DspPlan plan = dspPlanBuild(stereoInput());
+  TEST_ASSERT_FALSE(hasStage(plan, DSP_STAGE_EQ));
+  TEST_ASSERT_FALSE(plan.gainFolded);
+}
+
+// The band count must be visible before the audio task has run eqPrepare(),
+// otherwise the planner drops EQ and never runs the stage that would apply it.
+void test_enabled_bands_planned_before_prepare()
+{
+  eqSetBand(1, 4.0f);
+  eqSetBand(3, -6.0f);
+  eqUpdateCoefficients(TEST_RATE);
+
+  DspPlanInput in = stereoInput();
+  TEST_ASSERT_EQUAL_INT(2, in.eqBands);
+
+  DspPlan plan = dspPlanBuild(in);
+  TEST_ASSERT_TRUE(hasStage(plan, DSP_STAGE_EQ));
+}
+
+void test_band_count_limited_by_max_bands()
+{
+  for (int b = 0; b < 5; b++) {
+    eqSetBand(b, 3.0f);
+  }
+  eqSetMaxBands(3);
+  TEST_ASSERT_EQUAL_INT(3, eqGetActiveBandCount());
+}
+
+void test_disabled_eq_not_planned()
+{
+  eqSetBand(2, 6.0f);
+  g_eqSettings.enabled = false;
+  DspPlan plan         = dspPlanBuild(stereoInput());
+  TEST_ASSERT_FALSE(hasStage(plan, DSP_STAGE_EQ));
+}
+
+void setup()
+{
+  delay(2000); // Let the test runner open the port.
+  webLogBegin();
+  eqInit();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_flat_eq_not_planned);
+  RUN_TEST(test_enabled_bands_planned_before_prepare);
+  RUN_TEST(test_band_count_limited_by_max_bands);
+  RUN_TEST(test_disabled_eq_not_planned);
+  UNITY_END();
+}
+
+void loop() {}
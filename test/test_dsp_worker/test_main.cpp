@@ -0,0 +1,188 @@
+#include <Arduino.h>
+#include <math.h>
+#include <unity.h>
+
+#include "dsp_worker.h"
+#include "equalizer.h"
+#include "web_log.h"
+
+// Split-core EQ against single-core EQ (bit for bit), an independent
+// double-precision reference and a known answer. Runs on the board: pio test -e test -f test_dsp_worker
+
+static const size_t   TEST_FRAMES   = 4096;
+static const uint32_t TEST_RATE     = 44100;
+static const float    TEST_GAINS[5] = {6.0f, -4.0f, 3.0f, -8.0f, 10.0f};
+static const double   BAND_HZ[5]    = {60, 250, 1000, 4000, 12000};
+static const double   BAND_Q[5]     = {0.7, 1.0, 1.2, 1.2, 0.8};
+
+// float biquads on the target against double here; a wrong coefficient or
+// band order shows up as hundreds of LSB.
+static const int MAX_ERROR_LSB = 8;
+
+static int16_t g_input[TEST_FRAMES * 2];
+static int16_t g_output[TEST_FRAMES * 2];
+static int16_t g_single[TEST_FRAMES * 2];
+
+// Chunk size for the bit-exact case, so filter state is carried across calls.
+static const size_t TEST_CHUNK = 512;
+
+// RBJ cookbook peaking filter, direct form I, in double precision.
+struct RefBiquad {
+  double b0, b1, b2, a1, a2;
+  double x1, x2, y1, y2;
+
+  void design(double rate, double f0, double gainDb, double q)
+  {
+    double A     = pow(10.0, gainDb / 40.0);
+    double w0    = 2.0 * M_PI * f0 / rate;
+    double alpha = sin(w0) / (2.0 * q);
+    double a0    = 1.0 + alpha / A;
+    b0           = (1.0 + alpha * A) / a0;
+    b1           = -2.0 * cos(w0) / a0;
+    b2           = (1.0 - alpha * A) / a0;
+    a1           = -2.0 * cos(w0) / a0;
+    a2           = (1.0 - alpha / A) / a0;
+    x1 = x2 = y1 = y2 = 0.0;
+  }
+
+  double process(double x)
+  {
+    double y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+    x2       = x1;
+    x1       = x;
+    y2       = y1;
+    y1       = y;
+    return y;
+  }
+};
+
+static int16_t clampSample(double v)
+{
+  if (v > 32767.0)
+    v = 32767.0;
+  if (v < -32768.0)
+    v = -32768.0;
+  return (int16_t)v;
+}
+
+// Two tones plus noise, different per channel.
+static void fillTestSignal(int16_t* buf, size_t frames)
+{
+  uint32_t seed = 12345;
+  for (size_t i = 0; i < frames; i++) {
+    seed           = seed * 1103515245u + 12345u;
+    int32_t noise  = (int32_t)((seed >> 16) & 0x3FF) - 512;
+    buf[i * 2]     = (int16_t)(8000.0f * sinf(2.0f * M_PI * 220.0f * i / TEST_RATE) + noise);
+    buf[i * 2 + 1] = (int16_t)(8000.0f * sinf(2.0f * M_PI * 3100.0f * i / TEST_RATE) - noise);
+  }
+}
+
+static void setGains(const float* gains)
+{
+  for (int b = 0; b < 5; b++) {
+    eqSetBand(b, gains[b]);
+  }
+  g_eqSettings.enabled = true;
+  eqUpdateCoefficients(TEST_RATE);
+  eqResetState();
+}
+
+void setUp() {}
+
+void tearDown()
+{
+  eqSetDefaults(g_eqSettings);
+  eqUpdateCoefficients(TEST_RATE);
+  eqResetState();
+}
+
+void test_split_matches_reference()
+{
+  TEST_ASSERT_TRUE(dspWorkerReady());
+  setGains(TEST_GAINS);
+  fillTestSignal(g_input, TEST_FRAMES);
+  memcpy(g_output, g_input, sizeof(g_output));
+  dspWorkerEqStereo(g_output, TEST_FRAMES, TEST_RATE);
+
+  int worst = 0;
+  for (int ch = 0; ch < 2; ch++) {
+    RefBiquad bands[5];
+    for (int b = 0; b < 5; b++) {
+      bands[b].design(TEST_RATE, BAND_HZ[b], TEST_GAINS[b], BAND_Q[b]);
+    }
+    for (size_t i = 0; i < TEST_FRAMES; i++) {
+      double v = g_input[i * 2 + ch];
+      for (int b = 0; b < 5; b++) {
+        v = bands[b].process(v);
+      }
+      int err = abs((int)clampSample(v) - (int)g_output[i * 2 + ch]);
+      if (err > worst)
+        worst = err;
+    }
+  }
+  TEST_ASSERT_LESS_OR_EQUAL_INT(MAX_ERROR_LSB, worst);
+}
+
+// Splitting the channels across cores must not change a single sample.
+void test_split_matches_single_core()
+{
+  TEST_ASSERT_TRUE(dspWorkerReady());
+  setGains(TEST_GAINS);
+  fillTestSignal(g_input, TEST_FRAMES);
+  memcpy(g_single, g_input, sizeof(g_single));
+  memcpy(g_output, g_input, sizeof(g_output));
+
+  for (size_t i = 0; i < TEST_FRAMES; i += TEST_CHUNK) {
+    eqProcessBuffer(g_single + i * 2, TEST_CHUNK, TEST_RATE);
+  }
+  eqResetState();
+  for (size_t i = 0; i < TEST_FRAMES; i += TEST_CHUNK) {
+    dspWorkerEqStereo(g_output + i * 2, TEST_CHUNK, TEST_RATE);
+  }
+
+  TEST_ASSERT_EQUAL_MEMORY(g_single, g_output, sizeof(g_output));
+}
+
+// A peaking band has exactly its gain at the centre frequency.
+void test_band_centre_gain()
+{
+  const float gains[5] = {0.0f, 0.0f, 6.0f, 0.0f, 0.0f};
+  setGains(gains);
+  for (size_t i = 0; i < TEST_FRAMES; i++) {
+    int16_t s          = (int16_t)(4000.0f * sinf(2.0f * M_PI * 1000.0f * i / TEST_RATE));
+    g_input[i * 2]     = s;
+    g_input[i * 2 + 1] = s;
+  }
+  memcpy(g_output, g_input, sizeof(g_output));
+  dspWorkerEqStereo(g_output, TEST_FRAMES, TEST_RATE);
+
+  // Skip the filter's settling time.
+  double inPower[2]  = {0, 0};
+  double outPower[2] = {0, 0};
+  for (size_t i = TEST_FRAMES / 2; i < TEST_FRAMES; i++) {
+    for (int ch = 0; ch < 2; ch++) {
+      inPower[ch] += (double)g_input[i * 2 + ch] * g_input[i * 2 + ch];
+      outPower[ch] += (double)g_output[i * 2 + ch] * g_output[i * 2 + ch];
+    }
+  }
+  for (int ch = 0; ch < 2; ch++) {
+    float gainDb = (float)(10.0 * log10(outPower[ch] / inPower[ch]));
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 6.0f, gainDb);
+  }
+}
+
+void setup()
+{
+  delay(2000); // Let the test runner open the port.
+  webLogBegin();
+  eqInit();
+  dspWorkerBegin();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_split_matches_single_core);
+  RUN_TEST(test_split_matches_reference);
+  RUN_TEST(test_band_centre_gain);
+  UNITY_END();
+}
+
+void loop() {}
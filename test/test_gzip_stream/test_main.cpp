@@ -0,0 +1,239 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "gzip_stream.h"
+
+// Streaming gzip decoder against streams made by gzip/zlib, fed whole and
+// in small pieces. Runs on the board: pio test -e test -f test_gzip_stream
+
+static const char*  HELLO_TEXT    = "Hello, gzip! ";
+static const int    HELLO_REPEATS = 20;
+static const size_t PATTERN_BYTES = 100000;
+
+// "Hello, gzip! " x 20 and a newline, written by gzip with its file name.
+static const uint8_t GZ_HELLO[] = {
+    0x1F, 0x8B, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x02, 0xFF, 0x68, 0x65, 0x6C, 0x6C, 0x6F, 0x2E,
+    0x74, 0x78, 0x74, 0x00, 0xF3, 0x48, 0xCD, 0xC9, 0xC9, 0xD7, 0x51, 0x48, 0xAF, 0xCA, 0x2C, 0x50,
+    0x54, 0xF0, 0x18, 0x99, 0x1C, 0x2E, 0x00, 0x2D, 0xDD, 0x8F, 0xB9, 0x05, 0x01, 0x00, 0x00,
+};
+
+// The same text with FEXTRA, FNAME, FCOMMENT and FHCRC set.
+static const uint8_t GZ_ALL_FIELDS[] = {
+    0x1F, 0x8B, 0x08, 0x1E, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x06, 0x00, 0x41, 0x42, 0x02, 0x00,
+    0x78, 0x79, 0x68, 0x65, 0x6C, 0x6C, 0x6F, 0x2E, 0x74, 0x78, 0x74, 0x00, 0x61, 0x20, 0x63, 0x6F,
+    0x6D, 0x6D, 0x65, 0x6E, 0x74, 0x00, 0x28, 0xDA, 0xF3, 0x48, 0xCD, 0xC9, 0xC9, 0xD7, 0x51, 0x48,
+    0xAF, 0xCA, 0x2C, 0x50, 0x54, 0xF0, 0x18, 0x99, 0x1C, 0x2E, 0x00, 0x2D, 0xDD, 0x8F, 0xB9, 0x05,
+    0x01, 0x00, 0x00,
+};
+
+// PATTERN_BYTES of patternByte(), longer than the 32 KB window.
+static const uint8_t GZ_PATTERN[] = {
+    0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xED, 0xCF, 0xD3, 0x92, 0x10, 0x00,
+    0x00, 0x00, 0xC0, 0xCB, 0xB6, 0x79, 0xD9, 0xB6, 0x6D, 0xDB, 0xB6, 0x6D, 0xD7, 0x65, 0xDB, 0xB6,
+    0x6D, 0xDB, 0xB6, 0x26, 0x4E, 0x9C, 0x38, 0x71, 0xF2, 0x6F, 0xF4, 0xB0, 0xFB, 0x07, 0x1B, 0x10,
+    0x26, 0x72, 0xAC, 0x84, 0xC9, 0xD3, 0x65, 0xCD, 0x53, 0xB8, 0x54, 0xC5, 0x1A, 0xF5, 0x9B, 0xB5,
+    0xED, 0xD2, 0x7B, 0xD0, 0x88, 0xF1, 0xD3, 0xE6, 0x2E, 0x59, 0xBD, 0x69, 0xE7, 0x81, 0xE3, 0xE7,
+    0xAE, 0xDE, 0x79, 0xF4, 0xE2, 0xDD, 0x97, 0x5F, 0x21, 0xC2, 0x47, 0x8B, 0x1B, 0x98, 0x2A, 0x63,
+    0x8E, 0xFC, 0xC5, 0xCA, 0x56, 0xA9, 0xDD, 0xA8, 0x65, 0x87, 0xEE, 0xFD, 0x86, 0x8E, 0x9E, 0x34,
+    0x73, 0xC1, 0xF2, 0x75, 0x5B, 0xF7, 0x1C, 0x3E, 0x75, 0xF1, 0xC6, 0xFD, 0xA7, 0xAF, 0x3F, 0x7E,
+    0xFF, 0x1B, 0x3A, 0x52, 0xCC, 0x04, 0xC9, 0xD2, 0x66, 0xC9, 0x5D, 0xA8, 0x64, 0x85, 0xEA, 0xF5,
+    0x9A, 0xB6, 0xE9, 0xDC, 0x6B, 0xE0, 0xF0, 0x71, 0x53, 0xE7, 0x2C, 0x5E, 0xB5, 0x71, 0xC7, 0xFE,
+    0x63, 0x67, 0xAF, 0xDC, 0x7E, 0xF8, 0xFC, 0xED, 0xE7, 0x9F, 0xC1, 0xC3, 0x45, 0x8D, 0x93, 0x38,
+    0x65, 0x86, 0xEC, 0xF9, 0x8A, 0x96, 0xA9, 0x5C, 0xAB, 0x61, 0x8B, 0xF6, 0xDD, 0xFA, 0x0E, 0x19,
+    0x35, 0x71, 0xC6, 0xFC, 0x65, 0x6B, 0xB7, 0xEC, 0x3E, 0x74, 0xF2, 0xC2, 0xF5, 0x7B, 0x4F, 0x5E,
+    0x7D, 0xF8, 0xF6, 0x27, 0x54, 0xC4, 0x18, 0xF1, 0x93, 0xA6, 0xC9, 0x9C, 0xAB, 0x60, 0x89, 0xF2,
+    0xD5, 0xEA, 0x36, 0x69, 0xDD, 0xA9, 0xE7, 0x80, 0xA0, 0xB1, 0x53, 0x66, 0x2F, 0x5A, 0xB9, 0x61,
+    0xFB, 0xBE, 0xA3, 0x67, 0x2E, 0xDF, 0x7A, 0xF0, 0xEC, 0xCD, 0xA7, 0x1F, 0xC1, 0xC2, 0x46, 0x89,
+    0x9D, 0x28, 0x45, 0xFA, 0x6C, 0x79, 0x8B, 0x94, 0xAE, 0x54, 0xB3, 0x41, 0xF3, 0x76, 0x5D, 0xFB,
+    0x0C, 0x1E, 0x39, 0x61, 0xFA, 0xBC, 0xA5, 0x6B, 0x36, 0xEF, 0x3A, 0x78, 0xE2, 0xFC, 0xB5, 0xBB,
+    0x8F, 0x5F, 0xBE, 0xFF, 0xFA, 0x3B, 0x64, 0x84, 0xE8, 0xF1, 0x92, 0xA4, 0xCE, 0x94, 0xB3, 0x40,
+    0xF1, 0x72, 0x55, 0xEB, 0x34, 0x6E, 0xD5, 0xB1, 0x47, 0xFF, 0x61, 0x63, 0x26, 0xCF, 0x5A, 0xB8,
+    0x62, 0xFD, 0xB6, 0xBD, 0x47, 0x4E, 0x5F, 0xBA, 0x19, 0xA0, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE,
+    0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xAE, 0xFE, 0xBF, 0xD7, 0xFF, 0x01,
+    0xF1, 0xB0, 0x1F, 0xFE, 0xA0, 0x86, 0x01, 0x00,
+};
+
+static uint8_t patternByte(size_t i)
+{
+  return (uint8_t)((i % 251) * 7);
+}
+
+// Collects the output, or with `pattern` set checks it against patternByte()
+// as it arrives so long streams need no buffer.
+struct Sink {
+  String out;
+  size_t bytes;
+  bool   pattern;
+  bool   patternOk;
+  size_t stopAfter; // Refuse output once this many bytes arrived (0 = never).
+};
+
+static bool collect(const uint8_t* data, size_t len, void* ctx)
+{
+  Sink* s = (Sink*)ctx;
+  for (size_t i = 0; i < len; i++) {
+    if (s->pattern)
+      s->patternOk = s->patternOk && data[i] == patternByte(s->bytes + i);
+    else
+      s->out += (char)data[i];
+  }
+  s->bytes += len;
+  return s->stopAfter == 0 || s->bytes < s->stopAfter;
+}
+
+static GzipStream g_gz;
+
+// Feed in pieces of `step` bytes (0 = all at once).
+static bool decode(const uint8_t* data, size_t len, size_t step, Sink& sink)
+{
+  bool   ok  = gzipBegin(&g_gz, collect, &sink);
+  size_t pos = 0;
+  while (ok && pos < len) {
+    size_t n = step == 0 || step > len - pos ? len - pos : step;
+    ok       = gzipFeed(&g_gz, data + pos, n);
+    pos += n;
+  }
+  return ok;
+}
+
+static String helloText()
+{
+  String text;
+  for (int i = 0; i < HELLO_REPEATS; i++) {
+    text += HELLO_TEXT;
+  }
+  text += "\n";
+  return text;
+}
+
+void setUp() {}
+
+void tearDown()
+{
+  gzipEnd(&g_gz);
+}
+
+void test_sniff()
+{
+  TEST_ASSERT_TRUE(gzipSniff(GZ_HELLO, sizeof(GZ_HELLO)));
+  TEST_ASSERT_FALSE(gzipSniff(GZ_HELLO, 1));
+  TEST_ASSERT_FALSE(gzipSniff((const uint8_t*)"PK", 2));
+}
+
+void test_small_stream()
+{
+  const size_t steps[] = {0, 1, 3, 16};
+  for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+    Sink sink = {"", 0, false, true, 0};
+    TEST_ASSERT_TRUE(decode(GZ_HELLO, sizeof(GZ_HELLO), steps[s], sink));
+    TEST_ASSERT_TRUE(gzipDone(&g_gz));
+    TEST_ASSERT_EQUAL_STRING(helloText().c_str(), sink.out.c_str());
+    gzipEnd(&g_gz);
+  }
+}
+
+void test_all_header_fields()
+{
+  Sink sink = {"", 0, false, true, 0};
+  TEST_ASSERT_TRUE(decode(GZ_ALL_FIELDS, sizeof(GZ_ALL_FIELDS), 1, sink));
+  TEST_ASSERT_TRUE(gzipDone(&g_gz));
+  TEST_ASSERT_EQUAL_STRING(helloText().c_str(), sink.out.c_str());
+}
+
+// Output runs around the circular window several times.
+void test_long_stream()
+{
+  const size_t steps[] = {0, 1, 7, 4096};
+  for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+    Sink sink = {"", 0, true, true, 0};
+    TEST_ASSERT_TRUE(decode(GZ_PATTERN, sizeof(GZ_PATTERN), steps[s], sink));
+    TEST_ASSERT_TRUE(gzipDone(&g_gz));
+    TEST_ASSERT_EQUAL_UINT32(PATTERN_BYTES, sink.bytes);
+    TEST_ASSERT_TRUE(sink.patternOk);
+    gzipEnd(&g_gz);
+  }
+}
+
+void test_trailer_mismatch()
+{
+  static uint8_t bad[sizeof(GZ_HELLO)];
+  memcpy(bad, GZ_HELLO, sizeof(bad));
+  bad[sizeof(bad) - 8] ^= 0x01; // CRC-32.
+
+  Sink sink = {"", 0, false, true, 0};
+  TEST_ASSERT_FALSE(decode(bad, sizeof(bad), 0, sink));
+  TEST_ASSERT_FALSE(gzipDone(&g_gz));
+  TEST_ASSERT_EQUAL_STRING("CRC mismatch", gzipError(&g_gz));
+  gzipEnd(&g_gz);
+
+  memcpy(bad, GZ_HELLO, sizeof(bad));
+  bad[sizeof(bad) - 4] ^= 0x01; // Length.
+  sink = {"", 0, false, true, 0};
+  TEST_ASSERT_FALSE(decode(bad, sizeof(bad), 0, sink));
+  TEST_ASSERT_EQUAL_STRING("length mismatch", gzipError(&g_gz));
+}
+
+void test_truncated_stream()
+{
+  Sink sink = {"", 0, false, true, 0};
+  TEST_ASSERT_TRUE(decode(GZ_HELLO, sizeof(GZ_HELLO) - 4, 0, sink));
+  TEST_ASSERT_FALSE(gzipDone(&g_gz));
+  TEST_ASSERT_NULL(gzipError(&g_gz));
+}
+
+void test_not_gzip()
+{
+  const uint8_t zip[12] = {'P', 'K', 3, 4};
+  Sink          sink    = {"", 0, false, true, 0};
+  TEST_ASSERT_FALSE(decode(zip, sizeof(zip), 0, sink));
+  TEST_ASSERT_EQUAL_STRING("not gzip/deflate", gzipError(&g_gz));
+}
+
+void test_sink_stops_decoding()
+{
+  Sink sink = {"", 0, true, true, 1000};
+  TEST_ASSERT_FALSE(decode(GZ_PATTERN, sizeof(GZ_PATTERN), 0, sink));
+  TEST_ASSERT_EQUAL_STRING("stopped", gzipError(&g_gz));
+  TEST_ASSERT_FALSE(gzipDone(&g_gz));
+}
+
+void setup()
+{
+  delay(2000); // Let the test runner open the port.
+
+  UNITY_BEGIN();
+  RUN_TEST(test_sniff);
+  RUN_TEST(test_small_stream);
+  RUN_TEST(test_all_header_fields);
+  RUN_TEST(test_long_stream);
+  RUN_TEST(test_trailer_mismatch);
+  RUN_TEST(test_truncated_stream);
+  RUN_TEST(test_not_gzip);
+  RUN_TEST(test_sink_stops_decoding);
+  UNITY_END();
+}
+
+void loop() {}
@@ -0,0 +1,201 @@
+#include <Arduino.h>
+#include <SD.h>
+#include <SPI.h>
+#include <unity.h>
+
+#include "app_config.h"
+#include "media_library.h"
+#include "media_search.h"
+#include "sd_bus.h"
+#include "web_log.h"
+
+// Search over files the library has just been told about. Until its next
+// merge they are matched directly, once the index has caught up through it,
+// so the same answers are checked in both states. Needs a FAT32 card in
+// the player's slot; the files are removed again at the end.
+// Runs on the board: pio test -e test -f test_media_search
+
+static const char* TEST_DIR = "/searchtest";
+
+// Merge, tag probing and the index build each wait for the card to be quiet;
+// on a large card the index may not catch up within this.
+static const uint32_t SETTLE_TIMEOUT_MS = 5 * 60 * 1000;
+
+static const char* TEST_FILES[] = {
+    "/searchtest/Quokka Zebrafinch.mp3",
+    "/searchtest/quokka-live.flac",
+    "/searchtest/Wombatquokka.wav",
+    "/searchtest/notes.txt",
+};
+static const int TEST_FILE_COUNT = sizeof(TEST_FILES) / sizeof(TEST_FILES[0]);
+
+static bool g_cardReady = false;
+
+// Results inside TEST_DIR, so other files on the card do not matter.
+struct Results {
+  String names;
+  int    count;
+};
+
+static bool collect(const LibraryEntry& entry, void* ctx)
+{
+  Results* r = (Results*)ctx;
+  if (entry.path.startsWith(String(TEST_DIR) + "/")) {
+    r->names += entry.name + "|";
+    r->count++;
+  }
+  return true;
+}
+
+static Results run(const char* query, SearchMode mode, uint32_t offset = 0, uint32_t limit = 50,
+                   bool* more = nullptr)
+{
+  Results r = {"", 0};
+  searchRun(query, mode, offset, limit, collect, &r, more);
+  return r;
+}
+
+static bool mountCard()
+{
+  SPI.begin(SD_SCK, SD_MISO, SD_MOSI, SD_CS);
+  return SD.begin(SD_CS, SPI, 4000000);
+}
+
+static void createFiles()
+{
+  SD.mkdir(TEST_DIR);
+  for (int i = 0; i < TEST_FILE_COUNT; i++) {
+    File f = SD.open(TEST_FILES[i], FILE_WRITE);
+    f.print("not really audio");
+    f.close();
+    libraryNoteChanged(TEST_FILES[i]);
+  }
+}
+
+static void removeFiles()
+{
+  for (int i = 0; i < TEST_FILE_COUNT; i++) {
+    SD.remove(TEST_FILES[i]);
+    libraryNoteRemoved(TEST_FILES[i]);
+  }
+  SD.rmdir(TEST_DIR);
+  libraryNoteRemoved(TEST_DIR);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_card_mounted()
+{
+  TEST_ASSERT_TRUE_MESSAGE(g_cardReady, "No SD card in the slot");
+}
+
+void test_prefix_matches_word_starts()
+{
+  Results r = run("quokka", SEARCH_PREFIX);
+  TEST_ASSERT_EQUAL_INT(2, r.count);
+  TEST_ASSERT_TRUE(r.names.indexOf("Quokka Zebrafinch.mp3|") >= 0);
+  TEST_ASSERT_TRUE(r.names.indexOf("quokka-live.flac|") >= 0);
+
+  TEST_ASSERT_EQUAL_INT(1, run("zebra", SEARCH_PREFIX).count);
+  TEST_ASSERT_EQUAL_INT(0, run("finch", SEARCH_PREFIX).count);
+}
+
+void test_substring_matches_inside_words()
+{
+  Results r = run("quokka", SEARCH_SUBSTRING);
+  TEST_ASSERT_EQUAL_INT(3, r.count);
+  TEST_ASSERT_TRUE(r.names.indexOf("Wombatquokka.wav|") >= 0);
+
+  TEST_ASSERT_EQUAL_INT(1, run("finch", SEARCH_SUBSTRING).count);
+}
+
+void test_case_and_punctuation_are_ignored()
+{
+  TEST_ASSERT_EQUAL_INT(2, run("QUOKKA", SEARCH_PREFIX).count);
+  TEST_ASSERT_EQUAL_INT(1, run("quokka-LIVE", SEARCH_PREFIX).count);
+  TEST_ASSERT_EQUAL_INT(1, run("  Zebrafinch!  ", SEARCH_PREFIX).count);
+}
+
+void test_all_terms_must_match()
+{
+  TEST_ASSERT_EQUAL_INT(1, run("live quokka", SEARCH_PREFIX).count);
+  TEST_ASSERT_EQUAL_INT(1, run("quokka wombat", SEARCH_SUBSTRING).count);
+  TEST_ASSERT_EQUAL_INT(0, run("quokka wombat", SEARCH_PREFIX).count);
+}
+
+// The extension is not part of the searchable name.
+void test_extension_is_not_searched()
+{
+  TEST_ASSERT_EQUAL_INT(0, run("mp3", SEARCH_SUBSTRING).count);
+  TEST_ASSERT_EQUAL_INT(1, run("notes", SEARCH_PREFIX).count);
+  TEST_ASSERT_EQUAL_INT(0, run("flac", SEARCH_PREFIX).count);
+}
+
+void test_paging()
+{
+  bool    more = false;
+  Results page = run("quokka", SEARCH_SUBSTRING, 0, 2, &more);
+  TEST_ASSERT_EQUAL_INT(2, page.count);
+  TEST_ASSERT_TRUE(more);
+
+  Results rest = run("quokka", SEARCH_SUBSTRING, 2, 2, &more);
+  TEST_ASSERT_EQUAL_INT(1, rest.count);
+  TEST_ASSERT_FALSE(more);
+  TEST_ASSERT_TRUE(page.names.indexOf(rest.names) < 0);
+}
+
+// Changes merged and the search index built over the result.
+static bool waitForIndex()
+{
+  uint32_t startMs = millis();
+  while (millis() - startMs < SETTLE_TIMEOUT_MS) {
+    bool merged  = libraryGetStatsJson().indexOf("\"pendingChanges\":0,") >= 0;
+    bool current = searchGetStatsJson().indexOf("\"current\":true") >= 0;
+    if (merged && current)
+      return true;
+    delay(1000);
+  }
+  return false;
+}
+
+static void runAll()
+{
+  RUN_TEST(test_prefix_matches_word_starts);
+  RUN_TEST(test_substring_matches_inside_words);
+  RUN_TEST(test_case_and_punctuation_are_ignored);
+  RUN_TEST(test_all_terms_must_match);
+  RUN_TEST(test_extension_is_not_searched);
+  RUN_TEST(test_paging);
+}
+
+void setup()
+{
+  delay(2000); // Let the test runner open the port.
+  webLogBegin();
+
+  UNITY_BEGIN();
+  g_cardReady = mountCard();
+  RUN_TEST(test_card_mounted);
+  if (!g_cardReady) {
+    UNITY_END();
+    return;
+  }
+
+  sdBusBegin();
+  libraryBegin();
+  searchBegin();
+  createFiles();
+
+  runAll();
+  if (waitForIndex())
+    runAll();
+  else
+    TEST_MESSAGE("Search index did not catch up, indexed pass skipped");
+
+  removeFiles();
+  UNITY_END();
+}
+
+void loop() {}
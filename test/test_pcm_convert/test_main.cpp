@@ -0,0 +1,154 @@
+#include <Arduino.h>
+#include <math.h>
+#include <unity.h>
+
+#include "pcm_convert.h"
+
+// WAV sample format converters against values derived from the format
+// definitions. Runs on the board: pio test -e test -f test_pcm_convert
+
+static const size_t TEST_SAMPLES = 64;
+
+static uint8_t g_src[TEST_SAMPLES * 4 + 1];
+static int16_t g_dst[TEST_SAMPLES + 1];
+
+static void fillRandom(uint8_t* p, size_t len)
+{
+  uint32_t seed = 12345;
+  for (size_t i = 0; i < len; i++) {
+    seed = seed * 1103515245u + 12345u;
+    p[i] = (uint8_t)(seed >> 16);
+  }
+}
+
+// G.711 from its segment definition: sign, 3-bit exponent, 4-bit mantissa.
+// Magnitudes are in 13-bit (A-law) or 14-bit (mu-law) units before scaling.
+static int16_t referenceALaw(uint8_t code)
+{
+  uint8_t a   = code ^ 0x55;
+  int     exp = (a >> 4) & 7;
+  int     man = a & 0x0F;
+  int     mag = exp == 0 ? 2 * man + 1 : (2 * man + 33) << (exp - 1);
+  return (int16_t)((a & 0x80) ? mag * 8 : -mag * 8);
+}
+
+static int16_t referenceMuLaw(uint8_t code)
+{
+  uint8_t u   = (uint8_t)~code;
+  int     exp = (u >> 4) & 7;
+  int     man = u & 0x0F;
+  int     mag = ((2 * man + 33) << exp) - 33;
+  return (int16_t)((u & 0x80) ? -mag * 4 : mag * 4);
+}
+
+void setUp()
+{
+  memset(g_dst, 0, sizeof(g_dst));
+}
+
+void tearDown() {}
+
+void test_alaw()
+{
+  uint8_t codes[256];
+  int16_t out[256];
+  for (int i = 0; i < 256; i++) {
+    codes[i] = (uint8_t)i;
+  }
+  pcmConvertALaw(codes, out, 256);
+
+  for (int i = 0; i < 256; i++) {
+    TEST_ASSERT_EQUAL_INT16(referenceALaw((uint8_t)i), out[i]);
+  }
+  TEST_ASSERT_EQUAL_INT16(8, out[0xD5]);
+  TEST_ASSERT_EQUAL_INT16(-8, out[0x55]);
+  TEST_ASSERT_EQUAL_INT16(32256, out[0xAA]);
+  TEST_ASSERT_EQUAL_INT16(-32256, out[0x2A]);
+}
+
+void test_mulaw()
+{
+  uint8_t codes[256];
+  int16_t out[256];
+  for (int i = 0; i < 256; i++) {
+    codes[i] = (uint8_t)i;
+  }
+  pcmConvertMuLaw(codes, out, 256);
+
+  for (int i = 0; i < 256; i++) {
+    TEST_ASSERT_EQUAL_INT16(referenceMuLaw((uint8_t)i), out[i]);
+  }
+  TEST_ASSERT_EQUAL_INT16(0, out[0xFF]);
+  TEST_ASSERT_EQUAL_INT16(0, out[0x7F]);
+  TEST_ASSERT_EQUAL_INT16(32124, out[0x80]);
+  TEST_ASSERT_EQUAL_INT16(-32124, out[0x00]);
+}
+
+void test_u8()
+{
+  const uint8_t src[3] = {0, 128, 255};
+  pcmConvertU8(src, g_dst, 3);
+  TEST_ASSERT_EQUAL_INT16(-32768, g_dst[0]);
+  TEST_ASSERT_EQUAL_INT16(0, g_dst[1]);
+  TEST_ASSERT_EQUAL_INT16(32512, g_dst[2]);
+}
+
+// Every count from 1 to 9 runs the four-sample word path and the tail, from
+// an odd address as well.
+void test_s24()
+{
+  fillRandom(g_src, sizeof(g_src));
+  for (size_t offset = 0; offset < 2; offset++) {
+    for (size_t count = 1; count <= 9; count++) {
+      const uint8_t* src = g_src + offset;
+      g_dst[count]       = 0x5A5A;
+      pcmConvertS24(src, g_dst, count);
+
+      for (size_t i = 0; i < count; i++) {
+        // Sign-extended 24-bit value, top 16 bits kept.
+        const uint8_t* s = src + 3 * i;
+        int32_t        v = (int32_t)((uint32_t)s[0] << 8 | (uint32_t)s[1] << 16 |
+                                     (uint32_t)s[2] << 24);
+        TEST_ASSERT_EQUAL_INT16((int16_t)(v >> 16), g_dst[i]);
+      }
+      TEST_ASSERT_EQUAL_INT16(0x5A5A, g_dst[count]);
+    }
+  }
+}
+
+void test_s32()
+{
+  fillRandom(g_src, sizeof(g_src));
+  pcmConvertS32(g_src, g_dst, TEST_SAMPLES);
+  for (size_t i = 0; i < TEST_SAMPLES; i++) {
+    int32_t v;
+    memcpy(&v, g_src + 4 * i, sizeof(v));
+    TEST_ASSERT_EQUAL_INT16((int16_t)(v >> 16), g_dst[i]);
+  }
+}
+
+void test_f32()
+{
+  const float   in[8]       = {0.0f, 1.0f, -1.0f, 0.5f, 2.0f, -2.0f, -0.25f, NAN};
+  const int16_t expected[8] = {0, 32767, -32767, 16384, 32767, -32768, -8192, 0};
+  pcmConvertF32((const uint8_t*)in, g_dst, 8);
+  for (int i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL_INT16(expected[i], g_dst[i]);
+  }
+}
+
+void setup()
+{
+  delay(2000); // Let the test runner open the port.
+
+  UNITY_BEGIN();
+  RUN_TEST(test_alaw);
+  RUN_TEST(test_mulaw);
+  RUN_TEST(test_u8);
+  RUN_TEST(test_s24);
+  RUN_TEST(test_s32);
+  RUN_TEST(test_f32);
+  UNITY_END();
+}
+
+void loop() {}
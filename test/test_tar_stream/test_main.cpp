@@ -0,0 +1,270 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "tar_stream.h"
+
+// Incremental tar reader against archives built here, fed whole and in
+// small pieces. Runs on the board: pio test -e test -f test_tar_stream
+
+static const size_t ARCHIVE_MAX = 16 * 1024;
+
+static uint8_t g_archive[ARCHIVE_MAX];
+static size_t  g_archiveLen = 0;
+
+// Events as text, plus a running check of the file data against the
+// pattern it was written with.
+struct Recorder {
+  String   log;
+  uint32_t dataBytes;
+  bool     dataOk;
+  int      stopAt; // Event number whose callback returns false, or -1.
+  int      events;
+};
+
+static uint8_t patternByte(size_t i)
+{
+  return (uint8_t)(i * 7 + 3);
+}
+
+// ----------------------------------------------------------------------------
+// Archive builder
+// ----------------------------------------------------------------------------
+
+static void putOctal(uint8_t* p, size_t width, uint64_t v)
+{
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%0*llo", (int)(width - 1), (unsigned long long)v);
+  memcpy(p, buf, width - 1);
+  p[width - 1] = '\0';
+}
+
+static void addHeader(const char* name, char type, uint64_t size, const char* prefix = nullptr)
+{
+  uint8_t* h = g_archive + g_archiveLen;
+  memset(h, 0, TAR_BLOCK);
+  strncpy((char*)h, name, 100);
+  putOctal(h + 100, 8, 0644);
+  putOctal(h + 108, 8, 0);
+  putOctal(h + 116, 8, 0);
+  putOctal(h + 124, 12, size);
+  putOctal(h + 136, 12, 0);
+  h[156] = (uint8_t)type;
+  memcpy(h + 257, "ustar\0" "00", 8);
+  if (prefix)
+    strncpy((char*)h + 345, prefix, 155);
+
+  uint32_t sum = 0;
+  memset(h + 148, ' ', 8);
+  for (size_t i = 0; i < TAR_BLOCK; i++) {
+    sum += h[i];
+  }
+  putOctal(h + 148, 7, sum);
+  g_archiveLen += TAR_BLOCK;
+}
+
+// Entry data, padded to the next block.
+static void addData(const uint8_t* data, size_t len)
+{
+  memcpy(g_archive + g_archiveLen, data, len);
+  size_t padded = (len + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+  memset(g_archive + g_archiveLen + len, 0, padded - len);
+  g_archiveLen += padded;
+}
+
+static void addFile(const char* name, size_t size, const char* prefix = nullptr)
+{
+  static uint8_t data[2048];
+  for (size_t i = 0; i < size; i++) {
+    data[i] = patternByte(i);
+  }
+  addHeader(name, '0', size, prefix);
+  addData(data, size);
+}
+
+static void addEnd()
+{
+  memset(g_archive + g_archiveLen, 0, 2 * TAR_BLOCK);
+  g_archiveLen += 2 * TAR_BLOCK;
+}
+
+// ----------------------------------------------------------------------------
+// Reading
+// ----------------------------------------------------------------------------
+
+static bool recordEvent(TarEvent event, const char* name, const uint8_t* data, size_t len,
+                        void* ctx)
+{
+  Recorder* r = (Recorder*)ctx;
+  if (r->events++ == r->stopAt)
+    return false;
+
+  char line[200];
+  switch (event) {
+  case TAR_DIR:
+    snprintf(line, sizeof(line), "D %s|", name);
+    break;
+  case TAR_FILE_BEGIN:
+    r->dataBytes = 0;
+    snprintf(line, sizeof(line), "B %s %u|", name, (unsigned)len);
+    break;
+  case TAR_FILE_DATA:
+    for (size_t i = 0; i < len; i++) {
+      r->dataOk = r->dataOk && data[i] == patternByte(r->dataBytes + i);
+    }
+    r->dataBytes += len;
+    return true;
+  case TAR_FILE_END:
+    snprintf(line, sizeof(line), "E %s %u|", name, (unsigned)r->dataBytes);
+    break;
+  }
+  r->log += line;
+  return true;
+}
+
+// Feed the archive in pieces of `step` bytes (0 = all at once).
+static bool readArchive(Recorder& r, TarReader& tar, size_t step)
+{
+  r.log       = "";
+  r.dataBytes = 0;
+  r.dataOk    = true;
+  r.events    = 0;
+  tarBegin(&tar, recordEvent, &r);
+
+  size_t pos = 0;
+  while (pos < g_archiveLen) {
+    size_t n = step == 0 || step > g_archiveLen - pos ? g_archiveLen - pos : step;
+    if (!tarFeed(&tar, g_archive + pos, n))
+      return false;
+    pos += n;
+  }
+  return true;
+}
+
+static TarReader g_tar;
+
+void setUp()
+{
+  g_archiveLen = 0;
+}
+
+void tearDown() {}
+
+static void buildBasic()
+{
+  addHeader("music/", '5', 0);
+  addFile("music/a.txt", 700);
+  addFile("music/empty", 0);
+  addFile("b.bin", 512, "deep/path");
+  addHeader("old/", '0', 0); // Pre-ustar directory: trailing slash only.
+  addHeader("music/link", '2', 0);
+  addFile("c.raw", 1);
+  addEnd();
+}
+
+static const char* BASIC_LOG = "D music/|B music/a.txt 700|E music/a.txt 700|B music/empty 0|"
+                               "E music/empty 0|B deep/path/b.bin 512|E deep/path/b.bin 512|"
+                               "D old/|B c.raw 1|E c.raw 1|";
+
+void test_entries_in_one_piece()
+{
+  buildBasic();
+  Recorder r = {"", 0, true, -1, 0};
+  TEST_ASSERT_TRUE(readArchive(r, g_tar, 0));
+  TEST_ASSERT_TRUE(tarDone(&g_tar));
+  TEST_ASSERT_NULL(tarError(&g_tar));
+  TEST_ASSERT_EQUAL_STRING(BASIC_LOG, r.log.c_str());
+  TEST_ASSERT_TRUE(r.dataOk);
+}
+
+// Uploads arrive in arbitrary chunks; one byte at a time is the worst case.
+void test_entries_in_small_pieces()
+{
+  buildBasic();
+  const size_t steps[] = {1, 37, 511, 513};
+  for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+    Recorder r = {"", 0, true, -1, 0};
+    TEST_ASSERT_TRUE(readArchive(r, g_tar, steps[s]));
+    TEST_ASSERT_TRUE(tarDone(&g_tar));
+    TEST_ASSERT_EQUAL_STRING(BASIC_LOG, r.log.c_str());
+    TEST_ASSERT_TRUE(r.dataOk);
+  }
+}
+
+void test_long_names()
+{
+  char longName[160];
+  memset(longName, 'n', sizeof(longName));
+  memcpy(longName, "long/", 5);
+  longName[150] = '\0';
+
+  // GNU: the name is the data of a preceding 'L' entry, NUL-terminated.
+  addHeader("././@LongLink", 'L', strlen(longName) + 1);
+  addData((const uint8_t*)longName, strlen(longName) + 1);
+  addFile("long/nnnn", 10);
+
+  // pax: "<len> path=<value>\n", the length counting the whole record.
+  const char* pax = "24 path=pax/renamed.txt\n";
+  addHeader("PaxHeaders/x", 'x', strlen(pax));
+  addData((const uint8_t*)pax, strlen(pax));
+  addFile("short.txt", 3);
+  addEnd();
+
+  String expected = String("B ") + longName + " 10|E " + longName + " 10|" +
+                    "B pax/renamed.txt 3|E pax/renamed.txt 3|";
+
+  Recorder r = {"", 0, true, -1, 0};
+  TEST_ASSERT_TRUE(readArchive(r, g_tar, 100));
+  TEST_ASSERT_TRUE(tarDone(&g_tar));
+  TEST_ASSERT_EQUAL_STRING(expected.c_str(), r.log.c_str());
+}
+
+void test_bad_checksum()
+{
+  addFile("a.txt", 10);
+  addEnd();
+  g_archive[5] ^= 0x20; // Inside the name field.
+
+  Recorder r = {"", 0, true, -1, 0};
+  TEST_ASSERT_FALSE(readArchive(r, g_tar, 0));
+  TEST_ASSERT_FALSE(tarDone(&g_tar));
+  TEST_ASSERT_EQUAL_STRING("bad header checksum", tarError(&g_tar));
+  TEST_ASSERT_EQUAL_STRING("", r.log.c_str());
+}
+
+void test_callback_stops_reading()
+{
+  buildBasic();
+  Recorder r = {"", 0, true, 1, 0}; // Refuse the first file.
+  TEST_ASSERT_FALSE(readArchive(r, g_tar, 0));
+  TEST_ASSERT_EQUAL_STRING("stopped", tarError(&g_tar));
+  TEST_ASSERT_EQUAL_STRING("D music/|", r.log.c_str());
+}
+
+void test_data_after_end_is_ignored()
+{
+  addFile("a.txt", 10);
+  addEnd();
+  memset(g_archive + g_archiveLen, 0x5A, TAR_BLOCK);
+  g_archiveLen += TAR_BLOCK;
+
+  Recorder r = {"", 0, true, -1, 0};
+  TEST_ASSERT_TRUE(readArchive(r, g_tar, 0));
+  TEST_ASSERT_TRUE(tarDone(&g_tar));
+  TEST_ASSERT_EQUAL_STRING("B a.txt 10|E a.txt 10|", r.log.c_str());
+}
+
+void setup()
+{
+  delay(2000); // Let the test runner open the port.
+
+  UNITY_BEGIN();
+  RUN_TEST(test_entries_in_one_piece);
+  RUN_TEST(test_entries_in_small_pieces);
+  RUN_TEST(test_long_names);
+  RUN_TEST(test_bad_checksum);
+  RUN_TEST(test_callback_stops_reading);
+  RUN_TEST(test_data_after_end_is_ignored);
+  UNITY_END();
+}
+
+void loop() {}